@@ -0,0 +1,212 @@
+#include "DiskBuffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const size_t PAGE_BYTES = 1 << 16;
+	const size_t NO_BLOCK = SIZE_MAX;
+
+	bool SeekTo(FILE* file, size_t offset)
+	{
+#ifdef _WIN32
+		return _fseeki64(file, static_cast<long long>(offset), SEEK_SET) == 0;
+#else
+		return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+	}
+
+	//! a file name no other buffer of any process uses
+	std::string TempName(const char* directory)
+	{
+		static std::atomic<unsigned int> counter(0);
+#ifdef _WIN32
+		int pid = _getpid();
+#else
+		int pid = static_cast<int>(getpid());
+#endif
+		std::string path = directory;
+		if (path.back() != '/' && path.back() != '\\')
+		{
+			path += '/';
+		}
+		return path + "diskbuffer_" + std::to_string(pid) + "_" + std::to_string(counter++) + ".tmp";
+	}
+
+	inline size_t HashBlock(size_t block)
+	{
+		unsigned long long h = static_cast<unsigned long long>(block) * 0x9E3779B97F4A7C15ull;
+		return static_cast<size_t>(h ^ (h >> 32));
+	}
+}
+
+DiskBuffer::DiskBuffer(void)
+	: file_(NULL), record_size_(0), size_(0), file_bytes_(0), page_bytes_(PAGE_BYTES), failed_(false)
+{
+}
+
+DiskBuffer::~DiskBuffer(void)
+{
+	Close();
+}
+
+bool DiskBuffer::Create(const char* directory, size_t record_size, size_t cache_bytes)
+{
+	Close();
+	if (record_size == 0)
+	{
+		return false;
+	}
+	if (directory != NULL && directory[0] != 0)
+	{
+		// the file goes away when closed, even if the process is killed
+		std::string path = TempName(directory);
+#ifdef _WIN32
+		file_ = fopen(path.c_str(), "w+bTD");
+#else
+		file_ = fopen(path.c_str(), "w+b");
+		if (file_ != NULL)
+		{
+			remove(path.c_str());
+		}
+#endif
+	}
+	else
+	{
+		file_ = tmpfile();
+	}
+	if (file_ == NULL)
+	{
+		return false;
+	}
+	record_size_ = record_size;
+	size_ = 0;
+	file_bytes_ = 0;
+	failed_ = false;
+	pages_.resize(std::max<size_t>(cache_bytes / page_bytes_, 1));
+	for (size_t i = 0; i < pages_.size(); i++)
+	{
+		pages_[i].block = NO_BLOCK;
+		pages_[i].dirty = false;
+	}
+	return true;
+}
+
+void DiskBuffer::Close(void)
+{
+	if (file_ != NULL)
+	{
+		fclose(file_);
+		file_ = NULL;
+	}
+	std::vector<Page>().swap(pages_);
+	size_ = 0;
+	file_bytes_ = 0;
+}
+
+bool DiskBuffer::Flush(void)
+{
+	for (size_t i = 0; i < pages_.size(); i++)
+	{
+		Store(pages_[i]);
+	}
+	if (file_ != NULL && fflush(file_) != 0)
+	{
+		failed_ = true;
+	}
+	return !failed_;
+}
+
+void DiskBuffer::Read(size_t first, size_t count, void* out)
+{
+	size_t begin = first * record_size_;
+	size_t end = begin + count * record_size_;
+	char* dst = static_cast<char*>(out);
+	while (begin < end)
+	{
+		size_t block = begin / page_bytes_;
+		size_t offset = begin - block * page_bytes_;
+		size_t n = std::min(page_bytes_ - offset, end - begin);
+		memcpy(dst, &Fetch(block).data[offset], n);
+		dst += n;
+		begin += n;
+	}
+}
+
+void DiskBuffer::Write(size_t first, size_t count, const void* in)
+{
+	size_t begin = first * record_size_;
+	size_t end = begin + count * record_size_;
+	const char* src = static_cast<const char*>(in);
+	size_ = std::max(size_, first + count);
+	while (begin < end)
+	{
+		size_t block = begin / page_bytes_;
+		size_t offset = begin - block * page_bytes_;
+		size_t n = std::min(page_bytes_ - offset, end - begin);
+		Page& page = Fetch(block);
+		memcpy(&page.data[offset], src, n);
+		page.dirty = true;
+		src += n;
+		begin += n;
+	}
+}
+
+void DiskBuffer::swap(DiskBuffer& other)
+{
+	std::swap(file_, other.file_);
+	std::swap(record_size_, other.record_size_);
+	std::swap(size_, other.size_);
+	std::swap(file_bytes_, other.file_bytes_);
+	std::swap(page_bytes_, other.page_bytes_);
+	pages_.swap(other.pages_);
+	std::swap(failed_, other.failed_);
+}
+
+DiskBuffer::Page& DiskBuffer::Fetch(size_t block)
+{
+	Page& page = pages_[HashBlock(block) % pages_.size()];
+	if (page.block == block)
+	{
+		return page;
+	}
+	Store(page);
+	page.data.resize(page_bytes_);
+	page.block = block;
+
+	// the part of the block beyond the end of the file reads as zeros
+	size_t offset = block * page_bytes_;
+	size_t stored = file_bytes_ > offset ? std::min(file_bytes_ - offset, page_bytes_) : 0;
+	if (stored > 0 && (!SeekTo(file_, offset) || fread(&page.data[0], 1, stored, file_) != stored))
+	{
+		failed_ = true;
+	}
+	std::fill(page.data.begin() + stored, page.data.end(), 0);
+	return page;
+}
+
+void DiskBuffer::Store(Page& page)
+{
+	if (!page.dirty)
+	{
+		return;
+	}
+	// only the used part of the last block goes to the file
+	size_t offset = page.block * page_bytes_;
+	size_t n = std::min(page_bytes_, size_ * record_size_ - offset);
+	if (!SeekTo(file_, offset) || fwrite(&page.data[0], 1, n, file_) != n)
+	{
+		failed_ = true;
+	}
+	file_bytes_ = std::max(file_bytes_, offset + n);
+	page.dirty = false;
+}
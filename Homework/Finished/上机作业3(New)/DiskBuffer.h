@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/*!
+*	An array of fixed-size records kept in a temporary file.
+*
+*	Reads and writes go through a cache of pages, each page caching one
+*	aligned block of the file, chosen by a hash of the block. Sequential and
+*	spatially coherent accesses touch the disk in whole pages while the
+*	memory stays at the size of the cache. The array grows when written past
+*	its end, records never written read as zeros. The file has no name once
+*	created and is gone when the buffer is closed. Not thread-safe.
+*/
+class DiskBuffer
+{
+	struct Page
+	{
+		size_t				block;		//!< block of the file held, SIZE_MAX if none
+		bool				dirty;
+		std::vector<char>	data;
+	};
+
+	FILE*				file_;
+	size_t				record_size_;
+	size_t				size_;			//!< records
+	size_t				file_bytes_;	//!< bytes stored in the file so far
+	size_t				page_bytes_;
+	std::vector<Page>	pages_;
+	bool				failed_;		//!< a read or write of the file failed
+
+	DiskBuffer(const DiskBuffer&);
+	DiskBuffer& operator=(const DiskBuffer&);
+
+public:
+	DiskBuffer(void);
+	~DiskBuffer(void);
+
+	//! create an empty buffer of records of record_size bytes
+	/*!
+	*	\param directory where the file goes, NULL or "" for the system default
+	*	\param cache_bytes memory given to the page cache
+	*/
+	bool Create(const char* directory, size_t record_size, size_t cache_bytes);
+	//! drop the records and remove the file
+	void Close(void);
+	//! write the dirty pages, false if any I/O has failed
+	bool Flush(void);
+
+	inline bool isOpen(void) const {return file_ != NULL;}
+	inline bool good(void) const {return !failed_;}
+	inline size_t size(void) const {return size_;}
+	inline size_t record_size(void) const {return record_size_;}
+
+	//! copy the records [first, first + count) to out
+	void Read(size_t first, size_t count, void* out);
+	//! copy count records from in to [first, first + count)
+	void Write(size_t first, size_t count, const void* in);
+
+	//! exchange the contents of two buffers
+	void swap(DiskBuffer& other);
+
+private:
+	//! the page holding block, loaded if needed
+	Page& Fetch(size_t block);
+	//! write a dirty page back to the file
+	void Store(Page& page);
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <vector>
+#include "MeshArena.h"
+
+/*!
+*	Open-addressing hash table that maps a directed vertex pair
+*	(start id, end id) to the index of the half-edge between them.
+*
+*	It replaces the node-based std::map used while building connectivity:
+*	keys and values live in two flat arrays, collisions are resolved by
+*	linear probing and the table is kept at most half full, so a lookup is
+*	one multiply and usually a single cache miss.
+*/
+class HalfEdgeHash
+{
+	typedef unsigned long long KEY;
+	static const KEY EMPTY_KEY = ~0ull;
+
+private:
+	std::vector<KEY>		keys_;		//!< (start << 32 | end), EMPTY_KEY for a free slot
+	std::vector<HE_index>	values_;	//!< half-edge index stored with each key
+	size_t					size_;		//!< number of stored keys
+	size_t					mask_;		//!< capacity - 1, capacity is a power of two
+
+	static inline KEY make_key(HE_index vstart, HE_index vend)
+	{
+		return (static_cast<KEY>(vstart) << 32) | static_cast<KEY>(vend);
+	}
+
+	inline size_t slot(KEY key) const
+	{
+		// Fibonacci hashing, the high bits are the well mixed ones
+		return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & mask_;
+	}
+
+	void rehash(size_t capacity)
+	{
+		std::vector<KEY> old_keys;
+		std::vector<HE_index> old_values;
+		old_keys.swap(keys_);
+		old_values.swap(values_);
+
+		keys_.assign(capacity, KEY(EMPTY_KEY));
+		values_.resize(capacity);
+		mask_ = capacity - 1;
+		for (size_t i = 0; i < old_keys.size(); i++)
+		{
+			if (old_keys[i] != EMPTY_KEY)
+			{
+				size_t s = slot(old_keys[i]);
+				while (keys_[s] != EMPTY_KEY)
+				{
+					s = (s + 1) & mask_;
+				}
+				keys_[s] = old_keys[i];
+				values_[s] = old_values[i];
+			}
+		}
+	}
+
+public:
+	HalfEdgeHash(void) : size_(0), mask_(0) {}
+
+	inline size_t size(void) const {return size_;}
+	inline bool empty(void) const {return size_ == 0;}
+
+	//! make room for n half-edges without rehashing
+	void reserve(size_t n)
+	{
+		size_t capacity = 16;
+		while (capacity < 2 * n)
+		{
+			capacity <<= 1;
+		}
+		if (capacity > keys_.size())
+		{
+			rehash(capacity);
+		}
+	}
+
+	//! the half-edge from vstart to vend, HE_INVALID_INDEX if there is none
+	HE_index find(HE_index vstart, HE_index vend) const
+	{
+		if (size_ == 0)
+		{
+			return HE_INVALID_INDEX;
+		}
+		KEY key = make_key(vstart, vend);
+		for (size_t s = slot(key); keys_[s] != EMPTY_KEY; s = (s + 1) & mask_)
+		{
+			if (keys_[s] == key)
+			{
+				return values_[s];
+			}
+		}
+		return HE_INVALID_INDEX;
+	}
+
+	//! associate the half-edge from vstart to vend with index he
+	void insert(HE_index vstart, HE_index vend, HE_index he)
+	{
+		if (2 * (size_ + 1) > keys_.size())
+		{
+			rehash(keys_.empty() ? 16 : 2 * keys_.size());
+		}
+		KEY key = make_key(vstart, vend);
+		size_t s = slot(key);
+		while (keys_[s] != EMPTY_KEY)
+		{
+			if (keys_[s] == key)
+			{
+				values_[s] = he;
+				return;
+			}
+			s = (s + 1) & mask_;
+		}
+		keys_[s] = key;
+		values_[s] = he;
+		size_++;
+	}
+
+	//! forget all the keys but keep the table
+	void clear(void)
+	{
+		if (size_ > 0)
+		{
+			keys_.assign(keys_.size(), KEY(EMPTY_KEY));
+			size_ = 0;
+		}
+	}
+
+	//! forget all the keys and free the table
+	void release(void)
+	{
+		std::vector<KEY>().swap(keys_);
+		std::vector<HE_index>().swap(values_);
+		size_ = 0;
+		mask_ = 0;
+	}
+};
@@ -1,7 +1,11 @@
 #include "Mesh3D.h"
+#include "MeshIO.h"
 
 #include <fstream>
 #include <iostream>
+#include <algorithm>
+#include <string>
+#include <cstring>
 #include <xutility>
 
 #define SWAP(a,b,T) {T tmp=(a); (a)=(b); (b)=tmp;}
@@ -21,6 +25,17 @@ Mesh3D::Mesh3D(void)
 
 	num_components_ = 0;
 	average_edge_length_ = 1.f;
+	use_binary_cache_ = false;
+	weld_tolerance_ = 0.f;
+	normal_weighting_ = NORMAL_UNIFORM;
+	use_soa_ = false;
+	editing_ = false;
+	edit_bbox_shrinks_ = false;
+	positions_version_ = 0;
+	moved_log_start_ = 0;
+	snapshot_version_ = 0;
+	snapshot_full_ = true;
+	edge_length_sum_ = 0.0;
 }
 
 void Mesh3D::ClearData(void)
@@ -29,6 +44,16 @@ void Mesh3D::ClearData(void)
 	ClearEdges();
 	ClearFaces();
 	edgemap_.clear();
+	set_soa_positions(use_soa_);
+	TouchPositions(NULL, 0);
+
+	ring_start_.clear();
+	ring_verts_.clear();
+	num_components_ = 0;
+	vertex_component_.clear();
+	face_component_.clear();
+	component_faces_.clear();
+	component_face_start_.clear();
 
 	xmax_ = ymax_ = zmax_ = 1.f;
 	xmin_ = ymin_ = zmin_ = -1.f;
@@ -36,89 +61,46 @@ void Mesh3D::ClearData(void)
 
 void Mesh3D::ClearVertex(void)
 {
-
-	if (pvertices_list_==NULL)
-	{
-		return;
-	}
-	else
+	// the elements live in the arena, so the list only has to forget them;
+	// both keep their storage for the next mesh
+	if (pvertices_list_ != NULL)
 	{
-		for (VERTEX_ITER viter = pvertices_list_->begin(); viter != pvertices_list_->end(); viter++)
-		{
-			if (*viter != NULL)
-			{
-				delete *viter;
-				*viter = NULL;
-			}
-			else
-			{
-				// ERROR
-			}
-		}
-		delete pvertices_list_;
-		pvertices_list_ = NULL;
+		pvertices_list_->clear();
 	}
+	vertex_arena_.clear();
+	vertex_props_.Resize(0);
 }
 
 void Mesh3D::ClearEdges(void)
 {
-	if (pedges_list_ == NULL)
+	if (pedges_list_ != NULL)
 	{
-		return;
-	}
-	else
-	{
-		for (EDGE_ITER eiter = pedges_list_->begin(); eiter!=pedges_list_->end(); eiter++)
-		{
-			if (*eiter != NULL)
-			{
-				delete *eiter;
-				*eiter = NULL;
-			}
-			else
-			{
-				// ERROR
-			}
-		}
-		delete pedges_list_;
-		pedges_list_ = NULL;
+		pedges_list_->clear();
 	}
+	edge_arena_.clear();
+	half_edge_props_.Resize(0);
 }
 
 void Mesh3D::ClearFaces(void)
 {
-	if (pfaces_list_==NULL)
-	{
-		return;
-	}
-	else
+	if (pfaces_list_ != NULL)
 	{
-		for (FACE_ITER fiter = pfaces_list_->begin(); fiter!=pfaces_list_->end(); fiter++)
-		{
-			if (*fiter != NULL)
-			{
-				delete *fiter;
-				*fiter = NULL;
-			}
-			else
-			{
-				// ERROR
-			}
-		}
-		delete pfaces_list_;
-		pfaces_list_ = NULL;
+		pfaces_list_->clear();
 	}
+	face_arena_.clear();
+	face_props_.Resize(0);
 }
 
 HE_vert* Mesh3D::InsertVertex(const Vec3f& v)
 {
-	HE_vert* pvert = new HE_vert(v);
 	if (pvertices_list_ == NULL)
 	{
 		pvertices_list_ = new std::vector<HE_vert*>;
 	}
+	HE_vert* pvert = vertex_arena_.create(v);
 	pvert->id_ = static_cast<int>(pvertices_list_->size());
 	pvertices_list_->push_back(pvert);
+	vertex_props_.Resize(pvertices_list_->size());
 	return pvert;
 }
 
@@ -134,23 +116,39 @@ HE_edge* Mesh3D::InsertEdge(HE_vert* vstart, HE_vert* vend)
 		pedges_list_ = new std::vector<HE_edge*>;
 	}
 
-	if (edgemap_[PAIR_VERTEX(vstart, vend)] != NULL)
+	if (edgemap_.empty() && !pedges_list_->empty())
 	{
-		return edgemap_[PAIR_VERTEX(vstart, vend)];
+		RebuildEdgeMap();
 	}
 
-	HE_edge* pedge = new HE_edge;
+	HE_index found = edgemap_.find(vstart->id_, vend->id_);
+	if (found != HE_INVALID_INDEX)
+	{
+		return &edge_arena_[found];
+	}
+
+	HE_edge* pedge = edge_arena_.create();
 	pedge->pvert_ = vend;
 	pedge->pvert_->degree_ ++;
 	vstart->pedge_ = pedge;
-	edgemap_[PAIR_VERTEX(vstart, vend)] = pedge;
 
 	pedge->id_ = static_cast<int>(pedges_list_->size());
 	pedges_list_->push_back(pedge);
+	half_edge_props_.Resize(pedges_list_->size());
+	edgemap_.insert(vstart->id_, vend->id_, pedge->id_);
 
 	return pedge;
 }
 
+void Mesh3D::RebuildEdgeMap(void)
+{
+	edgemap_.reserve(pedges_list_->size());
+	for (EDGE_ITER eiter = pedges_list_->begin(); eiter != pedges_list_->end(); eiter++)
+	{
+		edgemap_.insert((*eiter)->ppair_->pvert_->id_, (*eiter)->pvert_->id_, (*eiter)->id_);
+	}
+}
+
 HE_face* Mesh3D::InsertFace(std::vector<HE_vert* >& vec_hv)
 {
 	int vsize = static_cast<int>(vec_hv.size());
@@ -164,7 +162,7 @@ HE_face* Mesh3D::InsertFace(std::vector<HE_vert* >& vec_hv)
 		pfaces_list_ = new std::vector<HE_face*>;
 	}
 
-	HE_face *pface = new HE_face;
+	HE_face *pface = face_arena_.create();
 	pface->valence_ = vsize;
 	VERTEX_ITER viter = vec_hv.begin();
 	VERTEX_ITER nviter = vec_hv.begin();
@@ -210,194 +208,145 @@ HE_face* Mesh3D::InsertFace(std::vector<HE_vert* >& vec_hv)
 
 	pface->id_ = static_cast<int>(pfaces_list_->size());
 	pfaces_list_->push_back(pface);
+	face_props_.Resize(pfaces_list_->size());
 
 	return pface;
 }
 
-bool Mesh3D::LoadFromOBJFile(const char* fins)
+void Mesh3D::Reserve(int nverts, int nfaces)
 {
-	//	cout << "Loading......." << endl;
-	FILE *pfile = fopen(fins, "r");
-
-	char *tok;
-	//char *tok_tok;
-	char temp[128];
-
-	try
+	if (pvertices_list_ == NULL)
 	{
-		ClearData();
-		//read vertex
-		fseek(pfile, 0, SEEK_SET);
-		char pLine[512];
-
-		while(fgets(pLine, 512, pfile))
-		{
-			if(pLine[0] == 'v' && pLine[1] == ' ')
-			{
-				Vec3f nvv;
-				tok = strtok(pLine," ");
-				for (int i=0; i<3; i++) 
-				{
-					tok = strtok(NULL," ");
-					strcpy(temp, tok);
-					temp[strcspn(temp," ")] = 0;
-					nvv[i] = (float)atof(temp);
-				}
-				InsertVertex(nvv);
-			}
-		}
-
-		//read facets
-		fseek(pfile, 0, SEEK_SET);
-
-		while(fgets(pLine, 512, pfile))
-		{
-			char *pTmp = pLine;
-			if(pTmp[0] == 'f')
-			{
-				std::vector<HE_vert* > s_faceid;
-
-				tok = strtok(pLine," ");
-				while ((tok = strtok(NULL," ")) != NULL)
-				{
-					strcpy(temp, tok);
-					temp[strcspn(temp, "/")] = 0;
-					int id = (int)strtol(temp, NULL, 10) - 1;
-					HE_vert* hv = get_vertex(id);
-					bool findit = false;
-					for (int i = 0; i <(int) s_faceid.size(); i++)
-					{
-						if (hv == s_faceid[i])	//remove redundant vertex id if it exists
-						{
-							//	cout << "remove redundant vertex" << endl;
-							findit = true;
-							break;
-						}
-					}
-					if (findit == false && hv != NULL)
-					{
-						s_faceid.push_back(hv);
-					}
-				}
-				if ((int)s_faceid.size() >= 3)
-				{
-					InsertFace(s_faceid);
-				}
-			}
-		}
-
-		//read texture coords
-		fseek(pfile, 0, SEEK_SET);
-		std::vector<Vec3f> texCoordsTemp;
-		while (fscanf(pfile, "%s", pLine) != EOF)
-		{
-			if (pLine[0] == 'v' && pLine[1] == 't')
-			{
-				Vec3f texTemp(0.f, 0.f, 0.f);
-				fscanf(pfile, "%f %f", &texTemp[0], &texTemp[1]);
-				texCoordsTemp.push_back(texTemp);
-			}
-		}
-		//read texture index
-
-		if (texCoordsTemp.size() > 0)
-		{
-			fseek(pfile, 0, SEEK_SET);
+		pvertices_list_ = new std::vector<HE_vert*>;
+	}
+	if (pedges_list_ == NULL)
+	{
+		pedges_list_ = new std::vector<HE_edge*>;
+	}
+	if (pfaces_list_ == NULL)
+	{
+		pfaces_list_ = new std::vector<HE_face*>;
+	}
 
-			int faceIndex = 0;
-			while (fscanf(pfile, "%s", pLine) != EOF)
-			{
+	// a closed triangle mesh has three half-edges per face
+	size_t nhalfedges = static_cast<size_t>(nfaces) * 3;
+	vertex_arena_.reserve(nverts);
+	edge_arena_.reserve(nhalfedges);
+	face_arena_.reserve(nfaces);
+	pvertices_list_->reserve(nverts);
+	pedges_list_->reserve(nhalfedges);
+	pfaces_list_->reserve(nfaces);
+	vertex_props_.Reserve(nverts);
+	half_edge_props_.Reserve(nhalfedges);
+	face_props_.Reserve(nfaces);
+	edgemap_.reserve(nhalfedges);
+}
 
-				if (pLine[0] == 'f')
-				{
-					int v, t;
-					fscanf(pfile, "%s", pLine);
-					if (sscanf(pLine, "%d/%d", &v, &t) == 2)
-					{
-						std::map<int, int> v2tex;
-						v2tex[v - 1] = t - 1;
-
-						fscanf(pfile, "%s", pLine);
-						sscanf(pLine, "%d/%d", &v, &t);
-						v2tex[v - 1] = t - 1;
-
-						fscanf(pfile, "%s", pLine);
-						sscanf(pLine, "%d/%d", &v, &t);
-						v2tex[v - 1] = t - 1;
-
-						HE_edge* edgeTemp = pfaces_list_->at(faceIndex)->pedge_;
-						edgeTemp->texCoord_ = texCoordsTemp.at(v2tex[edgeTemp->pvert_->id_]);	
-						edgeTemp->pvert_->texCoord_ = edgeTemp->texCoord_;
-						edgeTemp = edgeTemp->pnext_;
-						edgeTemp->texCoord_ = texCoordsTemp.at(v2tex[edgeTemp->pvert_->id_]);
-						edgeTemp->pvert_->texCoord_ = edgeTemp->texCoord_;
-						edgeTemp = edgeTemp->pnext_;
-						edgeTemp->texCoord_ = texCoordsTemp.at(v2tex[edgeTemp->pvert_->id_]);
-						edgeTemp->pvert_->texCoord_ = edgeTemp->texCoord_;
-						faceIndex++;
-					}
-				}
-			}
-		}
+bool Mesh3D::LoadFromOBJFile(const char* fins)
+{
+	MeshSourceKey key;
+	std::string fcache = std::string(fins) + ".hemesh";
+	bool cached = use_binary_cache_ && GetMeshSourceKey(fins, key);
+	if (cached && weld_tolerance_ > 0.f)
+	{
+		// a welded mesh is not the plain one, give its sidecar another key
+		unsigned int bits;
+		memcpy(&bits, &weld_tolerance_, sizeof(bits));
+		key.hash ^= (bits + 1ull) * 0x9E3779B97F4A7C15ull;
+	}
+	if (cached && LoadBinaryCache(fcache.c_str(), key))
+	{
+		return isValid();
+	}
 
-		//cout << vertex_list->size() << " vertex, " << faces_list->size() << " faces " << endl;
+	OBJData obj;
+	if (!ReadOBJFile(fins, obj))
+	{
+		ClearData();
+		ReleaseStandardProperties();
+		return false;
+	}
+	if (weld_tolerance_ > 0.f)
+	{
+		WeldOBJVertices(obj, weld_tolerance_);
+	}
 
-		UpdateMesh();
+	try
+	{
+		CreateMesh(obj);
 		Unify(2.f);
 	}
 	catch (...)
 	{
 		ClearData();
-		xmax_ = ymax_ = zmax_ = 1.f;
-		xmin_ = ymin_ = zmin_ = -1.f;
-
-		fclose(pfile);
+		ReleaseStandardProperties();
 		return false;
 	}
 
-	fclose(pfile);
-
+	if (cached && isValid())
+	{
+		WriteBinaryCache(fcache.c_str(), key);
+	}
 	return isValid();
 }
 
-void Mesh3D::WriteToOBJFile(const char* fouts)
+void Mesh3D::CreateMesh(const OBJData& obj)
 {
-	std::ofstream fout(fouts);
+	ClearData();
+	ReleaseStandardProperties();
+	Reserve(obj.num_of_vertices(), obj.num_of_faces());
 
-	fout<<"g object\n";
-	fout.precision(16);
-	//output coordinates of each vertex
-	VERTEX_ITER viter = pvertices_list_->begin();
-	for (;viter!=pvertices_list_->end(); viter++) 
+	const float* pos = obj.positions.empty() ? NULL : &obj.positions[0];
+	for (int i = 0; i < obj.num_of_vertices(); i++)
 	{
-		fout<<"v "<< std::scientific <<(*viter)->position_.x() 
-			<<" "<<(*viter)->position_.y() <<" "<< (*viter)->position_.z() <<"\n";
+		InsertVertex(Vec3f(pos[3 * i], pos[3 * i + 1], pos[3 * i + 2]));
 	}
 
-	// 		for (viter = pvertices_list_->begin();viter!=pvertices_list_->end(); viter++) 
-	// 		{
-	// 			fout<<"vn "<< std::scientific <<(*viter)->normal_.x() 
-	// 				<<" "<<(*viter)->normal_.y() <<" "<<(*viter)->normal_.z() <<"\n";
-	// 		}
-	//output the valence of each face and its vertices_list' id
-
-	FACE_ITER fiter = pfaces_list_->begin();
-
-	for (;fiter!=pfaces_list_->end(); fiter++) 
+	if (obj.num_of_texcoords() > 0)
 	{
-		fout<<"f";
+		request_half_edge_texcoords();
+		request_vertex_texcoords();
+	}
 
-		HE_edge* edge = (*fiter)->pedge_; 
+	std::vector<HE_vert* > s_faceid;
+	std::vector<int> s_texid;
+	for (int f = 0; f < obj.num_of_faces(); f++)
+	{
+		s_faceid.clear();
+		s_texid.clear();
+		for (int c = obj.face_starts[f]; c < obj.face_starts[f + 1]; c++)
+		{
+			HE_vert* hv = get_vertex(obj.corner_verts[c]);
+			//remove redundant vertex id if it exists
+			if (hv == NULL || std::find(s_faceid.begin(), s_faceid.end(), hv) != s_faceid.end())
+			{
+				continue;
+			}
+			s_faceid.push_back(hv);
+			s_texid.push_back(obj.corner_texs[c] < obj.num_of_texcoords() ? obj.corner_texs[c] : -1);
+		}
+		if ((int)s_faceid.size() < 3)
+		{
+			continue;
+		}
 
-		do {
-			fout<<" "<<edge->ppair_->pvert_->id_+1;
-			edge = edge->pnext_;
+		HE_face* face = InsertFace(s_faceid);
 
-		} while (edge != (*fiter)->pedge_);
-		fout<<"\n";
+		// the k-th half-edge of the face ends at the (k+1)-th corner
+		HE_edge* edge = face->pedge_;
+		for (size_t k = 0; k < s_faceid.size(); k++, edge = edge->pnext_)
+		{
+			int t = s_texid[(k + 1) % s_faceid.size()];
+			if (t >= 0)
+			{
+				Vec3f texcoord(obj.texcoords[2 * t], obj.texcoords[2 * t + 1], 0.f);
+				half_edge_texcoord(edge->id_) = texcoord;
+				vertex_texcoord(edge->pvert_->id_) = texcoord;
+			}
+		}
 	}
 
-	fout.close();
+	UpdateMesh();
 }
 
 void Mesh3D::UpdateMesh(void)
@@ -409,25 +358,60 @@ void Mesh3D::UpdateMesh(void)
 	}
 	SetBoundaryFlag();
 	BoundaryCheck();
+	set_soa_positions(use_soa_);	// the topology may have changed
+	TouchPositions(NULL, 0);
 	UpdateNormal();
 	ComputeBoundingBox();
 	ComputeAvarageEdgeLength();
+	ComputeNumComponents();
 	SetNeighbors();
+
+	// the pairing table is only needed while faces are being inserted
+	edgemap_.release();
 }
 
 void Mesh3D::SetBoundaryFlag(void)
 {
-	for (EDGE_ITER eiter = pedges_list_->begin(); eiter!=pedges_list_->end(); eiter++)
+	// every element looks at its own neighbourhood and only writes itself:
+	// a half-edge or its pair without a face, a face along such a pair, a
+	// vertex whose ring meets a half-edge without a face
+	parallel_for_half_edges([](HE_edge& he)
 	{
-		if ((*eiter)->pface_ == NULL)
+		if (he.pface_ == NULL || he.ppair_->pface_ == NULL)
 		{
-			(*eiter)->set_boundary_flag(BOUNDARY);
-			(*eiter)->ppair_->set_boundary_flag(BOUNDARY);
-			(*eiter)->pvert_->set_boundary_flag(BOUNDARY);
-			(*eiter)->ppair_->pvert_->set_boundary_flag(BOUNDARY);
-			(*eiter)->ppair_->pface_->set_boundary_flag(BOUNDARY);
+			he.set_boundary_flag(BOUNDARY);
 		}
-	}
+	});
+	parallel_for_faces([](HE_face& hf)
+	{
+		HE_edge* edge = hf.pedge_;
+		do
+		{
+			if (edge->ppair_->pface_ == NULL)
+			{
+				hf.set_boundary_flag(BOUNDARY);
+				break;
+			}
+			edge = edge->pnext_;
+		} while (edge != hf.pedge_);
+	});
+	parallel_for_vertices([](HE_vert& hv)
+	{
+		HE_edge* edge = hv.pedge_;
+		while (edge != NULL)
+		{
+			if (edge->pface_ == NULL || edge->ppair_->pface_ == NULL)
+			{
+				hv.set_boundary_flag(BOUNDARY);
+				break;
+			}
+			edge = edge->ppair_->pnext_;
+			if (edge == hv.pedge_)
+			{
+				break;
+			}
+		}
+	});
 }
 
 void Mesh3D::BoundaryCheck()
@@ -456,73 +440,106 @@ void Mesh3D::UpdateNormal(void)
 
 void Mesh3D::ComputeFaceslistNormal(void)
 {
-	for (FACE_ITER fiter = pfaces_list_->begin(); fiter!=pfaces_list_->end(); fiter++)
+	size_t nfaces = static_cast<size_t>(num_of_face_list());
+	snapshot_full_ = true;
+	if (normal_weighting_ == NORMAL_AREA)
+	{
+		face_area_.resize(nfaces);
+	}
+	if (PrepareSoA() && !soa_triangle_[0].empty())
 	{
-		ComputePerFaceNormal(*fiter);
+		ComputeFaceslistNormalSoA();
+		return;
 	}
+	parallel_for(0, nfaces, [this](size_t i)
+	{
+		ComputePerFaceNormal(&face_arena_[static_cast<HE_index>(i)]);
+	});
 }
 
-void Mesh3D::ComputePerFaceNormal(HE_face* hf) {
-	//ͼѧγϻҵ
-	//ڴ˴Ӽ淨
-	point a, b, c;
-	a = hf->pedge_->pvert_->position();  //õε
-	b = hf->pedge_->pnext_->pvert_->position();
-	c = hf->pedge_->pnext_->pnext_->pvert_->position();
-	point m1, m2;  //õ
-	m1 = b - a;
-	m2 = c - a;
-
-	double x = m1[1] * m2[2] - m1[2] * m2[1]; //˵õ
-	double y = m1[2] * m2[0] - m1[0] * m2[2];
-	double z = m1[0] * m2[1] - m1[1] * m2[0];
-
-	double norm = sqrt(x * x + y * y + z * z);
+void Mesh3D::ComputePerFaceNormal(HE_face* hf)
+{
+	Vec3f n;
+	HE_edge* edge = hf->pedge_;
+	if (hf->valence_ == 3)
+	{
+		const Vec3f& a = edge->pvert_->position_;
+		const Vec3f& b = edge->pnext_->pvert_->position_;
+		const Vec3f& c = edge->pnext_->pnext_->pvert_->position_;
+		n = (b - a) CROSS (c - a);
+	}
+	else
+	{
+		// Newell's method, stable for polygons that are not quite planar
+		do
+		{
+			const Vec3f& p = edge->pvert_->position_;
+			const Vec3f& q = edge->pnext_->pvert_->position_;
+			n[0] += (p[1] - q[1]) * (p[2] + q[2]);
+			n[1] += (p[2] - q[2]) * (p[0] + q[0]);
+			n[2] += (p[0] - q[0]) * (p[1] + q[1]);
+			edge = edge->pnext_;
+		} while (edge != hf->pedge_);
+	}
 
-	hf->facevector[0] = x / norm;
-	hf->facevector[1] = y / norm;
-	hf->facevector[2] = z / norm;
+	float length = len(n);
+	hf->normal_ = length > 0.f ? n / length : n;
+	if (normal_weighting_ == NORMAL_AREA)
+	{
+		face_area_[hf->id_] = 0.5f * length;
+	}
 }
 
 void Mesh3D::ComputeVertexlistNormal(void)
 {
-	for (VERTEX_ITER viter = pvertices_list_->begin(); viter!=pvertices_list_->end(); viter++) 
+	snapshot_full_ = true;
+	if (PrepareSoA())
 	{
-		ComputePerVertexNormal(*viter);
+		ComputeVertexlistNormalSoA();
+		return;
 	}
+	parallel_for(0, static_cast<size_t>(num_of_vertex_list()), [this](size_t i)
+	{
+		ComputePerVertexNormal(&vertex_arena_[static_cast<HE_index>(i)]);
+	});
 }
 
 void Mesh3D::ComputePerVertexNormal(HE_vert* hv)
 {
-	//ͼѧγϻҵ
-	//ڴ˴Ӽ淨
-	HE_edge* firstedge = hv->pedge_;
-	HE_face* face_ = firstedge->pface_;
-	Mesh3D::ComputeFaceNormal(face_);  //ú淨
-
-	hv->pointvector[0] = 0;  //ʼΪ0
-	hv->pointvector[1] = 0;
-	hv->pointvector[2] = 0;
-
-	float total = 0;  //öڵ
-	for (int i = 0; i < 3; ++i) {
-		hv->pointvector[i] += face->facevector[i];  //ڵ淨֮
-	}
+	Vec3f n = AccumulateFaceNormals(hv);
+	float length = len(n);
+	hv->normal_ = length > 0.f ? n / length : n;
+}
 
-	++total;
-	HE_edge* nextedge = firstedge->ppair_->pnext_;  //һ
-	while (nextedge != firstedge) {
-		face_ = nextedge->pface_;
-		Mesh3D::ComputePerFaceNormal(face_);
-		for (int i = 0; i < 3; ++i) {
-			hv->pointvector[i] += face->facevector[i];
-		}
-		++total;
-		nextedge = nextedge->ppair_->pnext_;
-	}
-	for (int i = 0; i < 3; ++i) {
-		hv->pointvector[i] = hv->pointvector[i] / total;
+Vec3f Mesh3D::AccumulateFaceNormals(HE_vert* hv)
+{
+	// gather the already computed normals of the incident faces
+	Vec3f n;
+	HE_edge* edge = hv->pedge_;
+	if (edge != NULL)
+	{
+		do
+		{
+			HE_face* face = edge->pface_;
+			if (face != NULL)	// the outgoing boundary half-edge has no face
+			{
+				float w = 1.f;
+				if (normal_weighting_ == NORMAL_AREA)
+				{
+					w = face_area_[face->id_];
+				}
+				else if (normal_weighting_ == NORMAL_ANGLE)
+				{
+					Vec3f e0 = edge->pvert_->position_ - hv->position_;
+					Vec3f e1 = edge->pprev_->ppair_->pvert_->position_ - hv->position_;
+					w = angle(e0, e1);
+				}
+				n += w * face->normal_;
+			}
+			edge = edge->ppair_->pnext_;
+		} while (edge != NULL && edge != hv->pedge_);
 	}
+	return n;
 }
 
 void Mesh3D::ComputeBoundingBox(void)
@@ -531,27 +548,55 @@ void Mesh3D::ComputeBoundingBox(void)
 	{
 		return;
 	}
+	if (PrepareSoA())
+	{
+		ComputeBoundingBoxSoA();
+		return;
+	}
 
 #define MAX_FLOAT_VALUE (static_cast<float>(10e10))
 #define MIN_FLOAT_VALUE	(static_cast<float>(-10e10))
 	
-	xmax_ = ymax_ = zmax_ = MIN_FLOAT_VALUE;
-	xmin_ = ymin_ = zmin_ = MAX_FLOAT_VALUE;
-
-	VERTEX_ITER viter = pvertices_list_->begin();
-	for (; viter!=pvertices_list_->end(); viter++)
+	struct Box
 	{
-		xmin_ = min(xmin_, (*viter)->position_.x());
-		ymin_ = min(ymin_, (*viter)->position_.y());
-		zmin_ = min(zmin_, (*viter)->position_.z());
-		xmax_ = max(xmax_, (*viter)->position_.x());
-		ymax_ = max(ymax_, (*viter)->position_.y());
-		zmax_ = max(zmax_, (*viter)->position_.z());
-	}
+		float lo[3], hi[3];
+	};
+	Box empty = {{MAX_FLOAT_VALUE, MAX_FLOAT_VALUE, MAX_FLOAT_VALUE},
+		{MIN_FLOAT_VALUE, MIN_FLOAT_VALUE, MIN_FLOAT_VALUE}};
+	Box box = parallel_reduce(0, pvertices_list_->size(), empty, [this](size_t i, Box& b)
+	{
+		const Vec3f& p = vertex_arena_[static_cast<HE_index>(i)].position_;
+		for (int k = 0; k < 3; k++)
+		{
+			b.lo[k] = min(b.lo[k], p[k]);
+			b.hi[k] = max(b.hi[k], p[k]);
+		}
+	}, [](const Box& a, const Box& b)
+	{
+		Box c;
+		for (int k = 0; k < 3; k++)
+		{
+			c.lo[k] = min(a.lo[k], b.lo[k]);
+			c.hi[k] = max(a.hi[k], b.hi[k]);
+		}
+		return c;
+	});
+	xmin_ = box.lo[0];
+	ymin_ = box.lo[1];
+	zmin_ = box.lo[2];
+	xmax_ = box.hi[0];
+	ymax_ = box.hi[1];
+	zmax_ = box.hi[2];
 }
 
 void Mesh3D::Unify(float size)
 {
+	TouchPositions(NULL, 0);
+	if (PrepareSoA())
+	{
+		UnifySoA(size);
+		return;
+	}
 	float scaleX = xmax_ - xmin_;
 	float scaleY = ymax_ - ymin_;
 	float scaleZ = zmax_ - zmin_;
@@ -575,6 +620,25 @@ void Mesh3D::Unify(float size)
 	{
 		pvertices_list_->at(i)->position_ = (pvertices_list_->at(i)->position_ - centerPos) * scaleV;
 	}
+	UnifyAggregates(centerPos, scaleV);
+}
+
+void Mesh3D::UnifyAggregates(const Vec3f& center, float scale)
+{
+	// the box, the edge lengths and the face areas move with the vertices,
+	// so they stay valid for the incremental updates of EndEdit
+	xmin_ = (xmin_ - center.x()) * scale;
+	xmax_ = (xmax_ - center.x()) * scale;
+	ymin_ = (ymin_ - center.y()) * scale;
+	ymax_ = (ymax_ - center.y()) * scale;
+	zmin_ = (zmin_ - center.z()) * scale;
+	zmax_ = (zmax_ - center.z()) * scale;
+	edge_length_sum_ *= scale;
+	average_edge_length_ *= scale;
+	for (size_t i = 0; i < face_area_.size(); i++)
+	{
+		face_area_[i] *= scale * scale;
+	}
 }
 
 void Mesh3D::ComputeAvarageEdgeLength(void)
@@ -582,20 +646,70 @@ void Mesh3D::ComputeAvarageEdgeLength(void)
 	if(!isValid())
 	{
 		average_edge_length_ = 0.f;
+		edge_length_sum_ = 0.0;
 		return;
 	}
-	float aveEdgeLength = 0.f;
-	for (int i=0; i<num_of_half_edges_list(); i++)
+	// blocks summed in a fixed order, so the value does not depend on the threads
+	double aveEdgeLength = parallel_reduce(0, static_cast<size_t>(num_of_half_edges_list()), 0.0,
+		[this](size_t i, double& sum)
 	{
-		HE_edge* edge = get_edges_list()->at(i);
-		HE_vert* v0 = edge->pvert_;
-		HE_vert* v1 = edge->ppair_->pvert_;
-		aveEdgeLength += (v0->position() - v1->position()).length();
-	}
-	average_edge_length_ = aveEdgeLength/num_of_half_edges_list();
+		const HE_edge& edge = edge_arena_[static_cast<HE_index>(i)];
+		sum += len(edge.pvert_->position_ - edge.ppair_->pvert_->position_);
+	}, [](double a, double b)
+	{
+		return a + b;
+	});
+	edge_length_sum_ = aveEdgeLength;
+	average_edge_length_ = static_cast<float>(aveEdgeLength/num_of_half_edges_list());
 	//std::cout << "Average_edge_length = " << average_edge_length_ << "\n";
 }
 
+void Mesh3D::SetNeighbors(void)
+{
+	// count the ring of every vertex, prefix sum, then fill the rows; both
+	// passes walk the rings in parallel and write disjoint slots
+	size_t nverts = static_cast<size_t>(num_of_vertex_list());
+	ring_start_.assign(nverts + 1, 0);
+	parallel_for(0, nverts, [this](size_t i)
+	{
+		HE_vert& hv = vertex_arena_[static_cast<HE_index>(i)];
+		HE_index count = 0;
+		HE_edge* edge = hv.pedge_;
+		if (edge != NULL)
+		{
+			do
+			{
+				count++;
+				edge = edge->ppair_->pnext_;
+			} while (edge != hv.pedge_ && edge != NULL);
+		}
+		ring_start_[i + 1] = count;
+	});
+	for (size_t i = 0; i < nverts; i++)
+	{
+		ring_start_[i + 1] += ring_start_[i];
+	}
+
+	ring_verts_.resize(ring_start_[nverts]);
+	parallel_for(0, nverts, [this](size_t i)
+	{
+		HE_vert& hv = vertex_arena_[static_cast<HE_index>(i)];
+		HE_edge* edge = hv.pedge_;
+		if (edge == NULL)
+		{
+			return;
+		}
+		// the rows keep the order of the former neighborIdx lists, which was
+		// the reverse of the pedge_ walk
+		HE_index slot = ring_start_[i + 1];
+		do
+		{
+			ring_verts_[--slot] = edge->pvert_->id_;
+			edge = edge->ppair_->pnext_;
+		} while (edge != hv.pedge_ && edge != NULL);
+	});
+}
+
 HE_face* Mesh3D::get_face(int vId0, int vId1, int vId2)
 {
 	HE_vert *v0 = get_vertex(vId0);
@@ -608,7 +722,7 @@ HE_face* Mesh3D::get_face(int vId0, int vId1, int vId2)
 
 	HE_face* face=NULL;
 
-	// ڶԱ߽bugҵǱ߽
+	// 由于对边界点的邻域遍历有bug，所以找到非边界点进行邻域遍历
 	if (v0->isOnBoundary())
 	{
 		if (!v1->isOnBoundary())
@@ -621,13 +735,13 @@ HE_face* Mesh3D::get_face(int vId0, int vId1, int vId2)
 		}
 		else
 		{
-			// v0, v1, v2 Ǳ߽
-			// ʱȲ
+			// v0, v1, v2 都是边界点
+			// 暂时先不处理
 			return NULL;
 		}
 	}
 
-	if (!v0->isOnBoundary())	// Ա߽ıbug
+	if (!v0->isOnBoundary())	// 对边界点的遍历有bug
 	{
 		HE_edge* edge=v0->pedge_;
 		bool inFace = true;
@@ -662,7 +776,7 @@ HE_face* Mesh3D::get_face(const std::vector<unsigned int>& ids)
 		std::cout << "can not return face" << std::endl;
 		return NULL;
 	}
-	// ҵһǱ߽
+	// 首先找到一个非边界点
 	HE_vert* v = NULL;
 	for (unsigned int i=0; i<ids.size(); i++)
 	{
@@ -674,8 +788,8 @@ HE_face* Mesh3D::get_face(const std::vector<unsigned int>& ids)
 	}
 	if (!v)
 	{
-		// е㶼Ǳ߽
-		// ݲ
+		// 所有点都是边界点
+		// 暂不处理
 		return NULL;
 	}
 
@@ -728,18 +842,20 @@ int Mesh3D::GetFaceId(HE_face* face)
 
 void Mesh3D::ResetFaceSelectedTags(int tag)
 {
-	for (int i=0; i<num_of_face_list(); i++)
+	request_face_selection();
+	parallel_for_faces([this, tag](HE_face& hf)
 	{
-		get_face(i)->set_selected(tag);
-	}
+		face_selected(hf.id_) = tag;
+	});
 }
 
 void Mesh3D::ResetVertexSelectedTags(int tag)
 {
-	for (int i=0; i<num_of_vertex_list(); i++)
+	request_vertex_selection();
+	parallel_for_vertices([this, tag](HE_vert& hv)
 	{
-		get_vertex(i)->set_seleted(tag);
-	}
+		vertex_selected(hv.id_) = tag;
+	});
 }
 
 bool Mesh3D::isNeighbors(HE_vert* v0, HE_vert* v1)
@@ -763,13 +879,13 @@ bool Mesh3D::isNeighbors(HE_vert* v0, HE_vert* v1)
 
 int Mesh3D::GetSelectedVrtId()
 {
-	if (!isValid())
+	if (!isValid() || !has_vertex_selection())
 	{
 		return -1;
 	}
 	for (int i=0; i<num_of_vertex_list(); i++)
 	{
-		if (get_vertex(i)->selected()==SELECTED)
+		if (vertex_selected(i)==SELECTED)
 		{
 			return i;
 		}
@@ -780,6 +896,8 @@ int Mesh3D::GetSelectedVrtId()
 void Mesh3D::CreateMesh(const std::vector<Vec3f>& verts, const std::vector<int>& triIdx)
 {
 	ClearData();
+	ReleaseStandardProperties();
+	Reserve(static_cast<int>(verts.size()), static_cast<int>(triIdx.size() / 3));
 	for (unsigned int i=0; i<verts.size(); i++)
 	{
 		InsertVertex(verts[i]);
@@ -802,6 +920,8 @@ void Mesh3D::CreateMesh(const std::vector<Vec3f>& verts, const std::vector<int>&
 void Mesh3D::CreateMesh(const std::vector<double>& verts, const std::vector<unsigned>& triIdx)
 {
 	ClearData();
+	ReleaseStandardProperties();
+	Reserve(static_cast<int>(verts.size() / 3), static_cast<int>(triIdx.size() / 3));
 	for (unsigned int i=0; i<verts.size(); i=i+3)
 	{
 		InsertVertex(Vec3f(verts[i], verts[i+1], verts[i+2]));
@@ -823,20 +943,22 @@ void Mesh3D::CreateMesh(const std::vector<double>& verts, const std::vector<unsi
 
 int Mesh3D::GetBoundaryVrtSize()
 {
-	int count = 0;
-	for (int i=0; i<num_of_vertex_list(); i++)
+	return parallel_reduce(0, static_cast<size_t>(num_of_vertex_list()), 0,
+		[this](size_t i, int& count)
 	{
-		if (get_vertex(i)->isOnBoundary())
-		{
-			count ++;
-		}
-	}
-	return count;
+		count += vertex_arena_[static_cast<HE_index>(i)].isOnBoundary();
+	}, [](int a, int b)
+	{
+		return a + b;
+	});
 }
 
 Mesh3D::~Mesh3D(void)
 {
 	ClearData();
+	delete pvertices_list_;
+	delete pedges_list_;
+	delete pfaces_list_;
 }
 
 
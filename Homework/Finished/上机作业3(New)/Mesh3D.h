@@ -2,13 +2,21 @@
 
 #include <vector>
 #include <map>
+#include <memory>
 #include "Vec.h"
+#include "MeshArena.h"
+#include "MeshProperty.h"
+#include "HalfEdgeHash.h"
+#include "MeshParallel.h"
 
 
 // forward declarations of mesh classes
 class HE_vert;
 class HE_edge;
 class HE_face;
+struct OBJData;
+struct MeshSourceKey;
+struct MeshSnapshot;
 
 
 using trimesh::point;
@@ -31,6 +39,83 @@ enum BoundaryTag
 	TO_SPLIT
 };
 
+//! space-filling curve used by Mesh3D::Reorder
+enum SpaceFillingCurve
+{
+	CURVE_MORTON,		//!< Z-order, cheapest to compute
+	CURVE_HILBERT		//!< no jumps between far apart cells, better locality
+};
+
+/*!
+*	Renumbering done by Mesh3D::Reorder: the element with old id i now has
+*	the id vertex[i], face[i] or half_edge[i].
+*/
+struct MeshPermutation
+{
+	std::vector<HE_index>	vertex;
+	std::vector<HE_index>	face;
+	std::vector<HE_index>	half_edge;
+};
+
+//! arrays filled by Mesh3D::ComputeCurvature, can be or-ed
+enum CurvatureField
+{
+	CURVATURE_MEAN = 1,
+	CURVATURE_GAUSSIAN = 2,
+	CURVATURE_PRINCIPAL = 4,
+	CURVATURE_ALL = 7
+};
+
+/*!
+*	Per-vertex curvature computed by Mesh3D::ComputeCurvature, indexed by
+*	vertex id. The arrays that were not asked for stay empty.
+*/
+struct MeshCurvature
+{
+	std::vector<float>	mean;		//!< mean curvature H, positive where the surface bends away from its normals
+	std::vector<float>	gaussian;	//!< Gaussian curvature K
+	std::vector<float>	kmax;		//!< larger principal curvature
+	std::vector<float>	kmin;		//!< smaller principal curvature
+	unsigned int		version;	//!< positions_version() of the mesh the arrays reflect
+
+	MeshCurvature(void) : version(0) {}
+};
+
+//! precision of Mesh3D::EncodeCompressed, in bits per quantized coordinate
+struct MeshCodecOptions
+{
+	int		position_bits;	//!< 1 to 24, over the largest side of the bounding box
+	int		normal_bits;	//!< 2 to 16 per octahedral coordinate, 0 leaves the normals out
+	int		texcoord_bits;	//!< 1 to 16, over the range of the texture coords, 0 leaves them out
+
+	MeshCodecOptions(void) : position_bits(14), normal_bits(10), texcoord_bits(12) {}
+};
+
+//! refinement rule of Mesh3D::Subdivide
+enum SubdivisionScheme
+{
+	SUBDIVISION_LOOP,			//!< triangles into 4 triangles, triangle meshes only
+	SUBDIVISION_CATMULL_CLARK	//!< n-gons into n quads, any polygon mesh
+};
+
+//! weights of the one-ring in Mesh3D::SmoothLaplacian and SmoothTaubin
+enum SmoothingWeights
+{
+	SMOOTH_UNIFORM,		//!< every neighbour counts the same
+	SMOOTH_COTANGENT	//!< cotangent weights, keeps the triangles in shape, triangle meshes only
+};
+
+//! how the face normals around a vertex are averaged into the vertex normal
+enum NormalWeighting
+{
+	NORMAL_UNIFORM,		//!< every incident face counts the same
+	NORMAL_AREA,		//!< faces are weighted by their area
+	NORMAL_ANGLE		//!< faces are weighted by their corner angle at the vertex
+};
+
+//! rgba of the vertices until a colour is set, gold
+const float DEFAULT_VERTEX_COLOR[4] = {1.f, 215.f / 255.f, 0.f, 1.f};
+
 /*!
 *	The basic vertex class for half-edge structure.
 */
@@ -42,39 +127,30 @@ public:
 	int			id_;
 	point 	position_;		//!< vertex position
 	Vec3f	normal_;		//!< vertex normal
-	Vec3f	texCoord_;		//!< texture coord
-	Vec4f	color_;
 	HE_edge		*pedge_;		//!< one of the half-edges_list emanating from the vertex
 	int			degree_;
 	BoundaryTag	boundary_flag_;	//!< boundary flag
-	int			selected_;		//!< a tag: whether the vertex is selected
-	float   pointvector[3] = { 0 };  //㷨
-	/*--------------------add by wang kang at 2013-10-12----------------------*/
-	std::vector<size_t> neighborIdx;
+
+	// colour, texture coords and selection are properties of the mesh,
+	// see Mesh3D::vertex_color, vertex_texcoord and vertex_selected
 
 public: 
 	HE_vert(const Vec3f& v)
-		: id_(-1), position_(v), pedge_(NULL), degree_(0), boundary_flag_(INNER), selected_(UNSELECTED)
-		, color_(255.f / 255.f, 215.f / 255.f, 0.f/ 255.f, 1.f),neighborIdx()
+		: id_(-1), position_(v), pedge_(NULL), degree_(0), boundary_flag_(INNER)
 	{}
 
-	~HE_vert(void) { neighborIdx.clear();}
+	~HE_vert(void) {}
 
 	bool		isOnBoundary(void) {return boundary_flag_==BOUNDARY;}
 	int			id(void) {return id_;}
 	Vec3f& normal(void) {return normal_;}
 	Vec3f& position(void) {return position_;}
-	Vec3f& texCoordinate(void) {return texCoord_;}
-	Vec4f& color(void) {return color_;};
 	int			degree(void) {return degree_;}
-	int			selected(void) {return selected_;}
 	BoundaryTag boundary_flag(void) {return boundary_flag_;}
 
 	void		set_normal(const Vec3f& n) {normal_=n;}
 	void		set_position(const Vec3f& p) {position_=p;}
 	void		set_id(int id) {id_=id;}
-	void		set_color(const Vec4f& c) {color_=c;}
-	void		set_seleted(int tag){selected_=tag;}
 	void		set_boundary_flag(BoundaryTag bt) {boundary_flag_=bt;}
 };
 
@@ -85,18 +161,20 @@ class HE_edge
 {
 public:
 	int			id_;
+	BoundaryTag boundary_flag_;	//!< boundary flag, next to id_ to fill the word
 	HE_vert		*pvert_;		//!< vertex at the end of the half-edge
 	HE_edge		*ppair_;		//!< oppositely oriented adjacent half-edge
 	HE_face		*pface_;		//!< face the half-edge borders
 	HE_edge		*pnext_;		//!< next half-edge around the face
 	HE_edge		*pprev_;		//!< prev half-edge around the face
-	Vec3f		texCoord_;		//!< texture coordinate of the end vertex
-	BoundaryTag boundary_flag_;	//!< boundary flag
+
+	// the texture coordinate of the end vertex is a property of the mesh,
+	// see Mesh3D::half_edge_texcoord
 
 public:
 	HE_edge()
-		: id_(-1), pvert_(NULL), ppair_(NULL)
-		, pface_(NULL), pnext_(NULL), pprev_(NULL), boundary_flag_(INNER)
+		: id_(-1), boundary_flag_(INNER), pvert_(NULL), ppair_(NULL)
+		, pface_(NULL), pnext_(NULL), pprev_(NULL)
 	{}
 
 	~HE_edge()
@@ -118,13 +196,14 @@ public:
 	HE_edge		*pedge_;		//!< one of the half-edges_list bordering the face
 	Vec3f		normal_;		//!< face normal
 	int			valence_;		//!< the number of edges_list
-	int			selected_;		//!< a tag: whether the face is selected
-	Vec4f		color_;			//!< the color of this face
 	BoundaryTag boundary_flag_;	//!< this flag is used to split the mesh
-	float		facevector[3];  //淨
+
+	// colour and selection are properties of the mesh, see
+	// Mesh3D::face_color and face_selected
+
 public:
 	HE_face()
-		: id_(-1), pedge_(NULL), valence_(0), selected_(UNSELECTED), boundary_flag_(INNER)
+		: id_(-1), pedge_(NULL), valence_(0), boundary_flag_(INNER)
 	{}
 
 	~HE_face()
@@ -133,12 +212,8 @@ public:
 	int				id(void) {return id_;}
 	int				valence(void) {return valence_;}
 	Vec3f&		normal(void) {return normal_;}
-	int				selected(void) {return selected_;}
-	Vec4f&		color(void) {return color_;}
 	BoundaryTag		boundary_flag() {return boundary_flag_;}
 
-	void			set_selected(int tag){selected_=tag;}
-	void			set_color(const Vec4f& c) {color_=c;}
 	void			set_boundary_flag(BoundaryTag bt) {boundary_flag_=bt;}
 
 	/*-----------add by wang kang at 2013-10-13-------------*/
@@ -185,7 +260,6 @@ class Mesh3D
 	typedef std::vector<HE_vert* >::reverse_iterator VERTEX_RITER;
 	typedef std::vector<HE_face* >::reverse_iterator FACE_RITER;
 	typedef std::vector<HE_edge* >::reverse_iterator EDGE_RITER;
-	typedef std::pair<HE_vert*, HE_vert* > PAIR_VERTEX;
 
 private:
 	// mesh data
@@ -193,17 +267,84 @@ private:
 	std::vector<HE_edge*>	*pedges_list_;		//!< store edges
 	std::vector<HE_face*>	*pfaces_list_;		//!< store faces
 
+	//! contiguous storage of the elements, the lists above only point into it
+	MeshArena<HE_vert>		vertex_arena_;
+	MeshArena<HE_edge>		edge_arena_;
+	MeshArena<HE_face>		face_arena_;
+
 	// mesh info
 	int		num_components_;						//!< number of components
+	std::vector<int>		vertex_component_;		//!< component id of every vertex
+	std::vector<int>		face_component_;		//!< component id of every face
+	//! face ids grouped by component, component c owns
+	//! [component_face_start_[c], component_face_start_[c+1])
+	std::vector<HE_index>	component_faces_;
+	std::vector<HE_index>	component_face_start_;
+
+	//! one-ring adjacency in compressed sparse rows: the neighbours of
+	//! vertex v are ring_verts_[ring_start_[v] .. ring_start_[v+1])
+	std::vector<HE_index>	ring_start_;
+	std::vector<HE_index>	ring_verts_;
 	float	average_edge_length_;				//!< the average edge length
+	double	edge_length_sum_;					//!< sum of all the half-edge lengths
 
-	//! associate two end vertex with its edge: only useful in creating mesh
-	std::map<std::pair<HE_vert*, HE_vert* >, HE_edge* >    edgemap_;	
-	//std::map<std::pair<HE_vert*, HE_vert* >, HE_vert* >    midPointMap_;
+	//! associate two end vertex with its edge: only useful in creating mesh,
+	//! freed by UpdateMesh and rebuilt on demand if more faces are inserted
+	HalfEdgeHash	edgemap_;
 
 	//! values for the bounding box
 	float xmax_, xmin_, ymax_, ymin_, zmax_, zmin_;
 
+	//! whether LoadFromOBJFile reads and writes the binary sidecar
+	bool	use_binary_cache_;
+	//! distance within which LoadFromOBJFile merges vertices, 0 for none
+	float	weld_tolerance_;
+
+	//! weighting used by UpdateNormal for the vertex normals
+	NormalWeighting		normal_weighting_;
+	//! face areas of the last normal update, only filled for NORMAL_AREA
+	std::vector<float>	face_area_;
+
+	//! structure-of-arrays copy of the geometry for the SIMD kernels
+	bool				use_soa_;
+	std::vector<float>	soa_position_[3];		//!< x, y and z of every vertex
+	std::vector<int>	soa_triangle_[3];		//!< corner vertex ids of every face, empty unless all faces are triangles
+	std::vector<float>	soa_face_normal_[3];	//!< face normals of the last update
+	std::vector<float>	soa_vertex_normal_[3];	//!< scratch for the vertex normals
+
+	//! state of a BeginEdit/EndEdit batch. The marks are sized to the
+	//! elements and are all zero outside of a batch.
+	bool					editing_;
+	bool					edit_bbox_shrinks_;	//!< a moved vertex was on the bounding box
+	std::vector<HE_index>	edit_verts_;		//!< vertices moved in the batch
+	std::vector<HE_index>	edit_edges_;		//!< edges whose length was taken out of edge_length_sum_
+	std::vector<unsigned char>	vert_edit_mark_;
+	std::vector<unsigned char>	edge_edit_mark_;
+	std::vector<unsigned char>	face_edit_mark_;
+
+	//! change tracking of the vertex positions for the spatial indices
+	unsigned int			positions_version_;		//!< bumped by every change of the positions
+	unsigned int			moved_log_start_;		//!< oldest version the log reaches back to
+	//! vertices moved since moved_log_start_, with the version their move created
+	std::vector<std::pair<unsigned int, HE_index> >	moved_log_;
+
+	//! the snapshot last published, only read and written atomically
+	std::shared_ptr<const MeshSnapshot>	snapshot_;
+	unsigned int			snapshot_version_;		//!< positions_version_ of the last publish
+	bool					snapshot_full_;			//!< normals or colours changed outside the moved log
+
+	//! attributes kept outside of the elements, one array per attribute
+	PropertyContainer		vertex_props_;
+	PropertyContainer		half_edge_props_;
+	PropertyContainer		face_props_;
+	//! the standard attributes, invalid until requested
+	VPropHandleT<Vec4f>		vertex_colors_;
+	VPropHandleT<Vec3f>		vertex_texcoords_;
+	VPropHandleT<int>		vertex_selected_;
+	HPropHandleT<Vec3f>		half_edge_texcoords_;
+	FPropHandleT<Vec4f>		face_colors_;
+	FPropHandleT<int>		face_selected_;
+
 public:
 	//! constructor
 	Mesh3D(void);
@@ -235,6 +376,28 @@ public:
 	//! get the number of components
 	inline int num_of_components(void) {return num_components_;}
 
+	//! get the component id of the id-th vertex, components are numbered by their smallest vertex id
+	inline int vertex_component(int id) {return id >= static_cast<int>(vertex_component_.size()) || id<0 ? -1 : vertex_component_[id];}
+
+	//! get the component id of the id-th face
+	inline int face_component(int id) {return id >= static_cast<int>(face_component_.size()) || id<0 ? -1 : face_component_[id];}
+
+	//! get the number of faces in component c
+	inline int num_of_component_faces(int c) {return static_cast<int>(component_face_start_[c+1] - component_face_start_[c]);}
+
+	//! get the ids of the faces in component c, in increasing order
+	inline const HE_index* component_faces(int c) {return component_faces_.data() + component_face_start_[c];}
+
+	//! get the number of one-ring neighbours of the id-th vertex
+	inline int num_of_neighbors(int id) {return static_cast<int>(ring_start_[id+1] - ring_start_[id]);}
+
+	//! get the ids of the one-ring neighbours of the id-th vertex
+	/*!
+	*	the ring is a slice of one array shared by all the vertices, read it
+	*	as neighbors(id)[0] .. neighbors(id)[num_of_neighbors(id)-1]
+	*/
+	inline const HE_index* neighbors(int id) {return ring_verts_.data() + ring_start_[id];}
+
 	//! get the average edge length
 	inline float average_edge_length(void) {return average_edge_length_;}
 
@@ -247,6 +410,155 @@ public:
 	//! get the pointer of the id-th face
 	inline HE_face* get_face(int id) {return id >= num_of_face_list() || id<0 ? NULL : (*pfaces_list_)[id];}
 
+	//! get the id-th vertex directly from the arena, no range check
+	inline HE_vert& vertex_at(HE_index id) {return vertex_arena_[id];}
+
+	//! get the id-th half-edge directly from the arena, no range check
+	inline HE_edge& half_edge_at(HE_index id) {return edge_arena_[id];}
+
+	//! get the id-th face directly from the arena, no range check
+	inline HE_face& face_at(HE_index id) {return face_arena_[id];}
+
+	//! run fn(HE_vert&) on every vertex on the thread pool, see parallel_for
+	template <class F>
+	void parallel_for_vertices(const F& fn, size_t grain = 4096)
+	{
+		parallel_for(0, static_cast<size_t>(num_of_vertex_list()), [this, &fn](size_t i)
+		{
+			fn(vertex_arena_[static_cast<HE_index>(i)]);
+		}, grain);
+	}
+
+	//! run fn(HE_edge&) on every half-edge on the thread pool
+	template <class F>
+	void parallel_for_half_edges(const F& fn, size_t grain = 4096)
+	{
+		parallel_for(0, static_cast<size_t>(num_of_half_edges_list()), [this, &fn](size_t i)
+		{
+			fn(edge_arena_[static_cast<HE_index>(i)]);
+		}, grain);
+	}
+
+	//! run fn(HE_face&) on every face on the thread pool
+	template <class F>
+	void parallel_for_faces(const F& fn, size_t grain = 4096)
+	{
+		parallel_for(0, static_cast<size_t>(num_of_face_list()), [this, &fn](size_t i)
+		{
+			fn(face_arena_[static_cast<HE_index>(i)]);
+		}, grain);
+	}
+
+	//! add a vertex property, every vertex starts with value
+	/*!
+	*	the property lives as long as the mesh or until remove_property,
+	*	and keeps a value for every vertex as vertices are created; it is
+	*	emptied with the mesh and follows the vertices in Reorder. The same
+	*	goes for the half-edge and face properties.
+	*/
+	template <class T>
+	void add_property(VPropHandleT<T>& h, const std::string& name = "<vprop>", const T& value = T())
+	{
+		h = VPropHandleT<T>(vertex_props_.Add<T>(name, value));
+	}
+	template <class T>
+	void add_property(HPropHandleT<T>& h, const std::string& name = "<hprop>", const T& value = T())
+	{
+		h = HPropHandleT<T>(half_edge_props_.Add<T>(name, value));
+	}
+	template <class T>
+	void add_property(FPropHandleT<T>& h, const std::string& name = "<fprop>", const T& value = T())
+	{
+		h = FPropHandleT<T>(face_props_.Add<T>(name, value));
+	}
+
+	//! free a property, h becomes invalid
+	template <class T>
+	void remove_property(VPropHandleT<T>& h) {vertex_props_.Remove(h.idx()); h.reset();}
+	template <class T>
+	void remove_property(HPropHandleT<T>& h) {half_edge_props_.Remove(h.idx()); h.reset();}
+	template <class T>
+	void remove_property(FPropHandleT<T>& h) {face_props_.Remove(h.idx()); h.reset();}
+
+	//! find a property by its name and type, false if there is none
+	template <class T>
+	bool get_property_handle(VPropHandleT<T>& h, const std::string& name)
+	{
+		h = VPropHandleT<T>(vertex_props_.Find<T>(name));
+		return h.is_valid();
+	}
+	template <class T>
+	bool get_property_handle(HPropHandleT<T>& h, const std::string& name)
+	{
+		h = HPropHandleT<T>(half_edge_props_.Find<T>(name));
+		return h.is_valid();
+	}
+	template <class T>
+	bool get_property_handle(FPropHandleT<T>& h, const std::string& name)
+	{
+		h = FPropHandleT<T>(face_props_.Find<T>(name));
+		return h.is_valid();
+	}
+
+	//! all the values of a property, indexed by element id
+	template <class T>
+	inline PropertyArray<T>& property(VPropHandleT<T> h) {return vertex_props_.Get<T>(h.idx());}
+	template <class T>
+	inline PropertyArray<T>& property(HPropHandleT<T> h) {return half_edge_props_.Get<T>(h.idx());}
+	template <class T>
+	inline PropertyArray<T>& property(FPropHandleT<T> h) {return face_props_.Get<T>(h.idx());}
+
+	//! the value of a property for the element with that id, no range check
+	template <class T>
+	inline T& property(VPropHandleT<T> h, HE_index id) {return vertex_props_.Get<T>(h.idx())[id];}
+	template <class T>
+	inline T& property(HPropHandleT<T> h, HE_index id) {return half_edge_props_.Get<T>(h.idx())[id];}
+	template <class T>
+	inline T& property(FPropHandleT<T> h, HE_index id) {return face_props_.Get<T>(h.idx())[id];}
+
+	//! bytes of the elements and of their properties
+	size_t memory_usage(void);
+
+	//! the standard attributes, created on request
+	/*!
+	*	request_ adds the property unless it exists, release_ frees it. The
+	*	accessors need the property: vertex colours start gold, texture
+	*	coordinates at 0 and selections at UNSELECTED. The loaders request
+	*	the texture coordinates of textured files, ColorByCurvature the
+	*	vertex colours, ResetVertexSelectedTags and ResetFaceSelectedTags the
+	*	selections. Loading or creating another mesh releases all of them.
+	*/
+	void request_vertex_colors(void);
+	void release_vertex_colors(void);
+	inline bool has_vertex_colors(void) {return vertex_colors_.is_valid();}
+	inline Vec4f& vertex_color(HE_index id) {return property(vertex_colors_, id);}
+
+	void request_vertex_texcoords(void);
+	void release_vertex_texcoords(void);
+	inline bool has_vertex_texcoords(void) {return vertex_texcoords_.is_valid();}
+	inline Vec3f& vertex_texcoord(HE_index id) {return property(vertex_texcoords_, id);}
+
+	void request_vertex_selection(void);
+	void release_vertex_selection(void);
+	inline bool has_vertex_selection(void) {return vertex_selected_.is_valid();}
+	inline int& vertex_selected(HE_index id) {return property(vertex_selected_, id);}
+
+	//! texture coordinate of the end vertex of a half-edge, per face corner
+	void request_half_edge_texcoords(void);
+	void release_half_edge_texcoords(void);
+	inline bool has_half_edge_texcoords(void) {return half_edge_texcoords_.is_valid();}
+	inline Vec3f& half_edge_texcoord(HE_index id) {return property(half_edge_texcoords_, id);}
+
+	void request_face_colors(void);
+	void release_face_colors(void);
+	inline bool has_face_colors(void) {return face_colors_.is_valid();}
+	inline Vec4f& face_color(HE_index id) {return property(face_colors_, id);}
+
+	void request_face_selection(void);
+	void release_face_selection(void);
+	inline bool has_face_selection(void) {return face_selected_.is_valid();}
+	inline int& face_selected(HE_index id) {return property(face_selected_, id);}
+
 	//! get the half-edge from vertex hv0 to hv1
 	inline HE_edge* get_edge(HE_vert* hv0, HE_vert* hv1)
 	{
@@ -291,12 +603,75 @@ public:
 	*/
 	HE_face* InsertFace(std::vector<HE_vert* >& vec_hv);
 
+	//! reserve storage for a mesh of the given size
+	/*!
+	*	avoids growing the arenas and lists one slab at a time while loading
+	*	\param nverts expected number of vertices
+	*	\param nfaces expected number of faces (triangles)
+	*/
+	void Reserve(int nverts, int nfaces);
+
 
 	// FILE IO
 	//! load a 3D mesh from an OBJ format file
 	bool LoadFromOBJFile(const char* fins);
 	//! export the current mesh to an OBJ format file
-	void WriteToOBJFile(const char* fouts);
+	/*!
+	*	writes the positions, the vertex normals and, when the corners have
+	*	any, the texture coordinates; the records are formatted in parallel
+	*/
+	bool WriteToOBJFile(const char* fouts);
+	//! export the positions, vertex normals and polygons to a binary PLY file
+	bool WriteToPLYFile(const char* fouts);
+	//! export to a binary STL file, polygons are split into triangle fans
+	bool WriteToSTLFile(const char* fouts);
+
+	//! encode the mesh into the compact quantized stream of MeshCodec.h
+	/*!
+	*	the positions are quantized within the bounding box as last computed.
+	*	The texture coordinates are only stored if some corner has one.
+	*	\return false if the mesh is empty or an option is out of range
+	*/
+	bool EncodeCompressed(std::vector<unsigned char>& bytes, const MeshCodecOptions& options = MeshCodecOptions());
+	//! rebuild the mesh from a stream of EncodeCompressed
+	/*!
+	*	vertices and faces are numbered in the order of the stream, which
+	*	differs from the encoded mesh, and a face may start at another
+	*	corner. The stored normals replace the computed ones.
+	*	\return false if the stream is broken, the mesh is then cleared
+	*/
+	bool DecodeCompressed(const unsigned char* bytes, size_t size);
+	//! EncodeCompressed to a file
+	bool WriteToCompressedFile(const char* fouts, const MeshCodecOptions& options = MeshCodecOptions());
+	//! DecodeCompressed from a file
+	bool LoadFromCompressedFile(const char* fins);
+
+	//! keep a binary sidecar "<file>.hemesh" next to the loaded OBJ files
+	/*!
+	*	when enabled, LoadFromOBJFile maps a sidecar whose key matches the OBJ
+	*	file instead of parsing it, and writes a new one after a full load
+	*/
+	inline void set_binary_cache(bool enable) {use_binary_cache_ = enable;}
+
+	//! merge the vertices closer than tolerance when loading an OBJ file
+	/*!
+	*	exporters duplicate the vertices along texture and normal seams,
+	*	which would otherwise load as boundaries between separate fans. The
+	*	tolerance is in the units of the file, 0 (the default) turns welding
+	*	off. The texture coordinates stay per corner, see half_edge_texcoord.
+	*/
+	inline void set_weld_tolerance(float tolerance) {weld_tolerance_ = tolerance > 0.f ? tolerance : 0.f;}
+	inline float weld_tolerance(void) {return weld_tolerance_;}
+
+	//! write the whole half-edge structure to a binary file tagged with the key of its source
+	bool WriteBinaryCache(const char* fcache, const MeshSourceKey& key);
+	//! load a binary file written by WriteBinaryCache
+	/*!
+	*	\return false if the file is missing, broken, of another version,
+	*	was not built from a source with this key or holds normals of another
+	*	weighting; the mesh is then cleared
+	*/
+	bool LoadBinaryCache(const char* fcache, const MeshSourceKey& key);
 
 	//! update mesh:
 	/*! 
@@ -306,13 +681,83 @@ public:
 
 	//! update normal
 	/*!
-	*	compute all the normals of vertex and faces
+	*	compute all the normals of vertex and faces: first every face normal
+	*	once, then every vertex normal from its incident faces. Both passes run
+	*	on all the cores and write the normal_ fields.
 	*/
 	void UpdateNormal(void);
 
+	//! choose how UpdateNormal weights the faces around a vertex
+	/*!
+	*	the normals keep the old weighting until the next UpdateNormal, an
+	*	edit batch under NORMAL_AREA first fills the face areas it needs
+	*/
+	inline void set_normal_weighting(NormalWeighting w) {if (w != normal_weighting_) face_area_.clear(); normal_weighting_ = w;}
+	inline NormalWeighting normal_weighting(void) {return normal_weighting_;}
+
 	//! compute the bounding box
 	void ComputeBoundingBox(void);
 
+	//! start a batch of vertex moves
+	/*!
+	*	inside the batch move the vertices with SetVertexPosition only.
+	*	EndEdit then refreshes the normals of the faces around the moved
+	*	vertices and of their one-ring, the bounding box and the average edge
+	*	length, at a cost proportional to the edited region. The topology must
+	*	not change during a batch.
+	*/
+	void BeginEdit(void);
+	//! move a vertex, outside of a batch the mesh is refreshed at once
+	void SetVertexPosition(HE_vert* hv, const Vec3f& pos);
+	//! finish the batch and refresh what it touched
+	void EndEdit(void);
+	inline bool isEditing(void) {return editing_;}
+
+	//! a number that changes whenever vertex positions or ids change
+	/*!
+	*	covers EndEdit, Unify, CommitSoAPositions and every rebuild of the
+	*	mesh. Writes through position() are not seen.
+	*/
+	inline unsigned int positions_version(void) {return positions_version_;}
+	//! the vertices moved since version since
+	/*!
+	*	\return false if more than single vertices changed since then (a
+	*	unify, a new mesh, or a log that grew too long), then everything
+	*	has to be treated as moved
+	*/
+	bool GetMovedVertices(unsigned int since, std::vector<HE_index>& ids);
+
+	//! publish the current state as an immutable MeshSnapshot for other threads
+	/*!
+	*	call it from the thread that edits the mesh, whenever an edit is
+	*	ready to be seen. The arrays share the pages that did not change
+	*	with the snapshot published before. After edit batches only, the
+	*	pages around the moved vertices are read again, at a cost
+	*	proportional to the edits; otherwise, or with full, the whole mesh
+	*	is read and compared. A new mesh, LoadFromOBJFile included, is not
+	*	seen before the next publish. Writes through position(), normal_ or
+	*	vertex_color are not tracked, publish with full after them.
+	*/
+	void PublishSnapshot(bool full = false);
+	//! the snapshot last published, NULL before the first; safe on any thread
+	std::shared_ptr<const MeshSnapshot> snapshot(void) const;
+
+	//! keep a structure-of-arrays copy of the positions
+	/*!
+	*	when enabled, UpdateNormal, ComputeBoundingBox and Unify run the SIMD
+	*	kernels of MeshSimd.h on it. The copy is refreshed when the number of
+	*	vertices changes; after moving vertices through position() call
+	*	SyncSoAPositions, or write soa_position() and call CommitSoAPositions.
+	*/
+	void set_soa_positions(bool enable);
+	inline bool soa_positions(void) {return use_soa_;}
+	//! the axis-th coordinate (0 x, 1 y, 2 z) of all the vertices, NULL when disabled
+	inline float* soa_position(int axis) {return use_soa_ ? soa_position_[axis].data() : NULL;}
+	//! copy the vertex positions into the structure of arrays
+	void SyncSoAPositions(void);
+	//! copy the structure of arrays back into the vertex positions
+	void CommitSoAPositions(void);
+
 	//! get the face with id0, id1, id2 vertices
 	HE_face* get_face(int vId0, int vId1, int vId2);
 	//! get the face whose vertices are the ids vertices
@@ -335,12 +780,82 @@ public:
 	//!   the triIdx is defined as tri0_v0, tri0_v1, tri0_v2, tr1_v0, tr1_v1, tr1_v2, ...
 	void CreateMesh(const std::vector<Vec3f>& verts, const std::vector<int>& triIdx);
 	void CreateMesh(const std::vector<double>& verts, const std::vector<unsigned>& triIdx);
+	//! create a mesh from a parsed OBJ file, polygons and texture coords included
+	void CreateMesh(const OBJData& obj);
+
+	//! renumber and re-store the mesh for memory locality
+	/*!
+	*	vertices are sorted along a space-filling curve through the bounding
+	*	box, faces by their first vertex in that order and the half-edges of a
+	*	face follow each other. The elements are moved in the arenas, so ring
+	*	and face walks touch neighbouring memory afterwards. All attributes,
+	*	normals and flags are kept.
+	*	\param perm if not NULL, receives the old to new id maps
+	*/
+	void Reorder(SpaceFillingCurve curve = CURVE_HILBERT, MeshPermutation* perm = NULL);
+
+	//! subdivide the mesh levels times into result
+	/*!
+	*	the new vertices are numbered after the old ones, which keep their
+	*	ids: first one per edge, then for Catmull-Clark one per face. Only
+	*	the positions are carried over. Boundaries follow the cubic B-spline
+	*	boundary rules, corners of a single face stay in place.
+	*	\return false if result is this mesh, or for SUBDIVISION_LOOP if a
+	*	face is not a triangle
+	*/
+	bool Subdivide(Mesh3D& result, SubdivisionScheme scheme, int levels = 1);
+
+	//! per-vertex curvature, the fields asked for
+	/*!
+	*	the mean curvature comes from the cotangent Laplacian, the Gaussian
+	*	curvature from the angle defect, both over the mixed Voronoi area of
+	*	the vertex (Meyer et al. 2003); the principal curvatures follow from
+	*	the two. One parallel pass over the one-rings, boundary vertices get 0.
+	*	Polygon meshes only have the Gaussian curvature, over the area of the
+	*	faces shared out among their corners.
+	*	\return false if the mesh is empty, or for CURVATURE_MEAN and
+	*	CURVATURE_PRINCIPAL if a face is not a triangle
+	*/
+	bool ComputeCurvature(MeshCurvature& curvature, int fields = CURVATURE_ALL);
+	//! bring curvature up to date with the moved vertices
+	/*!
+	*	only the moved vertices and their one-rings are recomputed when
+	*	GetMovedVertices knows them, else everything. The fields are the
+	*	arrays curvature already holds.
+	*/
+	bool UpdateCurvature(MeshCurvature& curvature);
+	//! colour the vertices by a curvature array: blue negative, white 0, red positive
+	/*!
+	*	\param range magnitude that gets the full colour, 0 takes the 95th
+	*	percentile of the magnitudes so a few spikes do not wash out the rest
+	*/
+	void ColorByCurvature(const std::vector<float>& values, float range = 0.f);
+
+	//! Laplacian smoothing, every step moves a vertex by lambda towards the mean of its ring
+	/*!
+	*	boundary vertices stay fixed, and with selected_only only the
+	*	SELECTED vertices move. The weights are taken from the mesh as it is
+	*	before the first step. The normals, bounding box and average edge
+	*	length are refreshed once at the end, only around the moved vertices
+	*	when they are few.
+	*	\return false if the mesh is empty or being edited, or for
+	*	SMOOTH_COTANGENT if a face is not a triangle
+	*/
+	bool SmoothLaplacian(int iterations, float lambda = 0.5f,
+		SmoothingWeights weights = SMOOTH_UNIFORM, bool selected_only = false);
+	//! Taubin smoothing, a lambda step then a mu step per iteration
+	/*!
+	*	mu is negative and slightly larger than lambda in magnitude, so the
+	*	mesh does not shrink as with SmoothLaplacian. Otherwise the same.
+	*/
+	bool SmoothTaubin(int iterations, float lambda = 0.5f, float mu = -0.53f,
+		SmoothingWeights weights = SMOOTH_UNIFORM, bool selected_only = false);
 
 	int GetBoundaryVrtSize();
 
 
 public:
-	//! clear all the data
+	//! clear all the data, the storage is kept for the next mesh
 	void ClearData(void);
 private:
 	//! clear vertex
@@ -349,6 +864,21 @@ private:
 	void ClearEdges(void);
 	//! clear faces
 	void ClearFaces(void);
+	//! refill edgemap_ from the existing half-edges
+	void RebuildEdgeMap(void);
+	//! drop the standard attributes of the mesh before, a new one requests its own
+	void ReleaseStandardProperties(void);
+
+	//! create the elements and link them from index arrays
+	/*!
+	*	positions and all the other attributes keep their defaults, only the
+	*	pointers, ids, degrees and valences are set. HE_INVALID_INDEX stands
+	*	for a NULL pointer.
+	*/
+	void BuildFromIndices(int nverts, int nhalfedges, int nfaces,
+		const HE_index* he_vert, const HE_index* he_pair, const HE_index* he_face,
+		const HE_index* he_next, const HE_index* he_prev,
+		const HE_index* vert_edge, const HE_index* face_edge);
 
 	//normal computation
 
@@ -361,59 +891,81 @@ private:
 	void ComputeVertexlistNormal(void);
 	//! compute the normal of a vertex
 	void ComputePerVertexNormal(HE_vert* hv); 
+	//! the weighted sum of the face normals around a vertex, not normalized
+	Vec3f AccumulateFaceNormals(HE_vert* hv);
+
+	//! bring the structure of arrays up to date, false when it is disabled
+	bool PrepareSoA(void);
+	//! SIMD versions of the passes above, they need PrepareSoA
+	void ComputeFaceslistNormalSoA(void);
+	void ComputeVertexlistNormalSoA(void);
+	void ComputeBoundingBoxSoA(void);
+	void UnifySoA(float size);
 
 
 	//! compute the number of components
+	/*!
+	*	labels every vertex and face with its component and groups the faces
+	*	by component, see vertex_component, face_component and component_faces
+	*/
 	void ComputeNumComponents(void);
 
 	//! compute the average edge length
 	void ComputeAvarageEdgeLength(void);
 
+	//! the largest number of edges of a face, 0 without faces
+	int MaxFaceValence(void);
+
 	//! set vertex and edge boundary flag
 	void SetBoundaryFlag(void);
 
 	//! for the boundary vertices, make sure the half-edge structure can find all of them
 	void BoundaryCheck();
 
+	//! record a change of the positions: the listed vertices, or all if moved is NULL
+	void TouchPositions(const HE_index* moved, size_t count);
+
 	//! unify mesh
 	void Unify(float size);
+	//! move the bounding box, edge lengths and face areas along with a unify
+	void UnifyAggregates(const Vec3f& center, float scale);
+
+	//! one level of Subdivide into result, whose aggregates are not updated
+	void SubdivideOnce(Mesh3D& result, SubdivisionScheme scheme);
+
+	//! both smoothing operators, mu 0 for Laplacian
+	bool Smooth(int iterations, float lambda, float mu, SmoothingWeights weights, bool selected_only);
+
+	//! curvature of count vertices, or of all of them if verts is NULL, into the arrays sized in curvature
+	void ComputeCurvatureOf(const HE_index* verts, size_t count, MeshCurvature& curvature);
 
 	//! check the face whether contains the vert
 	bool isFaceContainVertex(HE_face* face, HE_vert* vert);
 
 
 /*----------------------------------add by wang kang at 2013-10-12- -----------------------------------*/
+	//! copy the one-ring of a vertex, prefer neighbors() which copies nothing
 	void get_neighborId(const size_t& vertid, std::vector<size_t>& neighbors)
 	{
-		HE_edge* edge = get_vertex(vertid)->pedge_;
-		neighbors.clear();
-		do 
-		{
-			neighbors.push_back(edge->pvert_->id());
-			edge = edge->ppair_->pnext_;
-		} while (edge!=get_vertex(vertid)->pedge_ && edge != NULL);
-
-		std::vector<size_t> tmp = neighbors;
-		for (size_t i=0; i!= tmp.size(); ++i)
-			neighbors[i] = tmp[tmp.size()-i-1];
+		const HE_index* ring = this->neighbors(static_cast<int>(vertid));
+		neighbors.assign(ring, ring + num_of_neighbors(static_cast<int>(vertid)));
 	}
 private:
-	void SetNeighbors()
-	{
-		for (size_t i=0; i!= num_of_vertex_list(); ++i)
-			get_neighborId(i, pvertices_list_->at(i)->neighborIdx);
-	}
+	//! build the one-ring adjacency ring_start_ / ring_verts_
+	void SetNeighbors();
 
 public:
 	void LinearTex()
 	{
+		request_vertex_texcoords();
 		for (size_t i=0; i != num_of_vertex_list(); ++i)
-			pvertices_list_->at(i)->texCoord_ = pvertices_list_->at(i);
+			vertex_texcoord(static_cast<HE_index>(i)) = pvertices_list_->at(i)->position_;
 	}
 
 	void SphereTex()
 	{
 		static const float pi = 3.1415926;
+		request_vertex_texcoords();
 		for (size_t i=0; i != num_of_vertex_list(); ++i)
 		{
 			register HE_vert * vert = pvertices_list_->at(i);
@@ -422,8 +974,8 @@ public:
 
 			float r = sqrt(p[1]*p[1]+p[0]*p[0]);
 
-			vert->texCoord_[0] = asin(p[2])/pi + 0.5;
-			vert->texCoord_[1] = acos(p[0])/(2*pi);
+			vertex_texcoord(static_cast<HE_index>(i))[0] = asin(p[2])/pi + 0.5;
+			vertex_texcoord(static_cast<HE_index>(i))[1] = acos(p[0])/(2*pi);
 		}
 	}
 	/*---------------------------------------------------------*/
@@ -448,7 +1000,7 @@ public:
 //
 //bool Mesh3D::LoadFromOBJFile(const char* fins);
 //
-//void Mesh3D::WriteToOBJFile(const char* fouts);
+//bool Mesh3D::WriteToOBJFile(const char* fouts);
 //
 //void Mesh3D::UpdateMesh(void);
 //
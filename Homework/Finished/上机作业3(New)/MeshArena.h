@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vector>
+#include <new>
+#include <utility>
+#include <cstddef>
+
+//! 32-bit index of a vertex, half-edge or face inside its arena
+typedef unsigned int HE_index;
+
+//! marks "no element", e.g. the missing face of a boundary half-edge
+const HE_index HE_INVALID_INDEX = 0xffffffffu;
+
+/*!
+*	Slab arena used as the backing store of the half-edge elements.
+*
+*	Elements are constructed in place inside fixed-size contiguous slabs and
+*	are addressed by a 32-bit index (the id_ of the element). Slabs never move
+*	once allocated, so pointers into the arena stay valid while the mesh grows.
+*	clear() only runs the destructors and keeps the slabs, so reloading a mesh
+*	of a similar size does not allocate again; release() gives the memory back.
+*/
+template <class T, unsigned LOG2_SLAB = 12>
+class MeshArena
+{
+public:
+	enum { SLAB_SIZE = 1u << LOG2_SLAB, SLAB_MASK = SLAB_SIZE - 1 };
+
+private:
+	std::vector<T*>	slabs_;		//!< raw storage, SLAB_SIZE elements per slab
+	HE_index		size_;		//!< number of constructed elements
+
+	MeshArena(const MeshArena&);
+	MeshArena& operator=(const MeshArena&);
+
+public:
+	MeshArena(void) : size_(0) {}
+	~MeshArena(void) { release(); }
+
+	//! number of constructed elements
+	inline HE_index size(void) const {return size_;}
+	//! number of elements that fit into the allocated slabs
+	inline size_t capacity(void) const {return slabs_.size() << LOG2_SLAB;}
+	inline bool empty(void) const {return size_ == 0;}
+
+	//! access the i-th element, no range check
+	inline T& operator[](HE_index i) {return slabs_[i >> LOG2_SLAB][i & SLAB_MASK];}
+	inline const T& operator[](HE_index i) const {return slabs_[i >> LOG2_SLAB][i & SLAB_MASK];}
+
+	//! make sure n elements can be created without allocating
+	void reserve(size_t n)
+	{
+		while (capacity() < n)
+		{
+			slabs_.push_back(static_cast<T*>(::operator new(sizeof(T) * SLAB_SIZE)));
+		}
+	}
+
+	//! construct a new element at the end of the arena
+	template <class... Args>
+	T* create(Args&&... args)
+	{
+		if (size_ == capacity())
+		{
+			reserve(static_cast<size_t>(size_) + 1);
+		}
+		T* p = &(*this)[size_];
+		new (p) T(std::forward<Args>(args)...);
+		++size_;
+		return p;
+	}
+
+	//! destroy all the elements but keep the slabs for reuse
+	void clear(void)
+	{
+		for (HE_index i = 0; i < size_; i++)
+		{
+			(*this)[i].~T();
+		}
+		size_ = 0;
+	}
+
+	//! destroy all the elements and free the slabs
+	void release(void)
+	{
+		clear();
+		for (size_t i = 0; i < slabs_.size(); i++)
+		{
+			::operator delete(slabs_[i]);
+		}
+		slabs_.clear();
+	}
+
+	void swap(MeshArena& other)
+	{
+		slabs_.swap(other.slabs_);
+		std::swap(size_, other.size_);
+	}
+};
@@ -0,0 +1,492 @@
+#include "MeshBVH.h"
+
+#include <algorithm>
+#include <atomic>
+
+// SAH build.
+//
+// A node is split at the best of SAH_BINS planes per axis, placed between
+// the triangle centroids; a node becomes a leaf once splitting costs more
+// than intersecting all its triangles. Nodes are taken from a preallocated
+// array by an atomic counter, two at a time for the children, so subtrees
+// can be built by different tasks of the thread pool into the same array.
+
+namespace
+{
+	const int			SAH_BINS = 16;
+	const unsigned int	MAX_LEAF_SIZE = 8;		//!< larger leaves are split even against the SAH
+	const float			TRAVERSAL_COST = 1.f;	//!< cost of a node visit, relative to a triangle test
+	const unsigned int	PARALLEL_MIN = 4096;	//!< smaller subtrees are not split into pool tasks
+	const unsigned int	SAH_MAX_DEPTH = 64;		//!< deeper nodes are split at the median, this bounds the depth
+	const int			STACK_SIZE = 128;		//!< > SAH_MAX_DEPTH + 32, the traversal stack can not overflow
+
+	struct BuildBox
+	{
+		float lo[3], hi[3];
+
+		BuildBox(void)
+		{
+			lo[0] = lo[1] = lo[2] = 1e30f;
+			hi[0] = hi[1] = hi[2] = -1e30f;
+		}
+		void Grow(const float* p)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				lo[k] = std::min(lo[k], p[k]);
+				hi[k] = std::max(hi[k], p[k]);
+			}
+		}
+		void Grow(const BuildBox& b)
+		{
+			Grow(b.lo);
+			Grow(b.hi);
+		}
+		float HalfArea(void) const
+		{
+			float dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+			return dx < 0.f ? 0.f : dx * dy + dy * dz + dz * dx;
+		}
+	};
+
+	//! what the build needs of a triangle, partitioned in place so that
+	//! every pass over a node reads memory in order
+	struct BuildRef
+	{
+		BuildBox	box;
+		float		centroid[3];
+		HE_index	tri;
+	};
+
+	struct BVHBuilder
+	{
+		std::vector<BuildRef>		refs;		//!< triangles, in leaf order once built
+		MeshBVH::Node*				nodes;
+		std::atomic<unsigned int>	next_node;
+
+		void MakeLeaf(MeshBVH::Node& node, unsigned int begin, unsigned int end)
+		{
+			node.first = begin;
+			node.count = end - begin;
+		}
+
+		void Build(unsigned int index, unsigned int begin, unsigned int end, unsigned int depth)
+		{
+			MeshBVH::Node& node = nodes[index];
+			BuildBox bounds, cbounds;
+			for (unsigned int i = begin; i < end; i++)
+			{
+				bounds.Grow(refs[i].box);
+				cbounds.Grow(refs[i].centroid);
+			}
+			for (int k = 0; k < 3; k++)
+			{
+				node.bmin[k] = bounds.lo[k];
+				node.bmax[k] = bounds.hi[k];
+			}
+
+			unsigned int n = end - begin;
+			if (n <= 2)
+			{
+				MakeLeaf(node, begin, end);
+				return;
+			}
+
+			// binned SAH over the three axes
+			int best_axis = -1, best_split = 0;
+			float best_cost = 1e30f;
+			for (int axis = 0; axis < 3 && depth < SAH_MAX_DEPTH; axis++)
+			{
+				float extent = cbounds.hi[axis] - cbounds.lo[axis];
+				if (extent <= 0.f)
+				{
+					continue;
+				}
+				float scale = SAH_BINS / extent;
+				BuildBox bin_box[SAH_BINS];
+				unsigned int bin_count[SAH_BINS] = {0};
+				for (unsigned int i = begin; i < end; i++)
+				{
+					int b = std::min(SAH_BINS - 1, static_cast<int>((refs[i].centroid[axis] - cbounds.lo[axis]) * scale));
+					bin_count[b]++;
+					bin_box[b].Grow(refs[i].box);
+				}
+				// sweep from the right, then from the left
+				float right_area[SAH_BINS];
+				unsigned int right_count[SAH_BINS];
+				BuildBox acc;
+				unsigned int count = 0;
+				for (int b = SAH_BINS - 1; b > 0; b--)
+				{
+					acc.Grow(bin_box[b]);
+					count += bin_count[b];
+					right_area[b] = acc.HalfArea();
+					right_count[b] = count;
+				}
+				acc = BuildBox();
+				count = 0;
+				for (int b = 0; b < SAH_BINS - 1; b++)
+				{
+					acc.Grow(bin_box[b]);
+					count += bin_count[b];
+					if (count == 0 || right_count[b + 1] == 0)
+					{
+						continue;
+					}
+					float cost = acc.HalfArea() * count + right_area[b + 1] * right_count[b + 1];
+					if (cost < best_cost)
+					{
+						best_cost = cost;
+						best_axis = axis;
+						best_split = b + 1;
+					}
+				}
+			}
+
+			float leaf_cost = static_cast<float>(n);
+			float split_cost = TRAVERSAL_COST + best_cost / std::max(bounds.HalfArea(), 1e-30f);
+			if (n <= MAX_LEAF_SIZE && (best_axis < 0 || split_cost >= leaf_cost || depth >= SAH_MAX_DEPTH))
+			{
+				MakeLeaf(node, begin, end);
+				return;
+			}
+
+			unsigned int mid;
+			if (best_axis < 0)
+			{
+				// all the centroids coincide or the tree is too deep: halve
+				mid = begin + n / 2;
+			}
+			else
+			{
+				float lo = cbounds.lo[best_axis];
+				float scale = SAH_BINS / (cbounds.hi[best_axis] - lo);
+				BuildRef* split = std::partition(refs.data() + begin, refs.data() + end, [&](const BuildRef& r)
+				{
+					return std::min(SAH_BINS - 1, static_cast<int>((r.centroid[best_axis] - lo) * scale)) < best_split;
+				});
+				mid = static_cast<unsigned int>(split - refs.data());
+				if (mid == begin || mid == end)
+				{
+					mid = begin + n / 2;
+				}
+			}
+
+			unsigned int children = next_node.fetch_add(2);
+			node.first = children;
+			node.count = 0;
+			if (n >= PARALLEL_MIN)
+			{
+				parallel_invoke([&]() { Build(children, begin, mid, depth + 1); },
+					[&]() { Build(children + 1, mid, end, depth + 1); });
+			}
+			else
+			{
+				Build(children, begin, mid, depth + 1);
+				Build(children + 1, mid, end, depth + 1);
+			}
+		}
+	};
+}
+
+MeshBVH::MeshBVH(void)
+	: mesh_(NULL)
+{
+}
+
+MeshBVH::~MeshBVH(void)
+{
+}
+
+void MeshBVH::Clear(void)
+{
+	mesh_ = NULL;
+	nodes_.clear();
+	tri_verts_.clear();
+	tri_face_.clear();
+	tri_fan_.clear();
+}
+
+void MeshBVH::Build(Mesh3D* mesh)
+{
+	Clear();
+	if (mesh == NULL || !mesh->isValid())
+	{
+		return;
+	}
+	mesh_ = mesh;
+
+	// split the faces into fans of triangles
+	int nfaces = mesh->num_of_face_list();
+	std::vector<HE_index> first_tri(nfaces + 1, 0);
+	for (int f = 0; f < nfaces; f++)
+	{
+		first_tri[f + 1] = first_tri[f] + static_cast<HE_index>(std::max(mesh->face_at(f).valence_ - 2, 0));
+	}
+	size_t ntris = first_tri[nfaces];
+	std::vector<HE_index> verts(3 * ntris), faces(ntris);
+	std::vector<int> fans(ntris);
+	parallel_for(0, nfaces, [&](size_t f)
+	{
+		HE_edge* edge = mesh->face_at(static_cast<HE_index>(f)).pedge_;
+		HE_index c0 = edge->pvert_->id_;
+		edge = edge->pnext_;
+		for (HE_index t = first_tri[f], k = 0; t < first_tri[f + 1]; t++, k++)
+		{
+			verts[3 * t] = c0;
+			verts[3 * t + 1] = edge->pvert_->id_;
+			verts[3 * t + 2] = edge->pnext_->pvert_->id_;
+			faces[t] = static_cast<HE_index>(f);
+			fans[t] = static_cast<int>(k);
+			edge = edge->pnext_;
+		}
+	});
+	if (ntris == 0)
+	{
+		return;
+	}
+
+	BVHBuilder builder;
+	builder.refs.resize(ntris);
+	parallel_for(0, ntris, [&](size_t t)
+	{
+		BuildRef& ref = builder.refs[t];
+		BuildBox& box = ref.box;
+		for (int c = 0; c < 3; c++)
+		{
+			const Vec3f& p = mesh->vertex_at(verts[3 * t + c]).position_;
+			float q[3] = {p[0], p[1], p[2]};
+			box.Grow(q);
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			ref.centroid[k] = 0.5f * (box.lo[k] + box.hi[k]);
+		}
+		ref.tri = static_cast<HE_index>(t);
+	});
+
+	nodes_.resize(2 * ntris - 1);
+	builder.nodes = nodes_.data();
+	builder.next_node = 1;
+	builder.Build(0, 0, static_cast<unsigned int>(ntris), 0);
+	nodes_.resize(builder.next_node);
+
+	// store the triangles in leaf order
+	tri_verts_.resize(3 * ntris);
+	tri_face_.resize(ntris);
+	tri_fan_.resize(ntris);
+	parallel_for(0, ntris, [&](size_t i)
+	{
+		HE_index t = builder.refs[i].tri;
+		tri_verts_[3 * i] = verts[3 * t];
+		tri_verts_[3 * i + 1] = verts[3 * t + 1];
+		tri_verts_[3 * i + 2] = verts[3 * t + 2];
+		tri_face_[i] = faces[t];
+		tri_fan_[i] = fans[t];
+	});
+}
+
+void MeshBVH::FitNode(unsigned int i)
+{
+	Node& node = nodes_[i];
+	BuildBox box;
+	if (node.count > 0)
+	{
+		for (unsigned int t = node.first; t < node.first + node.count; t++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				const Vec3f& p = mesh_->vertex_at(tri_verts_[3 * t + c]).position_;
+				float q[3] = {p[0], p[1], p[2]};
+				box.Grow(q);
+			}
+		}
+	}
+	else
+	{
+		box.Grow(nodes_[node.first].bmin);
+		box.Grow(nodes_[node.first].bmax);
+		box.Grow(nodes_[node.first + 1].bmin);
+		box.Grow(nodes_[node.first + 1].bmax);
+	}
+	for (int k = 0; k < 3; k++)
+	{
+		node.bmin[k] = box.lo[k];
+		node.bmax[k] = box.hi[k];
+	}
+}
+
+void MeshBVH::Refit(void)
+{
+	if (nodes_.empty())
+	{
+		return;
+	}
+	// leaves in parallel, then the inner nodes bottom up: children always
+	// come after their parent in the array
+	parallel_for(0, nodes_.size(), [this](size_t i)
+	{
+		if (nodes_[i].count > 0)
+		{
+			FitNode(static_cast<unsigned int>(i));
+		}
+	});
+	for (size_t i = nodes_.size(); i-- > 0; )
+	{
+		if (nodes_[i].count == 0)
+		{
+			FitNode(static_cast<unsigned int>(i));
+		}
+	}
+}
+
+bool MeshBVH::IntersectTriangle(HE_index tri, const Vec3f& origin, const Vec3f& dir,
+	float tmax, float& t, float& u, float& v) const
+{
+	// Moller-Trumbore, both sides
+	const Vec3f& p0 = mesh_->vertex_at(tri_verts_[3 * tri]).position_;
+	const Vec3f& p1 = mesh_->vertex_at(tri_verts_[3 * tri + 1]).position_;
+	const Vec3f& p2 = mesh_->vertex_at(tri_verts_[3 * tri + 2]).position_;
+	Vec3f e1 = p1 - p0;
+	Vec3f e2 = p2 - p0;
+	Vec3f pv = dir CROSS e2;
+	float det = e1 DOT pv;
+	if (det == 0.f)
+	{
+		return false;
+	}
+	float inv = 1.f / det;
+	Vec3f tv = origin - p0;
+	u = (tv DOT pv) * inv;
+	if (u < 0.f || u > 1.f)
+	{
+		return false;
+	}
+	Vec3f qv = tv CROSS e1;
+	v = (dir DOT qv) * inv;
+	if (v < 0.f || u + v > 1.f)
+	{
+		return false;
+	}
+	t = (e2 DOT qv) * inv;
+	return t > 0.f && t < tmax;
+}
+
+namespace
+{
+	//! entry distance of the ray into the node box, or 1e30 for a miss
+	inline float SlabTest(const MeshBVH::Node& node, const float* origin, const float* inv_dir, float tmax)
+	{
+		float tnear = 0.f, tfar = tmax;
+		for (int k = 0; k < 3; k++)
+		{
+			float t0 = (node.bmin[k] - origin[k]) * inv_dir[k];
+			float t1 = (node.bmax[k] - origin[k]) * inv_dir[k];
+			if (t0 > t1)
+			{
+				std::swap(t0, t1);
+			}
+			tnear = std::max(tnear, t0);
+			tfar = std::min(tfar, t1);
+		}
+		return tnear <= tfar ? tnear : 1e30f;
+	}
+}
+
+bool MeshBVH::Intersect(const Vec3f& origin, const Vec3f& dir, RayHit& hit, float tmax) const
+{
+	if (nodes_.empty())
+	{
+		return false;
+	}
+	float o[3] = {origin[0], origin[1], origin[2]};
+	float inv_dir[3] = {1.f / dir[0], 1.f / dir[1], 1.f / dir[2]};
+
+	bool found = false;
+	unsigned int stack[STACK_SIZE];
+	int top = 0;
+	if (SlabTest(nodes_[0], o, inv_dir, tmax) < 1e30f)
+	{
+		stack[top++] = 0;
+	}
+	while (top > 0)
+	{
+		const Node& node = nodes_[stack[--top]];
+		if (node.count > 0)
+		{
+			for (unsigned int i = node.first; i < node.first + node.count; i++)
+			{
+				float t, u, v;
+				if (IntersectTriangle(i, origin, dir, tmax, t, u, v))
+				{
+					tmax = t;
+					hit.face = static_cast<int>(tri_face_[i]);
+					hit.fan = tri_fan_[i];
+					hit.t = t;
+					hit.u = u;
+					hit.v = v;
+					found = true;
+				}
+			}
+			continue;
+		}
+
+		// visit the nearer child first, push it last
+		unsigned int near_child = node.first, far_child = node.first + 1;
+		float t_near = SlabTest(nodes_[near_child], o, inv_dir, tmax);
+		float t_far = SlabTest(nodes_[far_child], o, inv_dir, tmax);
+		if (t_far < t_near)
+		{
+			std::swap(near_child, far_child);
+			std::swap(t_near, t_far);
+		}
+		if (t_far < 1e30f)
+		{
+			stack[top++] = far_child;
+		}
+		if (t_near < 1e30f)
+		{
+			stack[top++] = near_child;
+		}
+	}
+	return found;
+}
+
+bool MeshBVH::Occluded(const Vec3f& origin, const Vec3f& dir, float tmax) const
+{
+	if (nodes_.empty())
+	{
+		return false;
+	}
+	float o[3] = {origin[0], origin[1], origin[2]};
+	float inv_dir[3] = {1.f / dir[0], 1.f / dir[1], 1.f / dir[2]};
+
+	unsigned int stack[STACK_SIZE];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const Node& node = nodes_[stack[--top]];
+		if (SlabTest(node, o, inv_dir, tmax) >= 1e30f)
+		{
+			continue;
+		}
+		if (node.count > 0)
+		{
+			for (unsigned int i = node.first; i < node.first + node.count; i++)
+			{
+				float t, u, v;
+				if (IntersectTriangle(i, origin, dir, tmax, t, u, v))
+				{
+					return true;
+				}
+			}
+		}
+		else
+		{
+			stack[top++] = node.first + 1;
+			stack[top++] = node.first;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+#include "Mesh3D.h"
+
+/*!
+*	Result of a ray query against a MeshBVH.
+*
+*	The hit point is origin + t * dir, and also
+*	(1 - u - v) * p0 + u * p1 + v * p2 where p0 p1 p2 are the corners of the
+*	hit triangle. For a triangle face they are the vertices met walking from
+*	face->pedge_. A polygon is split into a fan (c0, c[fan+1], c[fan+2]).
+*/
+struct RayHit
+{
+	int		face;		//!< id of the hit face, -1 if nothing was hit
+	int		fan;		//!< triangle of the fan of a polygon, 0 for triangles
+	float	t;			//!< ray parameter of the hit
+	float	u, v;		//!< barycentric coordinates of the hit
+
+	RayHit(void) : face(-1), fan(0), t(0.f), u(0.f), v(0.f) {}
+};
+
+/*!
+*	Bounding volume hierarchy over the faces of a Mesh3D.
+*
+*	The tree is built top down with a binned surface area heuristic, the
+*	upper subtrees in parallel. Nodes live in one flat array, the two children
+*	of a node are stored next to each other and always after their parent, and
+*	the triangles are stored in leaf order. The BVH only keeps ids and reads
+*	the vertex positions from the mesh, which must outlive it. After moving
+*	vertices call Refit; after changing the topology build it again.
+*/
+class MeshBVH
+{
+public:
+	//! one node of the flat array, 32 bytes
+	struct Node
+	{
+		float			bmin[3];
+		unsigned int	first;		//!< leaf: first triangle, inner: index of the left child
+		float			bmax[3];
+		unsigned int	count;		//!< leaf: number of triangles, inner: 0
+	};
+
+private:
+	Mesh3D*					mesh_;
+	std::vector<Node>		nodes_;
+	std::vector<HE_index>	tri_verts_;		//!< the 3 corner vertex ids of every triangle
+	std::vector<HE_index>	tri_face_;		//!< face id of every triangle
+	std::vector<int>		tri_fan_;		//!< fan index of every triangle in its face
+
+	MeshBVH(const MeshBVH&);
+	MeshBVH& operator=(const MeshBVH&);
+
+public:
+	MeshBVH(void);
+	~MeshBVH(void);
+
+	//! build the hierarchy over all the faces of mesh
+	void Build(Mesh3D* mesh);
+	//! recompute the node bounds after vertices moved, the tree shape is kept
+	void Refit(void);
+	//! forget the tree
+	void Clear(void);
+
+	inline bool empty(void) const {return nodes_.empty();}
+	inline int num_of_nodes(void) const {return static_cast<int>(nodes_.size());}
+	inline int num_of_triangles(void) const {return static_cast<int>(tri_face_.size());}
+	inline const Node& node(int i) const {return nodes_[i];}
+
+	//! the closest hit along the ray with t in (0, tmax)
+	/*!
+	*	\param dir ray direction, need not be normalized
+	*	\return false if the ray hits nothing, hit is then left untouched
+	*/
+	bool Intersect(const Vec3f& origin, const Vec3f& dir, RayHit& hit, float tmax = 1e30f) const;
+
+	//! whether the ray hits anything with t in (0, tmax), stops at the first hit found
+	bool Occluded(const Vec3f& origin, const Vec3f& dir, float tmax = 1e30f) const;
+
+private:
+	//! ray / triangle test, t u v of the hit if it is in (0, tmax)
+	bool IntersectTriangle(HE_index tri, const Vec3f& origin, const Vec3f& dir,
+		float tmax, float& t, float& u, float& v) const;
+	//! fill the bounds of node i from its triangles or children
+	void FitNode(unsigned int i);
+};
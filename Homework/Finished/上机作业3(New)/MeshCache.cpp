@@ -0,0 +1,378 @@
+#include "Mesh3D.h"
+#include "MeshIO.h"
+
+#include <cstdio>
+#include <cstring>
+
+// Binary sidecar of a loaded mesh.
+//
+// The file is a fixed header followed by flat arrays, each starting at an
+// 8-byte aligned offset that only depends on the element counts:
+//
+//   vertices:   position[3] normal[3] texcoord[3] (float), edge (u32), flag (u8)
+//   half-edges: vert next prev pair face (u32), texcoord[3] (float), flag (u8)
+//   faces:      edge (u32), normal[3] (float), flag (u8)
+//
+// The texture coordinates are only there if the mesh has them, as told by
+// the flags of the header.
+//
+// Missing links are stored as HE_INVALID_INDEX. Loading maps the file and
+// links the elements straight from the mapped index arrays, so none of the
+// connectivity construction (InsertFace, boundary flags and checks, normals)
+// runs again.
+
+namespace
+{
+	const char			CACHE_MAGIC[8] = {'H', 'E', 'M', 'E', 'S', 'H', 0, 0};
+	const unsigned int	CACHE_VERSION = 4;	// 2: bbox and edge length are stored after Unify
+											// 3: texture coordinates only if present
+											// 4: normal weighting of the stored normals
+
+	//! bits of CacheHeader::flags
+	enum CacheFlags
+	{
+		CACHE_VERTEX_TEXCOORDS = 1,
+		CACHE_HALF_EDGE_TEXCOORDS = 2
+	};
+
+	struct CacheHeader
+	{
+		char				magic[8];
+		unsigned int		version;
+		unsigned int		header_size;
+		unsigned long long	src_size;
+		unsigned long long	src_mtime;
+		unsigned long long	src_hash;
+		unsigned int		num_verts;
+		unsigned int		num_half_edges;
+		unsigned int		num_faces;
+		unsigned int		flags;					//!< CacheFlags
+		float				bbox[6];				//!< xmin xmax ymin ymax zmin zmax
+		float				average_edge_length;
+		unsigned int		normal_weighting;		//!< NormalWeighting of the stored normals
+	};
+
+	//! byte offsets of the arrays behind the header
+	struct CacheLayout
+	{
+		size_t v_position, v_normal, v_texcoord, v_edge, v_flag;
+		size_t he_vert, he_next, he_prev, he_pair, he_face, he_texcoord, he_flag;
+		size_t f_edge, f_normal, f_flag;
+		size_t total;
+
+		CacheLayout(size_t nv, size_t nhe, size_t nf, unsigned int flags)
+		{
+			total = sizeof(CacheHeader);
+			v_position = Take(12 * nv);
+			v_normal = Take(12 * nv);
+			v_texcoord = Take(flags & CACHE_VERTEX_TEXCOORDS ? 12 * nv : 0);
+			v_edge = Take(4 * nv);
+			v_flag = Take(nv);
+			he_vert = Take(4 * nhe);
+			he_next = Take(4 * nhe);
+			he_prev = Take(4 * nhe);
+			he_pair = Take(4 * nhe);
+			he_face = Take(4 * nhe);
+			he_texcoord = Take(flags & CACHE_HALF_EDGE_TEXCOORDS ? 12 * nhe : 0);
+			he_flag = Take(nhe);
+			f_edge = Take(4 * nf);
+			f_normal = Take(12 * nf);
+			f_flag = Take(nf);
+		}
+
+	private:
+		size_t Take(size_t bytes)
+		{
+			size_t offset = total;
+			total = (total + bytes + 7) & ~static_cast<size_t>(7);
+			return offset;
+		}
+	};
+
+	template <class P>
+	inline HE_index IndexOf(P* p)
+	{
+		return p ? static_cast<HE_index>(p->id_) : HE_INVALID_INDEX;
+	}
+
+	inline void PutVec3(char* dst, const Vec3f& v)
+	{
+		memcpy(dst, &v[0], 3 * sizeof(float));
+	}
+
+	inline Vec3f GetVec3(const char* src)
+	{
+		float f[3];
+		memcpy(f, src, sizeof(f));
+		return Vec3f(f[0], f[1], f[2]);
+	}
+
+	//! every index must address an element or be HE_INVALID_INDEX
+	bool CheckIndices(const HE_index* idx, size_t n, size_t count, bool allow_invalid)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			if (idx[i] >= count && !(allow_invalid && idx[i] == HE_INVALID_INDEX))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+bool Mesh3D::WriteBinaryCache(const char* fcache, const MeshSourceKey& key)
+{
+	if (!isValid())
+	{
+		return false;
+	}
+
+	size_t nv = num_of_vertex_list();
+	size_t nhe = num_of_half_edges_list();
+	size_t nf = num_of_face_list();
+	unsigned int flags = (has_vertex_texcoords() ? CACHE_VERTEX_TEXCOORDS : 0)
+		| (has_half_edge_texcoords() ? CACHE_HALF_EDGE_TEXCOORDS : 0);
+	CacheLayout layout(nv, nhe, nf, flags);
+	std::vector<char> buffer(layout.total, 0);
+	char* data = &buffer[0];
+
+	CacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CACHE_VERSION;
+	header.header_size = sizeof(CacheHeader);
+	header.src_size = key.size;
+	header.src_mtime = key.mtime;
+	header.src_hash = key.hash;
+	header.num_verts = static_cast<unsigned int>(nv);
+	header.num_half_edges = static_cast<unsigned int>(nhe);
+	header.num_faces = static_cast<unsigned int>(nf);
+	header.flags = flags;
+	header.bbox[0] = xmin_; header.bbox[1] = xmax_;
+	header.bbox[2] = ymin_; header.bbox[3] = ymax_;
+	header.bbox[4] = zmin_; header.bbox[5] = zmax_;
+	header.average_edge_length = average_edge_length_;
+	header.normal_weighting = static_cast<unsigned int>(normal_weighting_);
+	memcpy(data, &header, sizeof(header));
+
+	HE_index* v_edge = reinterpret_cast<HE_index*>(data + layout.v_edge);
+	for (size_t i = 0; i < nv; i++)
+	{
+		HE_vert& v = vertex_arena_[static_cast<HE_index>(i)];
+		PutVec3(data + layout.v_position + 12 * i, v.position_);
+		PutVec3(data + layout.v_normal + 12 * i, v.normal_);
+		if (flags & CACHE_VERTEX_TEXCOORDS)
+		{
+			PutVec3(data + layout.v_texcoord + 12 * i, vertex_texcoord(static_cast<HE_index>(i)));
+		}
+		v_edge[i] = IndexOf(v.pedge_);
+		data[layout.v_flag + i] = static_cast<char>(v.boundary_flag_);
+	}
+
+	HE_index* he_vert = reinterpret_cast<HE_index*>(data + layout.he_vert);
+	HE_index* he_next = reinterpret_cast<HE_index*>(data + layout.he_next);
+	HE_index* he_prev = reinterpret_cast<HE_index*>(data + layout.he_prev);
+	HE_index* he_pair = reinterpret_cast<HE_index*>(data + layout.he_pair);
+	HE_index* he_face = reinterpret_cast<HE_index*>(data + layout.he_face);
+	for (size_t i = 0; i < nhe; i++)
+	{
+		HE_edge& e = edge_arena_[static_cast<HE_index>(i)];
+		he_vert[i] = IndexOf(e.pvert_);
+		he_next[i] = IndexOf(e.pnext_);
+		he_prev[i] = IndexOf(e.pprev_);
+		he_pair[i] = IndexOf(e.ppair_);
+		he_face[i] = IndexOf(e.pface_);
+		if (flags & CACHE_HALF_EDGE_TEXCOORDS)
+		{
+			PutVec3(data + layout.he_texcoord + 12 * i, half_edge_texcoord(static_cast<HE_index>(i)));
+		}
+		data[layout.he_flag + i] = static_cast<char>(e.boundary_flag_);
+	}
+
+	HE_index* f_edge = reinterpret_cast<HE_index*>(data + layout.f_edge);
+	for (size_t i = 0; i < nf; i++)
+	{
+		HE_face& f = face_arena_[static_cast<HE_index>(i)];
+		f_edge[i] = IndexOf(f.pedge_);
+		PutVec3(data + layout.f_normal + 12 * i, f.normal_);
+		data[layout.f_flag + i] = static_cast<char>(f.boundary_flag_);
+	}
+
+	FILE* pfile = fopen(fcache, "wb");
+	if (pfile == NULL)
+	{
+		return false;
+	}
+	bool ok = fwrite(data, 1, buffer.size(), pfile) == buffer.size();
+	ok = fclose(pfile) == 0 && ok;
+	if (!ok)
+	{
+		remove(fcache);
+	}
+	return ok;
+}
+
+bool Mesh3D::LoadBinaryCache(const char* fcache, const MeshSourceKey& key)
+{
+	ClearData();
+	ReleaseStandardProperties();
+
+	MappedFile file;
+	if (!file.Open(fcache) || file.size() < sizeof(CacheHeader))
+	{
+		return false;
+	}
+	const char* data = file.data();
+
+	CacheHeader header;
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0
+		|| header.version != CACHE_VERSION
+		|| header.header_size != sizeof(CacheHeader)
+		|| header.src_size != key.size
+		|| header.src_mtime != key.mtime
+		|| header.src_hash != key.hash
+		|| header.normal_weighting != static_cast<unsigned int>(normal_weighting_))
+	{
+		return false;
+	}
+
+	size_t nv = header.num_verts;
+	size_t nhe = header.num_half_edges;
+	size_t nf = header.num_faces;
+	CacheLayout layout(nv, nhe, nf, header.flags);
+	if (layout.total != file.size())
+	{
+		return false;
+	}
+
+	// the index arrays are used in place, the mapping is page aligned and
+	// every array starts at a multiple of 8
+	const HE_index* v_edge = reinterpret_cast<const HE_index*>(data + layout.v_edge);
+	const HE_index* he_vert = reinterpret_cast<const HE_index*>(data + layout.he_vert);
+	const HE_index* he_next = reinterpret_cast<const HE_index*>(data + layout.he_next);
+	const HE_index* he_prev = reinterpret_cast<const HE_index*>(data + layout.he_prev);
+	const HE_index* he_pair = reinterpret_cast<const HE_index*>(data + layout.he_pair);
+	const HE_index* he_face = reinterpret_cast<const HE_index*>(data + layout.he_face);
+	const HE_index* f_edge = reinterpret_cast<const HE_index*>(data + layout.f_edge);
+	if (!CheckIndices(v_edge, nv, nhe, true)
+		|| !CheckIndices(he_vert, nhe, nv, false)
+		|| !CheckIndices(he_next, nhe, nhe, true)
+		|| !CheckIndices(he_prev, nhe, nhe, true)
+		|| !CheckIndices(he_pair, nhe, nhe, false)
+		|| !CheckIndices(he_face, nhe, nf, true)
+		|| !CheckIndices(f_edge, nf, nhe, false))
+	{
+		return false;
+	}
+
+	BuildFromIndices(static_cast<int>(nv), static_cast<int>(nhe), static_cast<int>(nf),
+		he_vert, he_pair, he_face, he_next, he_prev, v_edge, f_edge);
+	if (header.flags & CACHE_VERTEX_TEXCOORDS)
+	{
+		request_vertex_texcoords();
+		for (size_t i = 0; i < nv; i++)
+		{
+			vertex_texcoord(static_cast<HE_index>(i)) = GetVec3(data + layout.v_texcoord + 12 * i);
+		}
+	}
+	if (header.flags & CACHE_HALF_EDGE_TEXCOORDS)
+	{
+		request_half_edge_texcoords();
+		for (size_t i = 0; i < nhe; i++)
+		{
+			half_edge_texcoord(static_cast<HE_index>(i)) = GetVec3(data + layout.he_texcoord + 12 * i);
+		}
+	}
+
+	for (size_t i = 0; i < nv; i++)
+	{
+		HE_vert& v = vertex_arena_[static_cast<HE_index>(i)];
+		v.position_ = GetVec3(data + layout.v_position + 12 * i);
+		v.normal_ = GetVec3(data + layout.v_normal + 12 * i);
+		v.boundary_flag_ = static_cast<BoundaryTag>(data[layout.v_flag + i]);
+	}
+	for (size_t i = 0; i < nhe; i++)
+	{
+		HE_edge& e = edge_arena_[static_cast<HE_index>(i)];
+		e.boundary_flag_ = static_cast<BoundaryTag>(data[layout.he_flag + i]);
+	}
+	for (size_t i = 0; i < nf; i++)
+	{
+		HE_face& f = face_arena_[static_cast<HE_index>(i)];
+		f.normal_ = GetVec3(data + layout.f_normal + 12 * i);
+		f.boundary_flag_ = static_cast<BoundaryTag>(data[layout.f_flag + i]);
+	}
+
+	xmin_ = header.bbox[0]; xmax_ = header.bbox[1];
+	ymin_ = header.bbox[2]; ymax_ = header.bbox[3];
+	zmin_ = header.bbox[4]; zmax_ = header.bbox[5];
+	average_edge_length_ = header.average_edge_length;
+	edge_length_sum_ = static_cast<double>(average_edge_length_) * nhe;
+	if (normal_weighting_ == NORMAL_AREA)
+	{
+		// the face areas are not stored, incremental updates need them
+		ComputeFaceslistNormal();
+	}
+	ComputeNumComponents();
+	SetNeighbors();
+	return true;
+}
+
+void Mesh3D::BuildFromIndices(int nverts, int nhalfedges, int nfaces,
+	const HE_index* he_vert, const HE_index* he_pair, const HE_index* he_face,
+	const HE_index* he_next, const HE_index* he_prev,
+	const HE_index* vert_edge, const HE_index* face_edge)
+{
+	ClearData();
+	Reserve(nverts, nfaces);
+	edge_arena_.reserve(nhalfedges);
+	pedges_list_->reserve(nhalfedges);
+
+	// create everything first, links may point forward
+	for (int i = 0; i < nverts; i++)
+	{
+		InsertVertex(Vec3f());
+	}
+	for (int i = 0; i < nhalfedges; i++)
+	{
+		HE_edge* e = edge_arena_.create();
+		e->id_ = i;
+		pedges_list_->push_back(e);
+	}
+	for (int i = 0; i < nfaces; i++)
+	{
+		HE_face* f = face_arena_.create();
+		f->id_ = i;
+		pfaces_list_->push_back(f);
+	}
+	half_edge_props_.Resize(nhalfedges);
+	face_props_.Resize(nfaces);
+
+	for (int i = 0; i < nhalfedges; i++)
+	{
+		HE_edge& e = edge_arena_[i];
+		e.pvert_ = &vertex_arena_[he_vert[i]];
+		e.ppair_ = he_pair[i] == HE_INVALID_INDEX ? NULL : &edge_arena_[he_pair[i]];
+		e.pface_ = he_face[i] == HE_INVALID_INDEX ? NULL : &face_arena_[he_face[i]];
+		e.pnext_ = he_next[i] == HE_INVALID_INDEX ? NULL : &edge_arena_[he_next[i]];
+		e.pprev_ = he_prev[i] == HE_INVALID_INDEX ? NULL : &edge_arena_[he_prev[i]];
+		e.pvert_->degree_++;
+	}
+	for (int i = 0; i < nverts; i++)
+	{
+		vertex_arena_[i].pedge_ = vert_edge[i] == HE_INVALID_INDEX ? NULL : &edge_arena_[vert_edge[i]];
+	}
+	for (int i = 0; i < nfaces; i++)
+	{
+		HE_face& f = face_arena_[i];
+		f.pedge_ = &edge_arena_[face_edge[i]];
+		HE_edge* e = f.pedge_;
+		do
+		{
+			f.valence_++;
+			e = e->pnext_;
+		} while (e != NULL && e != f.pedge_ && f.valence_ <= nhalfedges);
+	}
+}
@@ -0,0 +1,1044 @@
+#include "Mesh3D.h"
+#include "MeshCodec.h"
+#include "MeshIO.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// Encoder and decoder of the stream described in MeshCodec.h.
+//
+// Both sides run the same state: the edge and vertex FIFOs, the next new
+// vertex and the last values for the predictions, updated in the same
+// order. The encoder keeps the ids of the mesh in its FIFOs and the
+// decoder the ids of the stream, they differ only by the renumbering.
+
+namespace
+{
+	const char			CODEC_MAGIC[4] = {'H', 'E', 'M', 'Z'};
+	const unsigned int	CODEC_VERSION = 1;
+	const unsigned int	CODEC_POLYGONS = 1;		//!< flag: some face has more than 3 corners
+
+	enum CodecStream
+	{
+		STREAM_CODES,
+		STREAM_INDICES,
+		STREAM_VALENCES,
+		STREAM_POSITIONS,
+		STREAM_NORMALS,
+		STREAM_TEXCOORDS,
+		STREAM_TEXFLAGS,
+		NUM_STREAMS
+	};
+
+	struct CodecHeader
+	{
+		char			magic[4];
+		unsigned int	version;
+		unsigned int	header_size;
+		unsigned int	flags;
+		unsigned int	num_verts;
+		unsigned int	num_faces;
+		unsigned char	position_bits;
+		unsigned char	normal_bits;			//!< 0 if there are no normals
+		unsigned char	texcoord_bits;			//!< 0 if there are no texture coordinates
+		unsigned char	reserved;
+		float			origin[3];				//!< xmin ymin zmin
+		float			extent;					//!< largest side of the bounding box
+		float			tex_origin[2];
+		float			tex_extent[2];
+		unsigned int	stream_bytes[NUM_STREAMS];
+		unsigned int	checksum;				//!< CRC-32 of the header with this field 0, and of the streams
+	};
+
+	//! CRC-32 (IEEE 802.3) of n bytes, continuing from crc
+	unsigned int Crc32(const unsigned char* p, size_t n, unsigned int crc = 0)
+	{
+		struct Table
+		{
+			unsigned int	entry[256];
+
+			Table(void)
+			{
+				for (unsigned int i = 0; i < 256; i++)
+				{
+					unsigned int c = i;
+					for (int k = 0; k < 8; k++)
+					{
+						c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+					}
+					entry[i] = c;
+				}
+			}
+		};
+		static const Table table;
+		crc = ~crc;
+		for (size_t i = 0; i < n; i++)
+		{
+			crc = table.entry[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	//! whether no two faces of obj share a directed edge, as the half-edges need
+	bool DirectedEdgesUnique(const OBJData& obj, size_t nverts)
+	{
+		// the ends of the edges, grouped by their start with a counting sort
+		size_t nfaces = obj.face_starts.size() - 1;
+		size_t ncorners = obj.corner_verts.size();
+		std::vector<unsigned int> first(nverts + 1, 0);
+		std::vector<unsigned int> ends(ncorners);
+		for (size_t c = 0; c < ncorners; c++)
+		{
+			first[obj.corner_verts[c] + 1]++;
+		}
+		for (size_t v = 0; v < nverts; v++)
+		{
+			first[v + 1] += first[v];
+		}
+		{
+			std::vector<unsigned int> fill(first.begin(), first.end() - 1);
+			for (size_t f = 0; f < nfaces; f++)
+			{
+				int begin = obj.face_starts[f], end = obj.face_starts[f + 1];
+				for (int c = begin; c < end; c++)
+				{
+					int next = c + 1 < end ? c + 1 : begin;
+					ends[fill[obj.corner_verts[c]]++] = static_cast<unsigned int>(obj.corner_verts[next]);
+				}
+			}
+		}
+
+		// every vertex has a few edges, a repeated end shows after sorting them
+		std::vector<unsigned char> repeated(nverts, 0);
+		parallel_for(0, nverts, [&](size_t v)
+		{
+			unsigned int* begin = &ends[0] + first[v];
+			unsigned int* end = &ends[0] + first[v + 1];
+			std::sort(begin, end);
+			repeated[v] = std::adjacent_find(begin, end) != end;
+		});
+		return std::find(repeated.begin(), repeated.end(), 1) == repeated.end();
+	}
+
+	//! the checksum of a stream whose header is header
+	unsigned int StreamChecksum(CodecHeader header, const unsigned char* streams, size_t size)
+	{
+		header.checksum = 0;
+		unsigned int crc = Crc32(reinterpret_cast<const unsigned char*>(&header), sizeof(header));
+		return Crc32(streams, size, crc);
+	}
+
+	const int			FIFO_SIZE = 16;			//!< entries kept, a power of 2
+	const int			EDGE_SLOTS = 15;		//!< edge slots a code names, the high nibble 15 is a free triangle
+	const int			VERTEX_SLOTS = 14;		//!< vertex slots a code names, low nibble 1 to 14
+	const unsigned char	NEW_VERTEX = 0;
+	const unsigned char	EXPLICIT_VERTEX = 15;
+	const unsigned char	FREE_TRIANGLE = 0xF0;
+
+	inline unsigned int ZigZag(int v)
+	{
+		return (static_cast<unsigned int>(v) << 1) ^ static_cast<unsigned int>(v >> 31);
+	}
+
+	inline int UnZigZag(unsigned int v)
+	{
+		return static_cast<int>(v >> 1) ^ -static_cast<int>(v & 1);
+	}
+
+	//! a + b - c wrapping around, so that a broken stream can not overflow
+	inline int WrapSum(int a, int b, int c = 0)
+	{
+		return static_cast<int>(static_cast<unsigned int>(a) + static_cast<unsigned int>(b) - static_cast<unsigned int>(c));
+	}
+
+	struct ByteWriter
+	{
+		std::vector<unsigned char>	bytes;
+		int							bits;		//!< bits used in the last byte by Bit, 8 if full
+
+		ByteWriter(void) : bits(8) {}
+
+		inline void Byte(unsigned char b) {bytes.push_back(b);}
+		inline void Varint(unsigned int v)
+		{
+			while (v >= 0x80)
+			{
+				bytes.push_back(static_cast<unsigned char>(v | 0x80));
+				v >>= 7;
+			}
+			bytes.push_back(static_cast<unsigned char>(v));
+		}
+		inline void Signed(int v) {Varint(ZigZag(v));}
+		//! one bit, lowest first in every byte
+		inline void Bit(bool b)
+		{
+			if (bits == 8)
+			{
+				bytes.push_back(0);
+				bits = 0;
+			}
+			bytes.back() |= static_cast<unsigned char>(b ? 1 << bits : 0);
+			bits++;
+		}
+	};
+
+	//! reads a stream, past its end every read fails and gives 0
+	struct ByteReader
+	{
+		const unsigned char*	p;
+		const unsigned char*	end;
+		bool					failed;
+		unsigned char			byte;		//!< the byte Bit reads from
+		int						bits;		//!< bits of it left
+
+		ByteReader(void) : p(NULL), end(NULL), failed(false), byte(0), bits(0) {}
+
+		inline unsigned char Byte(void)
+		{
+			if (p == end)
+			{
+				failed = true;
+				return 0;
+			}
+			return *p++;
+		}
+		inline unsigned int Varint(void)
+		{
+			unsigned int v = 0;
+			for (int shift = 0; shift < 35 && p != end; shift += 7)
+			{
+				unsigned char b = *p++;
+				v |= static_cast<unsigned int>(b & 0x7F) << shift;
+				if (b < 0x80)
+				{
+					return v;
+				}
+			}
+			failed = true;
+			return 0;
+		}
+		inline int Signed(void) {return UnZigZag(Varint());}
+		inline bool Bit(void)
+		{
+			if (bits == 0)
+			{
+				byte = Byte();
+				bits = 8;
+			}
+			bits--;
+			return (byte >> (7 - bits) & 1) != 0;
+		}
+	};
+
+	//! the last edges of the coded triangles, slot 0 is the newest
+	struct EdgeFifo
+	{
+		HE_index		from[FIFO_SIZE];
+		HE_index		to[FIFO_SIZE];
+		HE_index		opposite[FIFO_SIZE];	//!< third vertex of the triangle of the edge
+		const HE_edge*	edge[FIFO_SIZE];		//!< the half-edge, NULL for the diagonals of a polygon; encoder only
+		int				head;
+		int				count;
+
+		EdgeFifo(void) : head(0), count(0) {}
+
+		inline int Slot(int i) const {return (head + i) & (FIFO_SIZE - 1);}
+		inline void Push(HE_index a, HE_index b, HE_index c, const HE_edge* e)
+		{
+			head = (head - 1) & (FIFO_SIZE - 1);
+			from[head] = a;
+			to[head] = b;
+			opposite[head] = c;
+			edge[head] = e;
+			count = std::min(count + 1, FIFO_SIZE);
+		}
+		//! slot of the edge from a to b, -1 if it is not in a named slot
+		inline int Find(HE_index a, HE_index b) const
+		{
+			int n = std::min(count, EDGE_SLOTS);
+			for (int i = 0; i < n; i++)
+			{
+				int s = Slot(i);
+				if (from[s] == a && to[s] == b)
+				{
+					return i;
+				}
+			}
+			return -1;
+		}
+	};
+
+	//! the last new or explicitly coded vertices, slot 0 is the newest
+	struct VertexFifo
+	{
+		HE_index	id[FIFO_SIZE];
+		int			head;
+		int			count;
+
+		VertexFifo(void) : head(0), count(0) {}
+
+		inline HE_index at(int i) const {return id[(head + i) & (FIFO_SIZE - 1)];}
+		inline void Push(HE_index v)
+		{
+			head = (head - 1) & (FIFO_SIZE - 1);
+			id[head] = v;
+			count = std::min(count + 1, FIFO_SIZE);
+		}
+		inline int Find(HE_index v) const
+		{
+			int n = std::min(count, VERTEX_SLOTS);
+			for (int i = 0; i < n; i++)
+			{
+				if (at(i) == v)
+				{
+					return i;
+				}
+			}
+			return -1;
+		}
+	};
+
+	//! x in [origin, origin + (max_q + 0.5) / scale) to [0, max_q], rounded
+	inline int Quantize(float x, float origin, float scale, int max_q)
+	{
+		float q = (x - origin) * scale + 0.5f;
+		return q > 0.f ? (q < static_cast<float>(max_q) ? static_cast<int>(q) : max_q) : 0;
+	}
+
+	inline float SignOf(float x)
+	{
+		return x < 0.f ? -1.f : 1.f;
+	}
+
+	//! a normal to quantized octahedral coordinates, the lower half folded over the diagonals
+	inline void EncodeOctahedral(const Vec3f& n, int max_q, int out[2])
+	{
+		float l1 = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+		float x = 0.f, y = 0.f;
+		if (l1 > 0.f)
+		{
+			x = n[0] / l1;
+			y = n[1] / l1;
+			if (n[2] < 0.f)
+			{
+				float fx = (1.f - std::fabs(y)) * SignOf(x);
+				y = (1.f - std::fabs(x)) * SignOf(y);
+				x = fx;
+			}
+		}
+		float scale = 0.5f * max_q;
+		out[0] = Quantize(x, -1.f, scale, max_q);
+		out[1] = Quantize(y, -1.f, scale, max_q);
+	}
+
+	inline void DecodeOctahedral(int u, int v, float step, float* n)
+	{
+		float x = u * step - 1.f, y = v * step - 1.f;
+		float z = 1.f - std::fabs(x) - std::fabs(y);
+		if (z < 0.f)
+		{
+			float fx = (1.f - std::fabs(y)) * SignOf(x);
+			y = (1.f - std::fabs(x)) * SignOf(y);
+			x = fx;
+		}
+		float l = std::sqrt(x * x + y * y + z * z);
+		n[0] = x / l;
+		n[1] = y / l;
+		n[2] = z / l;
+	}
+
+	//! the quantized attributes of the vertices seen so far, by the ids of one side
+	struct CodecValues
+	{
+		std::vector<int>	position;		//!< 3 per vertex
+		std::vector<int>	normal;			//!< 2 per vertex
+		std::vector<int>	texcoord;		//!< 2 per vertex, its last corner
+		std::vector<char>	has_texcoord;
+		int					last_position[3];
+		int					last_normal[2];
+		int					last_texcoord[2];
+
+		CodecValues(void)
+		{
+			std::fill(last_position, last_position + 3, 0);
+			std::fill(last_normal, last_normal + 2, 0);
+			std::fill(last_texcoord, last_texcoord + 2, 0);
+		}
+
+		//! the prediction of a new vertex across the edge of slot i, or from the last vertex if i < 0
+		inline void Predict(const EdgeFifo& fifo, int i, int pos[3], int nrm[2]) const
+		{
+			if (i < 0)
+			{
+				std::copy(last_position, last_position + 3, pos);
+				std::copy(last_normal, last_normal + 2, nrm);
+				return;
+			}
+			int s = fifo.Slot(i);
+			HE_index a = fifo.from[s], b = fifo.to[s], c = fifo.opposite[s];
+			for (int k = 0; k < 3; k++)
+			{
+				pos[k] = WrapSum(position[3 * a + k], position[3 * b + k], position[3 * c + k]);
+			}
+			if (!normal.empty())
+			{
+				for (int k = 0; k < 2; k++)
+				{
+					nrm[k] = WrapSum(normal[2 * a + k], normal[2 * b + k], normal[2 * c + k]);
+				}
+			}
+		}
+	};
+
+	class CodecEncoder
+	{
+	public:
+		ByteWriter				streams[NUM_STREAMS];
+		EdgeFifo				edges;
+		VertexFifo				verts;
+		CodecValues				values;			//!< filled for every vertex before coding
+		std::vector<int>		corner_texcoord;	//!< 2 per half-edge, quantized
+		std::vector<HE_index>	new_id;			//!< id in the stream, HE_INVALID_INDEX until coded
+		HE_index				next;
+		HE_index				last_explicit;	//!< the last vertex a code gave explicitly
+		bool					polygons;
+		bool					has_normals;
+		bool					has_texcoords;
+
+		CodecEncoder(size_t nverts) : new_id(nverts, HE_INVALID_INDEX), next(0), last_explicit(0), polygons(false), has_normals(false), has_texcoords(false) {}
+
+		//! number the vertex and code its attributes against the prediction from edge slot i
+		void Introduce(HE_index v, int i)
+		{
+			int pos[3], nrm[2];
+			values.Predict(edges, i, pos, nrm);
+			new_id[v] = next++;
+			verts.Push(v);
+			for (int k = 0; k < 3; k++)
+			{
+				values.last_position[k] = values.position[3 * v + k];
+				streams[STREAM_POSITIONS].Signed(values.last_position[k] - pos[k]);
+			}
+			if (has_normals)
+			{
+				for (int k = 0; k < 2; k++)
+				{
+					values.last_normal[k] = values.normal[2 * v + k];
+					streams[STREAM_NORMALS].Signed(values.last_normal[k] - nrm[k]);
+				}
+			}
+		}
+
+		//! the low nibble of the code for the third vertex of a triangle across edge slot i
+		unsigned char ThirdVertex(HE_index v, int i)
+		{
+			if (new_id[v] == HE_INVALID_INDEX)
+			{
+				Introduce(v, i);
+				return NEW_VERTEX;
+			}
+			int j = verts.Find(v);
+			if (j >= 0)
+			{
+				return static_cast<unsigned char>(1 + j);
+			}
+			// the explicit vertices of a run mostly follow each other along its border
+			streams[STREAM_INDICES].Signed(static_cast<int>(new_id[v] - last_explicit - 1));
+			last_explicit = new_id[v];
+			verts.Push(v);
+			return EXPLICIT_VERTEX;
+		}
+
+		//! a vertex of a triangle that shares no edge
+		void FreeVertex(HE_index v)
+		{
+			if (new_id[v] == HE_INVALID_INDEX)
+			{
+				streams[STREAM_INDICES].Signed(0);
+				Introduce(v, -1);
+			}
+			else
+			{
+				streams[STREAM_INDICES].Signed(static_cast<int>(new_id[v] - next));
+				verts.Push(v);
+			}
+		}
+
+		//! code the face whose corners start at the origin of h, across edge slot i or free if i < 0
+		void Face(const HE_edge* h, int i, std::vector<const HE_edge*>& ends)
+		{
+			// ends[k] is the half-edge ending at corner k, its successor leaves corner k
+			ends.clear();
+			const HE_edge* e = h->pprev_;
+			do
+			{
+				ends.push_back(e);
+				e = e->pnext_;
+			} while (e != h->pprev_);
+			size_t n = ends.size();
+			if (polygons)
+			{
+				streams[STREAM_VALENCES].Varint(static_cast<unsigned int>(n - 3));
+			}
+
+			// the fan (0, k, k + 1); every triangle after the first shares the
+			// diagonal the one before pushed last, so it is in slot 0
+			HE_index c0 = ends[0]->pvert_->id_;
+			for (size_t k = 1; k + 1 < n; k++)
+			{
+				HE_index a = ends[k]->pvert_->id_, b = ends[k + 1]->pvert_->id_;
+				if (k > 1)
+				{
+					i = 0;
+				}
+				if (i >= 0)
+				{
+					unsigned char code = static_cast<unsigned char>(i << 4);
+					streams[STREAM_CODES].Byte(static_cast<unsigned char>(code | ThirdVertex(b, i)));
+				}
+				else
+				{
+					streams[STREAM_CODES].Byte(FREE_TRIANGLE);
+					FreeVertex(c0);
+					FreeVertex(a);
+					FreeVertex(b);
+					edges.Push(c0, a, b, ends[1]);
+				}
+				edges.Push(a, b, c0, ends[k + 1]);
+				edges.Push(b, c0, a, k + 2 == n ? ends[0] : NULL);
+			}
+
+			if (has_texcoords)
+			{
+				for (size_t k = 0; k < n; k++)
+				{
+					Texcoord(ends[k]->pvert_->id_, &corner_texcoord[2 * ends[k]->id_]);
+				}
+			}
+		}
+
+		//! code the texture coordinate t of a corner of v, a flag if it is the one of the last corner of v
+		void Texcoord(HE_index v, const int* t)
+		{
+			const int* pred = values.has_texcoord[v] ? &values.texcoord[2 * v] : values.last_texcoord;
+			bool same = values.has_texcoord[v] && t[0] == pred[0] && t[1] == pred[1];
+			streams[STREAM_TEXFLAGS].Bit(same);
+			if (same)
+			{
+				return;
+			}
+			for (int k = 0; k < 2; k++)
+			{
+				streams[STREAM_TEXCOORDS].Signed(t[k] - pred[k]);
+			}
+			for (int k = 0; k < 2; k++)
+			{
+				values.texcoord[2 * v + k] = t[k];
+				values.last_texcoord[k] = t[k];
+			}
+			values.has_texcoord[v] = 1;
+		}
+	};
+}
+
+bool DecodeCompressedMesh(const unsigned char* bytes, size_t size, OBJData& obj)
+{
+	obj.clear();
+	CodecHeader header;
+	if (bytes == NULL || size < sizeof(header))
+	{
+		return false;
+	}
+	memcpy(&header, bytes, sizeof(header));
+	if (memcmp(header.magic, CODEC_MAGIC, sizeof(CODEC_MAGIC)) != 0 || header.version != CODEC_VERSION
+		|| header.header_size != sizeof(header) || header.position_bits < 1 || header.position_bits > 24
+		|| header.normal_bits > 16 || header.texcoord_bits > 16 || header.num_faces == 0)
+	{
+		return false;
+	}
+	ByteReader streams[NUM_STREAMS];
+	size_t offset = sizeof(header);
+	for (int s = 0; s < NUM_STREAMS; s++)
+	{
+		if (header.stream_bytes[s] > size - offset)
+		{
+			return false;
+		}
+		streams[s].p = bytes + offset;
+		streams[s].end = bytes + offset + header.stream_bytes[s];
+		offset += header.stream_bytes[s];
+	}
+	if (StreamChecksum(header, bytes + sizeof(header), offset - sizeof(header)) != header.checksum)
+	{
+		return false;
+	}
+
+	// every vertex takes 3 bytes of positions and every face a code at least
+	size_t nverts = header.num_verts, nfaces = header.num_faces;
+	if (nverts > header.stream_bytes[STREAM_POSITIONS] / 3 || nfaces > header.stream_bytes[STREAM_CODES])
+	{
+		return false;
+	}
+	bool polygons = (header.flags & CODEC_POLYGONS) != 0;
+	bool has_normals = header.normal_bits > 0;
+	bool has_texcoords = header.texcoord_bits > 0;
+	float position_step = header.extent / ((1 << header.position_bits) - 1);
+	float normal_step = has_normals ? 2.f / ((1 << header.normal_bits) - 1) : 0.f;
+	float tex_step[2] = {0.f, 0.f};
+	if (has_texcoords)
+	{
+		for (int k = 0; k < 2; k++)
+		{
+			tex_step[k] = header.tex_extent[k] / ((1 << header.texcoord_bits) - 1);
+		}
+	}
+
+	CodecValues values;
+	values.position.resize(3 * nverts);
+	values.normal.resize(has_normals ? 2 * nverts : 0);
+	values.texcoord.resize(has_texcoords ? 2 * nverts : 0);
+	values.has_texcoord.assign(has_texcoords ? nverts : 0, 0);
+	obj.positions.resize(3 * nverts);
+	obj.normals.resize(has_normals ? 3 * nverts : 0);
+	obj.corner_verts.reserve(3 * nfaces);
+	obj.face_starts.reserve(nfaces + 1);
+	EdgeFifo edges;
+	VertexFifo verts;
+	HE_index next = 0;
+	bool failed = false;
+
+	// number the next vertex and decode its attributes against the prediction from edge slot i
+	auto introduce = [&](int i) -> HE_index
+	{
+		if (next >= nverts)
+		{
+			failed = true;
+			return 0;
+		}
+		HE_index v = next++;
+		int pos[3], nrm[2];
+		values.Predict(edges, i, pos, nrm);
+		for (int k = 0; k < 3; k++)
+		{
+			int q = WrapSum(pos[k], streams[STREAM_POSITIONS].Signed());
+			values.position[3 * v + k] = values.last_position[k] = q;
+			obj.positions[3 * v + k] = header.origin[k] + q * position_step;
+		}
+		if (has_normals)
+		{
+			for (int k = 0; k < 2; k++)
+			{
+				values.normal[2 * v + k] = values.last_normal[k] = WrapSum(nrm[k], streams[STREAM_NORMALS].Signed());
+			}
+			DecodeOctahedral(values.normal[2 * v], values.normal[2 * v + 1], normal_step, &obj.normals[3 * v]);
+		}
+		verts.Push(v);
+		return v;
+	};
+	// a vertex given by an index, it must be decoded already
+	auto old_vertex = [&](long long v) -> HE_index
+	{
+		if (v < 0 || v >= static_cast<long long>(next))
+		{
+			failed = true;
+			return 0;
+		}
+		verts.Push(static_cast<HE_index>(v));
+		return static_cast<HE_index>(v);
+	};
+	HE_index last_explicit = 0;
+	auto third_vertex = [&](unsigned char low, int i) -> HE_index
+	{
+		if (low == NEW_VERTEX)
+		{
+			return introduce(i);
+		}
+		if (low == EXPLICIT_VERTEX)
+		{
+			last_explicit = old_vertex(static_cast<long long>(last_explicit) + 1 + streams[STREAM_INDICES].Signed());
+			return last_explicit;
+		}
+		if (low > std::min(verts.count, VERTEX_SLOTS))
+		{
+			failed = true;
+			return 0;
+		}
+		return verts.at(low - 1);
+	};
+	auto free_vertex = [&](void) -> HE_index
+	{
+		int d = streams[STREAM_INDICES].Signed();
+		return d == 0 ? introduce(-1) : old_vertex(static_cast<long long>(next) + d);
+	};
+
+	for (size_t f = 0; f < nfaces && !failed; f++)
+	{
+		size_t n = 3;
+		if (polygons)
+		{
+			// a face takes a code per triangle
+			n += streams[STREAM_VALENCES].Varint();
+			if (n - 2 > static_cast<size_t>(streams[STREAM_CODES].end - streams[STREAM_CODES].p))
+			{
+				failed = true;
+				break;
+			}
+		}
+		size_t start = obj.corner_verts.size();
+		HE_index c0 = 0, a = 0, b = 0;
+		for (size_t k = 1; k + 1 < n && !failed; k++)
+		{
+			unsigned char code = streams[STREAM_CODES].Byte();
+			int i = code >> 4;
+			if (k > 1)
+			{
+				// across the diagonal pushed last
+				if (i != 0)
+				{
+					failed = true;
+					break;
+				}
+				a = b;
+				b = third_vertex(code & 15, 0);
+				obj.corner_verts.push_back(static_cast<int>(b));
+			}
+			else if (code == FREE_TRIANGLE)
+			{
+				c0 = free_vertex();
+				a = free_vertex();
+				b = free_vertex();
+				edges.Push(c0, a, b, NULL);
+			}
+			else
+			{
+				if (i >= std::min(edges.count, EDGE_SLOTS))
+				{
+					failed = true;
+					break;
+				}
+				int s = edges.Slot(i);
+				c0 = edges.to[s];
+				a = edges.from[s];
+				b = third_vertex(code & 15, i);
+			}
+			if (k == 1)
+			{
+				obj.corner_verts.push_back(static_cast<int>(c0));
+				obj.corner_verts.push_back(static_cast<int>(a));
+				obj.corner_verts.push_back(static_cast<int>(b));
+			}
+			edges.Push(a, b, c0, NULL);
+			edges.Push(b, c0, a, NULL);
+		}
+
+		// a face through a vertex twice would not link into a half-edge loop
+		for (size_t c = start + 1; c < obj.corner_verts.size() && !failed; c++)
+		{
+			for (size_t d = start; d < c && !failed; d++)
+			{
+				failed = obj.corner_verts[d] == obj.corner_verts[c];
+			}
+		}
+
+		if (has_texcoords && !failed)
+		{
+			for (size_t c = start; c < obj.corner_verts.size(); c++)
+			{
+				HE_index v = static_cast<HE_index>(obj.corner_verts[c]);
+				int* t = &values.texcoord[2 * v];
+				bool same = streams[STREAM_TEXFLAGS].Bit();
+				if (same && !values.has_texcoord[v])
+				{
+					failed = true;
+				}
+				if (!same)
+				{
+					const int* pred = values.has_texcoord[v] ? t : values.last_texcoord;
+					for (int k = 0; k < 2; k++)
+					{
+						values.last_texcoord[k] = WrapSum(pred[k], streams[STREAM_TEXCOORDS].Signed());
+					}
+					std::copy(values.last_texcoord, values.last_texcoord + 2, t);
+					values.has_texcoord[v] = 1;
+				}
+				for (int k = 0; k < 2; k++)
+				{
+					obj.texcoords.push_back(header.tex_origin[k] + t[k] * tex_step[k]);
+				}
+			}
+		}
+		obj.face_starts.push_back(static_cast<int>(obj.corner_verts.size()));
+	}
+
+	// the vertices no face uses
+	while (next < nverts && !failed)
+	{
+		introduce(-1);
+	}
+	for (int s = 0; s < NUM_STREAMS; s++)
+	{
+		failed = failed || streams[s].failed;
+	}
+	if (failed || !DirectedEdgesUnique(obj, nverts))
+	{
+		obj.clear();
+		return false;
+	}
+
+	// the normals are per vertex, the texture coordinates per corner
+	size_t ncorners = obj.corner_verts.size();
+	obj.corner_norms.resize(ncorners, -1);
+	obj.corner_texs.resize(ncorners, -1);
+	for (size_t c = 0; c < ncorners; c++)
+	{
+		if (has_normals)
+		{
+			obj.corner_norms[c] = obj.corner_verts[c];
+		}
+		if (has_texcoords)
+		{
+			obj.corner_texs[c] = static_cast<int>(c);
+		}
+	}
+	return true;
+}
+
+bool Mesh3D::EncodeCompressed(std::vector<unsigned char>& bytes, const MeshCodecOptions& options)
+{
+	bytes.clear();
+	if (!isValid() || options.position_bits < 1 || options.position_bits > 24
+		|| options.normal_bits < 0 || options.normal_bits > 16 || options.normal_bits == 1
+		|| options.texcoord_bits < 0 || options.texcoord_bits > 16)
+	{
+		return false;
+	}
+	size_t nverts = static_cast<size_t>(num_of_vertex_list());
+	size_t nedges = static_cast<size_t>(num_of_half_edges_list());
+	size_t nfaces = static_cast<size_t>(num_of_face_list());
+
+	CodecEncoder enc(nverts);
+	enc.polygons = MaxFaceValence() > 3;
+	enc.has_normals = options.normal_bits > 0;
+	bool has_texture = false;
+	for (size_t i = 0; i < nedges && !has_texture && options.texcoord_bits > 0 && has_half_edge_texcoords(); i++)
+	{
+		const Vec3f& t = half_edge_texcoord(static_cast<HE_index>(i));
+		has_texture = edge_arena_[static_cast<HE_index>(i)].pface_ != NULL && (t[0] != 0.f || t[1] != 0.f);
+	}
+	enc.has_texcoords = has_texture;
+
+	CodecHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CODEC_MAGIC, sizeof(CODEC_MAGIC));
+	header.version = CODEC_VERSION;
+	header.header_size = sizeof(header);
+	header.flags = enc.polygons ? CODEC_POLYGONS : 0;
+	header.num_verts = static_cast<unsigned int>(nverts);
+	header.num_faces = static_cast<unsigned int>(nfaces);
+	header.position_bits = static_cast<unsigned char>(options.position_bits);
+	header.normal_bits = static_cast<unsigned char>(enc.has_normals ? options.normal_bits : 0);
+	header.texcoord_bits = static_cast<unsigned char>(enc.has_texcoords ? options.texcoord_bits : 0);
+
+	// positions over the largest side of the bounding box, so the steps are the same along every axis
+	header.origin[0] = xmin_;
+	header.origin[1] = ymin_;
+	header.origin[2] = zmin_;
+	header.extent = std::max(std::max(xmax_ - xmin_, ymax_ - ymin_), zmax_ - zmin_);
+	if (!(header.extent > 0.f))
+	{
+		header.extent = 1.f;
+	}
+	int max_position = (1 << options.position_bits) - 1;
+	float position_scale = max_position / header.extent;
+	int max_normal = (1 << header.normal_bits) - 1;
+	enc.values.position.resize(3 * nverts);
+	enc.values.normal.resize(enc.has_normals ? 2 * nverts : 0);
+	parallel_for(0, nverts, [&](size_t i)
+	{
+		const HE_vert& hv = vertex_arena_[static_cast<HE_index>(i)];
+		for (int k = 0; k < 3; k++)
+		{
+			enc.values.position[3 * i + k] = Quantize(hv.position_[k], header.origin[k], position_scale, max_position);
+		}
+		if (enc.has_normals)
+		{
+			EncodeOctahedral(hv.normal_, max_normal, &enc.values.normal[2 * i]);
+		}
+	});
+
+	// texture coordinates over their range, every axis on its own
+	if (enc.has_texcoords)
+	{
+		float lo[2] = {FLT_MAX, FLT_MAX}, hi[2] = {-FLT_MAX, -FLT_MAX};
+		const PropertyArray<Vec3f>& texcoords = property(half_edge_texcoords_);
+		for (size_t i = 0; i < nedges; i++)
+		{
+			for (int k = 0; k < 2 && edge_arena_[static_cast<HE_index>(i)].pface_ != NULL; k++)
+			{
+				lo[k] = std::min(lo[k], texcoords[i][k]);
+				hi[k] = std::max(hi[k], texcoords[i][k]);
+			}
+		}
+		int max_tex = (1 << options.texcoord_bits) - 1;
+		float tex_scale[2];
+		for (int k = 0; k < 2; k++)
+		{
+			header.tex_origin[k] = lo[k];
+			header.tex_extent[k] = hi[k] > lo[k] ? hi[k] - lo[k] : 1.f;
+			tex_scale[k] = max_tex / header.tex_extent[k];
+		}
+		enc.corner_texcoord.resize(2 * nedges);
+		parallel_for(0, nedges, [&](size_t i)
+		{
+			const Vec3f& t = texcoords[i];
+			for (int k = 0; k < 2; k++)
+			{
+				enc.corner_texcoord[2 * i + k] = Quantize(t[k], header.tex_origin[k], tex_scale[k], max_tex);
+			}
+		});
+		enc.values.texcoord.resize(2 * nverts);
+		enc.values.has_texcoord.assign(nverts, 0);
+	}
+
+	// every face grows across the newest edge with an uncoded face behind
+	// it; if there is none, the last uncoded neighbour of a coded face or
+	// the next uncoded id starts a new run
+	std::vector<char> coded(nfaces, 0);
+	std::vector<HE_index> neighbours;
+	std::vector<const HE_edge*> ends;
+	size_t cursor = 0;
+	for (size_t done = 0; done < nfaces; done++)
+	{
+		const HE_edge* h = NULL;
+		int slot = -1;
+		int nslots = std::min(enc.edges.count, EDGE_SLOTS);
+		for (int i = 0; i < nslots && h == NULL; i++)
+		{
+			const HE_edge* e = enc.edges.edge[enc.edges.Slot(i)];
+			if (e != NULL && e->ppair_->pface_ != NULL && !coded[e->ppair_->pface_->id_])
+			{
+				h = e->ppair_;
+				slot = i;
+			}
+		}
+		if (h == NULL)
+		{
+			const HE_face* face = NULL;
+			while (face == NULL && !neighbours.empty())
+			{
+				HE_index f = neighbours.back();
+				neighbours.pop_back();
+				face = coded[f] ? NULL : &face_arena_[f];
+			}
+			for (; face == NULL; cursor++)
+			{
+				face = coded[cursor] ? NULL : &face_arena_[static_cast<HE_index>(cursor)];
+			}
+			// it may still share an edge with the FIFO
+			h = face->pedge_;
+			const HE_edge* e = h;
+			do
+			{
+				int s = enc.edges.Find(e->pvert_->id_, e->pprev_->pvert_->id_);
+				if (s >= 0 && (slot < 0 || s < slot))
+				{
+					slot = s;
+					h = e;
+				}
+				e = e->pnext_;
+			} while (e != face->pedge_);
+		}
+
+		const HE_face* face = h->pface_;
+		coded[face->id_] = 1;
+		enc.Face(h, slot, ends);
+		const HE_edge* e = face->pedge_;
+		do
+		{
+			const HE_face* g = e->ppair_->pface_;
+			if (g != NULL && !coded[g->id_])
+			{
+				neighbours.push_back(g->id_);
+			}
+			e = e->pnext_;
+		} while (e != face->pedge_);
+	}
+	for (size_t i = 0; i < nverts; i++)
+	{
+		if (enc.new_id[i] == HE_INVALID_INDEX)
+		{
+			enc.Introduce(static_cast<HE_index>(i), -1);
+		}
+	}
+
+	size_t total = sizeof(header);
+	for (int s = 0; s < NUM_STREAMS; s++)
+	{
+		header.stream_bytes[s] = static_cast<unsigned int>(enc.streams[s].bytes.size());
+		total += enc.streams[s].bytes.size();
+	}
+	bytes.reserve(total);
+	bytes.insert(bytes.end(), reinterpret_cast<const unsigned char*>(&header), reinterpret_cast<const unsigned char*>(&header + 1));
+	for (int s = 0; s < NUM_STREAMS; s++)
+	{
+		bytes.insert(bytes.end(), enc.streams[s].bytes.begin(), enc.streams[s].bytes.end());
+	}
+	header.checksum = StreamChecksum(header, bytes.data() + sizeof(header), total - sizeof(header));
+	memcpy(&bytes[offsetof(CodecHeader, checksum)], &header.checksum, sizeof(header.checksum));
+	return true;
+}
+
+bool Mesh3D::DecodeCompressed(const unsigned char* bytes, size_t size)
+{
+	OBJData obj;
+	if (!DecodeCompressedMesh(bytes, size, obj))
+	{
+		ClearData();
+		ReleaseStandardProperties();
+		return false;
+	}
+	CreateMesh(obj);
+	if (!obj.normals.empty())
+	{
+		// the stored normals instead of the ones UpdateMesh computed
+		parallel_for(0, static_cast<size_t>(num_of_vertex_list()), [&](size_t i)
+		{
+			vertex_arena_[static_cast<HE_index>(i)].normal_ = Vec3f(obj.normals[3 * i], obj.normals[3 * i + 1], obj.normals[3 * i + 2]);
+		});
+	}
+	return isValid();
+}
+
+bool Mesh3D::WriteToCompressedFile(const char* fouts, const MeshCodecOptions& options)
+{
+	std::vector<unsigned char> bytes;
+	if (!EncodeCompressed(bytes, options))
+	{
+		return false;
+	}
+	FILE* file = fopen(fouts, "wb");
+	if (file == NULL)
+	{
+		return false;
+	}
+	bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+	{
+		remove(fouts);
+	}
+	return ok;
+}
+
+bool Mesh3D::LoadFromCompressedFile(const char* fins)
+{
+	MappedFile file;
+	if (!file.Open(fins))
+	{
+		return false;
+	}
+	return DecodeCompressed(reinterpret_cast<const unsigned char*>(file.data()), file.size());
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+
+struct OBJData;
+
+/*!
+*	Compact quantized mesh stream written by Mesh3D::EncodeCompressed.
+*
+*	A fixed header, with a CRC-32 of the whole stream, is followed by seven
+*	byte streams, read in one pass:
+*
+*	  codes:      one byte per triangle
+*	  indices:    vertex ids the codes can not express
+*	  valences:   valence - 3 of every face, polygon meshes only
+*	  positions:  xyz per vertex, quantized over the largest side of the
+*	              bounding box
+*	  normals:    octahedral uv per vertex
+*	  texcoords:  uv of the face corners, quantized over their range
+*	  texflags:   a bit per face corner, set if the corner has the texture
+*	              coordinate of the last corner of its vertex and so none
+*	              in texcoords
+*
+*	Numbers are zigzag LEB128 varints of the difference to a prediction.
+*	The faces are split into fans of triangles, and each triangle is coded
+*	against a FIFO of the last edges: the high nibble of its code is the
+*	slot of the edge it shares, the low nibble tells whether its third
+*	vertex is new, one of the last vertices, or an explicit index. The
+*	vertices are numbered in the order they first appear, so a new vertex
+*	is just the next one, and its position and normal are predicted by the
+*	parallelogram over the shared edge. The faces are ordered so that
+*	every face tries to grow across one of the last edges, a triangle that
+*	shares none costs three explicit indices.
+*/
+
+//! decode a stream of Mesh3D::EncodeCompressed into obj
+/*!
+*	fills the positions, one normal per vertex if the stream has normals,
+*	one texture coordinate per corner if it has texture coordinates, and
+*	the faces. The vertices and faces are in the order of the stream.
+*	\return false if the stream is broken, fails its checksum or has a face
+*	repeating a vertex or a directed edge of an earlier face, obj is then
+*	cleared
+*/
+bool DecodeCompressedMesh(const unsigned char* bytes, size_t size, OBJData& obj);
@@ -0,0 +1,131 @@
+#include "Mesh3D.h"
+
+#include <atomic>
+#include <memory>
+
+// Connected components with a concurrent union-find.
+//
+// Every vertex starts as its own root. The threads walk the edges and unite
+// the two end vertices; a root is only ever linked below a smaller vertex
+// id with a compare-and-swap, so no lock is taken and, whatever the thread
+// interleaving, each component ends up rooted at its smallest vertex. Finds
+// halve the paths they walk, again with compare-and-swap, which is safe
+// because a parent can only be replaced by one of its own ancestors.
+
+namespace
+{
+	typedef std::atomic<HE_index> PARENT;
+
+	HE_index FindRoot(PARENT* parent, HE_index x)
+	{
+		for (;;)
+		{
+			HE_index px = parent[x].load(std::memory_order_relaxed);
+			if (px == x)
+			{
+				return x;
+			}
+			HE_index gx = parent[px].load(std::memory_order_relaxed);
+			if (gx != px)
+			{
+				// path halving, losing the race only skips the shortcut
+				parent[x].compare_exchange_weak(px, gx, std::memory_order_relaxed);
+			}
+			x = gx;
+		}
+	}
+
+	void Unite(PARENT* parent, HE_index a, HE_index b)
+	{
+		for (;;)
+		{
+			a = FindRoot(parent, a);
+			b = FindRoot(parent, b);
+			if (a == b)
+			{
+				return;
+			}
+			if (a < b)
+			{
+				HE_index t = a;
+				a = b;
+				b = t;
+			}
+			// link the larger root below the smaller one, unless another
+			// thread linked it first; then start again from the new roots
+			HE_index expected = a;
+			if (parent[a].compare_exchange_strong(expected, b, std::memory_order_acq_rel))
+			{
+				return;
+			}
+		}
+	}
+}
+
+void Mesh3D::ComputeNumComponents(void)
+{
+	size_t nverts = static_cast<size_t>(num_of_vertex_list());
+	size_t nedges = static_cast<size_t>(num_of_half_edges_list());
+	size_t nfaces = static_cast<size_t>(num_of_face_list());
+
+	std::unique_ptr<PARENT[]> parent(new PARENT[nverts]);
+	PARENT* p = parent.get();
+	parallel_for(0, nverts, [p](size_t i)
+	{
+		p[i].store(static_cast<HE_index>(i), std::memory_order_relaxed);
+	});
+
+	// every edge once, through the half-edge of smaller id
+	parallel_for(0, nedges, [this, p](size_t i)
+	{
+		HE_edge& edge = edge_arena_[static_cast<HE_index>(i)];
+		if (edge.id_ < edge.ppair_->id_)
+		{
+			Unite(p, edge.pvert_->id_, edge.ppair_->pvert_->id_);
+		}
+	});
+
+	// the roots are the smallest vertex of each component, numbering them in
+	// vertex order makes the ids independent of the thread timing
+	vertex_component_.resize(nverts);
+	parallel_for(0, nverts, [this, p](size_t i)
+	{
+		vertex_component_[i] = static_cast<int>(FindRoot(p, static_cast<HE_index>(i)));
+	});
+	num_components_ = 0;
+	std::vector<int> root_label(nverts);
+	for (size_t i = 0; i < nverts; i++)
+	{
+		if (vertex_component_[i] == static_cast<int>(i))
+		{
+			root_label[i] = num_components_++;
+		}
+	}
+	parallel_for(0, nverts, [this, &root_label](size_t i)
+	{
+		vertex_component_[i] = root_label[vertex_component_[i]];
+	});
+
+	face_component_.resize(nfaces);
+	parallel_for(0, nfaces, [this](size_t i)
+	{
+		face_component_[i] = vertex_component_[face_arena_[static_cast<HE_index>(i)].pedge_->pvert_->id_];
+	});
+
+	// counting sort of the faces by component, stable in face id
+	component_face_start_.assign(num_components_ + 1, 0);
+	for (size_t i = 0; i < nfaces; i++)
+	{
+		component_face_start_[face_component_[i] + 1]++;
+	}
+	for (int c = 0; c < num_components_; c++)
+	{
+		component_face_start_[c + 1] += component_face_start_[c];
+	}
+	component_faces_.resize(nfaces);
+	std::vector<HE_index> next(component_face_start_.begin(), component_face_start_.end() - 1);
+	for (size_t i = 0; i < nfaces; i++)
+	{
+		component_faces_[next[face_component_[i]]++] = static_cast<HE_index>(i);
+	}
+}
@@ -0,0 +1,240 @@
+#include "Mesh3D.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Discrete curvature.
+//
+// Every vertex walks its one-ring once. Each face around it adds its corner
+// angle for the angle defect, its share of the mixed Voronoi area and, for
+// triangles, the two cotangent terms of the Laplacian. Nothing is shared
+// between vertices, so the pass runs in parallel and can be limited to any
+// subset of the vertices.
+
+namespace
+{
+	const double PI = 3.14159265358979323846;
+
+	//! cotangent of the angle between a and b
+	inline float Cotangent(const Vec3f& a, const Vec3f& b)
+	{
+		float sine = len(a ^ b);
+		return sine > 1e-12f ? (a * b) / sine : 0.f;
+	}
+}
+
+bool Mesh3D::ComputeCurvature(MeshCurvature& curvature, int fields)
+{
+	size_t nverts = static_cast<size_t>(num_of_vertex_list());
+	if (!isValid())
+	{
+		return false;
+	}
+	if (fields & (CURVATURE_MEAN | CURVATURE_PRINCIPAL))
+	{
+		for (int i = 0; i < num_of_face_list(); i++)
+		{
+			if (face_arena_[i].valence_ != 3)
+			{
+				return false;
+			}
+		}
+	}
+
+	curvature.mean.clear();
+	curvature.gaussian.clear();
+	curvature.kmax.clear();
+	curvature.kmin.clear();
+	if (fields & CURVATURE_MEAN)
+	{
+		curvature.mean.resize(nverts);
+	}
+	if (fields & CURVATURE_GAUSSIAN)
+	{
+		curvature.gaussian.resize(nverts);
+	}
+	if (fields & CURVATURE_PRINCIPAL)
+	{
+		curvature.kmax.resize(nverts);
+		curvature.kmin.resize(nverts);
+	}
+	ComputeCurvatureOf(NULL, nverts, curvature);
+	curvature.version = positions_version_;
+	return true;
+}
+
+bool Mesh3D::UpdateCurvature(MeshCurvature& curvature)
+{
+	size_t nverts = static_cast<size_t>(num_of_vertex_list());
+	int fields = (curvature.mean.empty() ? 0 : CURVATURE_MEAN) |
+		(curvature.gaussian.empty() ? 0 : CURVATURE_GAUSSIAN) |
+		(curvature.kmax.empty() ? 0 : CURVATURE_PRINCIPAL);
+	if (curvature.version == positions_version_ && fields != 0)
+	{
+		return true;
+	}
+
+	std::vector<HE_index> moved;
+	bool sizes_ok = (curvature.mean.empty() || curvature.mean.size() == nverts) &&
+		(curvature.gaussian.empty() || curvature.gaussian.size() == nverts) &&
+		(curvature.kmax.empty() || curvature.kmax.size() == nverts);
+	if (fields == 0 || !sizes_ok || !GetMovedVertices(curvature.version, moved))
+	{
+		return ComputeCurvature(curvature, fields != 0 ? fields : CURVATURE_ALL);
+	}
+
+	// the curvature of a vertex depends on its one-ring
+	if (ring_start_.size() != nverts + 1)
+	{
+		SetNeighbors();
+	}
+	std::vector<unsigned char> mark(nverts, 0);
+	std::vector<HE_index> verts;
+	for (size_t i = 0; i < moved.size(); i++)
+	{
+		HE_index v = moved[i];
+		if (!mark[v])
+		{
+			mark[v] = 1;
+			verts.push_back(v);
+		}
+		for (HE_index j = ring_start_[v]; j < ring_start_[v + 1]; j++)
+		{
+			HE_index u = ring_verts_[j];
+			if (!mark[u])
+			{
+				mark[u] = 1;
+				verts.push_back(u);
+			}
+		}
+	}
+	ComputeCurvatureOf(verts.data(), verts.size(), curvature);
+	curvature.version = positions_version_;
+	return true;
+}
+
+void Mesh3D::ComputeCurvatureOf(const HE_index* verts, size_t count, MeshCurvature& curvature)
+{
+	float* mean = curvature.mean.empty() ? NULL : curvature.mean.data();
+	float* gaussian = curvature.gaussian.empty() ? NULL : curvature.gaussian.data();
+	float* kmax = curvature.kmax.empty() ? NULL : curvature.kmax.data();
+	float* kmin = curvature.kmin.empty() ? NULL : curvature.kmin.data();
+
+	parallel_for(0, count, [&](size_t i)
+	{
+		HE_index v = verts != NULL ? verts[i] : static_cast<HE_index>(i);
+		HE_vert& hv = vertex_arena_[v];
+		float h = 0.f, k = 0.f;
+		HE_edge* start = hv.pedge_;
+		if (start != NULL && !hv.isOnBoundary())
+		{
+			const Vec3f& p = hv.position_;
+			Vec3f laplacian(0.f, 0.f, 0.f), normal(0.f, 0.f, 0.f);
+			double area = 0.0, angle = 0.0;
+			HE_edge* e = start;
+			do
+			{
+				// corner of face f at p, between u and w
+				HE_face* f = e->pface_;
+				const Vec3f& u = e->pvert_->position_;
+				const Vec3f& w = e->pprev_->ppair_->pvert_->position_;
+				Vec3f eu = u - p, ew = w - p;
+				Vec3f cross = eu ^ ew;
+				float sine = len(cross);
+				angle += std::atan2(sine, eu * ew);
+				normal += cross;
+				if (f->valence_ == 3)
+				{
+					float cot_u = Cotangent(p - u, w - u);
+					float cot_w = Cotangent(p - w, u - w);
+					laplacian += cot_w * (p - u) + cot_u * (p - w);
+
+					// mixed area: Voronoi unless the triangle is obtuse
+					float triangle = 0.5f * sine;
+					if (eu * ew < 0.f)
+					{
+						area += 0.5 * triangle;
+					}
+					else if ((p - u) * (w - u) < 0.f || (p - w) * (u - w) < 0.f)
+					{
+						area += 0.25 * triangle;
+					}
+					else
+					{
+						area += 0.125 * (len2(eu) * cot_w + len2(ew) * cot_u);
+					}
+				}
+				else
+				{
+					// polygon: its vector area shared by its corners
+					Vec3f vector_area(0.f, 0.f, 0.f);
+					HE_edge* fe = f->pedge_;
+					do
+					{
+						vector_area += fe->ppair_->pvert_->position_ ^ fe->pvert_->position_;
+						fe = fe->pnext_;
+					} while (fe != f->pedge_);
+					area += 0.5 * len(vector_area) / f->valence_;
+				}
+				e = e->ppair_->pnext_;
+			} while (e != NULL && e != start);
+
+			if (area > 0.0)
+			{
+				k = static_cast<float>((2.0 * PI - angle) / area);
+				// the mean curvature normal is laplacian / (2 area)
+				h = static_cast<float>(0.25 * len(laplacian) / area);
+				if (laplacian * normal < 0.f)
+				{
+					h = -h;
+				}
+			}
+		}
+
+		if (mean != NULL)
+		{
+			mean[v] = h;
+		}
+		if (gaussian != NULL)
+		{
+			gaussian[v] = k;
+		}
+		if (kmax != NULL)
+		{
+			// the discriminant is negative only through discretisation error
+			float d = std::sqrt(std::max(h * h - k, 0.f));
+			kmax[v] = h + d;
+			kmin[v] = h - d;
+		}
+	}, 1024);
+}
+
+void Mesh3D::ColorByCurvature(const std::vector<float>& values, float range)
+{
+	size_t nverts = static_cast<size_t>(num_of_vertex_list());
+	if (values.size() != nverts || nverts == 0)
+	{
+		return;
+	}
+	if (range <= 0.f)
+	{
+		std::vector<float> magnitude(nverts);
+		for (size_t i = 0; i < nverts; i++)
+		{
+			magnitude[i] = std::fabs(values[i]);
+		}
+		std::vector<float>::iterator it = magnitude.begin() + (nverts - 1) * 95 / 100;
+		std::nth_element(magnitude.begin(), it, magnitude.end());
+		range = *it > 0.f ? *it : 1.f;
+	}
+
+	request_vertex_colors();
+	snapshot_full_ = true;
+	PropertyArray<Vec4f>& colors = property(vertex_colors_);
+	parallel_for(0, nverts, [&](size_t i)
+	{
+		float t = std::max(-1.f, std::min(values[i] / range, 1.f));
+		colors[i] = t >= 0.f ? Vec4f(1.f, 1.f - t, 1.f - t, 1.f) : Vec4f(1.f + t, 1.f + t, 1.f, 1.f);
+	});
+}
@@ -0,0 +1,210 @@
+#include "Mesh3D.h"
+
+// Incremental refresh after moving vertices.
+//
+// SetVertexPosition takes the edges around a vertex out of edge_length_sum_
+// the first time the vertex moves in a batch, EndEdit adds their new lengths
+// back. The normals of the faces around the moved vertices and of all the
+// vertices of these faces are recomputed, nothing else is. The bounding box
+// grows with the moved vertices and is only recomputed in full when a vertex
+// that lay on it moved, because then it may have to shrink.
+
+void Mesh3D::TouchPositions(const HE_index* moved, size_t count)
+{
+	positions_version_++;
+	// past a quarter of the vertices, rebuilding an index beats replaying the log
+	if (moved == NULL || moved_log_.size() + count > static_cast<size_t>(num_of_vertex_list()) / 4)
+	{
+		moved_log_.clear();
+		moved_log_start_ = positions_version_;
+		return;
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		moved_log_.push_back(std::make_pair(positions_version_, moved[i]));
+	}
+}
+
+bool Mesh3D::GetMovedVertices(unsigned int since, std::vector<HE_index>& ids)
+{
+	ids.clear();
+	if (since < moved_log_start_ || since > positions_version_)
+	{
+		return false;
+	}
+	for (size_t i = moved_log_.size(); i > 0 && moved_log_[i - 1].first > since; i--)
+	{
+		ids.push_back(moved_log_[i - 1].second);
+	}
+	return true;
+}
+
+void Mesh3D::BeginEdit(void)
+{
+	if (editing_)
+	{
+		return;
+	}
+	editing_ = true;
+	edit_bbox_shrinks_ = false;
+	edit_verts_.clear();
+	edit_edges_.clear();
+	vert_edit_mark_.resize(num_of_vertex_list(), 0);
+	edge_edit_mark_.resize(num_of_half_edges_list(), 0);
+	face_edit_mark_.resize(num_of_face_list(), 0);
+}
+
+void Mesh3D::SetVertexPosition(HE_vert* hv, const Vec3f& pos)
+{
+	if (hv == NULL)
+	{
+		return;
+	}
+	if (!editing_)
+	{
+		BeginEdit();
+		SetVertexPosition(hv, pos);
+		EndEdit();
+		return;
+	}
+
+	if (!vert_edit_mark_[hv->id_])
+	{
+		vert_edit_mark_[hv->id_] = 1;
+		edit_verts_.push_back(hv->id_);
+
+		// take the current lengths of the edges around hv out of the sum,
+		// an edge is tracked through the half-edge of smaller id
+		HE_edge* edge = hv->pedge_;
+		if (edge != NULL)
+		{
+			do
+			{
+				HE_index e = edge->id_ < edge->ppair_->id_ ? edge->id_ : edge->ppair_->id_;
+				if (!edge_edit_mark_[e])
+				{
+					edge_edit_mark_[e] = 1;
+					edit_edges_.push_back(e);
+					edge_length_sum_ -= 2.0 * (edge->pvert_->position_ - hv->position_).length();
+				}
+				edge = edge->ppair_->pnext_;
+			} while (edge != NULL && edge != hv->pedge_);
+		}
+
+		const Vec3f& p = hv->position_;
+		if (p.x() == xmin_ || p.x() == xmax_ || p.y() == ymin_ || p.y() == ymax_ ||
+			p.z() == zmin_ || p.z() == zmax_)
+		{
+			edit_bbox_shrinks_ = true;
+		}
+	}
+
+	hv->position_ = pos;
+	if (use_soa_ && soa_position_[0].size() == static_cast<size_t>(num_of_vertex_list()))
+	{
+		soa_position_[0][hv->id_] = pos.x();
+		soa_position_[1][hv->id_] = pos.y();
+		soa_position_[2][hv->id_] = pos.z();
+	}
+}
+
+void Mesh3D::EndEdit(void)
+{
+	if (!editing_)
+	{
+		return;
+	}
+	editing_ = false;
+
+	// edge lengths
+	for (size_t i = 0; i < edit_edges_.size(); i++)
+	{
+		HE_edge& edge = edge_arena_[edit_edges_[i]];
+		edge_length_sum_ += 2.0 * (edge.pvert_->position_ - edge.ppair_->pvert_->position_).length();
+		edge_edit_mark_[edit_edges_[i]] = 0;
+	}
+	if (num_of_half_edges_list() > 0)
+	{
+		average_edge_length_ = static_cast<float>(edge_length_sum_ / num_of_half_edges_list());
+	}
+
+	// bounding box
+	if (edit_bbox_shrinks_)
+	{
+		ComputeBoundingBox();
+	}
+	else
+	{
+		for (size_t i = 0; i < edit_verts_.size(); i++)
+		{
+			const Vec3f& p = vertex_arena_[edit_verts_[i]].position_;
+			xmin_ = p.x() < xmin_ ? p.x() : xmin_;
+			xmax_ = p.x() > xmax_ ? p.x() : xmax_;
+			ymin_ = p.y() < ymin_ ? p.y() : ymin_;
+			ymax_ = p.y() > ymax_ ? p.y() : ymax_;
+			zmin_ = p.z() < zmin_ ? p.z() : zmin_;
+			zmax_ = p.z() > zmax_ ? p.z() : zmax_;
+		}
+	}
+
+	// the faces around the moved vertices
+	std::vector<HE_face*> faces;
+	for (size_t i = 0; i < edit_verts_.size(); i++)
+	{
+		HE_vert& hv = vertex_arena_[edit_verts_[i]];
+		vert_edit_mark_[hv.id_] = 0;
+		HE_edge* edge = hv.pedge_;
+		if (edge == NULL)
+		{
+			continue;
+		}
+		do
+		{
+			if (edge->pface_ != NULL && !face_edit_mark_[edge->pface_->id_])
+			{
+				face_edit_mark_[edge->pface_->id_] = 1;
+				faces.push_back(edge->pface_);
+			}
+			edge = edge->ppair_->pnext_;
+		} while (edge != NULL && edge != hv.pedge_);
+	}
+	if (normal_weighting_ == NORMAL_AREA && face_area_.size() != static_cast<size_t>(num_of_face_list()))
+	{
+		// the areas are missing (another weighting until now), the faces
+		// outside the region need theirs too
+		ComputeFaceslistNormal();
+	}
+	parallel_for(0, faces.size(), [&](size_t i)
+	{
+		ComputePerFaceNormal(faces[i]);
+	});
+
+	// every vertex of these faces sees a changed face normal
+	std::vector<HE_vert*> verts;
+	for (size_t i = 0; i < faces.size(); i++)
+	{
+		face_edit_mark_[faces[i]->id_] = 0;
+		HE_edge* edge = faces[i]->pedge_;
+		do
+		{
+			if (!vert_edit_mark_[edge->pvert_->id_])
+			{
+				vert_edit_mark_[edge->pvert_->id_] = 1;
+				verts.push_back(edge->pvert_);
+			}
+			edge = edge->pnext_;
+		} while (edge != faces[i]->pedge_);
+	}
+	parallel_for(0, verts.size(), [&](size_t i)
+	{
+		ComputePerVertexNormal(verts[i]);
+	});
+	for (size_t i = 0; i < verts.size(); i++)
+	{
+		vert_edit_mark_[verts[i]->id_] = 0;
+	}
+
+	TouchPositions(edit_verts_.data(), edit_verts_.size());
+	edit_verts_.clear();
+	edit_edges_.clear();
+}
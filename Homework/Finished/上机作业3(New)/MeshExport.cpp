@@ -0,0 +1,275 @@
+#include "Mesh3D.h"
+#include "MeshWrite.h"
+
+// Mesh export, the chunked parallel writing is in MeshWrite.h.
+
+int Mesh3D::MaxFaceValence(void)
+{
+	int valence = 0;
+	for (int i = 0; i < num_of_face_list(); i++)
+	{
+		valence = std::max(valence, face_arena_[i].valence_);
+	}
+	return valence;
+}
+
+bool Mesh3D::WriteToOBJFile(const char* fouts)
+{
+	if (!isValid())
+	{
+		return false;
+	}
+	size_t nverts = static_cast<size_t>(num_of_vertex_list());
+	size_t nedges = static_cast<size_t>(num_of_half_edges_list());
+	size_t nfaces = static_cast<size_t>(num_of_face_list());
+
+	// a vertex whose corners all agree writes one texture coordinate,
+	// a vertex on a seam writes one per corner, in the order of its ring
+	std::vector<HE_index> tex_count(nverts + 1, 0);
+	bool has_texture = false;
+	for (size_t i = 0; i < nedges && !has_texture && has_half_edge_texcoords(); i++)
+	{
+		const Vec3f& t = half_edge_texcoord(static_cast<HE_index>(i));
+		has_texture = edge_arena_[static_cast<HE_index>(i)].pface_ != NULL && (t[0] != 0.f || t[1] != 0.f);
+	}
+	std::vector<HE_index> corner_tex;
+	std::vector<Vec3f> texcoords;
+	if (has_texture)
+	{
+		parallel_for(0, nverts, [&](size_t i)
+		{
+			HE_edge* start = vertex_arena_[static_cast<HE_index>(i)].pedge_;
+			HE_edge* e = start;
+			HE_index corners = 0;
+			bool shared = true;
+			const HE_edge* first = NULL;
+			while (e != NULL)
+			{
+				HE_edge* in = e->ppair_;
+				if (in->pface_ != NULL)
+				{
+					if (first == NULL)
+					{
+						first = in;
+					}
+					const Vec3f& a = half_edge_texcoord(in->id_);
+					const Vec3f& b = half_edge_texcoord(first->id_);
+					shared = shared && a[0] == b[0] && a[1] == b[1];
+					corners++;
+				}
+				e = in->pnext_;
+				if (e == start)
+				{
+					break;
+				}
+			}
+			tex_count[i + 1] = shared ? std::min<HE_index>(corners, 1) : corners;
+		});
+		for (size_t i = 0; i < nverts; i++)
+		{
+			tex_count[i + 1] += tex_count[i];
+		}
+		corner_tex.resize(nedges, HE_INVALID_INDEX);
+		texcoords.resize(tex_count[nverts]);
+		parallel_for(0, nverts, [&](size_t i)
+		{
+			HE_index slot = tex_count[i];
+			bool shared = tex_count[i + 1] - slot == 1;
+			HE_edge* start = vertex_arena_[static_cast<HE_index>(i)].pedge_;
+			HE_edge* e = start;
+			while (e != NULL)
+			{
+				HE_edge* in = e->ppair_;
+				if (in->pface_ != NULL)
+				{
+					corner_tex[in->id_] = slot;
+					texcoords[slot] = half_edge_texcoord(in->id_);
+					slot += shared ? 0 : 1;
+				}
+				e = in->pnext_;
+				if (e == start)
+				{
+					break;
+				}
+			}
+		});
+	}
+
+	FILE* file = fopen(fouts, "wb");
+	if (file == NULL)
+	{
+		return false;
+	}
+	bool ok = WriteHeader(file, "g object\n");
+
+	ok = ok && WriteChunked(file, nverts, 3 + 3 * FLOAT_TEXT_CHARS, [&](size_t begin, size_t end, char* out)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const Vec3f& p = vertex_arena_[static_cast<HE_index>(i)].position_;
+			out = AppendText(out, "v");
+			out = AppendFloat(AppendFloat(AppendFloat(out, p[0]), p[1]), p[2]);
+			*out++ = '\n';
+		}
+		return out;
+	});
+	ok = ok && WriteChunked(file, texcoords.size(), 4 + 2 * FLOAT_TEXT_CHARS, [&](size_t begin, size_t end, char* out)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			out = AppendText(out, "vt");
+			out = AppendFloat(AppendFloat(out, texcoords[i][0]), texcoords[i][1]);
+			*out++ = '\n';
+		}
+		return out;
+	});
+	ok = ok && WriteChunked(file, nverts, 4 + 3 * FLOAT_TEXT_CHARS, [&](size_t begin, size_t end, char* out)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const Vec3f& n = vertex_arena_[static_cast<HE_index>(i)].normal_;
+			out = AppendText(out, "vn");
+			out = AppendFloat(AppendFloat(AppendFloat(out, n[0]), n[1]), n[2]);
+			*out++ = '\n';
+		}
+		return out;
+	});
+
+	// " v/vt/vn" for every corner, the first corner is the start of pedge_
+	size_t corner_chars = 3 + 3 * INDEX_TEXT_CHARS;
+	ok = ok && WriteChunked(file, nfaces, 2 + MaxFaceValence() * corner_chars, [&](size_t begin, size_t end, char* out)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			HE_face& f = face_arena_[static_cast<HE_index>(i)];
+			out = AppendText(out, "f");
+			HE_edge* e = f.pedge_;
+			do
+			{
+				HE_edge* corner = e->pprev_;
+				size_t v = static_cast<size_t>(corner->pvert_->id_) + 1;
+				*out++ = ' ';
+				out = AppendIndex(out, v);
+				*out++ = '/';
+				if (has_texture)
+				{
+					out = AppendIndex(out, static_cast<size_t>(corner_tex[corner->id_]) + 1);
+				}
+				*out++ = '/';
+				out = AppendIndex(out, v);
+				e = e->pnext_;
+			} while (e != f.pedge_);
+			*out++ = '\n';
+		}
+		return out;
+	});
+	return FinishWrite(file, fouts, ok);
+}
+
+bool Mesh3D::WriteToPLYFile(const char* fouts)
+{
+	if (!isValid())
+	{
+		return false;
+	}
+	size_t nverts = static_cast<size_t>(num_of_vertex_list());
+	size_t nfaces = static_cast<size_t>(num_of_face_list());
+	int max_valence = MaxFaceValence();
+	// the usual uchar count, unless a face is too large for it
+	bool small_faces = max_valence <= 255;
+
+	FILE* file = fopen(fouts, "wb");
+	if (file == NULL)
+	{
+		return false;
+	}
+	std::string header = "ply\nformat binary_little_endian 1.0\n";
+	header += "element vertex " + std::to_string(nverts) + "\n";
+	header += "property float x\nproperty float y\nproperty float z\n";
+	header += "property float nx\nproperty float ny\nproperty float nz\n";
+	header += "element face " + std::to_string(nfaces) + "\n";
+	header += small_faces ? "property list uchar int vertex_indices\n" : "property list int int vertex_indices\n";
+	header += "end_header\n";
+	bool ok = WriteHeader(file, header);
+
+	ok = ok && WriteChunked(file, nverts, 24, [&](size_t begin, size_t end, char* out)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const HE_vert& v = vertex_arena_[static_cast<HE_index>(i)];
+			out = AppendVec3(AppendVec3(out, v.position_), v.normal_);
+		}
+		return out;
+	});
+	ok = ok && WriteChunked(file, nfaces, 4 + 4 * max_valence, [&](size_t begin, size_t end, char* out)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			HE_face& f = face_arena_[static_cast<HE_index>(i)];
+			if (small_faces)
+			{
+				*out++ = static_cast<char>(f.valence_);
+			}
+			else
+			{
+				out = AppendBytes(out, &f.valence_, 4);
+			}
+			HE_edge* e = f.pedge_;
+			do
+			{
+				int v = e->pprev_->pvert_->id_;
+				out = AppendBytes(out, &v, 4);
+				e = e->pnext_;
+			} while (e != f.pedge_);
+		}
+		return out;
+	});
+	return FinishWrite(file, fouts, ok);
+}
+
+bool Mesh3D::WriteToSTLFile(const char* fouts)
+{
+	if (!isValid())
+	{
+		return false;
+	}
+	size_t nfaces = static_cast<size_t>(num_of_face_list());
+	unsigned int ntriangles = 0;
+	for (size_t i = 0; i < nfaces; i++)
+	{
+		ntriangles += std::max(face_arena_[static_cast<HE_index>(i)].valence_ - 2, 0);
+	}
+
+	FILE* file = fopen(fouts, "wb");
+	if (file == NULL)
+	{
+		return false;
+	}
+	char header[84];
+	memset(header, 0, sizeof(header));
+	strcpy(header, "binary STL");
+	memcpy(header + 80, &ntriangles, 4);
+	bool ok = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+
+	// the polygons become fans around the start of pedge_,
+	// every triangle is its normal, three corners and a zero attribute
+	ok = ok && WriteChunked(file, nfaces, 50 * std::max(MaxFaceValence() - 2, 1), [&](size_t begin, size_t end, char* out)
+	{
+		const unsigned short attribute = 0;
+		for (size_t i = begin; i < end; i++)
+		{
+			HE_face& f = face_arena_[static_cast<HE_index>(i)];
+			const Vec3f& p0 = f.pedge_->pprev_->pvert_->position_;
+			for (HE_edge* e = f.pedge_; e->pnext_ != f.pedge_->pprev_; e = e->pnext_)
+			{
+				out = AppendVec3(out, f.normal_);
+				out = AppendVec3(out, p0);
+				out = AppendVec3(out, e->pvert_->position_);
+				out = AppendVec3(out, e->pnext_->pvert_->position_);
+				out = AppendBytes(out, &attribute, 2);
+			}
+		}
+		return out;
+	});
+	return FinishWrite(file, fouts, ok);
+}
@@ -0,0 +1,593 @@
+#include "MeshGeodesic.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+
+// The heat method needs two solves with fixed matrices per query: the heat
+// step (mass + t stiffness) u = seeds and the Poisson step stiffness phi =
+// -div X. Both matrices live on the one-ring pattern and are factorised
+// once by an up-looking LDL^T (the ldl algorithm of T. Davis) after ordering
+// the vertices by geometric nested dissection: split the vertices at the
+// median of the longest axis, take the ones on the left that touch the
+// right as the separator, recurse and number the separator last. The heat
+// matrix is an M-matrix, so its triangular solves only add terms of one sign
+// and keep the tiny values far from the seeds accurate, which a relative
+// iterative tolerance would not.
+
+namespace
+{
+	//! vertices of a leaf of the dissection, numbered as they come
+	const size_t DISSECTION_LEAF = 64;
+
+	struct Dissection
+	{
+		const std::vector<Vec3f>&		pos;
+		const std::vector<HE_index>&	start;
+		const std::vector<HE_index>&	column;
+		std::vector<unsigned int>		side;
+		unsigned int					stamp;
+		std::vector<HE_index>&			order;
+
+		Dissection(const std::vector<Vec3f>& p, const std::vector<HE_index>& s,
+			const std::vector<HE_index>& c, std::vector<HE_index>& o)
+			: pos(p), start(s), column(c), side(p.size(), 0), stamp(0), order(o)
+		{}
+
+		//! number the vertices ids[0 .. count)
+		void Run(HE_index* ids, size_t count)
+		{
+			if (count <= DISSECTION_LEAF)
+			{
+				order.insert(order.end(), ids, ids + count);
+				return;
+			}
+
+			Vec3f lo = pos[ids[0]], hi = pos[ids[0]];
+			for (size_t i = 1; i < count; i++)
+			{
+				const Vec3f& p = pos[ids[i]];
+				for (int k = 0; k < 3; k++)
+				{
+					lo[k] = p[k] < lo[k] ? p[k] : lo[k];
+					hi[k] = p[k] > hi[k] ? p[k] : hi[k];
+				}
+			}
+			Vec3f extent = hi - lo;
+			int axis = extent[0] >= extent[1] ? (extent[0] >= extent[2] ? 0 : 2) : (extent[1] >= extent[2] ? 1 : 2);
+			size_t mid = count / 2;
+			const std::vector<Vec3f>& p = pos;
+			std::nth_element(ids, ids + mid, ids + count, [&p, axis](HE_index a, HE_index b)
+			{
+				return p[a][axis] < p[b][axis];
+			});
+
+			// the left vertices with a neighbour on the right separate the halves
+			unsigned int left = ++stamp, right = ++stamp;
+			for (size_t i = 0; i < mid; i++)
+			{
+				side[ids[i]] = left;
+			}
+			for (size_t i = mid; i < count; i++)
+			{
+				side[ids[i]] = right;
+			}
+			HE_index* separator = std::partition(ids, ids + mid, [this, right](HE_index v)
+			{
+				for (HE_index j = start[v]; j < start[v + 1]; j++)
+				{
+					if (side[column[j]] == right)
+					{
+						return false;
+					}
+				}
+				return true;
+			});
+
+			Run(ids, separator - ids);
+			Run(ids + mid, count - mid);
+			order.insert(order.end(), separator, ids + mid);
+		}
+	};
+}
+
+MeshGeodesic::MeshGeodesic(void)
+	: mesh_(NULL), version_(0), factored_(false), time_factor_(1.f)
+{
+}
+
+MeshGeodesic::~MeshGeodesic(void)
+{
+}
+
+void MeshGeodesic::Build(Mesh3D* mesh)
+{
+	Clear();
+	mesh_ = mesh;
+}
+
+void MeshGeodesic::Clear(void)
+{
+	mesh_ = NULL;
+	version_ = 0;
+	factored_ = false;
+	pattern_start_.clear();
+	pattern_column_.clear();
+	order_.clear();
+	inverse_order_.clear();
+	heat_ = Factor();
+	poisson_ = Factor();
+	pos_.clear();
+	tri_.clear();
+	tri_cot_.clear();
+	tri_grad_.clear();
+}
+
+void MeshGeodesic::set_time_factor(float factor)
+{
+	if (factor > 0.f && factor != time_factor_)
+	{
+		time_factor_ = factor;
+		factored_ = false;
+	}
+}
+
+void MeshGeodesic::Dijkstra(const std::vector<HE_index>& seeds, std::vector<float>& distance, float max_distance)
+{
+	distance.clear();
+	if (mesh_ == NULL)
+	{
+		return;
+	}
+	DijkstraQuery(seeds, distance, max_distance);
+}
+
+bool MeshGeodesic::HeatDistance(const std::vector<HE_index>& seeds, std::vector<float>& distance)
+{
+	distance.clear();
+	if (!Prepare())
+	{
+		return false;
+	}
+	HeatQuery(seeds, distance);
+	return true;
+}
+
+void MeshGeodesic::DijkstraBatch(const std::vector<std::vector<HE_index> >& seed_sets,
+	std::vector<std::vector<float> >& distances, float max_distance)
+{
+	distances.assign(seed_sets.size(), std::vector<float>());
+	if (mesh_ == NULL)
+	{
+		return;
+	}
+	parallel_for(0, seed_sets.size(), [&](size_t i)
+	{
+		DijkstraQuery(seed_sets[i], distances[i], max_distance);
+	}, 1);
+}
+
+bool MeshGeodesic::HeatDistanceBatch(const std::vector<std::vector<HE_index> >& seed_sets,
+	std::vector<std::vector<float> >& distances)
+{
+	distances.assign(seed_sets.size(), std::vector<float>());
+	if (!Prepare())
+	{
+		return false;
+	}
+	parallel_for(0, seed_sets.size(), [&](size_t i)
+	{
+		HeatQuery(seed_sets[i], distances[i]);
+	}, 1);
+	return true;
+}
+
+void MeshGeodesic::DijkstraQuery(const std::vector<HE_index>& seeds, std::vector<float>& distance, float max_distance) const
+{
+	size_t nverts = static_cast<size_t>(mesh_->num_of_vertex_list());
+	distance.assign(nverts, FLT_MAX);
+
+	typedef std::pair<float, HE_index> Entry;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > heap;
+	for (size_t i = 0; i < seeds.size(); i++)
+	{
+		if (seeds[i] < nverts && distance[seeds[i]] != 0.f)
+		{
+			distance[seeds[i]] = 0.f;
+			heap.push(Entry(0.f, seeds[i]));
+		}
+	}
+
+	// lazy deletion: a vertex may sit in the heap several times, only the
+	// entry with its final distance is expanded
+	while (!heap.empty())
+	{
+		Entry top = heap.top();
+		heap.pop();
+		HE_index v = top.second;
+		if (top.first > distance[v])
+		{
+			continue;
+		}
+		HE_vert* hv = &mesh_->vertex_at(v);
+		HE_edge* edge = hv->pedge_;
+		if (edge == NULL)
+		{
+			continue;
+		}
+		do
+		{
+			HE_index u = static_cast<HE_index>(edge->pvert_->id_);
+			float d = top.first + (edge->pvert_->position_ - hv->position_).length();
+			if (d < distance[u] && d <= max_distance)
+			{
+				distance[u] = d;
+				heap.push(Entry(d, u));
+			}
+			edge = edge->ppair_->pnext_;
+		} while (edge != NULL && edge != hv->pedge_);
+	}
+}
+
+bool MeshGeodesic::Prepare(void)
+{
+	if (mesh_ == NULL || !mesh_->isValid())
+	{
+		return false;
+	}
+	if (factored_ && version_ == mesh_->positions_version())
+	{
+		return true;
+	}
+	factored_ = false;
+	version_ = mesh_->positions_version();
+
+	size_t nverts = static_cast<size_t>(mesh_->num_of_vertex_list());
+	size_t nfaces = static_cast<size_t>(mesh_->num_of_face_list());
+	for (size_t f = 0; f < nfaces; f++)
+	{
+		if (mesh_->face_at(static_cast<HE_index>(f)).valence_ != 3)
+		{
+			return false;
+		}
+	}
+
+	pos_.resize(nverts);
+	pattern_start_.assign(nverts + 1, 0);
+	for (size_t i = 0; i < nverts; i++)
+	{
+		pos_[i] = mesh_->vertex_at(static_cast<HE_index>(i)).position_;
+		pattern_start_[i + 1] = pattern_start_[i] + mesh_->num_of_neighbors(static_cast<int>(i)) + 1;
+	}
+	pattern_column_.resize(pattern_start_[nverts]);
+	parallel_for(0, nverts, [&](size_t i)
+	{
+		HE_index* row = pattern_column_.data() + pattern_start_[i];
+		const HE_index* ring = mesh_->neighbors(static_cast<int>(i));
+		size_t n = pattern_start_[i + 1] - pattern_start_[i] - 1;
+		std::copy(ring, ring + n, row);
+		row[n] = static_cast<HE_index>(i);
+		std::sort(row, row + n + 1);
+	});
+
+	// corners, cotangents and hat function gradients of the triangles
+	tri_.resize(3 * nfaces);
+	tri_cot_.resize(3 * nfaces);
+	tri_grad_.resize(3 * nfaces);
+	std::vector<double> mass(nverts, 0.0);
+	std::vector<double> stiffness(pattern_column_.size(), 0.0);
+	for (size_t f = 0; f < nfaces; f++)
+	{
+		HE_edge* edge = mesh_->face_at(static_cast<HE_index>(f)).pedge_;
+		HE_index* c = &tri_[3 * f];
+		for (int k = 0; k < 3; k++, edge = edge->pnext_)
+		{
+			c[k] = static_cast<HE_index>(edge->pvert_->id_);
+		}
+		Vec3f normal = (pos_[c[1]] - pos_[c[0]]) ^ (pos_[c[2]] - pos_[c[0]]);
+		float double_area = len(normal);
+		if (double_area <= 0.f)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				tri_cot_[3 * f + k] = 0.f;
+				tri_grad_[3 * f + k] = Vec3f(0.f, 0.f, 0.f);
+			}
+			continue;
+		}
+		normal /= double_area;
+		for (int k = 0; k < 3; k++)
+		{
+			const Vec3f& p = pos_[c[k]];
+			const Vec3f& a = pos_[c[(k + 1) % 3]];
+			const Vec3f& b = pos_[c[(k + 2) % 3]];
+			tri_cot_[3 * f + k] = ((a - p) * (b - p)) / len((a - p) ^ (b - p));
+			tri_grad_[3 * f + k] = (normal ^ (b - a)) / double_area;
+			mass[c[k]] += double_area / 6.0;
+		}
+
+		// half the cotangent of a corner couples the two other corners
+		for (int k = 0; k < 3; k++)
+		{
+			HE_index a = c[(k + 1) % 3], b = c[(k + 2) % 3];
+			double w = 0.5 * tri_cot_[3 * f + k];
+			HE_index ends[2][2] = {{a, b}, {b, a}};
+			for (int s = 0; s < 2; s++)
+			{
+				HE_index i = ends[s][0], j = ends[s][1];
+				HE_index* row = pattern_column_.data() + pattern_start_[i];
+				HE_index* row_end = pattern_column_.data() + pattern_start_[i + 1];
+				stiffness[std::lower_bound(row, row_end, j) - pattern_column_.data()] -= w;
+				stiffness[std::lower_bound(row, row_end, i) - pattern_column_.data()] += w;
+			}
+		}
+	}
+
+	ComputeOrder();
+
+	// heat: mass + t stiffness; Poisson: stiffness shifted just enough to be definite
+	double h = mesh_->average_edge_length();
+	double t = time_factor_ * h * h;
+	double diagonal_sum = 0.0;
+	std::vector<double> heat(stiffness.size()), poisson(stiffness.size());
+	for (size_t i = 0; i < nverts; i++)
+	{
+		for (HE_index j = pattern_start_[i]; j < pattern_start_[i + 1]; j++)
+		{
+			heat[j] = t * stiffness[j];
+			if (pattern_column_[j] == i)
+			{
+				heat[j] += mass[i];
+				diagonal_sum += stiffness[j];
+				if (heat[j] <= 0.0)
+				{
+					heat[j] = 1.0;		// a vertex without faces
+				}
+			}
+		}
+	}
+	double shift = 1e-8 * (diagonal_sum > 0.0 ? diagonal_sum / nverts : 1.0);
+	for (size_t i = 0; i < nverts; i++)
+	{
+		for (HE_index j = pattern_start_[i]; j < pattern_start_[i + 1]; j++)
+		{
+			poisson[j] = stiffness[j] + (pattern_column_[j] == i ? shift : 0.0);
+		}
+	}
+
+	// the two factors are independent
+	bool ok[2];
+	parallel_for(0, 2, [&](size_t i)
+	{
+		ok[i] = i == 0 ? FactorMatrix(heat, heat_) : FactorMatrix(poisson, poisson_);
+	}, 1);
+	factored_ = ok[0] && ok[1];
+	return factored_;
+}
+
+void MeshGeodesic::ComputeOrder(void)
+{
+	size_t nverts = pos_.size();
+	std::vector<HE_index> ids(nverts);
+	for (size_t i = 0; i < nverts; i++)
+	{
+		ids[i] = static_cast<HE_index>(i);
+	}
+	order_.clear();
+	order_.reserve(nverts);
+	Dissection dissection(pos_, pattern_start_, pattern_column_, order_);
+	dissection.Run(ids.data(), nverts);
+
+	inverse_order_.resize(nverts);
+	for (size_t k = 0; k < nverts; k++)
+	{
+		inverse_order_[order_[k]] = static_cast<HE_index>(k);
+	}
+}
+
+bool MeshGeodesic::FactorMatrix(const std::vector<double>& values, Factor& factor) const
+{
+	size_t n = pos_.size();
+	const HE_index NONE = HE_INVALID_INDEX;
+	std::vector<HE_index> parent(n), count(n), flag(n), pattern(n);
+	std::vector<double> y(n, 0.0);
+
+	// symbolic: elimination tree and column counts of L
+	for (size_t k = 0; k < n; k++)
+	{
+		parent[k] = NONE;
+		flag[k] = static_cast<HE_index>(k);
+		count[k] = 0;
+		HE_index v = order_[k];
+		for (HE_index p = pattern_start_[v]; p < pattern_start_[v + 1]; p++)
+		{
+			for (HE_index i = inverse_order_[pattern_column_[p]]; i < k && flag[i] != k; i = parent[i])
+			{
+				if (parent[i] == NONE)
+				{
+					parent[i] = static_cast<HE_index>(k);
+				}
+				count[i]++;
+				flag[i] = static_cast<HE_index>(k);
+			}
+		}
+	}
+	factor.start.resize(n + 1);
+	factor.start[0] = 0;
+	for (size_t k = 0; k < n; k++)
+	{
+		factor.start[k + 1] = factor.start[k] + count[k];
+	}
+	factor.row.resize(factor.start[n]);
+	factor.value.resize(factor.start[n]);
+	factor.diagonal.resize(n);
+
+	// numeric: row k of L from a sparse triangular solve along the tree
+	for (size_t k = 0; k < n; k++)
+	{
+		HE_index top = static_cast<HE_index>(n);
+		flag[k] = static_cast<HE_index>(k);
+		count[k] = 0;
+		HE_index v = order_[k];
+		for (HE_index p = pattern_start_[v]; p < pattern_start_[v + 1]; p++)
+		{
+			HE_index i = inverse_order_[pattern_column_[p]];
+			if (i > k)
+			{
+				continue;
+			}
+			y[i] += values[p];
+			HE_index length = 0;
+			for (; flag[i] != k; i = parent[i])
+			{
+				pattern[length++] = i;
+				flag[i] = static_cast<HE_index>(k);
+			}
+			while (length > 0)
+			{
+				pattern[--top] = pattern[--length];
+			}
+		}
+		double d = y[k];
+		y[k] = 0.0;
+		for (; top < n; top++)
+		{
+			HE_index i = pattern[top];
+			double yi = y[i];
+			y[i] = 0.0;
+			HE_index end = factor.start[i] + count[i];
+			for (HE_index p = factor.start[i]; p < end; p++)
+			{
+				y[factor.row[p]] -= factor.value[p] * yi;
+			}
+			double l = yi / factor.diagonal[i];
+			d -= l * yi;
+			factor.row[end] = static_cast<HE_index>(k);
+			factor.value[end] = l;
+			count[i]++;
+		}
+		if (!(d > 0.0))
+		{
+			return false;
+		}
+		factor.diagonal[k] = d;
+	}
+	return true;
+}
+
+void MeshGeodesic::Solve(const Factor& factor, std::vector<double>& x, std::vector<double>& work) const
+{
+	size_t n = order_.size();
+	for (size_t k = 0; k < n; k++)
+	{
+		work[k] = x[order_[k]];
+	}
+	for (size_t j = 0; j < n; j++)
+	{
+		double xj = work[j];
+		for (HE_index p = factor.start[j]; p < factor.start[j + 1]; p++)
+		{
+			work[factor.row[p]] -= factor.value[p] * xj;
+		}
+	}
+	for (size_t j = 0; j < n; j++)
+	{
+		work[j] /= factor.diagonal[j];
+	}
+	for (size_t j = n; j > 0; j--)
+	{
+		double xj = work[j - 1];
+		for (HE_index p = factor.start[j - 1]; p < factor.start[j]; p++)
+		{
+			xj -= factor.value[p] * work[factor.row[p]];
+		}
+		work[j - 1] = xj;
+	}
+	for (size_t k = 0; k < n; k++)
+	{
+		x[order_[k]] = work[k];
+	}
+}
+
+void MeshGeodesic::HeatQuery(const std::vector<HE_index>& seeds, std::vector<float>& distance) const
+{
+	size_t nverts = pos_.size();
+	size_t nfaces = tri_.size() / 3;
+	distance.assign(nverts, FLT_MAX);
+
+	std::vector<double> u(nverts, 0.0), work(nverts);
+	std::vector<char> seed_component(static_cast<size_t>(std::max(mesh_->num_of_components(), 0)), 0);
+	bool any = false;
+	for (size_t i = 0; i < seeds.size(); i++)
+	{
+		if (seeds[i] < nverts)
+		{
+			u[seeds[i]] = 1.0;
+			int c = mesh_->vertex_component(static_cast<int>(seeds[i]));
+			if (c >= 0 && c < static_cast<int>(seed_component.size()))
+			{
+				seed_component[c] = 1;
+			}
+			any = true;
+		}
+	}
+	if (!any)
+	{
+		return;
+	}
+
+	// heat flow, then the divergence of its normalised negative gradient
+	Solve(heat_, u, work);
+	std::vector<double> divergence(nverts, 0.0);
+	for (size_t f = 0; f < nfaces; f++)
+	{
+		// in double: far from the seeds u is far below the float range
+		const HE_index* c = &tri_[3 * f];
+		double gradient[3] = {0.0, 0.0, 0.0};
+		for (int k = 0; k < 3; k++)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				gradient[axis] += u[c[k]] * tri_grad_[3 * f + k][axis];
+			}
+		}
+		double length = std::sqrt(gradient[0] * gradient[0] + gradient[1] * gradient[1] + gradient[2] * gradient[2]);
+		if (!(length > 0.0))
+		{
+			continue;
+		}
+		Vec3f x(static_cast<float>(-gradient[0] / length), static_cast<float>(-gradient[1] / length),
+			static_cast<float>(-gradient[2] / length));
+		for (int k = 0; k < 3; k++)
+		{
+			HE_index a = c[(k + 1) % 3], b = c[(k + 2) % 3];
+			const Vec3f& p = pos_[c[k]];
+			divergence[c[k]] += 0.5 * (tri_cot_[3 * f + (k + 2) % 3] * ((pos_[a] - p) * x) +
+				tri_cot_[3 * f + (k + 1) % 3] * ((pos_[b] - p) * x));
+		}
+	}
+
+	// stiffness phi = -div X, then the seeds are moved to 0
+	for (size_t i = 0; i < nverts; i++)
+	{
+		divergence[i] = -divergence[i];
+	}
+	Solve(poisson_, divergence, work);
+	double offset = DBL_MAX;
+	for (size_t i = 0; i < seeds.size(); i++)
+	{
+		if (seeds[i] < nverts)
+		{
+			offset = std::min(offset, divergence[seeds[i]]);
+		}
+	}
+	for (size_t i = 0; i < nverts; i++)
+	{
+		int c = mesh_->vertex_component(static_cast<int>(i));
+		if (c < 0 || c >= static_cast<int>(seed_component.size()) || seed_component[c])
+		{
+			distance[i] = static_cast<float>(std::max(divergence[i] - offset, 0.0));
+		}
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cfloat>
+#include <vector>
+#include "Mesh3D.h"
+
+/*!
+*	Distance fields from seed vertices over a Mesh3D.
+*
+*	Dijkstra runs over the edges of the mesh with a binary heap and gives
+*	the shortest path along edges, a quick upper bound of the geodesic
+*	distance. The heat method (Crane et al. 2013) gives smooth geodesic
+*	distances on triangle meshes: diffuse heat from the seeds for a short
+*	time, normalise its gradient and integrate it back with a Poisson solve.
+*
+*	The two sparse systems of the heat method are factorised once with a
+*	direct LDL^T Cholesky after a nested dissection ordering, so a query is
+*	only two pairs of triangular solves. The factors follow the mesh by
+*	positions_version() and are rebuilt on the first query after the mesh
+*	changed. The mesh must outlive this object.
+*
+*	The batch queries take many seed sets and answer them in parallel, one
+*	set per thread. Vertices that cannot be reached from a seed, in other
+*	components or past max_distance, get FLT_MAX.
+*/
+class MeshGeodesic
+{
+	//! LDL^T factor of a permuted sparse symmetric matrix, L stored by columns
+	struct Factor
+	{
+		std::vector<HE_index>	start;		//!< column j of L is [start[j], start[j + 1])
+		std::vector<HE_index>	row;
+		std::vector<double>		value;
+		std::vector<double>		diagonal;
+	};
+
+	Mesh3D*					mesh_;
+	unsigned int			version_;		//!< positions_version() of the mesh the factors belong to
+	bool					factored_;
+	float					time_factor_;
+
+	//! the pattern of both matrices: the one-rings plus the diagonal, by rows
+	std::vector<HE_index>	pattern_start_;
+	std::vector<HE_index>	pattern_column_;
+	std::vector<HE_index>	order_;			//!< fill-reducing order, new position to vertex id
+	std::vector<HE_index>	inverse_order_;	//!< vertex id to new position
+	Factor					heat_;			//!< of mass + t * stiffness
+	Factor					poisson_;		//!< of stiffness + a small shift
+
+	std::vector<Vec3f>		pos_;			//!< vertex positions the operators were built from
+	std::vector<HE_index>	tri_;			//!< the 3 corners of every face
+	std::vector<float>		tri_cot_;		//!< cotangent of the angle at every corner
+	std::vector<Vec3f>		tri_grad_;		//!< gradient of the hat function of every corner
+
+	MeshGeodesic(const MeshGeodesic&);
+	MeshGeodesic& operator=(const MeshGeodesic&);
+
+public:
+	MeshGeodesic(void);
+	~MeshGeodesic(void);
+
+	//! work on mesh, the factors are built by the first heat query
+	void Build(Mesh3D* mesh);
+	//! forget the mesh and the factors
+	void Clear(void);
+
+	//! heat time in units of the squared average edge length, 1 by default
+	/*!
+	*	larger values give smoother distances, changing it refactors
+	*/
+	void set_time_factor(float factor);
+	inline float time_factor(void) const {return time_factor_;}
+
+	//! shortest path distance along the edges from the nearest seed
+	/*!
+	*	\param max_distance the search stops there, the vertices beyond get FLT_MAX
+	*/
+	void Dijkstra(const std::vector<HE_index>& seeds, std::vector<float>& distance, float max_distance = FLT_MAX);
+	//! geodesic distance from the nearest seed by the heat method
+	/*!
+	*	\return false if the mesh is empty or a face is not a triangle
+	*/
+	bool HeatDistance(const std::vector<HE_index>& seeds, std::vector<float>& distance);
+
+	//! Dijkstra for every seed set, distances[i] belongs to seed_sets[i]
+	void DijkstraBatch(const std::vector<std::vector<HE_index> >& seed_sets,
+		std::vector<std::vector<float> >& distances, float max_distance = FLT_MAX);
+	//! HeatDistance for every seed set, distances[i] belongs to seed_sets[i]
+	bool HeatDistanceBatch(const std::vector<std::vector<HE_index> >& seed_sets,
+		std::vector<std::vector<float> >& distances);
+
+private:
+	//! build the operators and the two factors if the mesh changed
+	bool Prepare(void);
+	//! the fill-reducing order of the vertices by geometric nested dissection
+	void ComputeOrder(void);
+	//! factor the matrix with the given values on the pattern
+	bool FactorMatrix(const std::vector<double>& values, Factor& factor) const;
+	//! solve factor x = b in place, x in vertex order
+	void Solve(const Factor& factor, std::vector<double>& x, std::vector<double>& work) const;
+	//! one heat query on its own work space
+	void HeatQuery(const std::vector<HE_index>& seeds, std::vector<float>& distance) const;
+	//! one Dijkstra search
+	void DijkstraQuery(const std::vector<HE_index>& seeds, std::vector<float>& distance, float max_distance) const;
+};
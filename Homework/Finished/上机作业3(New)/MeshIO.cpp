@@ -0,0 +1,561 @@
+#include "MeshIO.h"
+#include "MeshParallel.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <charconv>
+#include <system_error>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+
+
+//////////////////////////////////////////////////////////////////////////
+// MappedFile
+
+static const char EMPTY_FILE[1] = {0};
+
+MappedFile::MappedFile(void)
+	: data_(NULL), size_(0)
+#ifdef _WIN32
+	, file_(INVALID_HANDLE_VALUE), mapping_(NULL)
+#else
+	, fd_(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile(void)
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const char* path)
+{
+	Close();
+	file_ = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file_ == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file_, &size))
+	{
+		Close();
+		return false;
+	}
+	size_ = static_cast<size_t>(size.QuadPart);
+	if (size_ == 0)
+	{
+		// an empty file can not be mapped
+		data_ = EMPTY_FILE;
+		return true;
+	}
+	mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping_ == NULL)
+	{
+		Close();
+		return false;
+	}
+	data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+	if (data_ == NULL)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close(void)
+{
+	if (data_ != NULL && data_ != EMPTY_FILE)
+	{
+		UnmapViewOfFile(data_);
+	}
+	if (mapping_ != NULL)
+	{
+		CloseHandle(mapping_);
+	}
+	if (file_ != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(file_);
+	}
+	data_ = NULL;
+	size_ = 0;
+	mapping_ = NULL;
+	file_ = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::Open(const char* path)
+{
+	Close();
+	fd_ = open(path, O_RDONLY);
+	if (fd_ < 0)
+	{
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd_, &st) != 0)
+	{
+		Close();
+		return false;
+	}
+	size_ = static_cast<size_t>(st.st_size);
+	if (size_ == 0)
+	{
+		// an empty file can not be mapped
+		data_ = EMPTY_FILE;
+		return true;
+	}
+	void* p = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+	if (p == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+	madvise(p, size_, MADV_SEQUENTIAL);
+	data_ = static_cast<const char*>(p);
+	return true;
+}
+
+void MappedFile::Close(void)
+{
+	if (data_ != NULL && data_ != EMPTY_FILE)
+	{
+		munmap(const_cast<char*>(data_), size_);
+	}
+	if (fd_ >= 0)
+	{
+		close(fd_);
+	}
+	data_ = NULL;
+	size_ = 0;
+	fd_ = -1;
+}
+
+#endif
+
+
+//////////////////////////////////////////////////////////////////////////
+// OBJ parsing
+
+void OBJData::clear(void)
+{
+	positions.clear();
+	texcoords.clear();
+	normals.clear();
+	corner_verts.clear();
+	corner_texs.clear();
+	corner_norms.clear();
+	face_starts.assign(1, 0);
+	vertex_base = 0;
+}
+
+namespace
+{
+	inline const char* SkipBlanks(const char* p, const char* end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t'))
+		{
+			++p;
+		}
+		return p;
+	}
+
+	inline const char* SkipLine(const char* p, const char* end)
+	{
+		const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+		return nl ? nl + 1 : end;
+	}
+
+	inline bool isBlank(char c)
+	{
+		return c == ' ' || c == '\t';
+	}
+
+	inline bool isTokenEnd(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '#';
+	}
+
+	//! read one float, a missing or broken number reads as 0
+	const char* ParseFloat(const char* p, const char* end, float& value)
+	{
+		p = SkipBlanks(p, end);
+		if (p < end && *p == '+')
+		{
+			++p;
+		}
+		std::from_chars_result res = std::from_chars(p, end, value);
+		if (res.ec == std::errc::invalid_argument)
+		{
+			value = 0.f;
+		}
+		else if (res.ec == std::errc::result_out_of_range)
+		{
+			// underflow or overflow, let strtof pick 0 or infinity
+			char token[64];
+			size_t len = static_cast<size_t>(res.ptr - p) < sizeof(token) - 1 ? res.ptr - p : sizeof(token) - 1;
+			memcpy(token, p, len);
+			token[len] = 0;
+			value = strtof(token, NULL);
+		}
+		p = res.ptr;
+		while (p < end && !isTokenEnd(*p))
+		{
+			++p;
+		}
+		return p;
+	}
+
+	//! read a signed integer, returns false if there are no digits
+	inline bool ParseInt(const char*& p, const char* end, int& value)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			++p;
+		}
+		if (p >= end || *p < '0' || *p > '9')
+		{
+			return false;
+		}
+		int v = 0;
+		while (p < end && *p >= '0' && *p <= '9')
+		{
+			v = v * 10 + (*p - '0');
+			++p;
+		}
+		value = negative ? -v : v;
+		return true;
+	}
+
+	//! corners whose negative index was resolved against a chunk, not the file
+	struct RelativeCorners
+	{
+		std::vector<size_t>	verts, texs, norms;
+	};
+
+	//! OBJ indices are 1-based, negative ones count back from the last element
+	inline int ResolveIndex(int idx, int count, std::vector<size_t>* relative, size_t corner)
+	{
+		if (idx > 0)
+		{
+			return idx - 1;
+		}
+		if (idx < 0)
+		{
+			if (relative)
+			{
+				relative->push_back(corner);
+			}
+			return count + idx;
+		}
+		return -1;
+	}
+
+	//! parse the corners "v", "v/t", "v//n" or "v/t/n" of a face line
+	const char* ParseFace(const char* p, const char* end, OBJData& obj, RelativeCorners* rel)
+	{
+		int nverts = obj.vertex_base + obj.num_of_vertices();
+		int ntexs = obj.num_of_texcoords();
+		int nnorms = obj.num_of_normals();
+		while (true)
+		{
+			p = SkipBlanks(p, end);
+			if (p >= end || *p == '\r' || *p == '\n' || *p == '#')
+			{
+				break;
+			}
+			int v = 0, t = 0, n = 0;
+			if (!ParseInt(p, end, v))
+			{
+				// not an index, skip the token
+				while (p < end && !isTokenEnd(*p))
+				{
+					++p;
+				}
+				continue;
+			}
+			if (p < end && *p == '/')
+			{
+				++p;
+				ParseInt(p, end, t);
+				if (p < end && *p == '/')
+				{
+					++p;
+					ParseInt(p, end, n);
+				}
+			}
+			size_t corner = obj.corner_verts.size();
+			obj.corner_verts.push_back(ResolveIndex(v, nverts, rel ? &rel->verts : NULL, corner));
+			obj.corner_texs.push_back(ResolveIndex(t, ntexs, rel ? &rel->texs : NULL, corner));
+			obj.corner_norms.push_back(ResolveIndex(n, nnorms, rel ? &rel->norms : NULL, corner));
+			while (p < end && !isTokenEnd(*p))
+			{
+				++p;
+			}
+		}
+		obj.face_starts.push_back(static_cast<int>(obj.corner_verts.size()));
+		return p;
+	}
+
+	//! count the v/vt/vn/f lines so that the arrays can be sized up front
+	void CountOBJLines(const char* p, const char* end, size_t& nv, size_t& nvt, size_t& nvn, size_t& nf)
+	{
+		nv = nvt = nvn = nf = 0;
+		while (p < end)
+		{
+			if (end - p > 1)
+			{
+				if (p[0] == 'v')
+				{
+					if (isBlank(p[1])) nv++;
+					else if (p[1] == 't') nvt++;
+					else if (p[1] == 'n') nvn++;
+				}
+				else if (p[0] == 'f' && isBlank(p[1]))
+				{
+					nf++;
+				}
+			}
+			p = SkipLine(p, end);
+		}
+	}
+
+	//! parse [begin, end) into obj, relative indices are recorded in rel if given
+	void ParseOBJText(const char* begin, const char* end, OBJData& obj, RelativeCorners* rel)
+	{
+		size_t nv, nvt, nvn, nf;
+		CountOBJLines(begin, end, nv, nvt, nvn, nf);
+		obj.positions.reserve(obj.positions.size() + 3 * nv);
+		obj.texcoords.reserve(obj.texcoords.size() + 2 * nvt);
+		obj.normals.reserve(obj.normals.size() + 3 * nvn);
+		obj.face_starts.reserve(obj.face_starts.size() + nf);
+		obj.corner_verts.reserve(obj.corner_verts.size() + 3 * nf);
+		obj.corner_texs.reserve(obj.corner_texs.size() + 3 * nf);
+		obj.corner_norms.reserve(obj.corner_norms.size() + 3 * nf);
+
+		const char* p = begin;
+		while (p < end)
+		{
+			p = SkipBlanks(p, end);
+			if (end - p > 1)
+			{
+				if (p[0] == 'v' && isBlank(p[1]))
+				{
+					float x, y, z;
+					p = ParseFloat(p + 1, end, x);
+					p = ParseFloat(p, end, y);
+					p = ParseFloat(p, end, z);
+					obj.positions.push_back(x);
+					obj.positions.push_back(y);
+					obj.positions.push_back(z);
+				}
+				else if (p[0] == 'v' && p[1] == 't' && end - p > 2 && isBlank(p[2]))
+				{
+					float u, v;
+					p = ParseFloat(p + 2, end, u);
+					p = ParseFloat(p, end, v);
+					obj.texcoords.push_back(u);
+					obj.texcoords.push_back(v);
+				}
+				else if (p[0] == 'v' && p[1] == 'n' && end - p > 2 && isBlank(p[2]))
+				{
+					float x, y, z;
+					p = ParseFloat(p + 2, end, x);
+					p = ParseFloat(p, end, y);
+					p = ParseFloat(p, end, z);
+					obj.normals.push_back(x);
+					obj.normals.push_back(y);
+					obj.normals.push_back(z);
+				}
+				else if (p[0] == 'f' && isBlank(p[1]))
+				{
+					p = ParseFace(p + 1, end, obj, rel);
+				}
+			}
+			// comments, groups, materials and the rest of the line are ignored
+			p = SkipLine(p, end);
+		}
+	}
+}
+
+void ParseOBJ(const char* begin, const char* end, OBJData& obj)
+{
+	ParseOBJText(begin, end, obj, NULL);
+}
+
+void ParseOBJParallel(const char* begin, const char* end, OBJData& obj, int num_threads)
+{
+	// below this size per chunk, merging costs more than parsing in parallel saves
+	const size_t MIN_CHUNK_BYTES = 1 << 20;
+
+	size_t bytes = static_cast<size_t>(end - begin);
+	if (num_threads <= 0)
+	{
+		num_threads = static_cast<int>(parallel_threads());
+	}
+	size_t nchunks = std::min(static_cast<size_t>(std::max(num_threads, 1)), bytes / MIN_CHUNK_BYTES);
+	if (nchunks <= 1)
+	{
+		ParseOBJText(begin, end, obj, NULL);
+		return;
+	}
+
+	// cut at newline boundaries so that no record is split
+	std::vector<const char*> cuts(nchunks + 1);
+	cuts[0] = begin;
+	cuts[nchunks] = end;
+	for (size_t i = 1; i < nchunks; i++)
+	{
+		const char* p = std::max(begin + bytes * i / nchunks, cuts[i - 1]);
+		cuts[i] = SkipLine(p, end);
+	}
+
+	// every chunk is parsed on its own, so the chunks only know their local
+	// counts of v/vt/vn; negative indices are fixed up after the merge
+	std::vector<OBJData> chunks(nchunks);
+	std::vector<RelativeCorners> relatives(nchunks);
+	parallel_for(0, nchunks, [&](size_t i)
+	{
+		ParseOBJText(cuts[i], cuts[i + 1], chunks[i], &relatives[i]);
+	}, 1);
+
+	// prefix sums of every array give the place of each chunk in the result
+	std::vector<size_t> pos_ofs(nchunks + 1, obj.positions.size());
+	std::vector<size_t> tex_ofs(nchunks + 1, obj.texcoords.size());
+	std::vector<size_t> nrm_ofs(nchunks + 1, obj.normals.size());
+	std::vector<size_t> corner_ofs(nchunks + 1, obj.corner_verts.size());
+	std::vector<size_t> face_ofs(nchunks + 1, obj.face_starts.size());
+	for (size_t i = 0; i < nchunks; i++)
+	{
+		pos_ofs[i + 1] = pos_ofs[i] + chunks[i].positions.size();
+		tex_ofs[i + 1] = tex_ofs[i] + chunks[i].texcoords.size();
+		nrm_ofs[i + 1] = nrm_ofs[i] + chunks[i].normals.size();
+		corner_ofs[i + 1] = corner_ofs[i] + chunks[i].corner_verts.size();
+		face_ofs[i + 1] = face_ofs[i] + chunks[i].num_of_faces();
+	}
+	obj.positions.resize(pos_ofs[nchunks]);
+	obj.texcoords.resize(tex_ofs[nchunks]);
+	obj.normals.resize(nrm_ofs[nchunks]);
+	obj.corner_verts.resize(corner_ofs[nchunks]);
+	obj.corner_texs.resize(corner_ofs[nchunks]);
+	obj.corner_norms.resize(corner_ofs[nchunks]);
+	obj.face_starts.resize(face_ofs[nchunks]);
+
+	struct Merge
+	{
+		static void Run(OBJData& dst, OBJData& src, RelativeCorners& rel,
+			size_t pos, size_t tex, size_t nrm, size_t corner, size_t face)
+		{
+			int vbase = dst.vertex_base + static_cast<int>(pos / 3);
+			int tbase = static_cast<int>(tex / 2);
+			int nbase = static_cast<int>(nrm / 3);
+			for (size_t k = 0; k < rel.verts.size(); k++) src.corner_verts[rel.verts[k]] += vbase;
+			for (size_t k = 0; k < rel.texs.size(); k++) src.corner_texs[rel.texs[k]] += tbase;
+			for (size_t k = 0; k < rel.norms.size(); k++) src.corner_norms[rel.norms[k]] += nbase;
+
+			std::copy(src.positions.begin(), src.positions.end(), dst.positions.begin() + pos);
+			std::copy(src.texcoords.begin(), src.texcoords.end(), dst.texcoords.begin() + tex);
+			std::copy(src.normals.begin(), src.normals.end(), dst.normals.begin() + nrm);
+			std::copy(src.corner_verts.begin(), src.corner_verts.end(), dst.corner_verts.begin() + corner);
+			std::copy(src.corner_texs.begin(), src.corner_texs.end(), dst.corner_texs.begin() + corner);
+			std::copy(src.corner_norms.begin(), src.corner_norms.end(), dst.corner_norms.begin() + corner);
+			// face_starts[0] of a chunk is 0, its faces start after the leading entry
+			for (size_t f = 1; f < src.face_starts.size(); f++)
+			{
+				dst.face_starts[face + f - 1] = src.face_starts[f] + static_cast<int>(corner);
+			}
+			src = OBJData();
+		}
+	};
+	parallel_for(0, nchunks, [&](size_t i)
+	{
+		Merge::Run(obj, chunks[i], relatives[i], pos_ofs[i], tex_ofs[i], nrm_ofs[i], corner_ofs[i], face_ofs[i]);
+	}, 1);
+}
+
+bool ReadOBJFile(const char* path, OBJData& obj, int num_threads)
+{
+	MappedFile file;
+	if (!file.Open(path))
+	{
+		return false;
+	}
+	obj.clear();
+	ParseOBJParallel(file.data(), file.data() + file.size(), obj, num_threads);
+	return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// source key
+
+namespace
+{
+	inline unsigned long long FNV1a(const char* p, size_t n, unsigned long long h)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			h ^= static_cast<unsigned char>(p[i]);
+			h *= 0x100000001B3ull;
+		}
+		return h;
+	}
+}
+
+bool GetMeshSourceKey(const char* path, MeshSourceKey& key)
+{
+	const size_t SAMPLE_BYTES = 64 * 1024;
+
+#ifdef _WIN32
+	struct _stat64 st;
+	if (_stat64(path, &st) != 0)
+	{
+		return false;
+	}
+#else
+	struct stat st;
+	if (stat(path, &st) != 0)
+	{
+		return false;
+	}
+#endif
+	MappedFile file;
+	if (!file.Open(path))
+	{
+		return false;
+	}
+
+	key.size = static_cast<unsigned long long>(file.size());
+	key.mtime = static_cast<unsigned long long>(st.st_mtime);
+
+	unsigned long long h = FNV1a(reinterpret_cast<const char*>(&key.size), sizeof(key.size), 0xCBF29CE484222325ull);
+	size_t head = std::min(file.size(), SAMPLE_BYTES);
+	h = FNV1a(file.data(), head, h);
+	if (file.size() > head)
+	{
+		size_t tail = std::min(file.size() - head, SAMPLE_BYTES);
+		h = FNV1a(file.data() + file.size() - tail, tail, h);
+	}
+	key.hash = h;
+	return true;
+}
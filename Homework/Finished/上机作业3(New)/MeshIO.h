@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+/*!
+*	Read-only memory mapping of a whole file.
+*/
+class MappedFile
+{
+private:
+	const char*	data_;		//!< first byte of the mapping, NULL if nothing is mapped
+	size_t		size_;		//!< size of the file in bytes
+#ifdef _WIN32
+	void*		file_;		//!< HANDLE of the file
+	void*		mapping_;	//!< HANDLE of the file mapping
+#else
+	int			fd_;
+#endif
+
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+public:
+	MappedFile(void);
+	~MappedFile(void);
+
+	//! map the file, returns false if it can not be opened
+	bool Open(const char* path);
+	//! unmap the file
+	void Close(void);
+
+	inline bool isOpen(void) const {return data_ != NULL;}
+	inline const char* data(void) const {return data_;}
+	inline size_t size(void) const {return size_;}
+};
+
+/*!
+*	The raw content of an OBJ file.
+*
+*	Polygons are stored as corners: face f owns the corners
+*	[face_starts[f], face_starts[f+1]). All indices are resolved to 0-based
+*	positions in the attribute arrays, -1 marks a missing texture or normal.
+*/
+struct OBJData
+{
+	std::vector<float>	positions;		//!< x y z of every "v" line
+	std::vector<float>	texcoords;		//!< u v of every "vt" line
+	std::vector<float>	normals;		//!< x y z of every "vn" line
+	std::vector<int>	corner_verts;	//!< position index of every face corner
+	std::vector<int>	corner_texs;	//!< texcoord index of every face corner
+	std::vector<int>	corner_norms;	//!< normal index of every face corner
+	std::vector<int>	face_starts;	//!< first corner of every face, plus the end
+	//! vertices of the file before positions[0], set when a file is read in blocks
+	/*!
+	*	negative indices count back from vertex_base + the parsed vertices,
+	*	so the corners always hold indices into the whole file
+	*/
+	int					vertex_base;
+
+	OBJData(void) : face_starts(1, 0), vertex_base(0) {}
+
+	inline int num_of_vertices(void) const {return static_cast<int>(positions.size() / 3);}
+	inline int num_of_texcoords(void) const {return static_cast<int>(texcoords.size() / 2);}
+	inline int num_of_normals(void) const {return static_cast<int>(normals.size() / 3);}
+	inline int num_of_faces(void) const {return static_cast<int>(face_starts.size()) - 1;}
+
+	void clear(void);
+};
+
+//! parse the OBJ text in [begin, end) and append it to obj
+void ParseOBJ(const char* begin, const char* end, OBJData& obj);
+
+//! parse the OBJ text in [begin, end) with several threads and append it to obj
+/*!
+*	the text is cut into chunks at newline boundaries, each task of the
+*	thread pool parses one chunk into its own buffers and the chunks are
+*	then copied into obj at prefix-summed offsets. Small inputs are parsed
+*	serially.
+*	\param num_threads number of chunks, 0 for one per thread of the pool
+*/
+void ParseOBJParallel(const char* begin, const char* end, OBJData& obj, int num_threads = 0);
+
+//! map an OBJ file and parse it, in parallel chunks if it is large
+bool ReadOBJFile(const char* path, OBJData& obj, int num_threads = 0);
+
+//! merge the vertices of obj that lie within tolerance of each other
+/*!
+*	the faces are remapped to the merged vertices, the texture and normal
+*	indices of the corners stay as they are. A face that would share a
+*	directed edge with an earlier face keeps its own vertices, a face that
+*	collapses to fewer than 3 vertices is removed. Runs in linear time on a
+*	hashed grid, in parallel.
+*	\return the number of vertices removed
+*/
+int WeldOBJVertices(OBJData& obj, float tolerance);
+
+/*!
+*	Identity of a source file, used to tell whether a cache built from it is
+*	still valid. The hash covers the size and the first and last 64 KB of the
+*	content, so checking it only touches a few pages of the file.
+*/
+struct MeshSourceKey
+{
+	unsigned long long	size;		//!< file size in bytes
+	unsigned long long	mtime;		//!< last modification time, seconds since the epoch
+	unsigned long long	hash;		//!< sampled FNV-1a hash of the content
+
+	MeshSourceKey(void) : size(0), mtime(0), hash(0) {}
+
+	inline bool operator==(const MeshSourceKey& k) const
+	{
+		return size == k.size && mtime == k.mtime && hash == k.hash;
+	}
+};
+
+//! compute the key of a file, returns false if it can not be read
+bool GetMeshSourceKey(const char* path, MeshSourceKey& key);
+
@@ -0,0 +1,457 @@
+#include "MeshKdTree.h"
+
+#include <algorithm>
+#include <utility>
+
+// Implicit median k-d tree.
+//
+// A range of points is split at its median along the axis of largest
+// extent, found with nth_element, and the median becomes the root of the
+// range. The tree needs no node array: the children of [b, e) with middle m
+// are [b, m) and [m + 1, e). The upper levels are built by tasks of the
+// thread pool, they work on disjoint ranges of the same arrays.
+
+namespace
+{
+	const size_t LEAF_SIZE = 8;				//!< ranges this small are scanned
+	const size_t PARALLEL_MIN = 16384;		//!< smaller ranges are not split into pool tasks
+	const size_t DIRTY_MIN = 64;			//!< moved vertices tolerated before a rebuild ...
+	const size_t DIRTY_FRACTION = 32;		//!< ... or this fraction of the points, whichever is more
+	const size_t BATCH_BLOCK = 256;			//!< points per task of the batch queries
+
+	struct BuildPoint
+	{
+		float		p[3];
+		HE_index	id;
+	};
+
+	void BuildRange(BuildPoint* pts, unsigned char* axis, size_t begin, size_t end)
+	{
+		if (end - begin <= LEAF_SIZE)
+		{
+			return;
+		}
+		float lo[3] = {pts[begin].p[0], pts[begin].p[1], pts[begin].p[2]};
+		float hi[3] = {lo[0], lo[1], lo[2]};
+		for (size_t i = begin + 1; i < end; i++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				lo[k] = std::min(lo[k], pts[i].p[k]);
+				hi[k] = std::max(hi[k], pts[i].p[k]);
+			}
+		}
+		int a = 0;
+		for (int k = 1; k < 3; k++)
+		{
+			if (hi[k] - lo[k] > hi[a] - lo[a])
+			{
+				a = k;
+			}
+		}
+
+		size_t mid = begin + (end - begin) / 2;
+		std::nth_element(pts + begin, pts + mid, pts + end, [a](const BuildPoint& l, const BuildPoint& r)
+		{
+			return l.p[a] < r.p[a];
+		});
+		axis[mid] = static_cast<unsigned char>(a);
+
+		if (end - begin >= PARALLEL_MIN)
+		{
+			parallel_invoke([&]() { BuildRange(pts, axis, begin, mid); },
+				[&]() { BuildRange(pts, axis, mid + 1, end); });
+		}
+		else
+		{
+			BuildRange(pts, axis, begin, mid);
+			BuildRange(pts, axis, mid + 1, end);
+		}
+	}
+
+	inline float Distance2(const float* a, const float* b)
+	{
+		float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+	//! read-only view of the tree shared by the recursive searches
+	struct KdView
+	{
+		const float*			points;
+		const HE_index*			ids;
+		const unsigned char*	axis;
+		const unsigned char*	dirty;
+		const float*			p;
+
+		inline bool Skip(size_t i) const {return dirty[ids[i]] != 0;}
+	};
+
+	struct KNearestVisitor : KdView
+	{
+		size_t										k;
+		std::vector<std::pair<float, HE_index> >*	heap;
+
+		inline float Bound(void) const
+		{
+			return heap->size() < k ? 3.4e38f : heap->front().first;
+		}
+		inline void Offer(float d2, HE_index id) const
+		{
+			if (heap->size() < k)
+			{
+				heap->push_back(std::make_pair(d2, id));
+				std::push_heap(heap->begin(), heap->end());
+			}
+			else if (d2 < heap->front().first)
+			{
+				std::pop_heap(heap->begin(), heap->end());
+				heap->back() = std::make_pair(d2, id);
+				std::push_heap(heap->begin(), heap->end());
+			}
+		}
+		void Visit(size_t begin, size_t end) const
+		{
+			if (end - begin <= LEAF_SIZE)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					if (!Skip(i))
+					{
+						Offer(Distance2(p, points + 3 * i), ids[i]);
+					}
+				}
+				return;
+			}
+			size_t mid = begin + (end - begin) / 2;
+			if (!Skip(mid))
+			{
+				Offer(Distance2(p, points + 3 * mid), ids[mid]);
+			}
+			float d = p[axis[mid]] - points[3 * mid + axis[mid]];
+			if (d < 0.f)
+			{
+				Visit(begin, mid);
+				if (d * d < Bound())
+				{
+					Visit(mid + 1, end);
+				}
+			}
+			else
+			{
+				Visit(mid + 1, end);
+				if (d * d < Bound())
+				{
+					Visit(begin, mid);
+				}
+			}
+		}
+	};
+
+	struct RadiusVisitor : KdView
+	{
+		float					r2;
+		std::vector<HE_index>*	out;
+		std::vector<float>*		out_dist2;
+
+		inline void Test(size_t i) const
+		{
+			float d2 = Distance2(p, points + 3 * i);
+			if (d2 <= r2 && !Skip(i))
+			{
+				out->push_back(ids[i]);
+				if (out_dist2 != NULL)
+				{
+					out_dist2->push_back(d2);
+				}
+			}
+		}
+		void Visit(size_t begin, size_t end) const
+		{
+			if (end - begin <= LEAF_SIZE)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					Test(i);
+				}
+				return;
+			}
+			size_t mid = begin + (end - begin) / 2;
+			Test(mid);
+			float d = p[axis[mid]] - points[3 * mid + axis[mid]];
+			if (d <= 0.f || d * d <= r2)
+			{
+				Visit(begin, mid);
+			}
+			if (d >= 0.f || d * d <= r2)
+			{
+				Visit(mid + 1, end);
+			}
+		}
+	};
+}
+
+MeshKdTree::MeshKdTree(void)
+	: mesh_(NULL), version_(0)
+{
+}
+
+MeshKdTree::~MeshKdTree(void)
+{
+}
+
+void MeshKdTree::Clear(void)
+{
+	mesh_ = NULL;
+	version_ = 0;
+	points_.clear();
+	ids_.clear();
+	split_axis_.clear();
+	dirty_mark_.clear();
+	dirty_.clear();
+}
+
+void MeshKdTree::Build(Mesh3D* mesh)
+{
+	Clear();
+	if (mesh == NULL)
+	{
+		return;
+	}
+	mesh_ = mesh;
+	version_ = mesh->positions_version();
+	size_t n = static_cast<size_t>(mesh->num_of_vertex_list());
+	dirty_mark_.assign(n, 0);
+	if (n == 0)
+	{
+		return;
+	}
+
+	std::vector<BuildPoint> pts(n);
+	parallel_for(0, n, [&](size_t i)
+	{
+		const Vec3f& p = mesh->vertex_at(static_cast<HE_index>(i)).position_;
+		pts[i].p[0] = p[0];
+		pts[i].p[1] = p[1];
+		pts[i].p[2] = p[2];
+		pts[i].id = static_cast<HE_index>(i);
+	});
+
+	split_axis_.assign(n, 0);
+	BuildRange(pts.data(), split_axis_.data(), 0, n);
+
+	points_.resize(3 * n);
+	ids_.resize(n);
+	parallel_for(0, n, [&](size_t i)
+	{
+		points_[3 * i] = pts[i].p[0];
+		points_[3 * i + 1] = pts[i].p[1];
+		points_[3 * i + 2] = pts[i].p[2];
+		ids_[i] = pts[i].id;
+	});
+}
+
+bool MeshKdTree::Sync(void)
+{
+	if (mesh_ == NULL)
+	{
+		return false;
+	}
+	unsigned int version = mesh_->positions_version();
+	if (version == version_)
+	{
+		return false;
+	}
+
+	std::vector<HE_index> moved;
+	if (dirty_mark_.size() == static_cast<size_t>(mesh_->num_of_vertex_list()) &&
+		mesh_->GetMovedVertices(version_, moved))
+	{
+		for (size_t i = 0; i < moved.size(); i++)
+		{
+			if (!dirty_mark_[moved[i]])
+			{
+				dirty_mark_[moved[i]] = 1;
+				dirty_.push_back(moved[i]);
+			}
+		}
+		version_ = version;
+		if (dirty_.size() <= std::max(DIRTY_MIN, ids_.size() / DIRTY_FRACTION))
+		{
+			return false;
+		}
+	}
+
+	Build(mesh_);
+	return true;
+}
+
+void MeshKdTree::SearchKNearest(const float* p, size_t k, std::vector<std::pair<float, HE_index> >& heap) const
+{
+	heap.clear();
+	if (k == 0)
+	{
+		return;
+	}
+	KNearestVisitor search;
+	search.points = points_.data();
+	search.ids = ids_.data();
+	search.axis = split_axis_.data();
+	search.dirty = dirty_mark_.data();
+	search.p = p;
+	search.k = k;
+	search.heap = &heap;
+	if (!ids_.empty())
+	{
+		search.Visit(0, ids_.size());
+	}
+	for (size_t i = 0; i < dirty_.size(); i++)
+	{
+		const Vec3f& q = mesh_->vertex_at(dirty_[i]).position_;
+		float qf[3] = {q[0], q[1], q[2]};
+		search.Offer(Distance2(p, qf), dirty_[i]);
+	}
+}
+
+void MeshKdTree::SearchRadius(const float* p, float r2, std::vector<HE_index>& ids, std::vector<float>* dist2) const
+{
+	RadiusVisitor search;
+	search.points = points_.data();
+	search.ids = ids_.data();
+	search.axis = split_axis_.data();
+	search.dirty = dirty_mark_.data();
+	search.p = p;
+	search.r2 = r2;
+	search.out = &ids;
+	search.out_dist2 = dist2;
+	if (!ids_.empty())
+	{
+		search.Visit(0, ids_.size());
+	}
+	for (size_t i = 0; i < dirty_.size(); i++)
+	{
+		const Vec3f& q = mesh_->vertex_at(dirty_[i]).position_;
+		float qf[3] = {q[0], q[1], q[2]};
+		float d2 = Distance2(p, qf);
+		if (d2 <= r2)
+		{
+			ids.push_back(dirty_[i]);
+			if (dist2 != NULL)
+			{
+				dist2->push_back(d2);
+			}
+		}
+	}
+}
+
+HE_index MeshKdTree::Nearest(const Vec3f& p, float* dist2)
+{
+	Sync();
+	float pf[3] = {p[0], p[1], p[2]};
+	std::vector<std::pair<float, HE_index> > heap;
+	SearchKNearest(pf, 1, heap);
+	if (heap.empty())
+	{
+		return HE_INVALID_INDEX;
+	}
+	if (dist2 != NULL)
+	{
+		*dist2 = heap[0].first;
+	}
+	return heap[0].second;
+}
+
+void MeshKdTree::KNearest(const Vec3f& p, int k, std::vector<HE_index>& ids, std::vector<float>* dist2)
+{
+	Sync();
+	float pf[3] = {p[0], p[1], p[2]};
+	std::vector<std::pair<float, HE_index> > heap;
+	SearchKNearest(pf, static_cast<size_t>(std::max(k, 0)), heap);
+	std::sort_heap(heap.begin(), heap.end());
+	ids.resize(heap.size());
+	for (size_t i = 0; i < heap.size(); i++)
+	{
+		ids[i] = heap[i].second;
+	}
+	if (dist2 != NULL)
+	{
+		dist2->resize(heap.size());
+		for (size_t i = 0; i < heap.size(); i++)
+		{
+			(*dist2)[i] = heap[i].first;
+		}
+	}
+}
+
+void MeshKdTree::RadiusSearch(const Vec3f& p, float r, std::vector<HE_index>& ids, std::vector<float>* dist2)
+{
+	Sync();
+	float pf[3] = {p[0], p[1], p[2]};
+	ids.clear();
+	if (dist2 != NULL)
+	{
+		dist2->clear();
+	}
+	SearchRadius(pf, r * r, ids, dist2);
+}
+
+void MeshKdTree::KNearestBatch(const std::vector<Vec3f>& points, int k, std::vector<HE_index>& ids)
+{
+	Sync();
+	size_t kk = static_cast<size_t>(std::max(k, 0));
+	ids.assign(points.size() * kk, HE_INVALID_INDEX);
+	parallel_for_blocks(0, points.size(), BATCH_BLOCK, [&](size_t begin, size_t end)
+	{
+		std::vector<std::pair<float, HE_index> > heap;
+		heap.reserve(kk);
+		for (size_t i = begin; i < end; i++)
+		{
+			float pf[3] = {points[i][0], points[i][1], points[i][2]};
+			SearchKNearest(pf, kk, heap);
+			std::sort_heap(heap.begin(), heap.end());
+			for (size_t j = 0; j < heap.size(); j++)
+			{
+				ids[i * kk + j] = heap[j].second;
+			}
+		}
+	});
+}
+
+void MeshKdTree::RadiusSearchBatch(const std::vector<Vec3f>& points, float r,
+	std::vector<size_t>& offsets, std::vector<HE_index>& ids)
+{
+	Sync();
+	size_t n = points.size();
+	offsets.assign(n + 1, 0);
+	ids.clear();
+	if (n == 0)
+	{
+		return;
+	}
+
+	// every block collects its results apart, the counts go to offsets[i + 1]
+	size_t nblocks = (n + BATCH_BLOCK - 1) / BATCH_BLOCK;
+	std::vector<std::vector<HE_index> > found(nblocks);
+	float r2 = r * r;
+	parallel_for_blocks(0, n, BATCH_BLOCK, [&](size_t begin, size_t end)
+	{
+		std::vector<HE_index>& out = found[begin / BATCH_BLOCK];
+		for (size_t i = begin; i < end; i++)
+		{
+			float pf[3] = {points[i][0], points[i][1], points[i][2]};
+			size_t before = out.size();
+			SearchRadius(pf, r2, out, NULL);
+			offsets[i + 1] = out.size() - before;
+		}
+	});
+
+	for (size_t i = 0; i < n; i++)
+	{
+		offsets[i + 1] += offsets[i];
+	}
+	ids.resize(offsets[n]);
+	parallel_for(0, nblocks, [&](size_t b)
+	{
+		std::copy(found[b].begin(), found[b].end(), ids.begin() + offsets[b * BATCH_BLOCK]);
+	}, 1);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+#include "Mesh3D.h"
+
+/*!
+*	k-d tree over the vertices of a Mesh3D for nearest neighbour queries.
+*
+*	The tree is implicit: the points are stored in tree order and the root of
+*	a range [b, e) is its middle point, splitting along the axis kept for it.
+*	Leaves hold at most a few points and are scanned linearly.
+*
+*	The tree follows the mesh by positions_version(). Vertices moved by a few
+*	edits are only marked: the tree skips them and the queries test them
+*	against their current positions, until there are enough of them to make a
+*	rebuild cheaper. A Unify, a reorder or a new mesh always rebuilds. The
+*	mesh must outlive the tree.
+*
+*	The single queries bring the tree up to date first and must not run
+*	concurrently. The batch queries do that once and then answer all the
+*	points in parallel.
+*/
+class MeshKdTree
+{
+	Mesh3D*						mesh_;
+	unsigned int				version_;		//!< positions_version() of the mesh the tree reflects
+	std::vector<float>			points_;		//!< xyz of every point in tree order
+	std::vector<HE_index>		ids_;			//!< vertex id of every point in tree order
+	std::vector<unsigned char>	split_axis_;	//!< split axis of the range whose middle is this point
+	std::vector<unsigned char>	dirty_mark_;	//!< per vertex id, moved since the build
+	std::vector<HE_index>		dirty_;			//!< the marked vertices
+
+	MeshKdTree(const MeshKdTree&);
+	MeshKdTree& operator=(const MeshKdTree&);
+
+public:
+	MeshKdTree(void);
+	~MeshKdTree(void);
+
+	//! build the tree over all the vertices of mesh
+	void Build(Mesh3D* mesh);
+	//! catch up with the changes of the mesh since the last build or sync
+	/*!
+	*	\return true if the tree had to be rebuilt
+	*/
+	bool Sync(void);
+	//! forget the tree
+	void Clear(void);
+
+	inline bool empty(void) const {return ids_.empty();}
+	inline int num_of_points(void) const {return static_cast<int>(ids_.size());}
+	//! number of moved vertices the queries test outside the tree
+	inline int num_of_dirty(void) const {return static_cast<int>(dirty_.size());}
+
+	//! id of the vertex closest to p, HE_INVALID_INDEX for an empty mesh
+	HE_index Nearest(const Vec3f& p, float* dist2 = NULL);
+	//! the k vertices closest to p, closest first
+	/*!
+	*	\param dist2 if not NULL, receives the squared distances
+	*/
+	void KNearest(const Vec3f& p, int k, std::vector<HE_index>& ids, std::vector<float>* dist2 = NULL);
+	//! all the vertices within distance r of p, in no particular order
+	void RadiusSearch(const Vec3f& p, float r, std::vector<HE_index>& ids, std::vector<float>* dist2 = NULL);
+
+	//! k nearest vertices of every point
+	/*!
+	*	\param ids receives k slots per point, closest first, padded with
+	*	HE_INVALID_INDEX when the mesh has fewer than k vertices
+	*/
+	void KNearestBatch(const std::vector<Vec3f>& points, int k, std::vector<HE_index>& ids);
+	//! vertices within distance r of every point
+	/*!
+	*	\param offsets receives points.size() + 1 entries, the vertices of
+	*	point i are ids[offsets[i]] to ids[offsets[i + 1] - 1]
+	*/
+	void RadiusSearchBatch(const std::vector<Vec3f>& points, float r,
+		std::vector<size_t>& offsets, std::vector<HE_index>& ids);
+
+private:
+	//! the k nearest, unsorted, as a max heap of (squared distance, id)
+	void SearchKNearest(const float* p, size_t k, std::vector<std::pair<float, HE_index> >& heap) const;
+	//! the vertices within squared distance r2
+	void SearchRadius(const float* p, float r2, std::vector<HE_index>& ids, std::vector<float>* dist2) const;
+};
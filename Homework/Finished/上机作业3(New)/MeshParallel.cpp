@@ -0,0 +1,174 @@
+#include "MeshParallel.h"
+
+// The queues are plain deques under a mutex each: the owner pushes and
+// pops at the back, thieves take from the front. A loop pushes about
+// eight tasks per thread, so the locks are taken rarely next to the work
+// of a task. Workers without work spin a little, then sleep until a task
+// is pushed; sleeping_ and queued_ are both sequentially consistent, so
+// either the worker sees the new task or the pusher sees the sleeper.
+
+namespace
+{
+	//! queue of the current thread, 0 outside the pool
+	thread_local unsigned current_queue = 0;
+
+	//! rounds a worker without work keeps looking before it sleeps
+	const int IDLE_SPINS = 64;
+}
+
+ThreadPool& ThreadPool::Instance(void)
+{
+	// never destroyed: the workers may still be waiting when the process
+	// exits, and joining them then can deadlock
+	static ThreadPool* pool = new ThreadPool();
+	return *pool;
+}
+
+ThreadPool::ThreadPool(void)
+	: num_threads_(std::max(1u, std::thread::hardware_concurrency())),
+	queues_(new Queue[num_threads_]), queued_(0), sleeping_(0)
+{
+	workers_.reserve(num_threads_ - 1);
+	for (unsigned k = 1; k < num_threads_; k++)
+	{
+		workers_.push_back(std::thread(&ThreadPool::WorkerLoop, this, k));
+	}
+}
+
+void ThreadPool::Run(RangeFn run, const void* fn, size_t begin, size_t end, size_t grain)
+{
+	size_t n = end > begin ? end - begin : 0;
+	grain = std::max(grain, (n + 8 * num_threads_ - 1) / (8 * num_threads_));
+	if (n <= grain || num_threads_ == 1)
+	{
+		run(fn, begin, end);
+		return;
+	}
+
+	Loop loop;
+	loop.run = run;
+	loop.fn = fn;
+	loop.grain = grain;
+	loop.pending.store(n);
+	loop.failed.store(false);
+	Task task = {&loop, begin, end};
+	unsigned k = current_queue;
+	Execute(k, task);
+
+	// help with whatever is queued until the stolen parts are done
+	while (loop.pending.load(std::memory_order_acquire) != 0)
+	{
+		if (Take(k, task))
+		{
+			Execute(k, task);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+	if (loop.error)
+	{
+		std::rethrow_exception(loop.error);
+	}
+}
+
+void ThreadPool::WorkerLoop(unsigned k)
+{
+	current_queue = k;
+	Task task;
+	for (;;)
+	{
+		for (int spin = 0; spin < IDLE_SPINS; spin++)
+		{
+			while (Take(k, task))
+			{
+				Execute(k, task);
+				spin = 0;
+			}
+			std::this_thread::yield();
+		}
+
+		std::unique_lock<std::mutex> lock(sleep_mutex_);
+		sleeping_++;
+		while (queued_.load() == 0)
+		{
+			wake_.wait(lock);
+		}
+		sleeping_--;
+	}
+}
+
+void ThreadPool::Push(unsigned k, const Task& task)
+{
+	{
+		std::lock_guard<std::mutex> lock(queues_[k].mutex);
+		queues_[k].tasks.push_back(task);
+		queued_++;
+	}
+	if (sleeping_.load() != 0)
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex_);
+		wake_.notify_one();
+	}
+}
+
+bool ThreadPool::Take(unsigned k, Task& task)
+{
+	if (queued_.load(std::memory_order_relaxed) == 0)
+	{
+		return false;
+	}
+	{
+		std::lock_guard<std::mutex> lock(queues_[k].mutex);
+		if (!queues_[k].tasks.empty())
+		{
+			task = queues_[k].tasks.back();
+			queues_[k].tasks.pop_back();
+			queued_--;
+			return true;
+		}
+	}
+	for (unsigned i = 1; i < num_threads_; i++)
+	{
+		Queue& victim = queues_[(k + i) % num_threads_];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty())
+		{
+			task = victim.tasks.front();
+			victim.tasks.pop_front();
+			queued_--;
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::Execute(unsigned k, Task task)
+{
+	Loop* loop = task.loop;
+	while (task.end - task.begin > loop->grain)
+	{
+		size_t mid = task.begin + (task.end - task.begin) / 2;
+		Task upper = {loop, mid, task.end};
+		Push(k, upper);
+		task.end = mid;
+	}
+	if (!loop->failed.load(std::memory_order_relaxed))
+	{
+		try
+		{
+			loop->run(loop->fn, task.begin, task.end);
+		}
+		catch (...)
+		{
+			// the owner reads error after pending reaches 0
+			if (!loop->failed.exchange(true))
+			{
+				loop->error = std::current_exception();
+			}
+		}
+	}
+	// the last touch of the loop, its owner may return right after
+	loop->pending.fetch_sub(task.end - task.begin, std::memory_order_acq_rel);
+}
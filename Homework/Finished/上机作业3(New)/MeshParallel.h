@@ -0,0 +1,202 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <algorithm>
+
+/*!
+*	Work-stealing pool of threads shared by all the parallel loops.
+*
+*	Every worker owns a queue of tasks, a task being a range of a loop. A
+*	thread that runs a task larger than the grain of its loop splits off
+*	the upper half into its own queue and goes on with the lower one, so
+*	it works on neighbouring indices in order. Idle workers steal the
+*	oldest task of another queue, which is the largest. Threads outside
+*	the pool share one more queue. A thread waiting for its loop to end
+*	runs queued tasks meanwhile, so loops may be nested and called from
+*	any thread. The pool starts on first use with one worker less than
+*	there are hardware threads, the caller of a loop being the last one,
+*	and lives until the process exits.
+*/
+class ThreadPool
+{
+public:
+	//! runs the indices [begin, end) of the loop fn points to
+	typedef void (*RangeFn)(const void* fn, size_t begin, size_t end);
+
+private:
+	struct Loop
+	{
+		RangeFn				run;
+		const void*			fn;
+		size_t				grain;			//!< tasks up to this size are not split
+		std::atomic<size_t>	pending;		//!< indices not run yet
+		std::atomic<bool>	failed;			//!< a range threw, the others are skipped
+		std::exception_ptr	error;			//!< the first exception, set by the range that failed
+	};
+	struct Task
+	{
+		Loop*	loop;
+		size_t	begin;
+		size_t	end;
+	};
+	struct Queue
+	{
+		std::mutex			mutex;
+		std::deque<Task>	tasks;
+	};
+
+	unsigned					num_threads_;	//!< workers and the caller
+	std::unique_ptr<Queue[]>	queues_;		//!< [0] for threads outside the pool, [k] of worker k
+	std::vector<std::thread>	workers_;
+	std::atomic<size_t>			queued_;		//!< tasks in all the queues
+	std::atomic<unsigned>		sleeping_;		//!< workers waiting on wake_
+	std::mutex					sleep_mutex_;
+	std::condition_variable		wake_;
+
+	ThreadPool(void);
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+
+public:
+	//! the pool, started by the first call
+	static ThreadPool& Instance(void);
+
+	//! the threads a loop runs on, the calling thread included
+	inline unsigned num_threads(void) const {return num_threads_;}
+
+	//! run(fn, b, e) on ranges covering [begin, end), return when all ran
+	/*!
+	*	the ranges have at least grain indices, or all the range when it is
+	*	smaller; they are also made larger when there would be more than
+	*	about eight per thread. If a range throws, the ranges not started
+	*	yet are skipped and the first exception is rethrown here once no
+	*	thread works on the loop any more.
+	*/
+	void Run(RangeFn run, const void* fn, size_t begin, size_t end, size_t grain);
+
+private:
+	void WorkerLoop(unsigned k);
+	void Push(unsigned k, const Task& task);
+	//! pop the newest task of queue k, else steal the oldest of another
+	bool Take(unsigned k, Task& task);
+	void Execute(unsigned k, Task task);
+};
+
+//! the threads the parallel loops run on
+inline unsigned parallel_threads(void)
+{
+	return ThreadPool::Instance().num_threads();
+}
+
+/*!
+*	Run fn(i) for every i in [begin, end) on the thread pool.
+*
+*	The range is split into tasks of at least grain indices, contiguous
+*	ones, so neighbouring elements stay on the same core; ranges up to
+*	grain run on the calling thread. fn must not write anything another
+*	index reads. An exception thrown by fn leaves some indices not run and
+*	is rethrown to the caller.
+*/
+template <class F>
+void parallel_for(size_t begin, size_t end, const F& fn, size_t grain = 4096)
+{
+	struct Range
+	{
+		static void Run(const void* f, size_t b, size_t e)
+		{
+			const F& body = *static_cast<const F*>(f);
+			for (size_t i = b; i < e; i++)
+			{
+				body(i);
+			}
+		}
+	};
+	if (end <= begin + std::max<size_t>(grain, 1))
+	{
+		Range::Run(&fn, begin, end);
+		return;
+	}
+	ThreadPool::Instance().Run(&Range::Run, &fn, begin, end, grain);
+}
+
+/*!
+*	Run fn(b, e) on consecutive blocks [b, e) of at most block indices that
+*	cover [begin, end), the blocks spread over all the threads of the pool.
+*	Useful for kernels that work on whole arrays at once.
+*/
+template <class F>
+void parallel_for_blocks(size_t begin, size_t end, size_t block, const F& fn)
+{
+	size_t n = end > begin ? end - begin : 0;
+	size_t nblocks = (n + block - 1) / block;
+	parallel_for(0, nblocks, [&](size_t k)
+	{
+		size_t b = begin + k * block;
+		fn(b, std::min(b + block, end));
+	}, 1);
+}
+
+/*!
+*	Run a() and b() on the thread pool, return when both ran.
+*
+*	b is queued for an idle thread to steal while the calling thread runs
+*	a, so a recursive build can split its two halves this way at every
+*	level and the pool spreads the subtrees over the threads.
+*/
+template <class A, class B>
+void parallel_invoke(const A& a, const B& b)
+{
+	parallel_for(0, 2, [&](size_t i)
+	{
+		if (i == 0)
+		{
+			a();
+		}
+		else
+		{
+			b();
+		}
+	}, 1);
+}
+
+/*!
+*	Reduce [begin, end) on the thread pool: body(i, value) folds index i
+*	into value, and combine(a, b) returns a joined with b.
+*
+*	The range is cut into blocks of grain indices whatever the threads,
+*	each block is folded into its own copy of identity and the blocks are
+*	combined from left to right, so a floating point sum comes out the
+*	same on every machine and every run.
+*/
+template <class T, class Body, class Combine>
+T parallel_reduce(size_t begin, size_t end, const T& identity, const Body& body,
+	const Combine& combine, size_t grain = 4096)
+{
+	size_t n = end > begin ? end - begin : 0;
+	grain = std::max<size_t>(grain, 1);
+	std::vector<T> partial((n + grain - 1) / grain, identity);
+	parallel_for(0, partial.size(), [&](size_t k)
+	{
+		size_t b = begin + k * grain;
+		size_t e = std::min(b + grain, end);
+		T& value = partial[k];
+		for (size_t i = b; i < e; i++)
+		{
+			body(i, value);
+		}
+	}, 1);
+
+	T result = identity;
+	for (size_t k = 0; k < partial.size(); k++)
+	{
+		result = combine(result, partial[k]);
+	}
+	return result;
+}
@@ -0,0 +1,123 @@
+#include "Mesh3D.h"
+
+// The standard attributes of the elements. Each is an ordinary property
+// under a fixed name, so add_property and get_property_handle reach them
+// too; the handles are kept in the mesh for the inline accessors.
+
+void Mesh3D::request_vertex_colors(void)
+{
+	if (!vertex_colors_.is_valid())
+	{
+		snapshot_full_ = true;
+		add_property(vertex_colors_, "v:colors", Vec4f(DEFAULT_VERTEX_COLOR[0],
+			DEFAULT_VERTEX_COLOR[1], DEFAULT_VERTEX_COLOR[2], DEFAULT_VERTEX_COLOR[3]));
+	}
+}
+
+void Mesh3D::release_vertex_colors(void)
+{
+	if (vertex_colors_.is_valid())
+	{
+		snapshot_full_ = true;
+		remove_property(vertex_colors_);
+	}
+}
+
+void Mesh3D::request_vertex_texcoords(void)
+{
+	if (!vertex_texcoords_.is_valid())
+	{
+		add_property(vertex_texcoords_, "v:texcoords", Vec3f(0.f, 0.f, 0.f));
+	}
+}
+
+void Mesh3D::release_vertex_texcoords(void)
+{
+	if (vertex_texcoords_.is_valid())
+	{
+		remove_property(vertex_texcoords_);
+	}
+}
+
+void Mesh3D::request_vertex_selection(void)
+{
+	if (!vertex_selected_.is_valid())
+	{
+		add_property(vertex_selected_, "v:selected", static_cast<int>(UNSELECTED));
+	}
+}
+
+void Mesh3D::release_vertex_selection(void)
+{
+	if (vertex_selected_.is_valid())
+	{
+		remove_property(vertex_selected_);
+	}
+}
+
+void Mesh3D::request_half_edge_texcoords(void)
+{
+	if (!half_edge_texcoords_.is_valid())
+	{
+		add_property(half_edge_texcoords_, "h:texcoords", Vec3f(0.f, 0.f, 0.f));
+	}
+}
+
+void Mesh3D::release_half_edge_texcoords(void)
+{
+	if (half_edge_texcoords_.is_valid())
+	{
+		remove_property(half_edge_texcoords_);
+	}
+}
+
+void Mesh3D::request_face_colors(void)
+{
+	if (!face_colors_.is_valid())
+	{
+		add_property(face_colors_, "f:colors", Vec4f(DEFAULT_VERTEX_COLOR[0],
+			DEFAULT_VERTEX_COLOR[1], DEFAULT_VERTEX_COLOR[2], DEFAULT_VERTEX_COLOR[3]));
+	}
+}
+
+void Mesh3D::release_face_colors(void)
+{
+	if (face_colors_.is_valid())
+	{
+		remove_property(face_colors_);
+	}
+}
+
+void Mesh3D::request_face_selection(void)
+{
+	if (!face_selected_.is_valid())
+	{
+		add_property(face_selected_, "f:selected", static_cast<int>(UNSELECTED));
+	}
+}
+
+void Mesh3D::release_face_selection(void)
+{
+	if (face_selected_.is_valid())
+	{
+		remove_property(face_selected_);
+	}
+}
+
+void Mesh3D::ReleaseStandardProperties(void)
+{
+	release_vertex_colors();
+	release_vertex_texcoords();
+	release_vertex_selection();
+	release_half_edge_texcoords();
+	release_face_colors();
+	release_face_selection();
+}
+
+size_t Mesh3D::memory_usage(void)
+{
+	return vertex_arena_.capacity() * sizeof(HE_vert)
+		+ edge_arena_.capacity() * sizeof(HE_edge)
+		+ face_arena_.capacity() * sizeof(HE_face)
+		+ vertex_props_.Bytes() + half_edge_props_.Bytes() + face_props_.Bytes();
+}
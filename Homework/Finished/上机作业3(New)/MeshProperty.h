@@ -0,0 +1,237 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <utility>
+#include "MeshArena.h"
+
+/*!
+*	Attributes of mesh elements kept outside of the elements, after the
+*	property model of OpenMesh.
+*
+*	Every property is an array with one value per vertex, half-edge or face,
+*	indexed by the id of the element. The mesh keeps one PropertyContainer
+*	per kind of element and grows all of its arrays with the elements, so a
+*	property costs memory only once it has been added, and a loop over one
+*	attribute streams through one dense array. A property is addressed by
+*	a typed handle returned when it is added, or found again by its name.
+*/
+
+//! one array of values, see PropertyArray
+class BaseProperty
+{
+	std::string	name_;
+
+public:
+	explicit BaseProperty(const std::string& name) : name_(name) {}
+	virtual ~BaseProperty(void) {}
+
+	inline const std::string& name(void) const {return name_;}
+
+	virtual size_t size(void) const = 0;
+	//! new elements get the default value of the property
+	virtual void resize(size_t n) = 0;
+	virtual void reserve(size_t n) = 0;
+	//! the value of element i becomes the one of element old_of_new[i]
+	virtual void permute(const HE_index* old_of_new) = 0;
+	//! bytes taken by the values
+	virtual size_t bytes(void) const = 0;
+};
+
+//! the values of a property of type T, not bool as std::vector<bool> has no T&
+template <class T>
+class PropertyArray : public BaseProperty
+{
+	std::vector<T>	data_;
+	T				default_;
+
+public:
+	PropertyArray(const std::string& name, const T& value)
+		: BaseProperty(name), default_(value)
+	{}
+
+	inline T& operator[](size_t i) {return data_[i];}
+	inline const T& operator[](size_t i) const {return data_[i];}
+	inline T* data(void) {return data_.data();}
+	inline const T* data(void) const {return data_.data();}
+	inline const T& default_value(void) const {return default_;}
+	//! set every element to value
+	void fill(const T& value) {data_.assign(data_.size(), value);}
+
+	size_t size(void) const {return data_.size();}
+	void resize(size_t n) {data_.resize(n, default_);}
+	void reserve(size_t n) {data_.reserve(n);}
+	void permute(const HE_index* old_of_new)
+	{
+		std::vector<T> permuted(data_.size());
+		for (size_t i = 0; i < data_.size(); i++)
+		{
+			permuted[i] = data_[old_of_new[i]];
+		}
+		data_.swap(permuted);
+	}
+	size_t bytes(void) const {return data_.capacity() * sizeof(T);}
+};
+
+//! typed index of a property in its container, invalid when -1
+template <class T>
+class PropertyHandle
+{
+	int	idx_;
+
+public:
+	explicit PropertyHandle(int idx = -1) : idx_(idx) {}
+
+	inline int idx(void) const {return idx_;}
+	inline bool is_valid(void) const {return idx_ >= 0;}
+	inline void reset(void) {idx_ = -1;}
+};
+
+//! handle of a vertex property
+template <class T>
+class VPropHandleT : public PropertyHandle<T>
+{
+public:
+	explicit VPropHandleT(int idx = -1) : PropertyHandle<T>(idx) {}
+};
+
+//! handle of a half-edge property
+template <class T>
+class HPropHandleT : public PropertyHandle<T>
+{
+public:
+	explicit HPropHandleT(int idx = -1) : PropertyHandle<T>(idx) {}
+};
+
+//! handle of a face property
+template <class T>
+class FPropHandleT : public PropertyHandle<T>
+{
+public:
+	explicit FPropHandleT(int idx = -1) : PropertyHandle<T>(idx) {}
+};
+
+/*!
+*	The properties of one kind of element, all of them as long as there
+*	are elements. Removing a property frees its slot for the next one, the
+*	handles of the others stay valid.
+*/
+class PropertyContainer
+{
+	std::vector<BaseProperty*>	properties_;	//!< NULL where one was removed
+	size_t						size_;			//!< number of elements
+
+	PropertyContainer(const PropertyContainer&);
+	PropertyContainer& operator=(const PropertyContainer&);
+
+public:
+	PropertyContainer(void) : size_(0) {}
+	~PropertyContainer(void)
+	{
+		for (size_t i = 0; i < properties_.size(); i++)
+		{
+			delete properties_[i];
+		}
+	}
+
+	//! add a property named name, every element set to value
+	template <class T>
+	int Add(const std::string& name, const T& value)
+	{
+		PropertyArray<T>* p = new PropertyArray<T>(name, value);
+		p->resize(size_);
+		for (size_t i = 0; i < properties_.size(); i++)
+		{
+			if (properties_[i] == NULL)
+			{
+				properties_[i] = p;
+				return static_cast<int>(i);
+			}
+		}
+		properties_.push_back(p);
+		return static_cast<int>(properties_.size()) - 1;
+	}
+
+	//! index of the property of that name and type, -1 if there is none
+	template <class T>
+	int Find(const std::string& name) const
+	{
+		for (size_t i = 0; i < properties_.size(); i++)
+		{
+			if (properties_[i] != NULL && properties_[i]->name() == name
+				&& dynamic_cast<PropertyArray<T>*>(properties_[i]) != NULL)
+			{
+				return static_cast<int>(i);
+			}
+		}
+		return -1;
+	}
+
+	//! the property at idx, which must be of type T
+	template <class T>
+	inline PropertyArray<T>& Get(int idx) {return *static_cast<PropertyArray<T>*>(properties_[idx]);}
+
+	void Remove(int idx)
+	{
+		if (idx >= 0 && idx < static_cast<int>(properties_.size()))
+		{
+			delete properties_[idx];
+			properties_[idx] = NULL;
+		}
+	}
+
+	inline size_t size(void) const {return size_;}
+
+	void Resize(size_t n)
+	{
+		size_ = n;
+		for (size_t i = 0; i < properties_.size(); i++)
+		{
+			if (properties_[i] != NULL)
+			{
+				properties_[i]->resize(n);
+			}
+		}
+	}
+
+	void Reserve(size_t n)
+	{
+		for (size_t i = 0; i < properties_.size(); i++)
+		{
+			if (properties_[i] != NULL)
+			{
+				properties_[i]->reserve(n);
+			}
+		}
+	}
+
+	//! reorder the elements, see BaseProperty::permute
+	void Permute(const HE_index* old_of_new)
+	{
+		for (size_t i = 0; i < properties_.size(); i++)
+		{
+			if (properties_[i] != NULL)
+			{
+				properties_[i]->permute(old_of_new);
+			}
+		}
+	}
+
+	void Swap(PropertyContainer& other)
+	{
+		properties_.swap(other.properties_);
+		std::swap(size_, other.size_);
+	}
+
+	//! bytes taken by the values of all the properties
+	size_t Bytes(void) const
+	{
+		size_t bytes = 0;
+		for (size_t i = 0; i < properties_.size(); i++)
+		{
+			bytes += properties_[i] != NULL ? properties_[i]->bytes() : 0;
+		}
+		return bytes;
+	}
+};
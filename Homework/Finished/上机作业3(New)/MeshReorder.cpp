@@ -0,0 +1,285 @@
+#include "Mesh3D.h"
+
+#include <algorithm>
+#include <utility>
+
+// Locality reordering.
+//
+// The vertex positions are quantised to 21 bits per axis inside the cube
+// around the bounding box and turned into a 63-bit key along a Morton or
+// Hilbert curve. Faces are then ordered by the smallest new id of their
+// corners, which also gives a GPU vertex cache a good chance to still hold
+// the earlier corners. The mesh is rebuilt from the permuted index arrays and
+// the attributes are copied over from a snapshot of the old elements.
+
+namespace
+{
+	const int CURVE_BITS = 21;
+
+	//! spread the low 21 bits of v so that two zero bits follow every bit
+	unsigned long long SpreadBits(unsigned long long v)
+	{
+		v &= 0x1fffffull;
+		v = (v | v << 32) & 0x001f00000000ffffull;
+		v = (v | v << 16) & 0x001f0000ff0000ffull;
+		v = (v | v << 8) & 0x100f00f00f00f00full;
+		v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+		v = (v | v << 2) & 0x1249249249249249ull;
+		return v;
+	}
+
+	unsigned long long MortonKey(unsigned int x, unsigned int y, unsigned int z)
+	{
+		return SpreadBits(x) << 2 | SpreadBits(y) << 1 | SpreadBits(z);
+	}
+
+	//! Hilbert key by Skilling's transform ("Programming the Hilbert curve", 2004)
+	unsigned long long HilbertKey(unsigned int x, unsigned int y, unsigned int z)
+	{
+		unsigned int X[3] = {x, y, z};
+		const unsigned int M = 1u << (CURVE_BITS - 1);
+
+		// inverse undo
+		for (unsigned int Q = M; Q > 1; Q >>= 1)
+		{
+			unsigned int P = Q - 1;
+			for (int i = 0; i < 3; i++)
+			{
+				if (X[i] & Q)
+				{
+					X[0] ^= P;
+				}
+				else
+				{
+					unsigned int t = (X[0] ^ X[i]) & P;
+					X[0] ^= t;
+					X[i] ^= t;
+				}
+			}
+		}
+
+		// gray encode
+		X[1] ^= X[0];
+		X[2] ^= X[1];
+		unsigned int t = 0;
+		for (unsigned int Q = M; Q > 1; Q >>= 1)
+		{
+			if (X[2] & Q)
+			{
+				t ^= Q - 1;
+			}
+		}
+		for (int i = 0; i < 3; i++)
+		{
+			X[i] ^= t;
+		}
+
+		// the transposed form interleaves into the key, X[0] first
+		return MortonKey(X[0], X[1], X[2]);
+	}
+}
+
+void Mesh3D::Reorder(SpaceFillingCurve curve, MeshPermutation* perm)
+{
+	if (!isValid())
+	{
+		return;
+	}
+	size_t nverts = static_cast<size_t>(num_of_vertex_list());
+	size_t nedges = static_cast<size_t>(num_of_half_edges_list());
+	size_t nfaces = static_cast<size_t>(num_of_face_list());
+
+	// vertices along the curve
+	float lo[3] = {vertex_arena_[0].position_[0], vertex_arena_[0].position_[1], vertex_arena_[0].position_[2]};
+	float hi[3] = {lo[0], lo[1], lo[2]};
+	for (size_t i = 1; i < nverts; i++)
+	{
+		const Vec3f& p = vertex_arena_[static_cast<HE_index>(i)].position_;
+		for (int k = 0; k < 3; k++)
+		{
+			lo[k] = std::min(lo[k], p[k]);
+			hi[k] = std::max(hi[k], p[k]);
+		}
+	}
+	// one scale for all the axes: stretching a flat axis to the full range
+	// would let its noise decide the order
+	float extent = std::max(hi[0] - lo[0], std::max(hi[1] - lo[1], hi[2] - lo[2]));
+	float scale = extent > 0.f ? ((1u << CURVE_BITS) - 1) / extent : 0.f;
+
+	std::vector<std::pair<unsigned long long, HE_index> > vkeys(nverts);
+	parallel_for(0, nverts, [&](size_t i)
+	{
+		const Vec3f& p = vertex_arena_[static_cast<HE_index>(i)].position_;
+		unsigned int q[3];
+		for (int k = 0; k < 3; k++)
+		{
+			q[k] = static_cast<unsigned int>((p[k] - lo[k]) * scale);
+			q[k] = std::min(q[k], (1u << CURVE_BITS) - 1);
+		}
+		vkeys[i].first = curve == CURVE_HILBERT ? HilbertKey(q[0], q[1], q[2]) : MortonKey(q[0], q[1], q[2]);
+		vkeys[i].second = static_cast<HE_index>(i);
+	});
+	std::sort(vkeys.begin(), vkeys.end());
+
+	std::vector<HE_index> vert_new(nverts), vert_old(nverts);
+	for (size_t i = 0; i < nverts; i++)
+	{
+		vert_old[i] = vkeys[i].second;
+		vert_new[vkeys[i].second] = static_cast<HE_index>(i);
+	}
+
+	// faces by their first corner in the new order
+	std::vector<unsigned long long> fkeys(nfaces);
+	parallel_for(0, nfaces, [&](size_t i)
+	{
+		HE_edge* edge = face_arena_[static_cast<HE_index>(i)].pedge_;
+		HE_index first = HE_INVALID_INDEX;
+		do
+		{
+			first = std::min(first, vert_new[edge->pvert_->id_]);
+			edge = edge->pnext_;
+		} while (edge != face_arena_[static_cast<HE_index>(i)].pedge_);
+		fkeys[i] = static_cast<unsigned long long>(first) << 32 | i;
+	});
+	std::sort(fkeys.begin(), fkeys.end());
+
+	std::vector<HE_index> face_new(nfaces), face_old(nfaces);
+	for (size_t i = 0; i < nfaces; i++)
+	{
+		face_old[i] = static_cast<HE_index>(fkeys[i] & 0xffffffffu);
+		face_new[face_old[i]] = static_cast<HE_index>(i);
+	}
+
+	// the half-edges of each face in a row, starting at its pedge_, then the
+	// boundary half-edges in the order of their pairs
+	std::vector<HE_index> edge_new(nedges, HE_INVALID_INDEX), edge_old;
+	edge_old.reserve(nedges);
+	for (size_t f = 0; f < nfaces; f++)
+	{
+		HE_face& face = face_arena_[face_old[f]];
+		HE_edge* edge = face.pedge_;
+		do
+		{
+			edge_new[edge->id_] = static_cast<HE_index>(edge_old.size());
+			edge_old.push_back(edge->id_);
+			edge = edge->pnext_;
+		} while (edge != face.pedge_);
+	}
+	size_t ninner = edge_old.size();
+	for (size_t i = 0; i < ninner; i++)
+	{
+		HE_edge& pair = *edge_arena_[edge_old[i]].ppair_;
+		if (pair.pface_ == NULL)
+		{
+			edge_new[pair.id_] = static_cast<HE_index>(edge_old.size());
+			edge_old.push_back(pair.id_);
+		}
+	}
+	if (edge_old.size() != nedges)
+	{
+		return;		// a half-edge reached from no face, leave the mesh as it is
+	}
+
+	// permuted connectivity
+	std::vector<HE_index> he_vert(nedges), he_pair(nedges), he_face(nedges), he_next(nedges), he_prev(nedges);
+	std::vector<HE_index> vert_edge(nverts), face_edge(nfaces);
+	for (size_t i = 0; i < nedges; i++)
+	{
+		HE_edge& e = edge_arena_[edge_old[i]];
+		he_vert[i] = vert_new[e.pvert_->id_];
+		he_pair[i] = edge_new[e.ppair_->id_];
+		he_face[i] = e.pface_ ? face_new[e.pface_->id_] : HE_INVALID_INDEX;
+		he_next[i] = e.pnext_ ? edge_new[e.pnext_->id_] : HE_INVALID_INDEX;
+		he_prev[i] = e.pprev_ ? edge_new[e.pprev_->id_] : HE_INVALID_INDEX;
+	}
+	for (size_t i = 0; i < nverts; i++)
+	{
+		HE_edge* e = vertex_arena_[vert_old[i]].pedge_;
+		vert_edge[i] = e ? edge_new[e->id_] : HE_INVALID_INDEX;
+	}
+	for (size_t i = 0; i < nfaces; i++)
+	{
+		face_edge[i] = edge_new[face_arena_[face_old[i]].pedge_->id_];
+	}
+
+	// snapshot what the rebuild resets
+	std::vector<HE_vert> old_verts;
+	std::vector<HE_edge> old_edges;
+	std::vector<HE_face> old_faces;
+	old_verts.reserve(nverts);
+	old_edges.reserve(nedges);
+	old_faces.reserve(nfaces);
+	for (size_t i = 0; i < nverts; i++)
+	{
+		old_verts.push_back(vertex_arena_[static_cast<HE_index>(i)]);
+	}
+	for (size_t i = 0; i < nedges; i++)
+	{
+		old_edges.push_back(edge_arena_[static_cast<HE_index>(i)]);
+	}
+	for (size_t i = 0; i < nfaces; i++)
+	{
+		old_faces.push_back(face_arena_[static_cast<HE_index>(i)]);
+	}
+	float box[6] = {xmin_, xmax_, ymin_, ymax_, zmin_, zmax_};
+	float average_edge_length = average_edge_length_;
+	double edge_length_sum = edge_length_sum_;
+	std::vector<float> face_area(face_area_.size());
+	for (size_t i = 0; i < face_area_.size(); i++)
+	{
+		face_area[face_new[i]] = face_area_[i];
+	}
+
+	// the properties sit out the rebuild, which would empty them
+	PropertyContainer vertex_props, half_edge_props, face_props;
+	vertex_props.Swap(vertex_props_);
+	half_edge_props.Swap(half_edge_props_);
+	face_props.Swap(face_props_);
+	BuildFromIndices(static_cast<int>(nverts), static_cast<int>(nedges), static_cast<int>(nfaces),
+		he_vert.data(), he_pair.data(), he_face.data(), he_next.data(), he_prev.data(),
+		vert_edge.data(), face_edge.data());
+	vertex_props_.Swap(vertex_props);
+	half_edge_props_.Swap(half_edge_props);
+	face_props_.Swap(face_props);
+	vertex_props_.Permute(vert_old.data());
+	half_edge_props_.Permute(edge_old.data());
+	face_props_.Permute(face_old.data());
+
+	parallel_for(0, nverts, [&](size_t i)
+	{
+		const HE_vert& from = old_verts[vert_old[i]];
+		HE_vert& to = vertex_arena_[static_cast<HE_index>(i)];
+		to.position_ = from.position_;
+		to.normal_ = from.normal_;
+		to.boundary_flag_ = from.boundary_flag_;
+	});
+	parallel_for(0, nedges, [&](size_t i)
+	{
+		const HE_edge& from = old_edges[edge_old[i]];
+		HE_edge& to = edge_arena_[static_cast<HE_index>(i)];
+		to.boundary_flag_ = from.boundary_flag_;
+	});
+	parallel_for(0, nfaces, [&](size_t i)
+	{
+		const HE_face& from = old_faces[face_old[i]];
+		HE_face& to = face_arena_[static_cast<HE_index>(i)];
+		to.normal_ = from.normal_;
+		to.boundary_flag_ = from.boundary_flag_;
+	});
+
+	xmin_ = box[0]; xmax_ = box[1];
+	ymin_ = box[2]; ymax_ = box[3];
+	zmin_ = box[4]; zmax_ = box[5];
+	average_edge_length_ = average_edge_length;
+	edge_length_sum_ = edge_length_sum;
+	face_area_.swap(face_area);
+	ComputeNumComponents();
+	SetNeighbors();
+
+	if (perm != NULL)
+	{
+		perm->vertex.swap(vert_new);
+		perm->face.swap(face_new);
+		perm->half_edge.swap(edge_new);
+	}
+}
@@ -0,0 +1,435 @@
+#include "MeshSimd.h"
+
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MESH_SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC accepts every intrinsic in any function, gcc and clang need the
+// instruction set enabled per function so the rest of the file stays generic
+#if defined(MESH_SIMD_X86) && !defined(_MSC_VER)
+#define MESH_TARGET_SSE		__attribute__((target("sse2")))
+#define MESH_TARGET_AVX2	__attribute__((target("avx2")))
+#else
+#define MESH_TARGET_SSE
+#define MESH_TARGET_AVX2
+#endif
+
+
+//////////////////////////////////////////////////////////////////////////
+// scalar kernels
+
+namespace
+{
+
+void BoundingBoxScalar(const float* x, const float* y, const float* z, size_t n, float box[6])
+{
+	const float* p[3] = {x, y, z};
+	for (int k = 0; k < 3; k++)
+	{
+		float lo = n > 0 ? p[k][0] : 0.f;
+		float hi = lo;
+		for (size_t i = 1; i < n; i++)
+		{
+			float v = p[k][i];
+			lo = v < lo ? v : lo;
+			hi = v > hi ? v : hi;
+		}
+		box[2 * k] = lo;
+		box[2 * k + 1] = hi;
+	}
+}
+
+void TransformScalar(float* x, float* y, float* z, size_t n, const float center[3], float scale)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		x[i] = (x[i] - center[0]) * scale;
+		y[i] = (y[i] - center[1]) * scale;
+		z[i] = (z[i] - center[2]) * scale;
+	}
+}
+
+void TriangleNormalsScalar(const float* x, const float* y, const float* z,
+	const int* i0, const int* i1, const int* i2, size_t n,
+	float* nx, float* ny, float* nz, float* area)
+{
+	for (size_t t = 0; t < n; t++)
+	{
+		int a = i0[t], b = i1[t], c = i2[t];
+		float ux = x[b] - x[a], uy = y[b] - y[a], uz = z[b] - z[a];
+		float vx = x[c] - x[a], vy = y[c] - y[a], vz = z[c] - z[a];
+		float cx = uy * vz - uz * vy;
+		float cy = uz * vx - ux * vz;
+		float cz = ux * vy - uy * vx;
+		float length = std::sqrt(cx * cx + cy * cy + cz * cz);
+		float inv = length > 0.f ? 1.f / length : 0.f;
+		nx[t] = cx * inv;
+		ny[t] = cy * inv;
+		nz[t] = cz * inv;
+		if (area != NULL)
+		{
+			area[t] = 0.5f * length;
+		}
+	}
+}
+
+void NormalizeScalar(float* x, float* y, float* z, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		float length = std::sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+		float inv = length > 0.f ? 1.f / length : 0.f;
+		x[i] *= inv;
+		y[i] *= inv;
+		z[i] *= inv;
+	}
+}
+
+} // namespace
+
+#ifdef MESH_SIMD_X86
+
+//////////////////////////////////////////////////////////////////////////
+// SSE kernels, 4 lanes
+
+namespace
+{
+
+MESH_TARGET_SSE
+void BoundingBoxSSE(const float* x, const float* y, const float* z, size_t n, float box[6])
+{
+	if (n < 4)
+	{
+		BoundingBoxScalar(x, y, z, n, box);
+		return;
+	}
+	const float* p[3] = {x, y, z};
+	for (int k = 0; k < 3; k++)
+	{
+		__m128 lo = _mm_loadu_ps(p[k]);
+		__m128 hi = lo;
+		size_t i = 4;
+		for (; i + 4 <= n; i += 4)
+		{
+			__m128 v = _mm_loadu_ps(p[k] + i);
+			lo = _mm_min_ps(lo, v);
+			hi = _mm_max_ps(hi, v);
+		}
+		float l[4], h[4];
+		_mm_storeu_ps(l, lo);
+		_mm_storeu_ps(h, hi);
+		for (int j = 1; j < 4; j++)
+		{
+			l[0] = l[j] < l[0] ? l[j] : l[0];
+			h[0] = h[j] > h[0] ? h[j] : h[0];
+		}
+		for (; i < n; i++)
+		{
+			l[0] = p[k][i] < l[0] ? p[k][i] : l[0];
+			h[0] = p[k][i] > h[0] ? p[k][i] : h[0];
+		}
+		box[2 * k] = l[0];
+		box[2 * k + 1] = h[0];
+	}
+}
+
+MESH_TARGET_SSE
+void TransformSSE(float* x, float* y, float* z, size_t n, const float center[3], float scale)
+{
+	float* p[3] = {x, y, z};
+	__m128 s = _mm_set1_ps(scale);
+	for (int k = 0; k < 3; k++)
+	{
+		__m128 c = _mm_set1_ps(center[k]);
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			_mm_storeu_ps(p[k] + i, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p[k] + i), c), s));
+		}
+		for (; i < n; i++)
+		{
+			p[k][i] = (p[k][i] - center[k]) * scale;
+		}
+	}
+}
+
+//! 1 / length, or 0 where the length is 0
+MESH_TARGET_SSE
+inline __m128 SafeInverseSSE(__m128 length)
+{
+	__m128 nonzero = _mm_cmpgt_ps(length, _mm_setzero_ps());
+	return _mm_and_ps(nonzero, _mm_div_ps(_mm_set1_ps(1.f), length));
+}
+
+MESH_TARGET_SSE
+void TriangleNormalsSSE(const float* x, const float* y, const float* z,
+	const int* i0, const int* i1, const int* i2, size_t n,
+	float* nx, float* ny, float* nz, float* area)
+{
+	size_t t = 0;
+	for (; t + 4 <= n; t += 4)
+	{
+		// SSE has no gather, the corners are loaded one by one
+		const int* a = i0 + t;
+		const int* b = i1 + t;
+		const int* c = i2 + t;
+		__m128 ax = _mm_setr_ps(x[a[0]], x[a[1]], x[a[2]], x[a[3]]);
+		__m128 ay = _mm_setr_ps(y[a[0]], y[a[1]], y[a[2]], y[a[3]]);
+		__m128 az = _mm_setr_ps(z[a[0]], z[a[1]], z[a[2]], z[a[3]]);
+		__m128 ux = _mm_sub_ps(_mm_setr_ps(x[b[0]], x[b[1]], x[b[2]], x[b[3]]), ax);
+		__m128 uy = _mm_sub_ps(_mm_setr_ps(y[b[0]], y[b[1]], y[b[2]], y[b[3]]), ay);
+		__m128 uz = _mm_sub_ps(_mm_setr_ps(z[b[0]], z[b[1]], z[b[2]], z[b[3]]), az);
+		__m128 vx = _mm_sub_ps(_mm_setr_ps(x[c[0]], x[c[1]], x[c[2]], x[c[3]]), ax);
+		__m128 vy = _mm_sub_ps(_mm_setr_ps(y[c[0]], y[c[1]], y[c[2]], y[c[3]]), ay);
+		__m128 vz = _mm_sub_ps(_mm_setr_ps(z[c[0]], z[c[1]], z[c[2]], z[c[3]]), az);
+
+		__m128 cx = _mm_sub_ps(_mm_mul_ps(uy, vz), _mm_mul_ps(uz, vy));
+		__m128 cy = _mm_sub_ps(_mm_mul_ps(uz, vx), _mm_mul_ps(ux, vz));
+		__m128 cz = _mm_sub_ps(_mm_mul_ps(ux, vy), _mm_mul_ps(uy, vx));
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, cx), _mm_mul_ps(cy, cy)), _mm_mul_ps(cz, cz)));
+		__m128 inv = SafeInverseSSE(length);
+		_mm_storeu_ps(nx + t, _mm_mul_ps(cx, inv));
+		_mm_storeu_ps(ny + t, _mm_mul_ps(cy, inv));
+		_mm_storeu_ps(nz + t, _mm_mul_ps(cz, inv));
+		if (area != NULL)
+		{
+			_mm_storeu_ps(area + t, _mm_mul_ps(length, _mm_set1_ps(0.5f)));
+		}
+	}
+	TriangleNormalsScalar(x, y, z, i0 + t, i1 + t, i2 + t, n - t,
+		nx + t, ny + t, nz + t, area != NULL ? area + t : NULL);
+}
+
+MESH_TARGET_SSE
+void NormalizeSSE(float* x, float* y, float* z, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 vx = _mm_loadu_ps(x + i);
+		__m128 vy = _mm_loadu_ps(y + i);
+		__m128 vz = _mm_loadu_ps(z + i);
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz)));
+		__m128 inv = SafeInverseSSE(length);
+		_mm_storeu_ps(x + i, _mm_mul_ps(vx, inv));
+		_mm_storeu_ps(y + i, _mm_mul_ps(vy, inv));
+		_mm_storeu_ps(z + i, _mm_mul_ps(vz, inv));
+	}
+	NormalizeScalar(x + i, y + i, z + i, n - i);
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+// AVX2 kernels, 8 lanes
+
+namespace
+{
+
+MESH_TARGET_AVX2
+void BoundingBoxAVX2(const float* x, const float* y, const float* z, size_t n, float box[6])
+{
+	if (n < 8)
+	{
+		BoundingBoxScalar(x, y, z, n, box);
+		return;
+	}
+	const float* p[3] = {x, y, z};
+	for (int k = 0; k < 3; k++)
+	{
+		__m256 lo = _mm256_loadu_ps(p[k]);
+		__m256 hi = lo;
+		size_t i = 8;
+		for (; i + 8 <= n; i += 8)
+		{
+			__m256 v = _mm256_loadu_ps(p[k] + i);
+			lo = _mm256_min_ps(lo, v);
+			hi = _mm256_max_ps(hi, v);
+		}
+		float l[8], h[8];
+		_mm256_storeu_ps(l, lo);
+		_mm256_storeu_ps(h, hi);
+		for (int j = 1; j < 8; j++)
+		{
+			l[0] = l[j] < l[0] ? l[j] : l[0];
+			h[0] = h[j] > h[0] ? h[j] : h[0];
+		}
+		for (; i < n; i++)
+		{
+			l[0] = p[k][i] < l[0] ? p[k][i] : l[0];
+			h[0] = p[k][i] > h[0] ? p[k][i] : h[0];
+		}
+		box[2 * k] = l[0];
+		box[2 * k + 1] = h[0];
+	}
+}
+
+MESH_TARGET_AVX2
+void TransformAVX2(float* x, float* y, float* z, size_t n, const float center[3], float scale)
+{
+	float* p[3] = {x, y, z};
+	__m256 s = _mm256_set1_ps(scale);
+	for (int k = 0; k < 3; k++)
+	{
+		__m256 c = _mm256_set1_ps(center[k]);
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8)
+		{
+			_mm256_storeu_ps(p[k] + i, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(p[k] + i), c), s));
+		}
+		for (; i < n; i++)
+		{
+			p[k][i] = (p[k][i] - center[k]) * scale;
+		}
+	}
+}
+
+//! 1 / length, or 0 where the length is 0
+MESH_TARGET_AVX2
+inline __m256 SafeInverseAVX2(__m256 length)
+{
+	__m256 nonzero = _mm256_cmp_ps(length, _mm256_setzero_ps(), _CMP_GT_OQ);
+	return _mm256_and_ps(nonzero, _mm256_div_ps(_mm256_set1_ps(1.f), length));
+}
+
+MESH_TARGET_AVX2
+void TriangleNormalsAVX2(const float* x, const float* y, const float* z,
+	const int* i0, const int* i1, const int* i2, size_t n,
+	float* nx, float* ny, float* nz, float* area)
+{
+	size_t t = 0;
+	for (; t + 8 <= n; t += 8)
+	{
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(i0 + t));
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(i1 + t));
+		__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(i2 + t));
+		__m256 ax = _mm256_i32gather_ps(x, a, 4);
+		__m256 ay = _mm256_i32gather_ps(y, a, 4);
+		__m256 az = _mm256_i32gather_ps(z, a, 4);
+		__m256 ux = _mm256_sub_ps(_mm256_i32gather_ps(x, b, 4), ax);
+		__m256 uy = _mm256_sub_ps(_mm256_i32gather_ps(y, b, 4), ay);
+		__m256 uz = _mm256_sub_ps(_mm256_i32gather_ps(z, b, 4), az);
+		__m256 vx = _mm256_sub_ps(_mm256_i32gather_ps(x, c, 4), ax);
+		__m256 vy = _mm256_sub_ps(_mm256_i32gather_ps(y, c, 4), ay);
+		__m256 vz = _mm256_sub_ps(_mm256_i32gather_ps(z, c, 4), az);
+
+		// no fma here, the results must match the scalar kernel bit for bit
+		__m256 cx = _mm256_sub_ps(_mm256_mul_ps(uy, vz), _mm256_mul_ps(uz, vy));
+		__m256 cy = _mm256_sub_ps(_mm256_mul_ps(uz, vx), _mm256_mul_ps(ux, vz));
+		__m256 cz = _mm256_sub_ps(_mm256_mul_ps(ux, vy), _mm256_mul_ps(uy, vx));
+		__m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, cx), _mm256_mul_ps(cy, cy)), _mm256_mul_ps(cz, cz)));
+		__m256 inv = SafeInverseAVX2(length);
+		_mm256_storeu_ps(nx + t, _mm256_mul_ps(cx, inv));
+		_mm256_storeu_ps(ny + t, _mm256_mul_ps(cy, inv));
+		_mm256_storeu_ps(nz + t, _mm256_mul_ps(cz, inv));
+		if (area != NULL)
+		{
+			_mm256_storeu_ps(area + t, _mm256_mul_ps(length, _mm256_set1_ps(0.5f)));
+		}
+	}
+	TriangleNormalsScalar(x, y, z, i0 + t, i1 + t, i2 + t, n - t,
+		nx + t, ny + t, nz + t, area != NULL ? area + t : NULL);
+}
+
+MESH_TARGET_AVX2
+void NormalizeAVX2(float* x, float* y, float* z, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 vx = _mm256_loadu_ps(x + i);
+		__m256 vy = _mm256_loadu_ps(y + i);
+		__m256 vz = _mm256_loadu_ps(z + i);
+		__m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)), _mm256_mul_ps(vz, vz)));
+		__m256 inv = SafeInverseAVX2(length);
+		_mm256_storeu_ps(x + i, _mm256_mul_ps(vx, inv));
+		_mm256_storeu_ps(y + i, _mm256_mul_ps(vy, inv));
+		_mm256_storeu_ps(z + i, _mm256_mul_ps(vz, inv));
+	}
+	NormalizeScalar(x + i, y + i, z + i, n - i);
+}
+
+//! whether the CPU and the OS support AVX2
+bool HasAVX2(void)
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+	{
+		return false;
+	}
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)	// the OS must save the ymm registers
+	{
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+//! whether the CPU supports SSE2
+bool HasSSE2(void)
+{
+#if defined(_M_X64) || defined(__x86_64__)
+	return true;	// part of the x86-64 baseline
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[3] & (1 << 26)) != 0;
+#else
+	return __builtin_cpu_supports("sse2") != 0;
+#endif
+}
+
+} // namespace
+
+#endif // MESH_SIMD_X86
+
+
+//////////////////////////////////////////////////////////////////////////
+// dispatch
+
+const MeshKernels& GetScalarMeshKernels(void)
+{
+	static const MeshKernels kernels =
+	{
+		BoundingBoxScalar, TransformScalar, TriangleNormalsScalar, NormalizeScalar, "scalar"
+	};
+	return kernels;
+}
+
+static MeshKernels SelectMeshKernels(void)
+{
+#ifdef MESH_SIMD_X86
+	if (HasAVX2())
+	{
+		MeshKernels kernels = {BoundingBoxAVX2, TransformAVX2, TriangleNormalsAVX2, NormalizeAVX2, "avx2"};
+		return kernels;
+	}
+	if (HasSSE2())
+	{
+		MeshKernels kernels = {BoundingBoxSSE, TransformSSE, TriangleNormalsSSE, NormalizeSSE, "sse"};
+		return kernels;
+	}
+#endif
+	return GetScalarMeshKernels();
+}
+
+const MeshKernels& GetMeshKernels(void)
+{
+	// thread-safe one-time initialisation
+	static const MeshKernels kernels = SelectMeshKernels();
+	return kernels;
+}
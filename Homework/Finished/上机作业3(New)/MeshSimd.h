@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+
+/*!
+*	Vectorised kernels over structure-of-arrays geometry.
+*
+*	Every kernel exists as a scalar, an SSE and an AVX2 version. The table
+*	returned by GetMeshKernels() is filled once with the widest version the
+*	CPU supports, so the callers never branch on the instruction set.
+*	The x, y and z components of points and normals are separate arrays.
+*/
+struct MeshKernels
+{
+	//! box = {xmin, xmax, ymin, ymax, zmin, zmax} of the n points
+	void (*bounding_box)(const float* x, const float* y, const float* z, size_t n, float box[6]);
+
+	//! p = (p - center) * scale for the n points
+	void (*transform)(float* x, float* y, float* z, size_t n, const float center[3], float scale);
+
+	//! unit normals of n triangles given by their corner indices i0 i1 i2
+	/*!
+	*	degenerate triangles get a zero normal. area may be NULL, otherwise
+	*	it receives the area of every triangle.
+	*/
+	void (*triangle_normals)(const float* x, const float* y, const float* z,
+		const int* i0, const int* i1, const int* i2, size_t n,
+		float* nx, float* ny, float* nz, float* area);
+
+	//! scale the n vectors to unit length, zero vectors stay zero
+	void (*normalize)(float* x, float* y, float* z, size_t n);
+
+	//! name of the selected instruction set: "avx2", "sse" or "scalar"
+	const char* name;
+};
+
+//! the kernels for the running CPU, detected on the first call
+const MeshKernels& GetMeshKernels(void);
+
+//! the portable kernels, used as the reference and on non-x86 targets
+const MeshKernels& GetScalarMeshKernels(void);
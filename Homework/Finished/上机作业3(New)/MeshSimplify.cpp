@@ -0,0 +1,695 @@
+#include "MeshSimplify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <unordered_set>
+
+// Edge collapses on an indexed copy.
+//
+// The collapses work on flat arrays taken from the half-edge mesh: the
+// triangles, the positions, and for every vertex the list of its triangles.
+// Collapsing (u, v) moves u to the target, hands the triangles of v over to
+// u and kills the two triangles of the edge, touching nothing but these
+// lists. The levels are written back as half-edge meshes.
+//
+// Every edge of the triangles is an entry of an indexed binary heap that
+// knows where each edge sits, so a collapse updates the costs of the edges
+// of the surviving vertex in place instead of pushing them again; the heap
+// never holds stale entries and only shrinks. The edges of v are handed
+// over to u like its triangles, an edge to a common neighbour of u and v
+// merging into the one u has. An edge that can not collapse leaves the
+// heap and comes back when one of its ends changes. The target point is
+// computed again for the few edges that get collapsed.
+
+namespace
+{
+	inline unsigned long long EdgeKey(unsigned int a, unsigned int b)
+	{
+		return a < b ? static_cast<unsigned long long>(a) << 32 | b : static_cast<unsigned long long>(b) << 32 | a;
+	}
+
+	const unsigned int NOT_QUEUED = ~0u;
+
+	struct Edge
+	{
+		unsigned int	u, v;		//!< the ends, v goes into u
+		unsigned int	heap_pos;	//!< NOT_QUEUED while out of the heap
+	};
+
+	//! the cost is kept next to the edge id, so sifting reads the heap only
+	struct HeapEntry
+	{
+		float			cost;
+		unsigned int	edge;
+	};
+
+	struct Collapser
+	{
+		std::vector<double>					pos;		//!< xyz per vertex
+		std::vector<Quadric>				quadric;
+		std::vector<unsigned char>			locked;
+		std::vector<unsigned char>			vert_alive;
+		std::vector<std::vector<unsigned> >	vert_tris;
+		std::vector<std::vector<unsigned> >	vert_edges;
+		std::vector<unsigned int>			tris;		//!< 3 vertex ids per triangle
+		std::vector<unsigned char>			tri_alive;
+		std::vector<unsigned int>			mark;		//!< per vertex, == tick while visited
+		unsigned int						tick;
+		std::vector<Edge>					edges;
+		std::vector<HeapEntry>				heap;		//!< the cheapest on top
+		int									num_tris;
+
+		inline const double* P(unsigned int v) const {return &pos[3 * v];}
+
+		inline bool Contains(unsigned int t, unsigned int v) const
+		{
+			return tris[3 * t] == v || tris[3 * t + 1] == v || tris[3 * t + 2] == v;
+		}
+
+		//! where the collapse of (u, v) puts u, and the error there
+		double Target(unsigned int a, unsigned int b, double* target) const
+		{
+			Quadric q = quadric[a];
+			q += quadric[b];
+			if (locked[a])
+			{
+				std::copy(P(a), P(a) + 3, target);
+			}
+			else if (!q.Minimum(target))
+			{
+				// the best of the ends and the middle
+				const double* pa = P(a);
+				const double* pb = P(b);
+				double mid[3] = {0.5 * (pa[0] + pb[0]), 0.5 * (pa[1] + pb[1]), 0.5 * (pa[2] + pb[2])};
+				const double* best = pa;
+				if (q.Error(pb) < q.Error(best))
+				{
+					best = pb;
+				}
+				if (q.Error(mid) < q.Error(best))
+				{
+					best = mid;
+				}
+				std::copy(best, best + 3, target);
+			}
+			return std::max(0.0, q.Error(target));
+		}
+
+		//! the cost and direction of edge e, the locked end survives
+		bool Evaluate(Edge& e, float& cost) const
+		{
+			if (locked[e.u] && locked[e.v])
+			{
+				return false;
+			}
+			if (locked[e.v])
+			{
+				std::swap(e.u, e.v);
+			}
+			double target[3];
+			cost = static_cast<float>(Target(e.u, e.v, target));
+			return true;
+		}
+
+		inline unsigned int Other(unsigned int e, unsigned int w) const
+		{
+			return edges[e].u == w ? edges[e].v : edges[e].u;
+		}
+
+		inline void Place(size_t pos, const HeapEntry& h)
+		{
+			heap[pos] = h;
+			edges[h.edge].heap_pos = static_cast<unsigned int>(pos);
+		}
+
+		void SiftUp(size_t pos)
+		{
+			HeapEntry h = heap[pos];
+			while (pos > 0 && heap[(pos - 1) / 2].cost > h.cost)
+			{
+				Place(pos, heap[(pos - 1) / 2]);
+				pos = (pos - 1) / 2;
+			}
+			Place(pos, h);
+		}
+
+		void SiftDown(size_t pos)
+		{
+			HeapEntry h = heap[pos];
+			size_t n = heap.size();
+			for (;;)
+			{
+				size_t child = 2 * pos + 1;
+				if (child >= n)
+				{
+					break;
+				}
+				if (child + 1 < n && heap[child + 1].cost < heap[child].cost)
+				{
+					child++;
+				}
+				if (heap[child].cost >= h.cost)
+				{
+					break;
+				}
+				Place(pos, heap[child]);
+				pos = child;
+			}
+			Place(pos, h);
+		}
+
+		//! take edge e out of the heap, if it is in
+		void Dequeue(unsigned int e)
+		{
+			size_t pos = edges[e].heap_pos;
+			if (pos == NOT_QUEUED)
+			{
+				return;
+			}
+			edges[e].heap_pos = NOT_QUEUED;
+			HeapEntry last = heap.back();
+			heap.pop_back();
+			if (pos < heap.size())
+			{
+				heap[pos] = last;
+				if (pos > 0 && heap[(pos - 1) / 2].cost > last.cost)
+				{
+					SiftUp(pos);
+				}
+				else
+				{
+					SiftDown(pos);
+				}
+			}
+		}
+
+		//! evaluate edge e again and move it in the heap, or out of it
+		void Requeue(unsigned int e)
+		{
+			HeapEntry h = {0.f, e};
+			if (!Evaluate(edges[e], h.cost))
+			{
+				Dequeue(e);
+				return;
+			}
+			size_t pos = edges[e].heap_pos;
+			if (pos == NOT_QUEUED)
+			{
+				pos = heap.size();
+				heap.push_back(h);
+			}
+			else
+			{
+				heap[pos] = h;
+			}
+			if (pos > 0 && heap[(pos - 1) / 2].cost > h.cost)
+			{
+				SiftUp(pos);
+			}
+			else
+			{
+				SiftDown(pos);
+			}
+		}
+
+		//! whether triangle t keeps its orientation with vertex from moved to p
+		bool KeepsOrientation(unsigned int t, unsigned int from, const double* p) const
+		{
+			const double* c[3];
+			const double* n[3];
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int w = tris[3 * t + k];
+				c[k] = P(w);
+				n[k] = w == from ? p : c[k];
+			}
+			double e1[3], e2[3], f1[3], f2[3];
+			for (int k = 0; k < 3; k++)
+			{
+				e1[k] = c[1][k] - c[0][k];
+				e2[k] = c[2][k] - c[0][k];
+				f1[k] = n[1][k] - n[0][k];
+				f2[k] = n[2][k] - n[0][k];
+			}
+			double old_n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+			double new_n[3] = {f1[1] * f2[2] - f1[2] * f2[1], f1[2] * f2[0] - f1[0] * f2[2], f1[0] * f2[1] - f1[1] * f2[0]};
+			double dot = old_n[0] * new_n[0] + old_n[1] * new_n[1] + old_n[2] * new_n[2];
+			double len2 = new_n[0] * new_n[0] + new_n[1] * new_n[1] + new_n[2] * new_n[2];
+			double old2 = old_n[0] * old_n[0] + old_n[1] * old_n[1] + old_n[2] * old_n[2];
+			// refuse flips and turns of the normal by more than about 84 degrees
+			return dot > 0.0 && dot * dot > 0.01 * len2 * old2;
+		}
+
+		//! the link condition, no duplicated triangle and no flipped one
+		bool CanCollapse(const Edge& c, const double* target)
+		{
+			unsigned int u = c.u, v = c.v;
+			++tick;
+			int shared = 0;
+			for (size_t i = 0; i < vert_tris[u].size(); i++)
+			{
+				unsigned int t = vert_tris[u][i];
+				for (int k = 0; k < 3; k++)
+				{
+					mark[tris[3 * t + k]] = tick;
+				}
+				if (Contains(t, v))
+				{
+					shared++;
+				}
+			}
+			if (shared == 0)
+			{
+				return false;
+			}
+			// the common neighbours of u and v must be exactly the opposite
+			// corners of the triangles of the edge
+			int common = 0;
+			unsigned int seen = ++tick;
+			for (size_t i = 0; i < vert_tris[v].size(); i++)
+			{
+				unsigned int t = vert_tris[v][i];
+				for (int k = 0; k < 3; k++)
+				{
+					unsigned int w = tris[3 * t + k];
+					if (w != u && w != v && mark[w] == seen - 1)
+					{
+						mark[w] = seen;
+						common++;
+					}
+				}
+			}
+			if (common != shared)
+			{
+				return false;
+			}
+
+			// the triangles of v that go over to u must not already exist,
+			// which happens when the two triangles of the edge close a
+			// tetrahedron; both other corners are then common neighbours
+			for (size_t i = 0; i < vert_tris[v].size(); i++)
+			{
+				unsigned int t = vert_tris[v][i];
+				if (Contains(t, u))
+				{
+					continue;
+				}
+				int common_corners = 0;
+				for (int k = 0; k < 3; k++)
+				{
+					common_corners += mark[tris[3 * t + k]] == seen;
+				}
+				for (size_t j = 0; j < vert_tris[u].size() && common_corners == 2; j++)
+				{
+					unsigned int s = vert_tris[u][j];
+					int same = 0;
+					for (int k = 0; k < 3; k++)
+					{
+						unsigned int w = tris[3 * t + k];
+						same += w != v && Contains(s, w);
+					}
+					if (same == 2 && !Contains(s, v))
+					{
+						return false;
+					}
+				}
+				if (!KeepsOrientation(t, v, target))
+				{
+					return false;
+				}
+			}
+			for (size_t i = 0; i < vert_tris[u].size(); i++)
+			{
+				unsigned int t = vert_tris[u][i];
+				if (!Contains(t, v) && !KeepsOrientation(t, u, target))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		static void Remove(std::vector<unsigned>& list, unsigned int t)
+		{
+			std::vector<unsigned>::iterator it = std::find(list.begin(), list.end(), t);
+			if (it != list.end())
+			{
+				*it = list.back();
+				list.pop_back();
+			}
+		}
+
+		void Collapse(unsigned int e, const double* target)
+		{
+			unsigned int u = edges[e].u, v = edges[e].v;
+			std::vector<unsigned>& tv = vert_tris[v];
+			for (size_t i = 0; i < tv.size(); i++)
+			{
+				unsigned int t = tv[i];
+				if (Contains(t, u))
+				{
+					tri_alive[t] = 0;
+					num_tris--;
+					for (int k = 0; k < 3; k++)
+					{
+						if (tris[3 * t + k] != v)
+						{
+							Remove(vert_tris[tris[3 * t + k]], t);
+						}
+					}
+				}
+				else
+				{
+					for (int k = 0; k < 3; k++)
+					{
+						if (tris[3 * t + k] == v)
+						{
+							tris[3 * t + k] = u;
+						}
+					}
+					vert_tris[u].push_back(t);
+				}
+			}
+			std::vector<unsigned>().swap(tv);
+			vert_alive[v] = 0;
+
+			std::copy(target, target + 3, &pos[3 * u]);
+			quadric[u] += quadric[v];
+
+			// the edges of v go over to u, but the one to a common neighbour
+			// is already there, as is the collapsed edge
+			++tick;
+			std::vector<unsigned>& eu = vert_edges[u];
+			for (size_t i = 0; i < eu.size(); i++)
+			{
+				mark[Other(eu[i], u)] = tick;
+			}
+			std::vector<unsigned>& ev = vert_edges[v];
+			for (size_t i = 0; i < ev.size(); i++)
+			{
+				unsigned int f = ev[i];
+				unsigned int w = Other(f, v);
+				if (w == u)
+				{
+					Remove(eu, f);
+				}
+				else if (mark[w] == tick)
+				{
+					Remove(vert_edges[w], f);
+				}
+				else
+				{
+					(edges[f].u == v ? edges[f].u : edges[f].v) = u;
+					eu.push_back(f);
+					continue;
+				}
+				Dequeue(f);
+			}
+			std::vector<unsigned>().swap(ev);
+
+			// the edges of u cost something else now
+			for (size_t i = 0; i < eu.size(); i++)
+			{
+				Requeue(eu[i]);
+			}
+		}
+
+		//! whether another live triangle runs along an edge of t in the same direction
+		bool SharesDirectedEdge(unsigned int t) const
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int a = tris[3 * t + k], b = tris[3 * t + (k + 1) % 3];
+				const std::vector<unsigned>& around = vert_tris[a];
+				for (size_t i = 0; i < around.size(); i++)
+				{
+					unsigned int s = around[i];
+					for (int j = 0; j < 3 && s != t; j++)
+					{
+						if (tris[3 * s + j] == a && tris[3 * s + (j + 1) % 3] == b)
+						{
+							return true;
+						}
+					}
+				}
+			}
+			return false;
+		}
+
+		void Emit(Mesh3D& out) const
+		{
+			std::vector<int> remap(vert_alive.size(), -1);
+			std::vector<Vec3f> verts;
+			std::vector<int> idx;
+			idx.reserve(3 * num_tris);
+			// InsertFace can not take a half-edge twice, a triangle that would
+			// need one again (only possible if the source was not a manifold
+			// once split into triangles) is left out. Only the triangles that
+			// share a directed edge with another one go through the set.
+			std::vector<unsigned char> contested(tri_alive.size(), 0);
+			parallel_for(0, tri_alive.size(), [&](size_t t)
+			{
+				contested[t] = tri_alive[t] && SharesDirectedEdge(static_cast<unsigned int>(t));
+			});
+			std::unordered_set<unsigned long long> used;
+			for (size_t t = 0; t < tri_alive.size(); t++)
+			{
+				if (!tri_alive[t])
+				{
+					continue;
+				}
+				if (contested[t])
+				{
+					const unsigned int* c = &tris[3 * t];
+					unsigned long long key[3];
+					for (int k = 0; k < 3; k++)
+					{
+						key[k] = static_cast<unsigned long long>(c[k]) << 32 | c[(k + 1) % 3];
+					}
+					if (used.count(key[0]) || used.count(key[1]) || used.count(key[2]))
+					{
+						continue;
+					}
+					used.insert(key, key + 3);
+				}
+				for (int k = 0; k < 3; k++)
+				{
+					unsigned int w = tris[3 * t + k];
+					if (remap[w] < 0)
+					{
+						remap[w] = static_cast<int>(verts.size());
+						verts.push_back(Vec3f(static_cast<float>(pos[3 * w]),
+							static_cast<float>(pos[3 * w + 1]), static_cast<float>(pos[3 * w + 2])));
+					}
+					idx.push_back(remap[w]);
+				}
+			}
+			out.CreateMesh(verts, idx);
+		}
+	};
+}
+
+MeshSimplifier::MeshSimplifier(void)
+	: keep_boundary_(true), max_cost_(1e300), num_collapses_(0)
+{
+}
+
+MeshSimplifier::~MeshSimplifier(void)
+{
+}
+
+bool MeshSimplifier::Simplify(Mesh3D& source, const std::vector<float>& ratios, std::vector<Mesh3D*>& lods)
+{
+	num_collapses_ = 0;
+	if (!source.isValid() || lods.size() < ratios.size())
+	{
+		return false;
+	}
+	size_t nverts = static_cast<size_t>(source.num_of_vertex_list());
+	size_t npolys = static_cast<size_t>(source.num_of_face_list());
+
+	// polygons are split into fans from their pedge_ corner
+	std::vector<size_t> first_tri(npolys + 1, 0);
+	for (size_t f = 0; f < npolys; f++)
+	{
+		int valence = source.face_at(static_cast<HE_index>(f)).valence_;
+		first_tri[f + 1] = first_tri[f] + (valence > 2 ? valence - 2 : 0);
+	}
+	size_t nfaces = first_tri[npolys];
+
+	Collapser col;
+	col.pos.resize(3 * nverts);
+	col.quadric.resize(nverts);
+	col.locked.assign(nverts, 0);
+	col.vert_alive.assign(nverts, 1);
+	col.vert_tris.resize(nverts);
+	col.vert_edges.resize(nverts);
+	col.tris.resize(3 * nfaces);
+	col.tri_alive.assign(nfaces, 1);
+	col.mark.assign(nverts, 0);
+	col.tick = 0;
+	col.num_tris = static_cast<int>(nfaces);
+
+	parallel_for(0, nverts, [&](size_t i)
+	{
+		HE_vert& hv = source.vertex_at(static_cast<HE_index>(i));
+		for (int k = 0; k < 3; k++)
+		{
+			col.pos[3 * i + k] = hv.position_[k];
+		}
+		col.locked[i] = keep_boundary_ && hv.boundary_flag_ == BOUNDARY;
+	});
+	std::vector<HE_index> corners;
+	std::unordered_set<unsigned long long> diagonals;
+	for (size_t f = 0; f < npolys; f++)
+	{
+		HE_face& face = source.face_at(static_cast<HE_index>(f));
+		corners.clear();
+		HE_edge* edge = face.pedge_;
+		do
+		{
+			corners.push_back(edge->pvert_->id_);
+			edge = edge->pnext_;
+		} while (edge != face.pedge_);
+
+		// a diagonal along an edge or an earlier diagonal would put that
+		// edge on three triangles, so the apex is the first corner whose fan
+		// has none. Two polygons that share two edges in a row need this.
+		size_t n = corners.size();
+		size_t apex = 0;
+		for (size_t a = 0; a < n && n > 3; a++)
+		{
+			const HE_index* ring = source.neighbors(corners[a]);
+			const HE_index* ring_end = ring + source.num_of_neighbors(corners[a]);
+			bool clear = true;
+			for (size_t j = 2; j + 1 < n && clear; j++)
+			{
+				HE_index w = corners[(a + j) % n];
+				clear = std::find(ring, ring_end, w) == ring_end &&
+					diagonals.count(EdgeKey(corners[a], w)) == 0;
+			}
+			if (clear)
+			{
+				apex = a;
+				break;
+			}
+		}
+		for (size_t j = 2; j + 1 < n; j++)
+		{
+			diagonals.insert(EdgeKey(corners[apex], corners[(apex + j) % n]));
+		}
+		for (size_t t = first_tri[f], j = 1; t < first_tri[f + 1]; t++, j++)
+		{
+			HE_index tri[3] = {corners[apex], corners[(apex + j) % n], corners[(apex + j + 1) % n]};
+			for (int k = 0; k < 3; k++)
+			{
+				col.tris[3 * t + k] = tri[k];
+				col.vert_tris[tri[k]].push_back(static_cast<unsigned>(t));
+			}
+		}
+	}
+
+	// area weighted plane quadrics, summed per vertex
+	std::vector<Quadric> face_quadric(nfaces);
+	parallel_for(0, nfaces, [&](size_t f)
+	{
+		const double* p0 = col.P(col.tris[3 * f]);
+		const double* p1 = col.P(col.tris[3 * f + 1]);
+		const double* p2 = col.P(col.tris[3 * f + 2]);
+		double e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+		double e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+		double n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+		double len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (len > 0.0)
+		{
+			double a = n[0] / len, b = n[1] / len, c = n[2] / len;
+			face_quadric[f] = Quadric(a, b, c, -(a * p0[0] + b * p0[1] + c * p0[2]), 0.5 * len);
+		}
+	});
+	parallel_for(0, nverts, [&](size_t v)
+	{
+		for (size_t i = 0; i < col.vert_tris[v].size(); i++)
+		{
+			col.quadric[v] += face_quadric[col.vert_tris[v][i]];
+		}
+	});
+
+	// every edge of the triangles once, from its end of smaller id
+	for (size_t a = 0; a < nverts; a++)
+	{
+		col.tick++;
+		for (size_t i = 0; i < col.vert_tris[a].size(); i++)
+		{
+			const unsigned int* c = &col.tris[3 * col.vert_tris[a][i]];
+			for (int k = 0; k < 3; k++)
+			{
+				if (c[k] > a && col.mark[c[k]] != col.tick)
+				{
+					col.mark[c[k]] = col.tick;
+					Edge e = {static_cast<unsigned int>(a), c[k], NOT_QUEUED};
+					col.vert_edges[a].push_back(static_cast<unsigned>(col.edges.size()));
+					col.vert_edges[c[k]].push_back(static_cast<unsigned>(col.edges.size()));
+					col.edges.push_back(e);
+				}
+			}
+		}
+	}
+	size_t nedges = col.edges.size();
+	std::vector<HeapEntry> entries(nedges);
+	std::vector<unsigned char> queued(nedges, 0);
+	parallel_for(0, nedges, [&](size_t e)
+	{
+		entries[e].edge = static_cast<unsigned int>(e);
+		queued[e] = col.Evaluate(col.edges[e], entries[e].cost);
+	});
+	col.heap.reserve(nedges);
+	for (size_t e = 0; e < nedges; e++)
+	{
+		if (queued[e])
+		{
+			col.heap.push_back(entries[e]);
+		}
+	}
+	for (size_t i = col.heap.size() / 2; i > 0; i--)
+	{
+		col.SiftDown(i - 1);
+	}
+	for (size_t i = 0; i < col.heap.size(); i++)
+	{
+		col.edges[col.heap[i].edge].heap_pos = static_cast<unsigned int>(i);
+	}
+
+	// the levels from the finest to the coarsest
+	std::vector<std::pair<int, size_t> > targets(ratios.size());
+	for (size_t i = 0; i < ratios.size(); i++)
+	{
+		targets[i].first = static_cast<int>(std::ceil(ratios[i] * nfaces));
+		targets[i].second = i;
+	}
+	std::sort(targets.begin(), targets.end(), std::greater<std::pair<int, size_t> >());
+
+	for (size_t level = 0; level < targets.size(); level++)
+	{
+		while (col.num_tris > targets[level].first && !col.heap.empty())
+		{
+			if (col.heap.front().cost > max_cost_)
+			{
+				break;
+			}
+			unsigned int e = col.heap.front().edge;
+			const Edge& c = col.edges[e];
+			col.Dequeue(e);
+			double target[3];
+			col.Target(c.u, c.v, target);
+			if (!col.CanCollapse(c, target))
+			{
+				continue;	// queued again if one of its ends changes
+			}
+			col.Collapse(e, target);
+			num_collapses_++;
+		}
+		col.Emit(*lods[targets[level].second]);
+	}
+	return true;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "Mesh3D.h"
+
+//! symmetric 4x4 quadric, upper triangle row by row
+struct Quadric
+{
+	double q[10];
+
+	Quadric(void)
+	{
+		std::fill(q, q + 10, 0.0);
+	}
+	//! the quadric of the plane a x + b y + c z + d = 0, times w
+	Quadric(double a, double b, double c, double d, double w)
+	{
+		q[0] = w * a * a; q[1] = w * a * b; q[2] = w * a * c; q[3] = w * a * d;
+		q[4] = w * b * b; q[5] = w * b * c; q[6] = w * b * d;
+		q[7] = w * c * c; q[8] = w * c * d;
+		q[9] = w * d * d;
+	}
+	Quadric& operator+=(const Quadric& o)
+	{
+		for (int i = 0; i < 10; i++)
+		{
+			q[i] += o.q[i];
+		}
+		return *this;
+	}
+	double Error(const double* p) const
+	{
+		double x = p[0], y = p[1], z = p[2];
+		return q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z + 2.0 * q[3] * x
+			+ q[4] * y * y + 2.0 * q[5] * y * z + 2.0 * q[6] * y
+			+ q[7] * z * z + 2.0 * q[8] * z
+			+ q[9];
+	}
+	//! the point of least error, false if the quadric is too flat to tell
+	bool Minimum(double* p) const
+	{
+		double a00 = q[0], a01 = q[1], a02 = q[2];
+		double a11 = q[4], a12 = q[5], a22 = q[7];
+		double c00 = a11 * a22 - a12 * a12;
+		double c01 = a02 * a12 - a01 * a22;
+		double c02 = a01 * a12 - a02 * a11;
+		double det = a00 * c00 + a01 * c01 + a02 * c02;
+		double trace = a00 + a11 + a22;
+		if (!(std::fabs(det) > 1e-10 * trace * trace * trace))
+		{
+			return false;
+		}
+		double c11 = a00 * a22 - a02 * a02;
+		double c12 = a01 * a02 - a00 * a12;
+		double c22 = a00 * a11 - a01 * a01;
+		double bx = -q[3], by = -q[6], bz = -q[8];
+		double inv = 1.0 / det;
+		p[0] = (c00 * bx + c01 * by + c02 * bz) * inv;
+		p[1] = (c01 * bx + c11 * by + c12 * bz) * inv;
+		p[2] = (c02 * bx + c12 * by + c22 * bz) * inv;
+		return true;
+	}
+};
+
+/*!
+*	Quadric error edge-collapse simplification (Garland and Heckbert 1997).
+*
+*	Every vertex carries the sum of the squared distances to the planes of
+*	its faces. An edge collapses to the point that minimises the sum of the
+*	quadrics of its two vertices, cheapest collapse first. Collapses that
+*	would make the surface non-manifold or flip a triangle are refused.
+*
+*	Simplify runs the collapses once and takes a copy of the mesh every time
+*	the face count drops to the next requested level, so a whole chain of
+*	levels of detail costs the same as the coarsest one. Polygons are split
+*	into triangle fans first and the levels are triangle meshes. Only
+*	positions and connectivity go into the levels.
+*/
+class MeshSimplifier
+{
+	bool	keep_boundary_;		//!< vertices tagged BOUNDARY neither move nor go away
+	double	max_cost_;			//!< collapses above this error are not done
+	int		num_collapses_;		//!< collapses done by the last Simplify
+
+public:
+	MeshSimplifier(void);
+	~MeshSimplifier(void);
+
+	//! whether the BOUNDARY vertices of the source are kept as they are, true by default
+	inline void set_keep_boundary(bool keep) {keep_boundary_ = keep;}
+	inline bool keep_boundary(void) const {return keep_boundary_;}
+	//! stop before collapses of a larger quadric error, no limit by default
+	inline void set_max_cost(double cost) {max_cost_ = cost;}
+	inline double max_cost(void) const {return max_cost_;}
+	//! number of collapses done by the last Simplify
+	inline int num_of_collapses(void) const {return num_collapses_;}
+
+	//! simplify source into a chain of levels of detail
+	/*!
+	*	\param ratios target triangle count of every level as a fraction of
+	*	the triangles of source, e.g. 0.5 0.25 0.1, in any order
+	*	\param lods one mesh per ratio, each is cleared and receives its level
+	*	\return false if source is not a valid mesh
+	*
+	*	A level may keep more faces than asked for when no more collapse is
+	*	allowed or max_cost stops the run. source is not changed.
+	*/
+	bool Simplify(Mesh3D& source, const std::vector<float>& ratios, std::vector<Mesh3D*>& lods);
+};
@@ -0,0 +1,208 @@
+#include "Mesh3D.h"
+
+#include <vector>
+
+// Laplacian and Taubin smoothing.
+//
+// The positions are copied into two structure-of-arrays buffers. Every step
+// reads one buffer and writes the moving vertices into the other, then the
+// two swap, so a step is a parallel sweep without any write another vertex
+// reads. The fixed vertices hold the same position in both buffers. The
+// weights of the one-rings are computed once, before the first step, and
+// are laid out along ring_verts_.
+
+bool Mesh3D::SmoothLaplacian(int iterations, float lambda, SmoothingWeights weights, bool selected_only)
+{
+	return Smooth(iterations, lambda, 0.f, weights, selected_only);
+}
+
+bool Mesh3D::SmoothTaubin(int iterations, float lambda, float mu, SmoothingWeights weights, bool selected_only)
+{
+	return Smooth(iterations, lambda, mu, weights, selected_only);
+}
+
+bool Mesh3D::Smooth(int iterations, float lambda, float mu, SmoothingWeights weights, bool selected_only)
+{
+	if (!isValid() || iterations < 1 || editing_)
+	{
+		return false;
+	}
+	size_t nverts = static_cast<size_t>(num_of_vertex_list());
+	size_t nfaces = static_cast<size_t>(num_of_face_list());
+	bool cotangent = weights == SMOOTH_COTANGENT;
+	if (cotangent)
+	{
+		for (size_t f = 0; f < nfaces; f++)
+		{
+			if (face_arena_[static_cast<HE_index>(f)].valence_ != 3)
+			{
+				return false;
+			}
+		}
+	}
+	if (ring_start_.size() != nverts + 1)
+	{
+		SetNeighbors();
+	}
+
+	// the vertices that move
+	std::vector<HE_index> moving;
+	moving.reserve(nverts);
+	for (size_t i = 0; i < nverts; i++)
+	{
+		HE_vert& hv = vertex_arena_[static_cast<HE_index>(i)];
+		if (hv.pedge_ != NULL && !hv.isOnBoundary() && (!selected_only || (has_vertex_selection() && vertex_selected(static_cast<HE_index>(i)) == SELECTED)))
+		{
+			moving.push_back(static_cast<HE_index>(i));
+		}
+	}
+	if (moving.empty())
+	{
+		return true;
+	}
+
+	std::vector<float> buffer[2][3];
+	for (int k = 0; k < 3; k++)
+	{
+		buffer[0][k].resize(nverts);
+	}
+	parallel_for(0, nverts, [&](size_t i)
+	{
+		const Vec3f& p = vertex_arena_[static_cast<HE_index>(i)].position_;
+		buffer[0][0][i] = p[0];
+		buffer[0][1][i] = p[1];
+		buffer[0][2][i] = p[2];
+	});
+	for (int k = 0; k < 3; k++)
+	{
+		buffer[1][k] = buffer[0][k];
+	}
+
+	// weight of every ring entry and the inverse of the sum per moving vertex
+	std::vector<float> ring_weight;
+	std::vector<float> inv_weight_sum(moving.size());
+	if (cotangent)
+	{
+		ring_weight.resize(ring_verts_.size());
+	}
+	parallel_for(0, moving.size(), [&](size_t m)
+	{
+		HE_index v = moving[m];
+		HE_index begin = ring_start_[v], end = ring_start_[v + 1];
+		if (!cotangent)
+		{
+			inv_weight_sum[m] = 1.f / (end - begin);
+			return;
+		}
+
+		// walk the ring in the order SetNeighbors filled it, the last slot first
+		HE_vert& hv = vertex_arena_[v];
+		const Vec3f& p = hv.position_;
+		HE_edge* edge = hv.pedge_;
+		HE_index slot = end;
+		float sum = 0.f;
+		do
+		{
+			const Vec3f& q = edge->pvert_->position_;
+			float w = 0.f;
+			HE_edge* sides[2] = {edge, edge->ppair_};
+			for (int s = 0; s < 2; s++)
+			{
+				if (sides[s]->pface_ == NULL)
+				{
+					continue;
+				}
+				// cotangent of the angle opposite the edge
+				const Vec3f& c = sides[s]->pnext_->pvert_->position_;
+				Vec3f a = p - c, b = q - c;
+				float sine = len(a ^ b);
+				if (sine > 1e-12f)
+				{
+					w += 0.5f * (a * b) / sine;
+				}
+			}
+			// obtuse triangles give negative weights, which make the step unstable
+			w = w > 0.f ? w : 0.f;
+			ring_weight[--slot] = w;
+			sum += w;
+			edge = edge->ppair_->pnext_;
+		} while (edge != hv.pedge_ && edge != NULL);
+
+		if (sum > 0.f)
+		{
+			inv_weight_sum[m] = 1.f / sum;
+		}
+		else
+		{
+			// a degenerate ring falls back to the uniform weights
+			for (HE_index j = begin; j < end; j++)
+			{
+				ring_weight[j] = 1.f;
+			}
+			inv_weight_sum[m] = 1.f / (end - begin);
+		}
+	});
+
+	// p + factor (weighted mean of the ring - p), from buffer src to 1 - src
+	int src = 0;
+	const HE_index* ring = ring_verts_.data();
+	const float* ring_w = cotangent ? ring_weight.data() : NULL;
+	for (int it = 0; it < iterations; it++)
+	{
+		for (int pass = 0; pass < (mu != 0.f ? 2 : 1); pass++)
+		{
+			float factor = pass == 0 ? lambda : mu;
+			const float* sx = buffer[src][0].data();
+			const float* sy = buffer[src][1].data();
+			const float* sz = buffer[src][2].data();
+			float* dx = buffer[1 - src][0].data();
+			float* dy = buffer[1 - src][1].data();
+			float* dz = buffer[1 - src][2].data();
+			parallel_for(0, moving.size(), [&](size_t m)
+			{
+				HE_index v = moving[m];
+				float x = 0.f, y = 0.f, z = 0.f;
+				for (HE_index j = ring_start_[v]; j < ring_start_[v + 1]; j++)
+				{
+					float w = ring_w != NULL ? ring_w[j] : 1.f;
+					x += w * sx[ring[j]];
+					y += w * sy[ring[j]];
+					z += w * sz[ring[j]];
+				}
+				float s = inv_weight_sum[m];
+				dx[v] = sx[v] + factor * (x * s - sx[v]);
+				dy[v] = sy[v] + factor * (y * s - sy[v]);
+				dz[v] = sz[v] + factor * (z * s - sz[v]);
+			});
+			src = 1 - src;
+		}
+	}
+
+	const float* px = buffer[src][0].data();
+	const float* py = buffer[src][1].data();
+	const float* pz = buffer[src][2].data();
+	if (moving.size() <= nverts / 4)
+	{
+		// a small region: EndEdit refreshes the normals, box and edge lengths around it
+		BeginEdit();
+		for (size_t m = 0; m < moving.size(); m++)
+		{
+			HE_index v = moving[m];
+			SetVertexPosition(&vertex_arena_[v], Vec3f(px[v], py[v], pz[v]));
+		}
+		EndEdit();
+		return true;
+	}
+
+	parallel_for(0, moving.size(), [&](size_t m)
+	{
+		HE_index v = moving[m];
+		vertex_arena_[v].position_ = Vec3f(px[v], py[v], pz[v]);
+	});
+	SyncSoAPositions();
+	TouchPositions(NULL, 0);
+	UpdateNormal();
+	ComputeBoundingBox();
+	ComputeAvarageEdgeLength();
+	return true;
+}
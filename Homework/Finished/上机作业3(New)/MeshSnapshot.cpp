@@ -0,0 +1,168 @@
+#include "MeshSnapshot.h"
+
+#include <algorithm>
+#include <atomic>
+
+// Snapshots for concurrent readers.
+//
+// The mesh itself is only touched by the thread that edits it. Publishing
+// copies what a renderer needs into a new MeshSnapshot and swaps it into
+// snapshot_ with one atomic store; readers take it with an atomic load and
+// keep it alive through their reference. The pages equal to those of the
+// snapshot before are shared. After edit batches only, the moved-vertex
+// log tells which vertices and faces changed since the last publish, and
+// only their pages are read again; everything else, topology included, is
+// taken over from the last snapshot. Anything the log does not cover (a
+// new mesh, a full normal pass, new colours) makes the next publish read
+// and compare the whole mesh.
+
+namespace
+{
+	//! sort the page numbers and drop the repeated ones
+	void UniquePages(std::vector<size_t>& pages)
+	{
+		std::sort(pages.begin(), pages.end());
+		pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+	}
+}
+
+void Mesh3D::PublishSnapshot(bool full)
+{
+	std::shared_ptr<const MeshSnapshot> previous = std::atomic_load(&snapshot_);
+	const MeshSnapshot* last = previous.get();
+	std::shared_ptr<MeshSnapshot> next = std::make_shared<MeshSnapshot>();
+
+	size_t nverts = static_cast<size_t>(num_of_vertex_list());
+	size_t nfaces = static_cast<size_t>(num_of_face_list());
+
+	auto positions = [this](size_t begin, size_t end, Vec3f* out)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			*out++ = vertex_arena_[i].position_;
+		}
+	};
+	auto normals = [this](size_t begin, size_t end, Vec3f* out)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			*out++ = vertex_arena_[i].normal_;
+		}
+	};
+	auto face_normals = [this](size_t begin, size_t end, Vec3f* out)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			*out++ = face_arena_[i].normal_;
+		}
+	};
+
+	std::vector<HE_index> moved;
+	if (!full && !snapshot_full_ && last != NULL
+		&& last->num_of_vertices() == nverts && last->num_of_faces() == nfaces
+		&& GetMovedVertices(snapshot_version_, moved))
+	{
+		// EndEdit renewed the normals of the faces around the moved
+		// vertices and of every vertex of these faces
+		const size_t page = SharedPages<Vec3f>::PAGE_SIZE;
+		std::vector<size_t> vert_pages, face_pages;
+		for (size_t i = 0; i < moved.size(); i++)
+		{
+			HE_vert& hv = vertex_arena_[moved[i]];
+			vert_pages.push_back(moved[i] / page);
+			HE_edge* edge = hv.pedge_;
+			if (edge == NULL)
+			{
+				continue;
+			}
+			do
+			{
+				if (edge->pface_ != NULL)
+				{
+					face_pages.push_back(edge->pface_->id_ / page);
+					HE_edge* corner = edge->pface_->pedge_;
+					do
+					{
+						vert_pages.push_back(corner->pvert_->id_ / page);
+						corner = corner->pnext_;
+					} while (corner != edge->pface_->pedge_);
+				}
+				edge = edge->ppair_->pnext_;
+			} while (edge != NULL && edge != hv.pedge_);
+		}
+		UniquePages(vert_pages);
+		UniquePages(face_pages);
+
+		next->positions.Update(last->positions, vert_pages, positions);
+		next->normals.Update(last->normals, vert_pages, normals);
+		next->face_normals.Update(last->face_normals, face_pages, face_normals);
+		next->colors = last->colors;
+		next->face_starts = last->face_starts;
+		next->corners = last->corners;
+	}
+	else
+	{
+		std::vector<HE_index> starts(nfaces + 1, 0);
+		for (size_t f = 0; f < nfaces; f++)
+		{
+			starts[f + 1] = starts[f] + face_arena_[f].valence_;
+		}
+
+		next->positions.Assign(nverts, last ? &last->positions : NULL, positions);
+		next->normals.Assign(nverts, last ? &last->normals : NULL, normals);
+		const Vec4f* colors = has_vertex_colors() ? property(vertex_colors_).data() : NULL;
+		next->colors.Assign(nverts, last ? &last->colors : NULL,
+			[colors](size_t begin, size_t end, Vec4f* out)
+		{
+			Vec4f gold(DEFAULT_VERTEX_COLOR[0], DEFAULT_VERTEX_COLOR[1], DEFAULT_VERTEX_COLOR[2], DEFAULT_VERTEX_COLOR[3]);
+			for (size_t i = begin; i < end; i++)
+			{
+				*out++ = colors ? colors[i] : gold;
+			}
+		});
+		next->face_normals.Assign(nfaces, last ? &last->face_normals : NULL, face_normals);
+		next->face_starts.Assign(nfaces + 1, last ? &last->face_starts : NULL,
+			[&starts](size_t begin, size_t end, HE_index* out)
+		{
+			std::copy(starts.begin() + begin, starts.begin() + end, out);
+		});
+		next->corners.Assign(starts[nfaces], last ? &last->corners : NULL,
+			[this, &starts](size_t begin, size_t end, HE_index* out)
+		{
+			// the face holding corner begin, then the faces after it
+			size_t f = std::upper_bound(starts.begin(), starts.end(), static_cast<HE_index>(begin)) - starts.begin() - 1;
+			HE_edge* edge = face_arena_[f].pedge_;
+			for (size_t k = starts[f]; k < begin; k++)
+			{
+				edge = edge->pnext_;
+			}
+			for (size_t c = begin; c < end; c++)
+			{
+				if (c == starts[f + 1])
+				{
+					edge = face_arena_[++f].pedge_;
+				}
+				*out++ = edge->pvert_->id_;
+				edge = edge->pnext_;
+			}
+		});
+	}
+
+	next->bbox[0] = xmin_;
+	next->bbox[1] = xmax_;
+	next->bbox[2] = ymin_;
+	next->bbox[3] = ymax_;
+	next->bbox[4] = zmin_;
+	next->bbox[5] = zmax_;
+	next->average_edge_length = average_edge_length_;
+	next->sequence = last ? last->sequence + 1 : 1;
+	snapshot_version_ = positions_version_;
+	snapshot_full_ = false;
+
+	std::atomic_store(&snapshot_, std::shared_ptr<const MeshSnapshot>(next));
+}
+
+std::shared_ptr<const MeshSnapshot> Mesh3D::snapshot(void) const
+{
+	return std::atomic_load(&snapshot_);
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstring>
+#include "Mesh3D.h"
+
+/*!
+*	Array of fixed-size pages that are never written once built, so that
+*	several versions can share the pages they have in common.
+*
+*	Assign builds a version from the previous one: every page is filled
+*	anew and compared with the page at the same place in the previous
+*	version, and if the values are the same the old page is kept and the
+*	new one dropped. An edit thus only costs memory for the pages it
+*	touched, and readers of the previous version are never disturbed.
+*	T is compared bytewise, so it must have no padding. When the changed
+*	indices are known, Update takes the previous version as it is and only
+*	fills the pages holding them.
+*/
+template <class T, unsigned LOG2_PAGE = 12>
+class SharedPages
+{
+public:
+	enum { PAGE_SIZE = 1u << LOG2_PAGE, PAGE_MASK = PAGE_SIZE - 1 };
+
+private:
+	typedef std::shared_ptr<const std::vector<T> >	Page;
+
+	std::vector<Page>	pages_;
+	size_t				size_;
+
+	template <class F>
+	std::vector<T> FillPage(size_t p, const F& fill) const
+	{
+		size_t begin = p << LOG2_PAGE;
+		size_t end = std::min(begin + PAGE_SIZE, size_);
+		std::vector<T> values(end - begin);
+		fill(begin, end, values.data());
+		return values;
+	}
+
+public:
+	SharedPages(void) : size_(0) {}
+
+	inline size_t size(void) const {return size_;}
+	inline bool empty(void) const {return size_ == 0;}
+	inline const T& operator[](size_t i) const {return (*pages_[i >> LOG2_PAGE])[i & PAGE_MASK];}
+
+	inline size_t num_of_pages(void) const {return pages_.size();}
+	//! the values [p * PAGE_SIZE, min((p + 1) * PAGE_SIZE, size())) as one array
+	inline const T* page(size_t p) const {return pages_[p]->data();}
+	//! the number of pages stored in the same memory as in other
+	size_t SharedWith(const SharedPages& other) const
+	{
+		size_t shared = 0;
+		for (size_t p = 0; p < pages_.size() && p < other.pages_.size(); p++)
+		{
+			shared += pages_[p] == other.pages_[p];
+		}
+		return shared;
+	}
+
+	//! build n values, fill(begin, end, out) writing the values [begin, end) to out
+	/*!
+	*	the pages are filled in parallel, so fill must only read shared
+	*	state. Pages equal to those of previous are taken from it.
+	*/
+	template <class F>
+	void Assign(size_t n, const SharedPages* previous, const F& fill)
+	{
+		size_ = n;
+		pages_.assign((n + PAGE_MASK) >> LOG2_PAGE, Page());
+		parallel_for(0, pages_.size(), [&](size_t p)
+		{
+			std::vector<T> values = FillPage(p, fill);
+			if (previous != NULL && p < previous->pages_.size())
+			{
+				const Page& old = previous->pages_[p];
+				if (old->size() == values.size()
+					&& memcmp(old->data(), values.data(), values.size() * sizeof(T)) == 0)
+				{
+					pages_[p] = old;
+					return;
+				}
+			}
+			pages_[p] = std::make_shared<const std::vector<T> >(std::move(values));
+		}, 1);
+	}
+
+	//! the values of previous, with the pages listed in dirty filled anew
+	/*!
+	*	fill is called as for Assign, on the dirty pages only; the others
+	*	are shared with previous as they are.
+	*/
+	template <class F>
+	void Update(const SharedPages& previous, const std::vector<size_t>& dirty, const F& fill)
+	{
+		size_ = previous.size_;
+		pages_ = previous.pages_;
+		parallel_for(0, dirty.size(), [&](size_t k)
+		{
+			pages_[dirty[k]] = std::make_shared<const std::vector<T> >(FillPage(dirty[k], fill));
+		}, 1);
+	}
+};
+
+/*!
+*	Immutable copy of what is needed to draw a Mesh3D, made by
+*	Mesh3D::PublishSnapshot and handed out by Mesh3D::snapshot.
+*
+*	The snapshot is never changed after it is published, so a render thread
+*	can draw it without any lock while the mesh goes on being edited; it is
+*	freed when the last thread holding it lets it go. Its arrays share their
+*	unchanged pages with the snapshot published before, see SharedPages.
+*/
+struct MeshSnapshot
+{
+	SharedPages<Vec3f>		positions;		//!< per vertex
+	SharedPages<Vec3f>		normals;		//!< per vertex
+	SharedPages<Vec4f>		colors;			//!< per vertex
+	SharedPages<Vec3f>		face_normals;	//!< per face
+	//! the corners of face f are corners[face_starts[f] .. face_starts[f+1]),
+	//! one vertex id each, starting at the end vertex of pedge_
+	SharedPages<HE_index>	face_starts;
+	SharedPages<HE_index>	corners;
+
+	float			bbox[6];				//!< xmin xmax ymin ymax zmin zmax
+	float			average_edge_length;
+	unsigned int	sequence;				//!< 1 for the first snapshot of a mesh, then one more each time
+
+	inline size_t num_of_vertices(void) const {return positions.size();}
+	inline size_t num_of_faces(void) const {return face_starts.empty() ? 0 : face_starts.size() - 1;}
+	inline size_t valence(size_t f) const {return face_starts[f + 1] - face_starts[f];}
+};
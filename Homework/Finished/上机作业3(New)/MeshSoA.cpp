@@ -0,0 +1,222 @@
+#include "Mesh3D.h"
+#include "MeshSimd.h"
+
+#include <vector>
+
+// Structure-of-arrays passes of Mesh3D.
+//
+// The positions are mirrored into three float arrays so the kernels of
+// MeshSimd.h can stream them. Each pass cuts its range into blocks, runs the
+// kernel on a block and copies the block's results back into the elements
+// while they are still in cache.
+
+namespace
+{
+	//! elements handled by one kernel call
+	const size_t SOA_BLOCK = 4096;
+}
+
+void Mesh3D::set_soa_positions(bool enable)
+{
+	use_soa_ = enable;
+	for (int k = 0; k < 3; k++)
+	{
+		soa_position_[k].clear();
+		soa_triangle_[k].clear();
+		soa_face_normal_[k].clear();
+		soa_vertex_normal_[k].clear();
+		if (!enable)
+		{
+			soa_position_[k].shrink_to_fit();
+			soa_triangle_[k].shrink_to_fit();
+			soa_face_normal_[k].shrink_to_fit();
+			soa_vertex_normal_[k].shrink_to_fit();
+		}
+	}
+}
+
+void Mesh3D::SyncSoAPositions(void)
+{
+	if (!use_soa_)
+	{
+		return;
+	}
+	size_t nverts = static_cast<size_t>(num_of_vertex_list());
+	for (int k = 0; k < 3; k++)
+	{
+		soa_position_[k].resize(nverts);
+		soa_vertex_normal_[k].resize(nverts);
+	}
+	float* px = soa_position_[0].data();
+	float* py = soa_position_[1].data();
+	float* pz = soa_position_[2].data();
+	parallel_for(0, nverts, [&](size_t i)
+	{
+		const Vec3f& p = vertex_arena_[static_cast<HE_index>(i)].position_;
+		px[i] = p[0];
+		py[i] = p[1];
+		pz[i] = p[2];
+	});
+}
+
+void Mesh3D::CommitSoAPositions(void)
+{
+	if (!use_soa_ || soa_position_[0].size() != static_cast<size_t>(num_of_vertex_list()))
+	{
+		return;
+	}
+	const float* px = soa_position_[0].data();
+	const float* py = soa_position_[1].data();
+	const float* pz = soa_position_[2].data();
+	parallel_for(0, soa_position_[0].size(), [&](size_t i)
+	{
+		vertex_arena_[static_cast<HE_index>(i)].position_ = Vec3f(px[i], py[i], pz[i]);
+	});
+	TouchPositions(NULL, 0);
+}
+
+bool Mesh3D::PrepareSoA(void)
+{
+	if (!use_soa_)
+	{
+		return false;
+	}
+	if (soa_position_[0].size() != static_cast<size_t>(num_of_vertex_list()))
+	{
+		SyncSoAPositions();
+	}
+
+	size_t nfaces = static_cast<size_t>(num_of_face_list());
+	if (soa_face_normal_[0].size() != nfaces)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			soa_face_normal_[k].resize(nfaces);
+			soa_triangle_[k].clear();
+		}
+
+		// the triangle kernel only runs when there is no polygon at all
+		bool triangles = true;
+		for (size_t i = 0; i < nfaces && triangles; i++)
+		{
+			triangles = face_arena_[static_cast<HE_index>(i)].valence_ == 3;
+		}
+		if (triangles)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				soa_triangle_[k].resize(nfaces);
+			}
+			parallel_for(0, nfaces, [this](size_t i)
+			{
+				HE_edge* edge = face_arena_[static_cast<HE_index>(i)].pedge_;
+				for (int k = 0; k < 3; k++)
+				{
+					soa_triangle_[k][i] = edge->pvert_->id_;
+					edge = edge->pnext_;
+				}
+			});
+		}
+	}
+	return true;
+}
+
+void Mesh3D::ComputeFaceslistNormalSoA(void)
+{
+	const MeshKernels& kernels = GetMeshKernels();
+	const float* px = soa_position_[0].data();
+	const float* py = soa_position_[1].data();
+	const float* pz = soa_position_[2].data();
+	const int* t0 = soa_triangle_[0].data();
+	const int* t1 = soa_triangle_[1].data();
+	const int* t2 = soa_triangle_[2].data();
+	float* nx = soa_face_normal_[0].data();
+	float* ny = soa_face_normal_[1].data();
+	float* nz = soa_face_normal_[2].data();
+	float* area = normal_weighting_ == NORMAL_AREA ? face_area_.data() : NULL;
+
+	parallel_for_blocks(0, soa_triangle_[0].size(), SOA_BLOCK, [&](size_t b, size_t e)
+	{
+		kernels.triangle_normals(px, py, pz, t0 + b, t1 + b, t2 + b, e - b,
+			nx + b, ny + b, nz + b, area != NULL ? area + b : NULL);
+		for (size_t i = b; i < e; i++)
+		{
+			face_arena_[static_cast<HE_index>(i)].normal_ = Vec3f(nx[i], ny[i], nz[i]);
+		}
+	});
+}
+
+void Mesh3D::ComputeVertexlistNormalSoA(void)
+{
+	const MeshKernels& kernels = GetMeshKernels();
+	float* nx = soa_vertex_normal_[0].data();
+	float* ny = soa_vertex_normal_[1].data();
+	float* nz = soa_vertex_normal_[2].data();
+
+	parallel_for_blocks(0, soa_vertex_normal_[0].size(), SOA_BLOCK, [&](size_t b, size_t e)
+	{
+		for (size_t i = b; i < e; i++)
+		{
+			Vec3f n = AccumulateFaceNormals(&vertex_arena_[static_cast<HE_index>(i)]);
+			nx[i] = n[0];
+			ny[i] = n[1];
+			nz[i] = n[2];
+		}
+		kernels.normalize(nx + b, ny + b, nz + b, e - b);
+		for (size_t i = b; i < e; i++)
+		{
+			vertex_arena_[static_cast<HE_index>(i)].normal_ = Vec3f(nx[i], ny[i], nz[i]);
+		}
+	});
+}
+
+void Mesh3D::ComputeBoundingBoxSoA(void)
+{
+	const MeshKernels& kernels = GetMeshKernels();
+	size_t nverts = soa_position_[0].size();
+	std::vector<float> boxes(6 * ((nverts + SOA_BLOCK - 1) / SOA_BLOCK));
+
+	parallel_for_blocks(0, nverts, SOA_BLOCK, [&](size_t b, size_t e)
+	{
+		kernels.bounding_box(soa_position_[0].data() + b, soa_position_[1].data() + b,
+			soa_position_[2].data() + b, e - b, &boxes[6 * (b / SOA_BLOCK)]);
+	});
+
+	xmin_ = xmax_ = boxes[0];
+	ymin_ = ymax_ = boxes[2];
+	zmin_ = zmax_ = boxes[4];
+	for (size_t i = 0; i < boxes.size(); i += 6)
+	{
+		xmin_ = boxes[i] < xmin_ ? boxes[i] : xmin_;
+		xmax_ = boxes[i + 1] > xmax_ ? boxes[i + 1] : xmax_;
+		ymin_ = boxes[i + 2] < ymin_ ? boxes[i + 2] : ymin_;
+		ymax_ = boxes[i + 3] > ymax_ ? boxes[i + 3] : ymax_;
+		zmin_ = boxes[i + 4] < zmin_ ? boxes[i + 4] : zmin_;
+		zmax_ = boxes[i + 5] > zmax_ ? boxes[i + 5] : zmax_;
+	}
+}
+
+void Mesh3D::UnifySoA(float size)
+{
+	float scaleX = xmax_ - xmin_;
+	float scaleY = ymax_ - ymin_;
+	float scaleZ = zmax_ - zmin_;
+	float scaleMax = scaleX < scaleY ? scaleY : scaleX;
+	scaleMax = scaleMax < scaleZ ? scaleZ : scaleMax;
+	float scaleV = size / scaleMax;
+	float center[3] = {(xmin_ + xmax_) / 2.f, (ymin_ + ymax_) / 2.f, (zmin_ + zmax_) / 2.f};
+
+	const MeshKernels& kernels = GetMeshKernels();
+	float* px = soa_position_[0].data();
+	float* py = soa_position_[1].data();
+	float* pz = soa_position_[2].data();
+	parallel_for_blocks(0, soa_position_[0].size(), SOA_BLOCK, [&](size_t b, size_t e)
+	{
+		kernels.transform(px + b, py + b, pz + b, e - b, center, scaleV);
+		for (size_t i = b; i < e; i++)
+		{
+			vertex_arena_[static_cast<HE_index>(i)].position_ = Vec3f(px[i], py[i], pz[i]);
+		}
+	});
+	UnifyAggregates(Vec3f(center[0], center[1], center[2]), scaleV);
+}
@@ -0,0 +1,1009 @@
+#include "MeshStream.h"
+#include "MeshIO.h"
+#include "MeshSimplify.h"
+#include "HalfEdgeHash.h"
+#include "MeshWrite.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+// Out-of-core mesh processing.
+//
+// Open makes four sequential passes over temporary buffers, so the whole
+// mesh is never in memory: parse the OBJ file into raw positions and
+// triangles, count the vertices per grid cell to cut the chunks, renumber
+// the vertices chunk by chunk, and scatter the renumbered triangles to the
+// chunks they touch. The old-to-new vertex numbers are a disk buffer too;
+// the triangles usually refer to nearby vertices, so their lookups mostly
+// hit the cache.
+
+namespace
+{
+	const size_t DEFAULT_BUDGET = 256u << 20;
+	//! records per read or write of a sequential pass
+	const size_t IO_RECORDS = 1 << 16;
+	//! bits per axis of the grid the chunks are cut from
+	const int GRID_BITS = 6;
+	//! working memory of a chunk per own vertex: positions, triangles and rings with the halo
+	const size_t CHUNK_BYTES_PER_VERTEX = 256;
+
+	//! interleave the bits of the cell coordinates, x lowest
+	inline unsigned int Morton(unsigned int x, unsigned int y, unsigned int z)
+	{
+		unsigned int code = 0;
+		for (int b = 0; b < GRID_BITS; b++)
+		{
+			code |= ((x >> b) & 1u) << (3 * b) | ((y >> b) & 1u) << (3 * b + 1) | ((z >> b) & 1u) << (3 * b + 2);
+		}
+		return code;
+	}
+
+	inline unsigned int CellCoord(float p, float lo, float scale)
+	{
+		float c = (p - lo) * scale;
+		return c <= 0.f ? 0u : std::min(static_cast<unsigned int>(c), (1u << GRID_BITS) - 1);
+	}
+
+	//! chunk of vertex v, from the first vertex of every chunk
+	inline size_t ChunkOf(const std::vector<size_t>& chunk_verts, size_t v)
+	{
+		return std::upper_bound(chunk_verts.begin(), chunk_verts.end(), v) - chunk_verts.begin() - 1;
+	}
+}
+
+MeshStream::MeshStream(void)
+	: memory_budget_(DEFAULT_BUDGET), normal_weighting_(NORMAL_UNIFORM)
+	, num_verts_(0), num_tris_(0), has_normals_(false)
+{
+	std::fill(bbox_, bbox_ + 6, 0.f);
+}
+
+MeshStream::~MeshStream(void)
+{
+	Close();
+}
+
+void MeshStream::Close(void)
+{
+	positions_.Close();
+	normals_.Close();
+	tris_.Close();
+	chunk_verts_.clear();
+	chunk_tris_.clear();
+	num_verts_ = 0;
+	num_tris_ = 0;
+	has_normals_ = false;
+}
+
+size_t MeshStream::CacheBytes(void) const
+{
+	// four buffers at most are open at a time, they share half the budget
+	return std::max<size_t>(memory_budget_ / 8, 1 << 20);
+}
+
+size_t MeshStream::chunk_vertices(void) const
+{
+	return std::max<size_t>(memory_budget_ / 2 / CHUNK_BYTES_PER_VERTEX, 1024);
+}
+
+bool MeshStream::Open(const char* fins)
+{
+	Close();
+	FILE* file = fopen(fins, "rb");
+	if (file == NULL)
+	{
+		return false;
+	}
+	const char* dir = temp_directory_.c_str();
+	size_t cache = CacheBytes();
+	DiskBuffer raw_positions, raw_tris;
+	if (!raw_positions.Create(dir, 12, cache) || !raw_tris.Create(dir, 12, cache))
+	{
+		fclose(file);
+		return false;
+	}
+
+	// 1. parse the text in blocks that end at a line break, the rest of the
+	// last line is moved to the start of the next block
+	float lo[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+	float hi[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+	size_t nverts = 0, nraw = 0;
+	size_t block_bytes = std::max<size_t>(memory_budget_ / 8, 1 << 20);
+	std::vector<char> text(block_bytes);
+	size_t kept = 0;
+	bool more = true;
+	OBJData obj;
+	std::vector<HE_index> block_tris;
+	while (more)
+	{
+		if (kept == text.size())
+		{
+			// a line longer than a block
+			text.resize(2 * text.size());
+		}
+		size_t got = fread(&text[kept], 1, text.size() - kept, file);
+		more = kept + got == text.size();
+		const char* p = text.data();
+		const char* end = p + kept + got;
+		const char* q = end;
+		if (more)
+		{
+			while (q > p && q[-1] != '\n')
+			{
+				q--;
+			}
+			if (q == p)
+			{
+				kept = end - p;
+				continue;
+			}
+		}
+		obj.clear();
+		obj.vertex_base = static_cast<int>(nverts);
+		ParseOBJParallel(p, q, obj);
+		kept = end - q;
+		memmove(&text[0], q, kept);
+
+		size_t n = obj.positions.size() / 3;
+		for (size_t i = 0; i < n; i++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				lo[k] = std::min(lo[k], obj.positions[3 * i + k]);
+				hi[k] = std::max(hi[k], obj.positions[3 * i + k]);
+			}
+		}
+		raw_positions.Write(nverts, n, obj.positions.data());
+		nverts += n;
+
+		block_tris.clear();
+		for (int f = 0; f < obj.num_of_faces(); f++)
+		{
+			int first = obj.face_starts[f];
+			for (int c = first + 2; c < obj.face_starts[f + 1]; c++)
+			{
+				int a = obj.corner_verts[first], b = obj.corner_verts[c - 1], d = obj.corner_verts[c];
+				if (a >= 0 && b >= 0 && d >= 0)
+				{
+					block_tris.push_back(static_cast<HE_index>(a));
+					block_tris.push_back(static_cast<HE_index>(b));
+					block_tris.push_back(static_cast<HE_index>(d));
+				}
+			}
+		}
+		raw_tris.Write(nraw, block_tris.size() / 3, block_tris.data());
+		nraw += block_tris.size() / 3;
+	}
+	obj.clear();
+	std::vector<char>().swap(text);
+	bool read_ok = ferror(file) == 0;
+	fclose(file);
+	if (!read_ok || nverts == 0 || nraw == 0 || nverts >= HE_INVALID_INDEX)
+	{
+		return false;
+	}
+	bbox_[0] = lo[0]; bbox_[1] = hi[0];
+	bbox_[2] = lo[1]; bbox_[3] = hi[1];
+	bbox_[4] = lo[2]; bbox_[5] = hi[2];
+
+	// 2. count the vertices of every grid cell and cut the cells, in Morton
+	// order, into chunks
+	float scale[3];
+	for (int k = 0; k < 3; k++)
+	{
+		scale[k] = hi[k] > lo[k] ? (1 << GRID_BITS) / (hi[k] - lo[k]) : 0.f;
+	}
+	std::vector<float> xyz(3 * IO_RECORDS);
+	std::vector<unsigned int> cell_count(1u << (3 * GRID_BITS), 0);
+	for (size_t first = 0; first < nverts; first += IO_RECORDS)
+	{
+		size_t n = std::min(IO_RECORDS, nverts - first);
+		raw_positions.Read(first, n, xyz.data());
+		for (size_t i = 0; i < n; i++)
+		{
+			unsigned int cell = Morton(CellCoord(xyz[3 * i], lo[0], scale[0]),
+				CellCoord(xyz[3 * i + 1], lo[1], scale[1]), CellCoord(xyz[3 * i + 2], lo[2], scale[2]));
+			cell_count[cell]++;
+		}
+	}
+	size_t limit = chunk_vertices();
+	std::vector<unsigned int> cell_chunk(cell_count.size());
+	chunk_verts_.assign(1, 0);
+	size_t filled = 0;
+	for (size_t cell = 0; cell < cell_count.size(); cell++)
+	{
+		if (filled > 0 && cell_count[cell] > 0 && filled + cell_count[cell] > limit)
+		{
+			chunk_verts_.push_back(chunk_verts_.back() + filled);
+			filled = 0;
+		}
+		cell_chunk[cell] = static_cast<unsigned int>(chunk_verts_.size() - 1);
+		filled += cell_count[cell];
+	}
+	chunk_verts_.push_back(nverts);
+	size_t nchunks = chunk_verts_.size() - 1;
+
+	// 3. number the vertices chunk by chunk
+	DiskBuffer new_id;
+	if (!positions_.Create(dir, 12, cache) || !new_id.Create(dir, sizeof(HE_index), cache))
+	{
+		Close();
+		return false;
+	}
+	std::vector<size_t> fill(chunk_verts_.begin(), chunk_verts_.end() - 1);
+	std::vector<HE_index> ids(IO_RECORDS);
+	for (size_t first = 0; first < nverts; first += IO_RECORDS)
+	{
+		size_t n = std::min(IO_RECORDS, nverts - first);
+		raw_positions.Read(first, n, xyz.data());
+		for (size_t i = 0; i < n; i++)
+		{
+			unsigned int cell = Morton(CellCoord(xyz[3 * i], lo[0], scale[0]),
+				CellCoord(xyz[3 * i + 1], lo[1], scale[1]), CellCoord(xyz[3 * i + 2], lo[2], scale[2]));
+			size_t id = fill[cell_chunk[cell]]++;
+			ids[i] = static_cast<HE_index>(id);
+			positions_.Write(id, 1, &xyz[3 * i]);
+		}
+		new_id.Write(first, n, ids.data());
+	}
+	raw_positions.Close();
+
+	// 4. renumber the triangles, drop the broken ones, count them per chunk,
+	// then scatter them to every chunk they touch
+	DiskBuffer renumbered;
+	if (!renumbered.Create(dir, 12, cache) || !tris_.Create(dir, 12, cache))
+	{
+		Close();
+		return false;
+	}
+	std::vector<HE_index> in(3 * IO_RECORDS), out(3 * IO_RECORDS);
+	std::vector<size_t> chunk_count(nchunks, 0);
+	size_t ntris = 0;
+	for (size_t first = 0; first < nraw; first += IO_RECORDS)
+	{
+		size_t n = std::min(IO_RECORDS, nraw - first);
+		raw_tris.Read(first, n, in.data());
+		size_t kept = 0;
+		for (size_t t = 0; t < n; t++)
+		{
+			HE_index v[3];
+			bool ok = true;
+			for (int k = 0; k < 3 && ok; k++)
+			{
+				ok = in[3 * t + k] < nverts;
+				if (ok)
+				{
+					new_id.Read(in[3 * t + k], 1, &v[k]);
+				}
+			}
+			if (!ok || v[0] == v[1] || v[1] == v[2] || v[2] == v[0])
+			{
+				continue;
+			}
+			size_t c[3];
+			for (int k = 0; k < 3; k++)
+			{
+				c[k] = ChunkOf(chunk_verts_, v[k]);
+				out[3 * kept + k] = v[k];
+			}
+			chunk_count[c[0]]++;
+			if (c[1] != c[0])
+			{
+				chunk_count[c[1]]++;
+			}
+			if (c[2] != c[0] && c[2] != c[1])
+			{
+				chunk_count[c[2]]++;
+			}
+			kept++;
+		}
+		renumbered.Write(ntris, kept, out.data());
+		ntris += kept;
+	}
+	raw_tris.Close();
+	new_id.Close();
+	if (ntris == 0)
+	{
+		Close();
+		return false;
+	}
+
+	chunk_tris_.assign(nchunks + 1, 0);
+	for (size_t c = 0; c < nchunks; c++)
+	{
+		chunk_tris_[c + 1] = chunk_tris_[c] + chunk_count[c];
+	}
+	fill.assign(chunk_tris_.begin(), chunk_tris_.end() - 1);
+	for (size_t first = 0; first < ntris; first += IO_RECORDS)
+	{
+		size_t n = std::min(IO_RECORDS, ntris - first);
+		renumbered.Read(first, n, in.data());
+		for (size_t t = 0; t < n; t++)
+		{
+			const HE_index* v = &in[3 * t];
+			size_t c0 = ChunkOf(chunk_verts_, v[0]);
+			size_t c1 = ChunkOf(chunk_verts_, v[1]);
+			size_t c2 = ChunkOf(chunk_verts_, v[2]);
+			tris_.Write(fill[c0]++, 1, v);
+			if (c1 != c0)
+			{
+				tris_.Write(fill[c1]++, 1, v);
+			}
+			if (c2 != c0 && c2 != c1)
+			{
+				tris_.Write(fill[c2]++, 1, v);
+			}
+		}
+	}
+	bool ok = renumbered.good() && positions_.Flush() && tris_.Flush();
+	renumbered.Close();
+	if (!ok)
+	{
+		Close();
+		return false;
+	}
+	num_verts_ = nverts;
+	num_tris_ = ntris;
+	return true;
+}
+
+void MeshStream::ReadPositions(size_t first, size_t count, float* xyz)
+{
+	positions_.Read(first, count, xyz);
+}
+
+void MeshStream::ReadNormals(size_t first, size_t count, float* xyz)
+{
+	normals_.Read(first, count, xyz);
+}
+
+void MeshStream::LoadChunk(size_t c, DiskBuffer& positions, Chunk& chunk)
+{
+	chunk.first = chunk_verts_[c];
+	chunk.count = chunk_verts_[c + 1] - chunk.first;
+	size_t ntris = chunk_tris_[c + 1] - chunk_tris_[c];
+	chunk.tris.resize(3 * ntris);
+	tris_.Read(chunk_tris_[c], ntris, chunk.tris.data());
+
+	size_t first = chunk.first, last = chunk.first + chunk.count;
+	chunk.halo.clear();
+	for (size_t i = 0; i < chunk.tris.size(); i++)
+	{
+		if (chunk.tris[i] < first || chunk.tris[i] >= last)
+		{
+			chunk.halo.push_back(chunk.tris[i]);
+		}
+	}
+	std::sort(chunk.halo.begin(), chunk.halo.end());
+	chunk.halo.erase(std::unique(chunk.halo.begin(), chunk.halo.end()), chunk.halo.end());
+	parallel_for(0, chunk.tris.size(), [&](size_t i)
+	{
+		HE_index v = chunk.tris[i];
+		chunk.tris[i] = v >= first && v < last ? static_cast<HE_index>(v - first) : static_cast<HE_index>(
+			chunk.count + (std::lower_bound(chunk.halo.begin(), chunk.halo.end(), v) - chunk.halo.begin()));
+	});
+
+	ReadVertices(positions, chunk.first, chunk.count, chunk.halo.data(), chunk.halo.size(), chunk.pos);
+}
+
+void MeshStream::ReadVertices(DiskBuffer& buffer, size_t first, size_t count,
+	const HE_index* halo, size_t nhalo, std::vector<float>& xyz)
+{
+	// own vertices in one read, the halo in runs of consecutive ids
+	xyz.resize(3 * (count + nhalo));
+	buffer.Read(first, count, xyz.data());
+	for (size_t i = 0; i < nhalo;)
+	{
+		size_t run = 1;
+		while (i + run < nhalo && halo[i + run] == halo[i] + run)
+		{
+			run++;
+		}
+		buffer.Read(halo[i], run, &xyz[3 * (count + i)]);
+		i += run;
+	}
+}
+
+bool MeshStream::ComputeNormals(void)
+{
+	if (!isOpen())
+	{
+		return false;
+	}
+	if (!normals_.isOpen() && !normals_.Create(temp_directory_.c_str(), 12, CacheBytes()))
+	{
+		return false;
+	}
+
+	Chunk chunk;
+	std::vector<Vec3f> face_normal;
+	std::vector<float> corner_weight;
+	std::vector<Vec3f> normal;
+	std::vector<float> normal_xyz;
+	for (size_t c = 0; c + 1 < chunk_verts_.size(); c++)
+	{
+		LoadChunk(c, positions_, chunk);
+		size_t ntris = chunk.tris.size() / 3;
+		const float* xyz = chunk.pos.data();
+		auto pos = [xyz](HE_index v) {return Vec3f(xyz[3 * v], xyz[3 * v + 1], xyz[3 * v + 2]);};
+		face_normal.resize(ntris);
+		corner_weight.resize(3 * ntris);
+		parallel_for(0, ntris, [&](size_t t)
+		{
+			const HE_index* v = &chunk.tris[3 * t];
+			Vec3f n = (pos(v[1]) - pos(v[0])) ^ (pos(v[2]) - pos(v[0]));
+			float length = len(n);
+			face_normal[t] = length > 0.f ? n / length : n;
+			for (int k = 0; k < 3; k++)
+			{
+				float w = 1.f;
+				if (normal_weighting_ == NORMAL_AREA)
+				{
+					w = 0.5f * length;
+				}
+				else if (normal_weighting_ == NORMAL_ANGLE)
+				{
+					w = angle(pos(v[(k + 1) % 3]) - pos(v[k]), pos(v[(k + 2) % 3]) - pos(v[k]));
+				}
+				corner_weight[3 * t + k] = w;
+			}
+		});
+
+		normal.assign(chunk.count, Vec3f(0.f, 0.f, 0.f));
+		for (size_t t = 0; t < ntris; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				HE_index v = chunk.tris[3 * t + k];
+				if (v < chunk.count)
+				{
+					normal[v] += corner_weight[3 * t + k] * face_normal[t];
+				}
+			}
+		}
+		normal_xyz.resize(3 * chunk.count);
+		parallel_for(0, chunk.count, [&](size_t i)
+		{
+			float length = len(normal[i]);
+			Vec3f n = length > 0.f ? normal[i] / length : normal[i];
+			for (int k = 0; k < 3; k++)
+			{
+				normal_xyz[3 * i + k] = n[k];
+			}
+		});
+		normals_.Write(chunk.first, chunk.count, normal_xyz.data());
+	}
+	has_normals_ = normals_.Flush() && positions_.good() && tris_.good();
+	return has_normals_;
+}
+
+bool MeshStream::SmoothLaplacian(int iterations, float lambda)
+{
+	return Smooth(iterations, lambda, 0.f);
+}
+
+bool MeshStream::SmoothTaubin(int iterations, float lambda, float mu)
+{
+	return Smooth(iterations, lambda, mu);
+}
+
+bool MeshStream::Smooth(int iterations, float lambda, float mu)
+{
+	if (!isOpen() || iterations < 1)
+	{
+		return false;
+	}
+
+	// the rings do not change between the steps, so they are built once
+	DiskBuffer rings;
+	if (!rings.Create(temp_directory_.c_str(), sizeof(HE_index), CacheBytes()))
+	{
+		return false;
+	}
+	std::vector<size_t> ring_chunks(1, 0);
+	Chunk chunk;
+	std::vector<HE_index> record;
+	for (size_t c = 0; c + 1 < chunk_verts_.size(); c++)
+	{
+		LoadChunk(c, positions_, chunk);
+		BuildRings(chunk, record);
+		rings.Write(ring_chunks.back(), record.size(), record.data());
+		ring_chunks.push_back(ring_chunks.back() + record.size());
+	}
+	if (!rings.Flush())
+	{
+		return false;
+	}
+
+	for (int it = 0; it < iterations; it++)
+	{
+		if (!SmoothStep(lambda, rings, ring_chunks) || (mu != 0.f && !SmoothStep(mu, rings, ring_chunks)))
+		{
+			return false;
+		}
+	}
+	return !has_normals_ || ComputeNormals();
+}
+
+void MeshStream::BuildRings(const Chunk& chunk, std::vector<HE_index>& record)
+{
+	size_t count = chunk.count;
+
+	// the edges at own vertices with the number of their triangles; an
+	// edge of a single triangle makes its ends boundary vertices
+	std::vector<unsigned long long> edges;
+	edges.reserve(chunk.tris.size());
+	for (size_t t = 0; 3 * t < chunk.tris.size(); t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			HE_index a = chunk.tris[3 * t + k], b = chunk.tris[3 * t + (k + 1) % 3];
+			if (a < count || b < count)
+			{
+				HE_index lo = std::min(a, b), hi = std::max(a, b);
+				edges.push_back(static_cast<unsigned long long>(lo) << 32 | hi);
+			}
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	std::vector<unsigned char> boundary(count, 0);
+	for (size_t i = 0; i < edges.size();)
+	{
+		size_t j = i + 1;
+		while (j < edges.size() && edges[j] == edges[i])
+		{
+			j++;
+		}
+		if (j - i == 1)
+		{
+			HE_index a = static_cast<HE_index>(edges[i] >> 32), b = static_cast<HE_index>(edges[i]);
+			if (a < count)
+			{
+				boundary[a] = 1;
+			}
+			if (b < count)
+			{
+				boundary[b] = 1;
+			}
+		}
+		i = j;
+	}
+	edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+	// [halo size, halo, ring starts of the own vertices, rings in local ids],
+	// the boundary vertices have empty rings and stay
+	size_t nhalo = chunk.halo.size();
+	record.assign(1 + nhalo + count + 1, 0);
+	record[0] = static_cast<HE_index>(nhalo);
+	std::copy(chunk.halo.begin(), chunk.halo.end(), record.begin() + 1);
+	HE_index* ring_start = &record[1 + nhalo];
+	for (size_t i = 0; i < edges.size(); i++)
+	{
+		HE_index a = static_cast<HE_index>(edges[i] >> 32), b = static_cast<HE_index>(edges[i]);
+		if (a < count && !boundary[a])
+		{
+			ring_start[a + 1]++;
+		}
+		if (b < count && !boundary[b])
+		{
+			ring_start[b + 1]++;
+		}
+	}
+	for (size_t v = 0; v < count; v++)
+	{
+		ring_start[v + 1] += ring_start[v];
+	}
+	size_t base = record.size();
+	record.resize(base + ring_start[count]);
+	ring_start = &record[1 + nhalo];
+	std::vector<HE_index> fill(ring_start, ring_start + count);
+	for (size_t i = 0; i < edges.size(); i++)
+	{
+		HE_index a = static_cast<HE_index>(edges[i] >> 32), b = static_cast<HE_index>(edges[i]);
+		if (a < count && !boundary[a])
+		{
+			record[base + fill[a]++] = b;
+		}
+		if (b < count && !boundary[b])
+		{
+			record[base + fill[b]++] = a;
+		}
+	}
+}
+
+bool MeshStream::SmoothStep(float factor, DiskBuffer& rings, const std::vector<size_t>& ring_chunks)
+{
+	DiskBuffer next;
+	if (!next.Create(temp_directory_.c_str(), 12, CacheBytes()))
+	{
+		return false;
+	}
+
+	std::vector<HE_index> record;
+	std::vector<float> pos, moved;
+	for (size_t c = 0; c + 1 < chunk_verts_.size(); c++)
+	{
+		size_t first = chunk_verts_[c], count = chunk_verts_[c + 1] - first;
+		record.resize(ring_chunks[c + 1] - ring_chunks[c]);
+		rings.Read(ring_chunks[c], record.size(), record.data());
+		size_t nhalo = record[0];
+		const HE_index* ring_start = &record[1 + nhalo];
+		const HE_index* ring = ring_start + count + 1;
+		ReadVertices(positions_, first, count, &record[1], nhalo, pos);
+
+		moved.resize(3 * count);
+		parallel_for(0, count, [&](size_t v)
+		{
+			HE_index begin = ring_start[v], end = ring_start[v + 1];
+			float mean[3] = {0.f, 0.f, 0.f};
+			for (HE_index j = begin; j < end; j++)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					mean[k] += pos[3 * ring[j] + k];
+				}
+			}
+			float step = begin < end ? factor : 0.f;
+			float inv = begin < end ? 1.f / (end - begin) : 0.f;
+			for (int k = 0; k < 3; k++)
+			{
+				moved[3 * v + k] = pos[3 * v + k] + step * (mean[k] * inv - pos[3 * v + k]);
+			}
+		});
+		next.Write(first, count, moved.data());
+	}
+	if (!next.Flush() || !positions_.good() || !rings.good())
+	{
+		return false;
+	}
+	positions_.swap(next);
+	return true;
+}
+
+bool MeshStream::Simplify(float cell_size, const char* fouts)
+{
+	if (!isOpen() || !(cell_size > 0.f))
+	{
+		return false;
+	}
+	struct Cell
+	{
+		Quadric			quadric;
+		double			sum[3];		//!< of the positions in the cell
+		unsigned int	count;
+
+		Cell(void) : count(0)
+		{
+			sum[0] = sum[1] = sum[2] = 0.0;
+		}
+	};
+	const unsigned long long AXIS_MASK = (1ull << 21) - 1;
+	double inv_cell = 1.0 / cell_size;
+	auto key_of = [&](const float* p)
+	{
+		unsigned long long key = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			double c = std::floor((p[k] - bbox_[2 * k]) * inv_cell);
+			key |= std::min(static_cast<unsigned long long>(std::max(c, 0.0)), AXIS_MASK) << (21 * k);
+		}
+		return key;
+	};
+
+	// the quadrics of the cells and the triangles over three cells
+	std::unordered_map<unsigned long long, Cell> cells;
+	DiskBuffer kept;
+	if (!kept.Create(temp_directory_.c_str(), 3 * sizeof(unsigned long long), CacheBytes()))
+	{
+		return false;
+	}
+	size_t nkept = 0;
+	Chunk chunk;
+	std::vector<unsigned long long> keys;
+	for (size_t c = 0; c + 1 < chunk_verts_.size(); c++)
+	{
+		LoadChunk(c, positions_, chunk);
+		size_t nlocal = chunk.pos.size() / 3;
+		keys.resize(nlocal);
+		parallel_for(0, nlocal, [&](size_t v)
+		{
+			keys[v] = key_of(&chunk.pos[3 * v]);
+		});
+		for (size_t v = 0; v < chunk.count; v++)
+		{
+			Cell& cell = cells[keys[v]];
+			for (int k = 0; k < 3; k++)
+			{
+				cell.sum[k] += chunk.pos[3 * v + k];
+			}
+			cell.count++;
+		}
+		for (size_t t = 0; 3 * t < chunk.tris.size(); t++)
+		{
+			if (!chunk.primary(t))
+			{
+				continue;
+			}
+			const HE_index* v = &chunk.tris[3 * t];
+			const float* p0 = &chunk.pos[3 * v[0]];
+			const float* p1 = &chunk.pos[3 * v[1]];
+			const float* p2 = &chunk.pos[3 * v[2]];
+			double e1[3], e2[3];
+			for (int k = 0; k < 3; k++)
+			{
+				e1[k] = p1[k] - p0[k];
+				e2[k] = p2[k] - p0[k];
+			}
+			double n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+			double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			if (length > 0.0)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					n[k] /= length;
+				}
+				// weighted by the area
+				Quadric q(n[0], n[1], n[2], -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]), 0.5 * length);
+				for (int k = 0; k < 3; k++)
+				{
+					cells[keys[v[k]]].quadric += q;
+				}
+			}
+			unsigned long long tri[3] = {keys[v[0]], keys[v[1]], keys[v[2]]};
+			if (tri[0] != tri[1] && tri[1] != tri[2] && tri[2] != tri[0])
+			{
+				kept.Write(nkept++, 1, tri);
+			}
+		}
+	}
+	if (!kept.Flush() || !positions_.good() || !tris_.good())
+	{
+		return false;
+	}
+
+	// one vertex per cell, at the minimum of its quadric if that lies in the cell
+	std::vector<unsigned long long> cell_keys;
+	cell_keys.reserve(cells.size());
+	for (std::unordered_map<unsigned long long, Cell>::const_iterator it = cells.begin(); it != cells.end(); ++it)
+	{
+		cell_keys.push_back(it->first);
+	}
+	std::sort(cell_keys.begin(), cell_keys.end());
+	std::vector<Vec3f> points(cell_keys.size());
+	parallel_for(0, cell_keys.size(), [&](size_t i)
+	{
+		const Cell& cell = cells.find(cell_keys[i])->second;
+		double p[3];
+		bool inside = cell.quadric.Minimum(p);
+		for (int k = 0; k < 3 && inside; k++)
+		{
+			double lo = bbox_[2 * k] + ((cell_keys[i] >> (21 * k)) & AXIS_MASK) * static_cast<double>(cell_size);
+			inside = p[k] >= lo && p[k] <= lo + cell_size;
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			points[i][k] = static_cast<float>(inside ? p[k] : cell.sum[k] / cell.count);
+		}
+	});
+	cells.clear();
+
+	// the surviving triangles. A triangle that would repeat a directed edge,
+	// where the clustering folded the surface onto itself, is dropped so the
+	// result stays an edge-manifold mesh Mesh3D can load
+	std::vector<HE_index> tris(3 * nkept);
+	std::vector<unsigned long long> tri_keys;
+	for (size_t first = 0; first < nkept; first += IO_RECORDS)
+	{
+		size_t n = std::min(IO_RECORDS, nkept - first);
+		tri_keys.resize(3 * n);
+		kept.Read(first, n, tri_keys.data());
+		parallel_for(0, 3 * n, [&](size_t i)
+		{
+			tris[3 * first + i] = static_cast<HE_index>(
+				std::lower_bound(cell_keys.begin(), cell_keys.end(), tri_keys[i]) - cell_keys.begin());
+		});
+	}
+	kept.Close();
+	HalfEdgeHash used;
+	used.reserve(3 * nkept);
+	size_t ntris = 0;
+	for (size_t t = 0; t < nkept; t++)
+	{
+		const HE_index* v = &tris[3 * t];
+		if (used.find(v[0], v[1]) != HE_INVALID_INDEX || used.find(v[1], v[2]) != HE_INVALID_INDEX ||
+			used.find(v[2], v[0]) != HE_INVALID_INDEX)
+		{
+			continue;
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			used.insert(v[k], v[(k + 1) % 3], static_cast<HE_index>(ntris));
+			tris[3 * ntris + k] = v[k];
+		}
+		ntris++;
+	}
+
+	FILE* file = fopen(fouts, "wb");
+	if (file == NULL)
+	{
+		return false;
+	}
+	bool ok = WriteHeader(file, "g object\n");
+	ok = ok && WriteChunked(file, points.size(), 3 + 3 * FLOAT_TEXT_CHARS, [&](size_t begin, size_t end, char* text)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			text = AppendText(text, "v");
+			text = AppendFloat(AppendFloat(AppendFloat(text, points[i][0]), points[i][1]), points[i][2]);
+			*text++ = '\n';
+		}
+		return text;
+	});
+	ok = ok && WriteChunked(file, ntris, 2 + 3 * (1 + INDEX_TEXT_CHARS), [&](size_t begin, size_t end, char* text)
+	{
+		for (size_t t = begin; t < end; t++)
+		{
+			text = AppendText(text, "f");
+			for (int k = 0; k < 3; k++)
+			{
+				*text++ = ' ';
+				text = AppendIndex(text, static_cast<size_t>(tris[3 * t + k]) + 1);
+			}
+			*text++ = '\n';
+		}
+		return text;
+	});
+	return FinishWrite(file, fouts, ok);
+}
+
+bool MeshStream::WriteToOBJFile(const char* fouts)
+{
+	if (!isOpen())
+	{
+		return false;
+	}
+	FILE* file = fopen(fouts, "wb");
+	if (file == NULL)
+	{
+		return false;
+	}
+	bool ok = WriteHeader(file, "g object\n");
+
+	// the vertices, then the normals, a block of them at a time
+	std::vector<float> xyz;
+	for (int pass = 0; pass < (has_normals_ ? 2 : 1) && ok; pass++)
+	{
+		DiskBuffer& buffer = pass == 0 ? positions_ : normals_;
+		const char* tag = pass == 0 ? "v" : "vn";
+		for (size_t first = 0; first < num_verts_ && ok; first += IO_RECORDS)
+		{
+			size_t n = std::min(IO_RECORDS, num_verts_ - first);
+			xyz.resize(3 * n);
+			buffer.Read(first, n, xyz.data());
+			ok = WriteChunked(file, n, 4 + 3 * FLOAT_TEXT_CHARS, [&](size_t begin, size_t end, char* text)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					text = AppendText(text, tag);
+					text = AppendFloat(AppendFloat(AppendFloat(text, xyz[3 * i]), xyz[3 * i + 1]), xyz[3 * i + 2]);
+					*text++ = '\n';
+				}
+				return text;
+			});
+		}
+	}
+
+	// the triangles chunk by chunk, each from the first chunk that has it
+	std::vector<HE_index> tris;
+	for (size_t c = 0; c + 1 < chunk_verts_.size() && ok; c++)
+	{
+		size_t ntris = chunk_tris_[c + 1] - chunk_tris_[c];
+		tris.resize(3 * ntris);
+		tris_.Read(chunk_tris_[c], ntris, tris.data());
+		size_t first = chunk_verts_[c], nprimary = 0;
+		for (size_t t = 0; t < ntris; t++)
+		{
+			if (tris[3 * t] >= first && tris[3 * t + 1] >= first && tris[3 * t + 2] >= first)
+			{
+				std::copy(&tris[3 * t], &tris[3 * t] + 3, &tris[3 * nprimary++]);
+			}
+		}
+		ok = WriteChunked(file, nprimary, 2 + 3 * (3 + 2 * INDEX_TEXT_CHARS), [&](size_t begin, size_t end, char* text)
+		{
+			for (size_t t = begin; t < end; t++)
+			{
+				text = AppendText(text, "f");
+				for (int k = 0; k < 3; k++)
+				{
+					size_t v = static_cast<size_t>(tris[3 * t + k]) + 1;
+					*text++ = ' ';
+					text = AppendIndex(text, v);
+					if (has_normals_)
+					{
+						text = AppendText(text, "//");
+						text = AppendIndex(text, v);
+					}
+				}
+				*text++ = '\n';
+			}
+			return text;
+		});
+	}
+	ok = ok && positions_.good() && tris_.good() && (!has_normals_ || normals_.good());
+	return FinishWrite(file, fouts, ok);
+}
+
+bool MeshStream::WriteToPLYFile(const char* fouts)
+{
+	if (!isOpen())
+	{
+		return false;
+	}
+	FILE* file = fopen(fouts, "wb");
+	if (file == NULL)
+	{
+		return false;
+	}
+	std::string header = "ply\nformat binary_little_endian 1.0\n";
+	header += "element vertex " + std::to_string(num_verts_) + "\n";
+	header += "property float x\nproperty float y\nproperty float z\n";
+	if (has_normals_)
+	{
+		header += "property float nx\nproperty float ny\nproperty float nz\n";
+	}
+	header += "element face " + std::to_string(num_tris_) + "\n";
+	header += "property list uchar int vertex_indices\nend_header\n";
+	bool ok = WriteHeader(file, header);
+
+	std::vector<float> xyz, normal;
+	for (size_t first = 0; first < num_verts_ && ok; first += IO_RECORDS)
+	{
+		size_t n = std::min(IO_RECORDS, num_verts_ - first);
+		xyz.resize(3 * n);
+		positions_.Read(first, n, xyz.data());
+		if (has_normals_)
+		{
+			normal.resize(3 * n);
+			normals_.Read(first, n, normal.data());
+		}
+		ok = WriteChunked(file, n, 24, [&](size_t begin, size_t end, char* out)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				out = AppendBytes(out, &xyz[3 * i], 12);
+				if (has_normals_)
+				{
+					out = AppendBytes(out, &normal[3 * i], 12);
+				}
+			}
+			return out;
+		});
+	}
+
+	std::vector<HE_index> tris;
+	for (size_t c = 0; c + 1 < chunk_verts_.size() && ok; c++)
+	{
+		size_t ntris = chunk_tris_[c + 1] - chunk_tris_[c];
+		tris.resize(3 * ntris);
+		tris_.Read(chunk_tris_[c], ntris, tris.data());
+		size_t first = chunk_verts_[c];
+		ok = WriteChunked(file, ntris, 13, [&](size_t begin, size_t end, char* out)
+		{
+			for (size_t t = begin; t < end; t++)
+			{
+				const HE_index* v = &tris[3 * t];
+				if (v[0] >= first && v[1] >= first && v[2] >= first)
+				{
+					*out++ = 3;
+					out = AppendBytes(out, v, 12);
+				}
+			}
+			return out;
+		});
+	}
+	ok = ok && positions_.good() && tris_.good() && (!has_normals_ || normals_.good());
+	return FinishWrite(file, fouts, ok);
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Mesh3D.h"
+#include "DiskBuffer.h"
+
+/*!
+*	Out-of-core processing of triangle meshes larger than memory.
+*
+*	Open reads an OBJ file block by block and keeps the mesh in disk
+*	buffers: the positions, the normals and the triangles, polygons being
+*	split into fans. The vertices are grouped into spatially coherent
+*	chunks: a 64^3 grid over the bounding box is walked in Morton order and
+*	consecutive cells are gathered until a chunk holds chunk_vertices()
+*	vertices. The vertices are then numbered chunk by chunk. Every chunk
+*	stores all the triangles that touch one of its own vertices, so the
+*	one-rings of its vertices are complete; a triangle across chunks is
+*	stored in each of them. The other vertices of these triangles are the
+*	halo of the chunk, read along with it.
+*
+*	Every operation visits one chunk at a time, so the memory stays within
+*	the budget whatever the size of the mesh: the caches of the disk buffers
+*	plus one chunk and its halo. Only the offsets of the chunks are kept for
+*	the whole mesh. A smoothing step reads the positions of the previous
+*	step and writes a second buffer, so every step is one pass over the
+*	chunks and gives the same result as in memory. The exported files list
+*	the vertices in chunk order.
+*/
+class MeshStream
+{
+	//! the part of the mesh one chunk works on
+	struct Chunk
+	{
+		size_t					first;		//!< its own vertices are [first, first + count)
+		size_t					count;
+		std::vector<HE_index>	tris;		//!< 3 local ids per triangle: own vertices, then the halo
+		std::vector<HE_index>	halo;		//!< global ids of the halo vertices, sorted
+		std::vector<float>		pos;		//!< xyz of every local vertex
+
+		//! global id of local vertex v
+		inline size_t global(HE_index v) const {return v < count ? first + v : halo[v - count];}
+		//! whether triangle t belongs to this chunk and not to one before it
+		inline bool primary(size_t t) const
+		{
+			return global(tris[3 * t]) >= first && global(tris[3 * t + 1]) >= first && global(tris[3 * t + 2]) >= first;
+		}
+	};
+
+	std::string				temp_directory_;	//!< where the disk buffers go, "" for the system default
+	size_t					memory_budget_;		//!< bytes
+	NormalWeighting			normal_weighting_;
+
+	size_t					num_verts_;
+	size_t					num_tris_;			//!< distinct triangles
+	float					bbox_[6];			//!< xmin xmax ymin ymax zmin zmax
+	std::vector<size_t>		chunk_verts_;		//!< vertices of chunk c are [chunk_verts_[c], chunk_verts_[c + 1])
+	std::vector<size_t>		chunk_tris_;		//!< triangles of chunk c in tris_, likewise
+	DiskBuffer				positions_;			//!< xyz per vertex
+	DiskBuffer				normals_;			//!< xyz per vertex, once ComputeNormals ran
+	DiskBuffer				tris_;				//!< 3 global vertex ids per triangle, by chunk
+	bool					has_normals_;
+
+	MeshStream(const MeshStream&);
+	MeshStream& operator=(const MeshStream&);
+
+public:
+	MeshStream(void);
+	~MeshStream(void);
+
+	//! memory for caches and chunks in bytes, 256 MB by default; takes effect on Open
+	inline void set_memory_budget(size_t bytes) {memory_budget_ = bytes;}
+	inline size_t memory_budget(void) const {return memory_budget_;}
+	//! directory of the temporary files, the system default if empty
+	inline void set_temp_directory(const char* directory) {temp_directory_ = directory != NULL ? directory : "";}
+	//! weighting of the face normals in ComputeNormals, NORMAL_UNIFORM by default
+	inline void set_normal_weighting(NormalWeighting w) {normal_weighting_ = w;}
+
+	//! read the OBJ file into chunked disk buffers
+	/*!
+	*	\return false if the file can not be read, has no triangle, or a
+	*	temporary file can not be written
+	*/
+	bool Open(const char* fins);
+	//! drop the mesh and its temporary files
+	void Close(void);
+
+	inline bool isOpen(void) const {return positions_.isOpen();}
+	inline size_t num_of_vertices(void) const {return num_verts_;}
+	inline size_t num_of_triangles(void) const {return num_tris_;}
+	inline size_t num_of_chunks(void) const {return chunk_verts_.empty() ? 0 : chunk_verts_.size() - 1;}
+	inline bool has_normals(void) const {return has_normals_;}
+	//! the most vertices a chunk gets under the memory budget
+	size_t chunk_vertices(void) const;
+
+	//! copy the xyz of the vertices [first, first + count) to xyz
+	void ReadPositions(size_t first, size_t count, float* xyz);
+	//! copy the normals of the vertices [first, first + count) to xyz
+	void ReadNormals(size_t first, size_t count, float* xyz);
+
+	//! compute the vertex normals from the incident triangles
+	bool ComputeNormals(void);
+	//! uniform Laplacian smoothing, boundary vertices stay, see Mesh3D::SmoothLaplacian
+	/*!
+	*	the normals are computed again if there were any
+	*/
+	bool SmoothLaplacian(int iterations, float lambda = 0.5f);
+	//! Taubin lambda|mu smoothing with uniform weights, see Mesh3D::SmoothTaubin
+	bool SmoothTaubin(int iterations, float lambda = 0.5f, float mu = -0.53f);
+
+	//! simplify by vertex clustering and write the result to an OBJ file
+	/*!
+	*	every cell of a grid of side cell_size becomes one vertex, placed where
+	*	the quadric of the triangles in the cell is smallest (Lindstrom 2000);
+	*	triangles over three cells survive. The memory grows with the output,
+	*	so cell_size bounds it.
+	*/
+	bool Simplify(float cell_size, const char* fouts);
+
+	//! export the positions, the normals if computed, and the triangles
+	bool WriteToOBJFile(const char* fouts);
+	//! export to a binary little-endian PLY file
+	bool WriteToPLYFile(const char* fouts);
+
+private:
+	//! bytes of the page cache of one disk buffer
+	size_t CacheBytes(void) const;
+	//! read the triangles of chunk c, its vertices and halo from positions
+	void LoadChunk(size_t c, DiskBuffer& positions, Chunk& chunk);
+	//! read the records [first, first + count) and then the halo records into xyz
+	void ReadVertices(DiskBuffer& buffer, size_t first, size_t count,
+		const HE_index* halo, size_t nhalo, std::vector<float>& xyz);
+	bool Smooth(int iterations, float lambda, float mu);
+	//! the halo and the one-rings of the own vertices of a chunk, as one record
+	void BuildRings(const Chunk& chunk, std::vector<HE_index>& record);
+	//! one smoothing step p += factor * (mean of the ring - p)
+	bool SmoothStep(float factor, DiskBuffer& rings, const std::vector<size_t>& ring_chunks);
+};
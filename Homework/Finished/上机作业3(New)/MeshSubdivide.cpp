@@ -0,0 +1,292 @@
+#include "Mesh3D.h"
+
+#include <cmath>
+
+// Loop and Catmull-Clark subdivision.
+//
+// Every old half-edge h is split into the new half-edges 2h (from its start
+// to the edge point) and 2h + 1 (from the edge point to its end), so the
+// pair of 2h is 2 pair(h) + 1 and nothing has to be looked up. The edge
+// point of h is found through the edge id shared by h and its pair. The
+// half-edges inside the old faces follow after 2 * nedges, a fixed number
+// per face for Loop and per corner for Catmull-Clark. All the index arrays
+// are filled in parallel and handed to BuildFromIndices.
+
+namespace
+{
+	const double PI = 3.14159265358979323846;
+
+	//! Loop's weight of every neighbour of an inner vertex of valence n
+	inline float LoopBeta(int n)
+	{
+		double c = 0.375 + 0.25 * std::cos(2.0 * PI / n);
+		return static_cast<float>((0.625 - c * c) / n);
+	}
+}
+
+bool Mesh3D::Subdivide(Mesh3D& result, SubdivisionScheme scheme, int levels)
+{
+	if (&result == this || !isValid() || levels < 1)
+	{
+		return false;
+	}
+	if (scheme == SUBDIVISION_LOOP)
+	{
+		for (int i = 0; i < num_of_face_list(); i++)
+		{
+			if (face_arena_[i].valence_ != 3)
+			{
+				return false;
+			}
+		}
+	}
+
+	// the intermediate levels only need the connectivity and the positions
+	Mesh3D temp[2];
+	Mesh3D* from = this;
+	for (int level = 0; level < levels; level++)
+	{
+		Mesh3D* to = level + 1 == levels ? &result : &temp[level % 2];
+		from->SubdivideOnce(*to, scheme);
+		from = to;
+	}
+	result.UpdateMesh();
+	return true;
+}
+
+void Mesh3D::SubdivideOnce(Mesh3D& result, SubdivisionScheme scheme)
+{
+	size_t nverts = static_cast<size_t>(num_of_vertex_list());
+	size_t nhalfedges = static_cast<size_t>(num_of_half_edges_list());
+	size_t nfaces = static_cast<size_t>(num_of_face_list());
+	bool loop = scheme == SUBDIVISION_LOOP;
+
+	// the half-edges of every face in a row, starting at its pedge_
+	std::vector<HE_index> face_start(nfaces + 1, 0);
+	for (size_t f = 0; f < nfaces; f++)
+	{
+		face_start[f + 1] = face_start[f] + face_arena_[static_cast<HE_index>(f)].valence_;
+	}
+	size_t ncorners = face_start[nfaces];
+	std::vector<HE_index> corner_he(ncorners);
+	parallel_for(0, nfaces, [&](size_t f)
+	{
+		HE_edge* edge = face_arena_[static_cast<HE_index>(f)].pedge_;
+		for (HE_index c = face_start[f]; c < face_start[f + 1]; c++, edge = edge->pnext_)
+		{
+			corner_he[c] = edge->id_;
+		}
+	});
+
+	// one id per edge, shared by its two half-edges
+	std::vector<HE_index> edge_of(nhalfedges), edge_he;
+	edge_he.reserve(nhalfedges / 2);
+	for (size_t h = 0; h < nhalfedges; h++)
+	{
+		HE_edge& e = edge_arena_[static_cast<HE_index>(h)];
+		if (e.id_ < e.ppair_->id_)
+		{
+			edge_of[h] = static_cast<HE_index>(edge_he.size());
+			edge_he.push_back(static_cast<HE_index>(h));
+		}
+	}
+	parallel_for(0, nhalfedges, [&](size_t h)
+	{
+		HE_edge& e = edge_arena_[static_cast<HE_index>(h)];
+		if (e.id_ > e.ppair_->id_)
+		{
+			edge_of[h] = edge_of[e.ppair_->id_];
+		}
+	});
+	size_t nedges = edge_he.size();
+
+	// new vertices: old ones, edge points, face points
+	HE_index edge_point = static_cast<HE_index>(nverts);
+	HE_index face_point = static_cast<HE_index>(nverts + nedges);
+	size_t new_nverts = nverts + nedges + (loop ? 0 : nfaces);
+	size_t new_nfaces = loop ? 4 * nfaces : ncorners;
+	size_t inner = 2 * nhalfedges;		// first half-edge inside an old face
+	size_t new_nhalfedges = inner + (loop ? 6 * nfaces : 2 * ncorners);
+
+	std::vector<HE_index> he_vert(new_nhalfedges), he_pair(new_nhalfedges), he_face(new_nhalfedges);
+	std::vector<HE_index> he_next(new_nhalfedges), he_prev(new_nhalfedges);
+	std::vector<HE_index> vert_edge(new_nverts), face_edge(new_nfaces);
+
+	// the two halves of every old half-edge, linked inside the faces below
+	parallel_for(0, nhalfedges, [&](size_t h)
+	{
+		HE_edge& e = edge_arena_[static_cast<HE_index>(h)];
+		HE_index pair = e.ppair_->id_;
+		he_vert[2 * h] = edge_point + edge_of[h];
+		he_vert[2 * h + 1] = e.pvert_->id_;
+		he_pair[2 * h] = 2 * pair + 1;
+		he_pair[2 * h + 1] = 2 * pair;
+		if (e.pface_ == NULL)
+		{
+			he_face[2 * h] = he_face[2 * h + 1] = HE_INVALID_INDEX;
+			he_next[2 * h] = he_next[2 * h + 1] = HE_INVALID_INDEX;
+			he_prev[2 * h] = he_prev[2 * h + 1] = HE_INVALID_INDEX;
+		}
+	});
+
+	parallel_for(0, nfaces, [&](size_t f)
+	{
+		HE_index s = face_start[f];
+		HE_index n = face_start[f + 1] - s;
+		for (HE_index k = 0; k < n; k++)
+		{
+			HE_index hk = corner_he[s + k];				// from corner k to corner k + 1
+			HE_index hp = corner_he[s + (k + n - 1) % n];	// from corner k - 1 to corner k
+			HE_index a = 2 * hk;						// corner k to edge point k
+			HE_index d = 2 * hp + 1;					// edge point k - 1 to corner k
+			if (loop)
+			{
+				// corner triangle k and the middle triangle 3
+				HE_index base = static_cast<HE_index>(inner + 6 * f);
+				HE_index b = base + k;					// edge point k to edge point k - 1
+				HE_index m = base + 3 + k;				// its pair, in the middle triangle
+				HE_index face = static_cast<HE_index>(4 * f + k);
+				he_vert[b] = edge_point + edge_of[hp];
+				he_pair[b] = m;
+				he_vert[m] = edge_point + edge_of[hk];
+				he_pair[m] = b;
+				he_face[a] = he_face[b] = he_face[d] = face;
+				he_next[a] = b; he_next[b] = d; he_next[d] = a;
+				he_prev[a] = d; he_prev[b] = a; he_prev[d] = b;
+				he_face[m] = static_cast<HE_index>(4 * f + 3);
+				he_next[m] = base + 3 + (k + 1) % 3;
+				he_prev[m] = base + 3 + (k + 2) % 3;
+				face_edge[face] = a;
+			}
+			else
+			{
+				// quad k: corner k, edge point k, face point, edge point k - 1
+				HE_index base = static_cast<HE_index>(inner + 2 * s);
+				HE_index b = base + 2 * k;				// edge point k to the face point
+				HE_index c = base + 2 * k + 1;			// face point to edge point k - 1
+				HE_index face = s + k;
+				he_vert[b] = face_point + static_cast<HE_index>(f);
+				he_pair[b] = base + 2 * ((k + 1) % n) + 1;
+				he_vert[c] = edge_point + edge_of[hp];
+				he_pair[c] = base + 2 * ((k + n - 1) % n);
+				he_face[a] = he_face[b] = he_face[c] = he_face[d] = face;
+				he_next[a] = b; he_next[b] = c; he_next[c] = d; he_next[d] = a;
+				he_prev[a] = d; he_prev[b] = a; he_prev[c] = b; he_prev[d] = c;
+				face_edge[face] = a;
+			}
+		}
+		if (loop)
+		{
+			face_edge[4 * f + 3] = static_cast<HE_index>(inner + 6 * f + 3);
+		}
+		else
+		{
+			vert_edge[face_point + f] = static_cast<HE_index>(inner + 2 * s + 1);
+		}
+	});
+
+	// outgoing half-edges, on the boundary if there is one as BoundaryCheck wants
+	parallel_for(0, nverts, [&](size_t v)
+	{
+		HE_edge* e = vertex_arena_[static_cast<HE_index>(v)].pedge_;
+		vert_edge[v] = e == NULL ? HE_INVALID_INDEX : 2 * e->id_;
+	});
+	parallel_for(0, nedges, [&](size_t i)
+	{
+		HE_edge& e = edge_arena_[edge_he[i]];
+		HE_index h = e.ppair_->pface_ == NULL ? e.ppair_->id_ : e.id_;
+		vert_edge[edge_point + i] = 2 * h + 1;
+	});
+
+	// geometry
+	std::vector<Vec3f> pos(new_nverts);
+	if (!loop)
+	{
+		parallel_for(0, nfaces, [&](size_t f)
+		{
+			Vec3f sum(0.f, 0.f, 0.f);
+			for (HE_index c = face_start[f]; c < face_start[f + 1]; c++)
+			{
+				sum += edge_arena_[corner_he[c]].pvert_->position_;
+			}
+			pos[face_point + f] = sum / static_cast<float>(face_start[f + 1] - face_start[f]);
+		});
+	}
+	parallel_for(0, nedges, [&](size_t i)
+	{
+		HE_edge& e = edge_arena_[edge_he[i]];
+		const Vec3f& a = e.ppair_->pvert_->position_;
+		const Vec3f& b = e.pvert_->position_;
+		if (e.pface_ == NULL || e.ppair_->pface_ == NULL)
+		{
+			pos[edge_point + i] = 0.5f * (a + b);
+		}
+		else if (loop)
+		{
+			const Vec3f& c = e.pnext_->pvert_->position_;
+			const Vec3f& d = e.ppair_->pnext_->pvert_->position_;
+			pos[edge_point + i] = 0.375f * (a + b) + 0.125f * (c + d);
+		}
+		else
+		{
+			pos[edge_point + i] = 0.25f * (a + b + pos[face_point + e.pface_->id_] + pos[face_point + e.ppair_->pface_->id_]);
+		}
+	});
+	parallel_for(0, nverts, [&](size_t i)
+	{
+		HE_vert& hv = vertex_arena_[static_cast<HE_index>(i)];
+		const Vec3f& p = hv.position_;
+		pos[i] = p;
+		HE_edge* start = hv.pedge_;
+		if (start == NULL)
+		{
+			return;
+		}
+
+		Vec3f ring(0.f, 0.f, 0.f), faces(0.f, 0.f, 0.f);
+		int n = 0;
+		HE_edge* e = start;
+		HE_edge* last = start;
+		do
+		{
+			ring += e->pvert_->position_;
+			if (!loop && e->pface_ != NULL)
+			{
+				faces += pos[face_point + e->pface_->id_];
+			}
+			n++;
+			last = e;
+			e = e->ppair_->pnext_;
+		} while (e != NULL && e != start);
+
+		if (start->pface_ == NULL)
+		{
+			// boundary: pedge_ runs along it, the walk stopped at the other boundary edge;
+			// a corner of a single face stays where it is
+			if (n > 2)
+			{
+				pos[i] = 0.75f * p + 0.125f * (start->pvert_->position_ + last->pvert_->position_);
+			}
+		}
+		else if (loop)
+		{
+			float beta = LoopBeta(n);
+			pos[i] = (1.f - n * beta) * p + beta * ring;
+		}
+		else
+		{
+			// (F + 2 R + (n - 3) p) / n with R the mean of the edge midpoints
+			Vec3f r = 0.5f * (ring / static_cast<float>(n) + p);
+			pos[i] = (faces / static_cast<float>(n) + 2.f * r + (n - 3.f) * p) / static_cast<float>(n);
+		}
+	});
+
+	result.ReleaseStandardProperties();
+	result.BuildFromIndices(static_cast<int>(new_nverts), static_cast<int>(new_nhalfedges), static_cast<int>(new_nfaces),
+		he_vert.data(), he_pair.data(), he_face.data(), he_next.data(), he_prev.data(),
+		vert_edge.data(), face_edge.data());
+	parallel_for(0, new_nverts, [&](size_t i)
+	{
+		result.vertex_arena_[static_cast<HE_index>(i)].position_ = pos[i];
+	});
+}
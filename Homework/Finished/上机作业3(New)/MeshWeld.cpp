@@ -0,0 +1,208 @@
+#include "MeshIO.h"
+#include "MeshParallel.h"
+#include "HalfEdgeHash.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Welding of coincident OBJ vertices.
+//
+// The vertices are bucketed by the grid cell of side tolerance they fall in,
+// with a counting sort over a hash of the cell. Every vertex then looks
+// through the 27 cells around it for the smallest index within tolerance
+// and points to it; following the pointers in index order merges chains.
+// The faces are remapped to the surviving vertices before any connectivity
+// is built. The corners keep their own texture and normal indices, so the
+// seams of the texture stay on the half-edges.
+
+namespace
+{
+	inline unsigned long long HashCell(long long x, long long y, long long z)
+	{
+		unsigned long long h = static_cast<unsigned long long>(x) * 0x9E3779B97F4A7C15ull;
+		h ^= static_cast<unsigned long long>(y) * 0xC2B2AE3D27D4EB4Full;
+		h ^= static_cast<unsigned long long>(z) * 0x165667B19E3779F9ull;
+		return h ^ (h >> 29);
+	}
+}
+
+int WeldOBJVertices(OBJData& obj, float tolerance)
+{
+	size_t nverts = static_cast<size_t>(obj.num_of_vertices());
+	if (nverts == 0 || !(tolerance > 0.f))
+	{
+		return 0;
+	}
+	const float* pos = &obj.positions[0];
+	double inv_cell = 1.0 / tolerance;
+	float tolerance2 = tolerance * tolerance;
+
+	// counting sort of the vertices by the bucket of their cell
+	size_t nbuckets = 1;
+	while (nbuckets < 2 * nverts)
+	{
+		nbuckets <<= 1;
+	}
+	std::vector<long long> cell(3 * nverts);
+	std::vector<unsigned int> bucket_of(nverts);
+	parallel_for(0, nverts, [&](size_t i)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			cell[3 * i + k] = static_cast<long long>(std::floor(pos[3 * i + k] * inv_cell));
+		}
+		bucket_of[i] = static_cast<unsigned int>(HashCell(cell[3 * i], cell[3 * i + 1], cell[3 * i + 2]) & (nbuckets - 1));
+	});
+	std::vector<unsigned int> bucket_start(nbuckets + 1, 0);
+	for (size_t i = 0; i < nverts; i++)
+	{
+		bucket_start[bucket_of[i] + 1]++;
+	}
+	for (size_t b = 0; b < nbuckets; b++)
+	{
+		bucket_start[b + 1] += bucket_start[b];
+	}
+	std::vector<unsigned int> bucket_verts(nverts);
+	{
+		std::vector<unsigned int> fill(bucket_start.begin(), bucket_start.end() - 1);
+		for (size_t i = 0; i < nverts; i++)
+		{
+			bucket_verts[fill[bucket_of[i]]++] = static_cast<unsigned int>(i);
+		}
+	}
+
+	// the smallest index within tolerance, then chains collapse to their first vertex
+	std::vector<int> weld(nverts);
+	parallel_for(0, nverts, [&](size_t i)
+	{
+		const float* p = pos + 3 * i;
+		unsigned int best = static_cast<unsigned int>(i);
+		for (int dx = -1; dx <= 1; dx++)
+		{
+			for (int dy = -1; dy <= 1; dy++)
+			{
+				for (int dz = -1; dz <= 1; dz++)
+				{
+					size_t b = HashCell(cell[3 * i] + dx, cell[3 * i + 1] + dy, cell[3 * i + 2] + dz) & (nbuckets - 1);
+					for (unsigned int j = bucket_start[b]; j < bucket_start[b + 1]; j++)
+					{
+						unsigned int u = bucket_verts[j];
+						if (u >= best)
+						{
+							continue;
+						}
+						const float* q = pos + 3 * u;
+						float d0 = p[0] - q[0], d1 = p[1] - q[1], d2 = p[2] - q[2];
+						if (d0 * d0 + d1 * d1 + d2 * d2 <= tolerance2)
+						{
+							best = u;
+						}
+					}
+				}
+			}
+		}
+		weld[i] = static_cast<int>(best);
+	});
+	for (size_t i = 0; i < nverts; i++)
+	{
+		weld[i] = weld[weld[i]];
+	}
+
+	// remap the faces. A face that would reuse a directed edge of an earlier
+	// one, where two sheets touch or the orientations disagree, keeps its own
+	// vertices so the mesh stays manifold there; a face that collapses is dropped
+	std::vector<unsigned char> keep(nverts, 0);
+	for (size_t i = 0; i < nverts; i++)
+	{
+		keep[i] = weld[i] == static_cast<int>(i);
+	}
+	HalfEdgeHash used;
+	used.reserve(obj.corner_verts.size());
+	std::vector<int> welded, welded_corner, original, original_corner;
+	size_t out = 0;
+	int nfaces = obj.num_of_faces();
+	int out_faces = 0;
+	int end = obj.face_starts[0];
+	for (int f = 0; f < nfaces; f++)
+	{
+		// face_starts is rewritten behind the reading position
+		int begin = end;
+		end = obj.face_starts[f + 1];
+		welded.clear();
+		welded_corner.clear();
+		original.clear();
+		original_corner.clear();
+		for (int c = begin; c < end; c++)
+		{
+			int v = obj.corner_verts[c];
+			if (v < 0 || v >= static_cast<int>(nverts))
+			{
+				continue;
+			}
+			if (std::find(welded.begin(), welded.end(), weld[v]) == welded.end())
+			{
+				welded.push_back(weld[v]);
+				welded_corner.push_back(c);
+			}
+			if (std::find(original.begin(), original.end(), v) == original.end())
+			{
+				original.push_back(v);
+				original_corner.push_back(c);
+			}
+		}
+		if (welded.size() < 3)
+		{
+			continue;
+		}
+
+		bool free = true;
+		for (size_t k = 0; k < welded.size() && free; k++)
+		{
+			free = used.find(welded[k], welded[(k + 1) % welded.size()]) == HE_INVALID_INDEX;
+		}
+		std::vector<int>& ids = free ? welded : original;
+		std::vector<int>& corners = free ? welded_corner : original_corner;
+		for (size_t k = 0; k < ids.size(); k++)
+		{
+			used.insert(ids[k], ids[(k + 1) % ids.size()], static_cast<HE_index>(f));
+			keep[ids[k]] = 1;
+
+			// the corners only move down, out never passes the corner being read
+			int c = corners[k];
+			obj.corner_verts[out] = ids[k];
+			obj.corner_texs[out] = obj.corner_texs[c];
+			obj.corner_norms[out] = obj.corner_norms[c];
+			out++;
+		}
+		obj.face_starts[++out_faces] = static_cast<int>(out);
+	}
+	obj.corner_verts.resize(out);
+	obj.corner_texs.resize(out);
+	obj.corner_norms.resize(out);
+	obj.face_starts.resize(out_faces + 1);
+
+	// compact the vertices
+	std::vector<int> new_id(nverts);
+	int nkept = 0;
+	for (size_t i = 0; i < nverts; i++)
+	{
+		new_id[i] = keep[i] ? nkept++ : -1;
+	}
+	std::vector<float> positions(3 * static_cast<size_t>(nkept));
+	parallel_for(0, nverts, [&](size_t i)
+	{
+		if (new_id[i] >= 0)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				positions[3 * new_id[i] + k] = pos[3 * i + k];
+			}
+		}
+	});
+	parallel_for(0, out, [&](size_t c)
+	{
+		obj.corner_verts[c] = new_id[obj.corner_verts[c]];
+	});
+	obj.positions.swap(positions);
+	return static_cast<int>(nverts) - nkept;
+}
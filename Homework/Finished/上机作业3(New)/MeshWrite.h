@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Mesh3D.h"
+
+// Helpers of the mesh writers.
+//
+// A writer cuts its records into chunks. Every round formats one chunk per
+// thread into a buffer of its own, then the buffers go to the file in order,
+// one fwrite each. The output does not depend on the number of threads and
+// the memory stays at one round. Numbers are formatted with std::to_chars,
+// the shortest text that reads back as the same float. The binary formats
+// are little-endian, the byte order of the machines this runs on, so
+// records are copied as they are.
+
+const size_t WRITE_CHUNK_RECORDS = 1 << 16;
+
+//! format the records [0, count) chunk by chunk and write them in order
+/*!
+*	\param max_bytes bound on the bytes of one record
+*	\param format format(begin, end, out) writes records [begin, end) to out
+*	and returns the end of what it wrote
+*/
+template <class F>
+bool WriteChunked(FILE* file, size_t count, size_t max_bytes, const F& format)
+{
+	size_t nchunks = (count + WRITE_CHUNK_RECORDS - 1) / WRITE_CHUNK_RECORDS;
+	size_t nthreads = parallel_threads();
+	std::vector<std::vector<char> > buffers(std::min(nthreads, nchunks));
+	std::vector<size_t> sizes(buffers.size());
+	for (size_t first = 0; first < nchunks; first += buffers.size())
+	{
+		size_t round = std::min(buffers.size(), nchunks - first);
+		parallel_for(0, round, [&](size_t k)
+		{
+			size_t begin = (first + k) * WRITE_CHUNK_RECORDS;
+			size_t end = std::min(begin + WRITE_CHUNK_RECORDS, count);
+			std::vector<char>& buffer = buffers[k];
+			buffer.resize((end - begin) * max_bytes);
+			sizes[k] = format(begin, end, buffer.data()) - buffer.data();
+		}, 1);
+		for (size_t k = 0; k < round; k++)
+		{
+			if (fwrite(buffers[k].data(), 1, sizes[k], file) != sizes[k])
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+//! bound on the characters of " " + a float
+const size_t FLOAT_TEXT_CHARS = 1 + 24;
+//! bound on the characters of an index
+const size_t INDEX_TEXT_CHARS = 20;
+
+//! " " and the shortest text of value
+inline char* AppendFloat(char* out, float value)
+{
+	*out++ = ' ';
+	return std::to_chars(out, out + FLOAT_TEXT_CHARS - 1, value).ptr;
+}
+
+inline char* AppendIndex(char* out, size_t value)
+{
+	return std::to_chars(out, out + INDEX_TEXT_CHARS, value).ptr;
+}
+
+inline char* AppendText(char* out, const char* text)
+{
+	size_t n = strlen(text);
+	memcpy(out, text, n);
+	return out + n;
+}
+
+//! the raw bytes, for the binary formats
+inline char* AppendBytes(char* out, const void* data, size_t size)
+{
+	memcpy(out, data, size);
+	return out + size;
+}
+
+inline char* AppendVec3(char* out, const Vec3f& v)
+{
+	float xyz[3] = {v[0], v[1], v[2]};
+	return AppendBytes(out, xyz, sizeof(xyz));
+}
+
+//! write a text header, false on a failed write
+inline bool WriteHeader(FILE* file, const std::string& header)
+{
+	return fwrite(header.data(), 1, header.size(), file) == header.size();
+}
+
+//! close the file; a failed export leaves nothing behind
+inline bool FinishWrite(FILE* file, const char* fouts, bool ok)
+{
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+	{
+		remove(fouts);
+	}
+	return ok;
+}
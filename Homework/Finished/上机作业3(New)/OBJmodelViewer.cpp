@@ -20,11 +20,15 @@
 #include <string> 
 #include <fstream> 
 #include <vector>
+#include <chrono>
+#include <filesystem>
 
 #include <GL/glew.h>
 #include <GL/freeglut.h> 
 #include <cmath>
 #include"Mesh3D.h"
+#include"MeshSnapshot.h"
+#include"MeshSimplify.h"
 
 #define M_PI 3.1415926
 GLfloat radians_matrix[16];
@@ -38,7 +42,10 @@ static float *vertices = NULL;  // Vertex array of the object x, y, z values.
 static int *faces = NULL; // Face (triangle) vertex indices.
 static int numIndices; // Number of face vertex indices.
 static float Xangle = 0.0, Yangle = 0.0, Zangle = 0.0; // Angles to rotate the object.
-int change = 0;   //лƽɫƽɫ
+int change = 0;   //切换平滑着色和平面着色
+int w = 600, h = 500;//视角高宽
+Mesh3D* ptr_mesh_ = new Mesh3D();
+MeshCurvature curvature_;	//曲率着色用的曲率
 
 // Routine to read a Wavefront OBJ file. 
 // Only vertex and face lines are processed. All other lines,including texture, 
@@ -56,851 +63,6 @@ int change = 0;   //
 // All vertex indices are decremented by 1 to make the index range start from 0.
 
 
-#include "Mesh3D.h"
-
-#include <fstream>
-#include <iostream>
-#include <xutility>
-
-#define SWAP(a,b,T) {T tmp=(a); (a)=(b); (b)=tmp;}
-#define min(a,b) a<b?a:b
-#define max(a,b) a>b?a:b
-
-int w = 600, h = 500;//ӽǸ߿
-Mesh3D* ptr_mesh_ = new Mesh3D();
-
-Mesh3D::Mesh3D(void)
-{
-	// intialization
-	pvertices_list_ = NULL;
-	pfaces_list_ = NULL;
-	pedges_list_ = NULL;
-
-	xmax_ = ymax_ = zmax_ = 1.f;
-	xmin_ = ymin_ = zmin_ = -1.f;
-
-	num_components_ = 0;
-	average_edge_length_ = 1.f;
-}
-
-void Mesh3D::ClearData(void)
-{
-	ClearVertex();
-	ClearEdges();
-	ClearFaces();
-	edgemap_.clear();
-
-	xmax_ = ymax_ = zmax_ = 1.f;
-	xmin_ = ymin_ = zmin_ = -1.f;
-}
-
-void Mesh3D::ClearVertex(void)
-{
-
-	if (pvertices_list_ == NULL)
-	{
-		return;
-	}
-	else
-	{
-		for (VERTEX_ITER viter = pvertices_list_->begin(); viter != pvertices_list_->end(); viter++)
-		{
-			if (*viter != NULL)
-			{
-				delete* viter;
-				*viter = NULL;
-			}
-			else
-			{
-				// ERROR
-			}
-		}
-		delete pvertices_list_;
-		pvertices_list_ = NULL;
-	}
-}
-
-void Mesh3D::ClearEdges(void)
-{
-	if (pedges_list_ == NULL)
-	{
-		return;
-	}
-	else
-	{
-		for (EDGE_ITER eiter = pedges_list_->begin(); eiter != pedges_list_->end(); eiter++)
-		{
-			if (*eiter != NULL)
-			{
-				delete* eiter;
-				*eiter = NULL;
-			}
-			else
-			{
-				// ERROR
-			}
-		}
-		delete pedges_list_;
-		pedges_list_ = NULL;
-	}
-}
-
-void Mesh3D::ClearFaces(void)
-{
-	if (pfaces_list_ == NULL)
-	{
-		return;
-	}
-	else
-	{
-		for (FACE_ITER fiter = pfaces_list_->begin(); fiter != pfaces_list_->end(); fiter++)
-		{
-			if (*fiter != NULL)
-			{
-				delete* fiter;
-				*fiter = NULL;
-			}
-			else
-			{
-				// ERROR
-			}
-		}
-		delete pfaces_list_;
-		pfaces_list_ = NULL;
-	}
-}
-
-HE_vert* Mesh3D::InsertVertex(const Vec3f& v)
-{
-	HE_vert* pvert = new HE_vert(v);
-	if (pvertices_list_ == NULL)
-	{
-		pvertices_list_ = new std::vector<HE_vert*>;
-	}
-	pvert->id_ = static_cast<int>(pvertices_list_->size());
-	pvertices_list_->push_back(pvert);
-	return pvert;
-}
-
-HE_edge* Mesh3D::InsertEdge(HE_vert* vstart, HE_vert* vend)
-{
-	if (vstart == NULL || vend == NULL)
-	{
-		return NULL;
-	}
-
-	if (pedges_list_ == NULL)
-	{
-		pedges_list_ = new std::vector<HE_edge*>;
-	}
-
-	if (edgemap_[PAIR_VERTEX(vstart, vend)] != NULL)
-	{
-		return edgemap_[PAIR_VERTEX(vstart, vend)];
-	}
-
-	HE_edge* pedge = new HE_edge;
-	pedge->pvert_ = vend;
-	pedge->pvert_->degree_++;
-	vstart->pedge_ = pedge;
-	edgemap_[PAIR_VERTEX(vstart, vend)] = pedge;
-
-	pedge->id_ = static_cast<int>(pedges_list_->size());
-	pedges_list_->push_back(pedge);
-
-	return pedge;
-}
-
-HE_face* Mesh3D::InsertFace(std::vector<HE_vert* >& vec_hv)
-{
-	int vsize = static_cast<int>(vec_hv.size());
-	//if (vsize != 3)
-	//{
-	//	return NULL;
-	//}
-
-	if (pfaces_list_ == NULL)
-	{
-		pfaces_list_ = new std::vector<HE_face*>;
-	}
-
-	HE_face* pface = new HE_face;
-	pface->valence_ = vsize;
-	VERTEX_ITER viter = vec_hv.begin();
-	VERTEX_ITER nviter = vec_hv.begin();
-	nviter++;
-
-	HE_edge* he1 = NULL, * he2 = NULL;
-	std::vector<HE_edge*> vec_edges;
-	int i = 0;
-	for (i = 0; i < vsize - 1; i++)
-	{
-		he1 = InsertEdge(*viter, *nviter);
-		he2 = InsertEdge(*nviter, *viter);
-
-		if (pface->pedge_ == NULL)
-			pface->pedge_ = he1;
-
-		he1->pface_ = pface;
-		he1->ppair_ = he2;
-		he2->ppair_ = he1;
-		vec_edges.push_back(he1);
-		viter++, nviter++;
-	}
-
-	nviter = vec_hv.begin();
-
-	he1 = InsertEdge(*viter, *nviter);
-	he2 = InsertEdge(*nviter, *viter);
-	he1->pface_ = pface;
-	if (pface->pedge_ == NULL)
-		pface->pedge_ = he1;
-
-	he1->ppair_ = he2;
-	he2->ppair_ = he1;
-	vec_edges.push_back(he1);
-
-	for (i = 0; i < vsize - 1; i++)
-	{
-		vec_edges[i]->pnext_ = vec_edges[i + 1];
-		vec_edges[i + 1]->pprev_ = vec_edges[i];
-	}
-	vec_edges[i]->pnext_ = vec_edges[0];
-	vec_edges[0]->pprev_ = vec_edges[i];
-
-	pface->id_ = static_cast<int>(pfaces_list_->size());
-	pfaces_list_->push_back(pface);
-
-	return pface;
-}
-
-bool Mesh3D::LoadFromOBJFile(const char* fins)
-{
-	//	cout << "Loading......." << endl;
-	FILE* pfile = fopen(fins, "r");
-
-	char* tok;
-	//char *tok_tok;
-	char temp[128];
-
-	try
-	{
-		ClearData();
-		//read vertex
-		fseek(pfile, 0, SEEK_SET);
-		char pLine[512];
-
-		while (fgets(pLine, 512, pfile))
-		{
-			if (pLine[0] == 'v' && pLine[1] == ' ')
-			{
-				Vec3f nvv;
-				tok = strtok(pLine, " ");
-				for (int i = 0; i < 3; i++)
-				{
-					tok = strtok(NULL, " ");
-					strcpy(temp, tok);
-					temp[strcspn(temp, " ")] = 0;
-					nvv[i] = (float)atof(temp);
-				}
-				InsertVertex(nvv);
-			}
-		}
-
-		//read facets
-		fseek(pfile, 0, SEEK_SET);
-
-		while (fgets(pLine, 512, pfile))
-		{
-			char* pTmp = pLine;
-			if (pTmp[0] == 'f')
-			{
-				std::vector<HE_vert* > s_faceid;
-
-				tok = strtok(pLine, " ");
-				while ((tok = strtok(NULL, " ")) != NULL)
-				{
-					strcpy(temp, tok);
-					temp[strcspn(temp, "/")] = 0;
-					int id = (int)strtol(temp, NULL, 10) - 1;
-					HE_vert* hv = get_vertex(id);
-					bool findit = false;
-					for (int i = 0; i < (int)s_faceid.size(); i++)
-					{
-						if (hv == s_faceid[i])	//remove redundant vertex id if it exists
-						{
-							//	cout << "remove redundant vertex" << endl;
-							findit = true;
-							break;
-						}
-					}
-					if (findit == false && hv != NULL)
-					{
-						s_faceid.push_back(hv);
-					}
-				}
-				if ((int)s_faceid.size() >= 3)
-				{
-					InsertFace(s_faceid);
-				}
-			}
-		}
-
-		//read texture coords
-		fseek(pfile, 0, SEEK_SET);
-		std::vector<Vec3f> texCoordsTemp;
-		while (fscanf(pfile, "%s", pLine) != EOF)
-		{
-			if (pLine[0] == 'v' && pLine[1] == 't')
-			{
-				Vec3f texTemp(0.f, 0.f, 0.f);
-				fscanf(pfile, "%f %f", &texTemp[0], &texTemp[1]);
-				texCoordsTemp.push_back(texTemp);
-			}
-		}
-		//read texture index
-
-		if (texCoordsTemp.size() > 0)
-		{
-			fseek(pfile, 0, SEEK_SET);
-
-			int faceIndex = 0;
-			while (fscanf(pfile, "%s", pLine) != EOF)
-			{
-
-				if (pLine[0] == 'f')
-				{
-					int v, t;
-					fscanf(pfile, "%s", pLine);
-					if (sscanf(pLine, "%d/%d", &v, &t) == 2)
-					{
-						std::map<int, int> v2tex;
-						v2tex[v - 1] = t - 1;
-
-						fscanf(pfile, "%s", pLine);
-						sscanf(pLine, "%d/%d", &v, &t);
-						v2tex[v - 1] = t - 1;
-
-						fscanf(pfile, "%s", pLine);
-						sscanf(pLine, "%d/%d", &v, &t);
-						v2tex[v - 1] = t - 1;
-
-						HE_edge* edgeTemp = pfaces_list_->at(faceIndex)->pedge_;
-						edgeTemp->texCoord_ = texCoordsTemp.at(v2tex[edgeTemp->pvert_->id_]);
-						edgeTemp->pvert_->texCoord_ = edgeTemp->texCoord_;
-						edgeTemp = edgeTemp->pnext_;
-						edgeTemp->texCoord_ = texCoordsTemp.at(v2tex[edgeTemp->pvert_->id_]);
-						edgeTemp->pvert_->texCoord_ = edgeTemp->texCoord_;
-						edgeTemp = edgeTemp->pnext_;
-						edgeTemp->texCoord_ = texCoordsTemp.at(v2tex[edgeTemp->pvert_->id_]);
-						edgeTemp->pvert_->texCoord_ = edgeTemp->texCoord_;
-						faceIndex++;
-					}
-				}
-			}
-		}
-
-		//cout << vertex_list->size() << " vertex, " << faces_list->size() << " faces " << endl;
-
-		UpdateMesh();
-		Unify(2.f);
-	}
-	catch (...)
-	{
-		ClearData();
-		xmax_ = ymax_ = zmax_ = 1.f;
-		xmin_ = ymin_ = zmin_ = -1.f;
-
-		fclose(pfile);
-		return false;
-	}
-
-	fclose(pfile);
-
-	return isValid();
-}
-
-void Mesh3D::WriteToOBJFile(const char* fouts)
-{
-	std::ofstream fout(fouts);
-
-	fout << "g object\n";
-	fout.precision(16);
-	//output coordinates of each vertex
-	VERTEX_ITER viter = pvertices_list_->begin();
-	for (; viter != pvertices_list_->end(); viter++)
-	{
-		fout << "v " << std::scientific << (*viter)->position_.x()
-			<< " " << (*viter)->position_.y() << " " << (*viter)->position_.z() << "\n";
-	}
-
-	// 		for (viter = pvertices_list_->begin();viter!=pvertices_list_->end(); viter++) 
-	// 		{
-	// 			fout<<"vn "<< std::scientific <<(*viter)->normal_.x() 
-	// 				<<" "<<(*viter)->normal_.y() <<" "<<(*viter)->normal_.z() <<"\n";
-	// 		}
-	//output the valence of each face and its vertices_list' id
-
-	FACE_ITER fiter = pfaces_list_->begin();
-
-	for (; fiter != pfaces_list_->end(); fiter++)
-	{
-		fout << "f";
-
-		HE_edge* edge = (*fiter)->pedge_;
-
-		do {
-			fout << " " << edge->ppair_->pvert_->id_ + 1;
-			edge = edge->pnext_;
-
-		} while (edge != (*fiter)->pedge_);
-		fout << "\n";
-	}
-
-	fout.close();
-}
-
-void Mesh3D::UpdateMesh(void)
-{
-	if (!isValid())
-	{
-		std::cout << "Invalid" << "\n";
-		return;
-	}
-	SetBoundaryFlag();
-	BoundaryCheck();
-	UpdateNormal();
-	ComputeBoundingBox();
-	ComputeAvarageEdgeLength();
-	SetNeighbors();
-}
-
-void Mesh3D::SetBoundaryFlag(void)
-{
-	for (EDGE_ITER eiter = pedges_list_->begin(); eiter != pedges_list_->end(); eiter++)
-	{
-		if ((*eiter)->pface_ == NULL)
-		{
-			(*eiter)->set_boundary_flag(BOUNDARY);
-			(*eiter)->ppair_->set_boundary_flag(BOUNDARY);
-			(*eiter)->pvert_->set_boundary_flag(BOUNDARY);
-			(*eiter)->ppair_->pvert_->set_boundary_flag(BOUNDARY);
-			(*eiter)->ppair_->pface_->set_boundary_flag(BOUNDARY);
-		}
-	}
-}
-
-void Mesh3D::BoundaryCheck()
-{
-	for (VERTEX_ITER viter = pvertices_list_->begin(); viter != pvertices_list_->end(); viter++)
-	{
-		if ((*viter)->isOnBoundary())
-		{
-			HE_edge* edge = (*viter)->pedge_;
-			int deg = 0;
-			while (edge->pface_ != NULL && deg < (*viter)->degree())
-			{
-				edge = edge->pprev_->ppair_;
-				deg++;
-			}
-			(*viter)->pedge_ = edge;
-		}
-	}
-}
-
-void Mesh3D::UpdateNormal(void)
-{
-	ComputeFaceslistNormal();
-	ComputeVertexlistNormal();
-}
-
-void Mesh3D::ComputeFaceslistNormal(void)
-{
-	for (FACE_ITER fiter = pfaces_list_->begin(); fiter != pfaces_list_->end(); fiter++)
-	{
-		ComputePerFaceNormal(*fiter);
-	}
-}
-
-void Mesh3D::ComputePerFaceNormal(HE_face* hf) {
-	//ͼѧγϻҵ
-	//ڴ˴Ӽ淨
-	point a, b, c;
-	a = hf->pedge_->pvert_->position();  //õε
-	b = hf->pedge_->pnext_->pvert_->position();
-	c = hf->pedge_->pnext_->pnext_->pvert_->position();
-	point m1, m2;  //õ
-	m1 = b - a;
-	m2 = c - a;
-
-	double x = m1[1] * m2[2] - m1[2] * m2[1]; //˵õ
-	double y = m1[2] * m2[0] - m1[0] * m2[2];
-	double z = m1[0] * m2[1] - m1[1] * m2[0];
-
-	double norm = sqrt(x * x + y * y + z * z);
-
-	hf->facevector[0] = x / norm;
-	hf->facevector[1] = y / norm;
-	hf->facevector[2] = z / norm;
-}
-
-void Mesh3D::ComputeVertexlistNormal(void)
-{
-	for (VERTEX_ITER viter = pvertices_list_->begin(); viter != pvertices_list_->end(); viter++)
-	{
-		ComputePerVertexNormal(*viter);
-	}
-}
-
-void Mesh3D::ComputePerVertexNormal(HE_vert* hv)
-{
-	//ͼѧγϻҵ
-	//ڴ˴Ӽ淨
-	HE_edge* firstedge = hv->pedge_;
-	HE_face* face_ = firstedge->pface_;
-	Mesh3D::ComputePerFaceNormal(face_);  //ú淨
-
-	hv->pointvector[0] = 0;  //ʼΪ0
-	hv->pointvector[1] = 0;
-	hv->pointvector[2] = 0;
-
-	float total = 0;  //öڵ
-	for (int i = 0; i < 3; ++i) {
-		hv->pointvector[i] += face_->facevector[i];  //ڵ淨֮
-	}
-
-	++total;
-	HE_edge* nextedge = firstedge->ppair_->pnext_;  //һ
-	while (nextedge != firstedge) {
-		face_ = nextedge->pface_;
-		Mesh3D::ComputePerFaceNormal(face_);
-		for (int i = 0; i < 3; ++i) {
-			hv->pointvector[i] += face_->facevector[i];
-		}
-		++total;
-		nextedge = nextedge->ppair_->pnext_;
-	}
-	for (int i = 0; i < 3; ++i) {
-		hv->pointvector[i] = hv->pointvector[i] / total;
-	}
-}
-
-void Mesh3D::ComputeBoundingBox(void)
-{
-	if (pvertices_list_->size() < 3)
-	{
-		return;
-	}
-
-#define MAX_FLOAT_VALUE (static_cast<float>(10e10))
-#define MIN_FLOAT_VALUE	(static_cast<float>(-10e10))
-
-	xmax_ = ymax_ = zmax_ = MIN_FLOAT_VALUE;
-	xmin_ = ymin_ = zmin_ = MAX_FLOAT_VALUE;
-
-	VERTEX_ITER viter = pvertices_list_->begin();
-	for (; viter != pvertices_list_->end(); viter++)
-	{
-		xmin_ = min(xmin_, (*viter)->position_.x());
-		ymin_ = min(ymin_, (*viter)->position_.y());
-		zmin_ = min(zmin_, (*viter)->position_.z());
-		xmax_ = max(xmax_, (*viter)->position_.x());
-		ymax_ = max(ymax_, (*viter)->position_.y());
-		zmax_ = max(zmax_, (*viter)->position_.z());
-	}
-}
-
-void Mesh3D::Unify(float size)
-{
-	float scaleX = xmax_ - xmin_;
-	float scaleY = ymax_ - ymin_;
-	float scaleZ = zmax_ - zmin_;
-	float scaleMax;
-
-	if (scaleX < scaleY)
-	{
-		scaleMax = scaleY;
-	}
-	else
-	{
-		scaleMax = scaleX;
-	}
-	if (scaleMax < scaleZ)
-	{
-		scaleMax = scaleZ;
-	}
-	float scaleV = size / scaleMax;
-	Vec3f centerPos((xmin_ + xmax_) / 2.f, (ymin_ + ymax_) / 2.f, (zmin_ + zmax_) / 2.f);
-	for (size_t i = 0; i != pvertices_list_->size(); i++)
-	{
-		pvertices_list_->at(i)->position_ = (pvertices_list_->at(i)->position_ - centerPos) * scaleV;
-	}
-}
-
-void Mesh3D::ComputeAvarageEdgeLength(void)
-{
-	if (!isValid())
-	{
-		average_edge_length_ = 0.f;
-		return;
-	}
-	float aveEdgeLength = 0.f;
-	for (int i = 0; i < num_of_half_edges_list(); i++)
-	{
-		HE_edge* edge = get_edges_list()->at(i);
-		HE_vert* v0 = edge->pvert_;
-		HE_vert* v1 = edge->ppair_->pvert_;
-		aveEdgeLength += (v0->position() - v1->position()).length();
-	}
-	average_edge_length_ = aveEdgeLength / num_of_half_edges_list();
-	//std::cout << "Average_edge_length = " << average_edge_length_ << "\n";
-}
-
-HE_face* Mesh3D::get_face(int vId0, int vId1, int vId2)
-{
-	HE_vert* v0 = get_vertex(vId0);
-	HE_vert* v1 = get_vertex(vId1);
-	HE_vert* v2 = get_vertex(vId2);
-	if (!v0 || !v1 || !v2)
-	{
-		return NULL;
-	}
-
-	HE_face* face = NULL;
-
-	// ڶԱ߽bugҵǱ߽
-	if (v0->isOnBoundary())
-	{
-		if (!v1->isOnBoundary())
-		{
-			SWAP(v0, v1, HE_vert*);
-		}
-		else if (!v2->isOnBoundary())
-		{
-			SWAP(v0, v2, HE_vert*);
-		}
-		else
-		{
-			// v0, v1, v2 Ǳ߽
-			// ʱȲ
-			return NULL;
-		}
-	}
-
-	if (!v0->isOnBoundary())	// Ա߽ıbug
-	{
-		HE_edge* edge = v0->pedge_;
-		bool inFace = true;
-		do
-		{
-			bool b1 = isFaceContainVertex(edge->pface_, v1);
-			bool b2 = isFaceContainVertex(edge->pface_, v2);
-			if (!b1 && !b1)
-			{
-				edge = edge->ppair_->pnext_;
-			}
-			else if (b1 && b2)
-			{
-				face = edge->pface_;
-				break;
-			}
-			else
-			{
-				inFace = false;
-				break;
-			}
-		} while (edge != v0->pedge_ && edge != NULL);
-	}
-
-	return face;
-}
-
-HE_face* Mesh3D::get_face(const std::vector<unsigned int>& ids)
-{
-	if (ids.size() < 3)
-	{
-		std::cout << "can not return face" << std::endl;
-		return NULL;
-	}
-	// ҵһǱ߽
-	HE_vert* v = NULL;
-	for (unsigned int i = 0; i < ids.size(); i++)
-	{
-		if (!get_vertex(ids[i])->isOnBoundary())
-		{
-			v = get_vertex(ids[i]);
-			break;
-		}
-	}
-	if (!v)
-	{
-		// е㶼Ǳ߽
-		// ݲ
-		return NULL;
-	}
-
-	HE_edge* edge = v->pedge_;
-	HE_face* face = NULL;
-	do
-	{
-		face = edge->pface_;
-		edge = edge->ppair_->pnext_;
-		bool bInFace = isFaceContainVertex(face, get_vertex(ids[0]));
-		if (!bInFace)
-		{
-			continue;
-		}
-		for (unsigned int i = 1; i < ids.size(); i++)
-		{
-			bool b = isFaceContainVertex(face, get_vertex(ids[i]));
-			if (b != bInFace)
-			{
-				bInFace = false;
-				break;
-			}
-		}
-		if (bInFace)
-		{
-			return face;
-		}
-	} while (edge != v->pedge_ && edge != NULL);
-	return NULL;
-}
-
-bool Mesh3D::isFaceContainVertex(HE_face* face, HE_vert* vert)
-{
-	HE_edge* edge = face->pedge_;
-	do
-	{
-		if (edge->pvert_ == vert)
-		{
-			return true;
-		}
-		edge = edge->pnext_;
-	} while (edge != face->pedge_ && edge != NULL);
-	return false;
-}
-
-int Mesh3D::GetFaceId(HE_face* face)
-{
-	return !face ? -1 : face->id();
-}
-
-void Mesh3D::ResetFaceSelectedTags(int tag)
-{
-	for (int i = 0; i < num_of_face_list(); i++)
-	{
-		get_face(i)->set_selected(tag);
-	}
-}
-
-void Mesh3D::ResetVertexSelectedTags(int tag)
-{
-	for (int i = 0; i < num_of_vertex_list(); i++)
-	{
-		get_vertex(i)->set_seleted(tag);
-	}
-}
-
-bool Mesh3D::isNeighbors(HE_vert* v0, HE_vert* v1)
-{
-	if (!v0 || !v1)
-	{
-		return false;
-	}
-
-	HE_edge* edge = v0->pedge_;
-	do
-	{
-		if (edge->pvert_ == v1)
-		{
-			return true;
-		}
-		edge = edge->ppair_->pnext_;
-	} while (edge != v0->pedge_ && edge);
-	return false;
-}
-
-int Mesh3D::GetSelectedVrtId()
-{
-	if (!isValid())
-	{
-		return -1;
-	}
-	for (int i = 0; i < num_of_vertex_list(); i++)
-	{
-		if (get_vertex(i)->selected() == SELECTED)
-		{
-			return i;
-		}
-	}
-	return -1;
-}
-
-void Mesh3D::CreateMesh(const std::vector<Vec3f>& verts, const std::vector<int>& triIdx)
-{
-	ClearData();
-	for (unsigned int i = 0; i < verts.size(); i++)
-	{
-		InsertVertex(verts[i]);
-	}
-	for (unsigned int i = 0; i < triIdx.size(); i = i + 3)
-	{
-		std::vector<HE_vert*> tri;
-		HE_vert* v0 = get_vertex(triIdx[i]);
-		HE_vert* v1 = get_vertex(triIdx[i + 1]);
-		HE_vert* v2 = get_vertex(triIdx[i + 2]);
-		if (!v0 || !v1 || !v2) continue;
-		tri.push_back(v0);
-		tri.push_back(v1);
-		tri.push_back(v2);
-		InsertFace(tri);
-	}
-	UpdateMesh();
-}
-
-void Mesh3D::CreateMesh(const std::vector<double>& verts, const std::vector<unsigned>& triIdx)
-{
-	ClearData();
-	for (unsigned int i = 0; i < verts.size(); i = i + 3)
-	{
-		InsertVertex(Vec3f(verts[i], verts[i + 1], verts[i + 2]));
-	}
-	for (unsigned int i = 0; i < triIdx.size(); i = i + 3)
-	{
-		std::vector<HE_vert*> tri;
-		HE_vert* v0 = get_vertex(triIdx[i]);
-		HE_vert* v1 = get_vertex(triIdx[i + 1]);
-		HE_vert* v2 = get_vertex(triIdx[i + 2]);
-		if (!v0 || !v1 || !v2) continue;
-		tri.push_back(v0);
-		tri.push_back(v1);
-		tri.push_back(v2);
-		InsertFace(tri);
-	}
-	UpdateMesh();
-}
-
-int Mesh3D::GetBoundaryVrtSize()
-{
-	int count = 0;
-	for (int i = 0; i < num_of_vertex_list(); i++)
-	{
-		if (get_vertex(i)->isOnBoundary())
-		{
-			count++;
-		}
-	}
-	return count;
-}
-
-Mesh3D::~Mesh3D(void)
-{
-	ClearData();
-}
-
-
-
 void loadOBJ(std::string fileName)
 {
    std::string line;
@@ -1009,13 +171,13 @@ void loadOBJ(std::string fileName)
    inFile.close();
 }
 
-// ߺķĵ
+// 计算光线和三角面的法向量的点积
 vector<double> dot_products;   //alpha
 vector<double> light_vector= { 0,0,1};
 vector<vector<double> > face_normal_vector;
 GLfloat rotation_matrix[16];
 
-// Ĳ õλ
+// 计算向量的叉乘 得到单位向量
 vector<double> cross_product(vector<double> v1, vector<double> v2) {
 	double x = v1[1] * v2[2] - v1[2] * v2[1];
 	double y = v1[2] * v2[0] - v1[0] * v2[2];
@@ -1024,14 +186,14 @@ vector<double> cross_product(vector<double> v1, vector<double> v2) {
 	return { x / norm, y / norm, z / norm};
 }
 
-// ķ
+// 计算三角面的法向量
 vector<double> face_normal(vector<double> v1, vector<double> v2, vector<double> v3) {
 	vector<double> e1 = { v2[0] - v1[0], v2[1] - v1[1], v2[2] - v1[2] };
 	vector<double> e2 = { v3[0] - v1[0], v3[1] - v1[1], v3[2] - v1[2] };
 	return cross_product(e1, e2);
 }
 
-// ߺͷĵ
+// 计算光线和法向量的点积
 double dot_product(vector<double> v1, vector<double> v2) {
 	return v1[0] * v2[0] + v1[1] * v2[1] + v1[2] * v2[2];
 }
@@ -1061,6 +223,7 @@ void setup(void)
 
 	// Read the external OBJ file into the internal vertex and face vectors.
 	bool is_open = ptr_mesh_->LoadFromOBJFile("gourd.obj");
+	ptr_mesh_->PublishSnapshot();
 
 	//// Size the vertex array and copy into it x, y, z values from the vertex vector.
 	//vertices = new float[verticesVector.size()];
@@ -1093,51 +256,55 @@ void drawScene(void)
 	glRotatef(Yangle, 0.0, 1.0, 0.0);
 	glRotatef(Xangle, 1.0, 0.0, 0.0);
 
-	// Draw the object mesh.
-	for (int i = 0; i < ptr_mesh_->num_of_face_list(); i = i++)
+	// Draw the object mesh, from the last published snapshot so that the
+	// mesh may be edited meanwhile.
+	std::shared_ptr<const MeshSnapshot> mesh = ptr_mesh_->snapshot();
+	for (size_t i = 0; mesh && i < mesh->num_of_faces(); i++)
 	{
-		point first, second, third;
-		first = ptr_mesh_->get_face(i)->pedge_->pvert_->position();//һ
-		second = ptr_mesh_->get_face(i)->pedge_->pnext_->pvert_->position();//ڶ
-		third = ptr_mesh_->get_face(i)->pedge_->pnext_->pnext_->pvert_->position();//
+		size_t begin = mesh->face_starts[i], end = mesh->face_starts[i + 1];
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		glBegin(GL_TRIANGLES);//
-		if (change == 0)
+		glBegin(GL_TRIANGLES);//画三角形，多边形拆成扇形
+		for (size_t k = begin + 1; k + 1 < end; k++)
 		{
-			glNormal3fv(ptr_mesh_->get_face(i)->facevector);//ƽ
-			glVertex3f(first[0], first[1], first[2]);
-			glVertex3f(second[0], second[1], second[2]);
-			glVertex3f(third[0], third[1], third[2]);
-		}
-		else if (change == 1)//ƽմ
-		{
-			glNormal3fv(ptr_mesh_->get_face(i)->pedge_->pvert_->pointvector);
-			glVertex3f(first[0], first[1], first[2]);
-			glNormal3fv(ptr_mesh_->get_face(i)->pedge_->pnext_->pvert_->pointvector);
-			glVertex3f(second[0], second[1], second[2]);
-			glNormal3fv(ptr_mesh_->get_face(i)->pedge_->pnext_->pnext_->pvert_->pointvector);
-			glVertex3f(third[0], third[1], third[2]);
+			HE_index corner[3] = { mesh->corners[begin], mesh->corners[k], mesh->corners[k + 1] };
+			for (int c = 0; c < 3; c++)
+			{
+				if (change == 0)
+				{
+					glNormal3fv(mesh->face_normals[i]);//平面光照
+				}
+				else if (change == 1)//平滑光照处理
+				{
+					glNormal3fv(mesh->normals[corner[c]]);
+				}
+				else if (change == 2)//曲率着色
+				{
+					glColor4fv(mesh->colors[corner[c]]);
+					glNormal3fv(mesh->normals[corner[c]]);
+				}
+				glVertex3fv(mesh->positions[corner[c]]);
+			}
 		}
 		glEnd();
 	}
-	//̶Դ
-	GLfloat sun_light_position[] = { 0.0f, 0.0f, 4.0f, 1.0f }; //Դλϵǰʽ
-	GLfloat sun_light_ambient[] = { 0.0f, 0.0f, 0.0f, 1.0f };  //RGBAģʽĻ⣬Ϊ0
-	GLfloat sun_light_diffuse[] = { 1.0f, 1.0f, 1.0f, 1.0f };  //RGBAģʽ⣬ȫ׹
-	GLfloat sun_light_specular[] = { 1.0f, 1.0f, 1.0f, 1.0f }; //RGBAģʽµľ ȫ׹
+	//固定光源
+	GLfloat sun_light_position[] = { 0.0f, 0.0f, 4.0f, 1.0f }; //光源的位置在世界坐标系前方，齐次坐标形式
+	GLfloat sun_light_ambient[] = { 0.0f, 0.0f, 0.0f, 1.0f };  //RGBA模式的环境光，为0
+	GLfloat sun_light_diffuse[] = { 1.0f, 1.0f, 1.0f, 1.0f };  //RGBA模式的漫反射光，全白光
+	GLfloat sun_light_specular[] = { 1.0f, 1.0f, 1.0f, 1.0f }; //RGBA模式下的镜面光 ，全白光
 	glLightfv(GL_LIGHT0, GL_POSITION, sun_light_position);
 	glLightfv(GL_LIGHT0, GL_AMBIENT, sun_light_ambient);
 	glLightfv(GL_LIGHT0, GL_DIFFUSE, sun_light_diffuse);
 	glLightfv(GL_LIGHT0, GL_SPECULAR, sun_light_specular);
 
-	//ƹ
+	//开启灯光
 	glEnable(GL_LIGHT0);
 	glEnable(GL_LIGHTING);
 	glEnable(GL_DEPTH_TEST);
 
 
 
-	//ƶԴ
+	//可移动光源
 	GLfloat light_pos[] = { 0.0,2.0,0.0,1.0 };
 	glViewport(0, 0, (GLsizei)w, (GLsizei)h);
 	glMatrixMode(GL_PROJECTION);
@@ -1176,7 +343,7 @@ void drawScene(void)
 	//	dot_products.push_back(dot);
 	//}
 
-	//double cl[3] = { 0.4f, 0.09f, 0.6f }; //ɫ
+	//double cl[3] = { 0.4f, 0.09f, 0.6f }; //茄子色
 
 	//glPushMatrix();
 
@@ -1190,7 +357,7 @@ void drawScene(void)
 	//	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 	//	glBegin(GL_TRIANGLES);
 	//	double t = dot_products[i / 3];
-	//	glColor3f(cl[0] * t, cl[1] * t, cl[2] * t); //Ⱦ
+	//	glColor3f(cl[0] * t, cl[1] * t, cl[2] * t); //染
 	//	glVertex3f(vertices[(faces[i]) * 3], vertices[(faces[i]) * 3 + 1], vertices[(faces[i]) * 3 + 2]);
 	//	glVertex3f(vertices[(faces[i + 1]) * 3], vertices[(faces[i + 1]) * 3 + 1], vertices[(faces[i + 1]) * 3 + 2]);
 	//	glVertex3f(vertices[(faces[i + 2]) * 3], vertices[(faces[i + 2]) * 3 + 1], vertices[(faces[i + 2]) * 3 + 2]);
@@ -1251,11 +418,25 @@ void keyInput(unsigned char key, int x, int y)
 		glutPostRedisplay();
 		break;
 	case'c':
-		change = 1;//0лΪƽ 1лƽ
+		change = 1;//0切换为平面 1切换到平滑
+		glDisable(GL_COLOR_MATERIAL);
 		glutPostRedisplay();
 		break;
 	case'C':
 		change = 0;
+		glDisable(GL_COLOR_MATERIAL);
+		glutPostRedisplay();
+		break;
+	case'k':
+		// colour by the mean curvature, or the Gaussian one on polygon meshes
+		if (ptr_mesh_->UpdateCurvature(curvature_) || ptr_mesh_->ComputeCurvature(curvature_, CURVATURE_GAUSSIAN))
+		{
+			ptr_mesh_->ColorByCurvature(curvature_.mean.empty() ? curvature_.gaussian : curvature_.mean);
+			ptr_mesh_->PublishSnapshot();
+			change = 2;
+			glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
+			glEnable(GL_COLOR_MATERIAL);
+		}
 		glutPostRedisplay();
 		break;
 	default:
@@ -1268,11 +449,59 @@ void printInteraction(void)
 {
    std::cout << "Interaction:" << std::endl;
    std::cout << "Press x, X, y, Y, z, Z to turn the object." << std::endl;
+   std::cout << "Press c, C for smooth or flat shading, k to colour by curvature." << std::endl;
+}
+
+// Time the simplifier on every OBJ model of dir, the best of a few runs each.
+int benchmarkSimplify(const char* dir)
+{
+   std::error_code error;
+   std::filesystem::directory_iterator it(dir, error), end;
+   if (error)
+   {
+      std::cout << "cannot open " << dir << std::endl;
+      return 1;
+   }
+   std::vector<float> ratios = { 0.5f, 0.25f, 0.1f };
+   long long total_collapses = 0;
+   double total_seconds = 0.0;
+   for (; it != end; ++it)
+   {
+      if (it->path().extension() != ".obj")
+         continue;
+      Mesh3D mesh;
+      if (!mesh.LoadFromOBJFile(it->path().string().c_str()))
+         continue;
+      Mesh3D lod[3];
+      std::vector<Mesh3D*> lods = { &lod[0], &lod[1], &lod[2] };
+      MeshSimplifier simplifier;
+      double best = 1e30;
+      for (int run = 0; run < 5; run++)
+      {
+         std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+         simplifier.Simplify(mesh, ratios, lods);
+         double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+         if (seconds < best)
+            best = seconds;
+      }
+      std::cout << it->path().filename().string() << ": " << mesh.num_of_face_list() << " faces, "
+         << simplifier.num_of_collapses() << " collapses in " << best * 1e3 << " ms, "
+         << simplifier.num_of_collapses() / best << " collapses/s" << std::endl;
+      total_collapses += simplifier.num_of_collapses();
+      total_seconds += best;
+   }
+   if (total_seconds > 0.0)
+      std::cout << "all: " << total_collapses / total_seconds << " collapses/s" << std::endl;
+   return 0;
 }
 
 // Main routine.
 int main(int argc, char **argv)
 {
+   // OBJmodelViewer -simplify-bench [dir]: benchmark instead of the viewer
+   if (argc > 1 && std::string(argv[1]) == "-simplify-bench")
+      return benchmarkSimplify(argc > 2 ? argv[2] : "../../../obj_model");
+
    printInteraction();
    glutInit(&argc, argv);
 